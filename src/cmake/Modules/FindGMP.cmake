@@ -8,6 +8,21 @@ find_library(GMP_LIBRARIES NAMES gmp libgmp REQUIRED)
 #find_library(GMPXX_LIBRARIES NAMES gmpxx libgmpxx )
 #MESSAGE(STATUS "GMP: " ${GMP_LIBRARIES}) # " " ${GMPXX_LIBRARIES} )
 
+# Determine GMP version
+if(GMP_INCLUDE_DIR AND EXISTS "${GMP_INCLUDE_DIR}/gmp.h")
+  file(STRINGS "${GMP_INCLUDE_DIR}/gmp.h" gmp_version_str REGEX "^#define[ \t]+__GNU_MP_VERSION(_MINOR|_PATCHLEVEL)?[ \t]+[0-9]+")
+  string(REGEX REPLACE ".*#define[ \t]+__GNU_MP_VERSION[ \t]+([0-9]+).*" "\\1" gmp_major "${gmp_version_str}")
+  string(REGEX REPLACE ".*#define[ \t]+__GNU_MP_VERSION_MINOR[ \t]+([0-9]+).*" "\\1" gmp_minor "${gmp_version_str}")
+  string(REGEX REPLACE ".*#define[ \t]+__GNU_MP_VERSION_PATCHLEVEL[ \t]+([0-9]+).*" "\\1" gmp_patch "${gmp_version_str}")
+  set(GMP_VERSION "${gmp_major}.${gmp_minor}.${gmp_patch}")
+  unset(gmp_version_str)
+  unset(gmp_major)
+  unset(gmp_minor)
+  unset(gmp_patch)
+endif()
+
 include(FindPackageHandleStandardArgs)
-FIND_PACKAGE_HANDLE_STANDARD_ARGS(GMP DEFAULT_MSG GMP_INCLUDE_DIR GMP_LIBRARIES)
+FIND_PACKAGE_HANDLE_STANDARD_ARGS(GMP
+                                  REQUIRED_VARS GMP_INCLUDE_DIR GMP_LIBRARIES
+                                  VERSION_VAR GMP_VERSION)
 mark_as_advanced(GMP_INCLUDE_DIR GMP_LIBRARIES)
\ No newline at end of file
@@ -148,6 +148,9 @@ void parser_imp::parse_def_core(bool is_definition) {
             pre_val   = mk_abstraction(expr_kind::Lambda, parameters, val_body);
         }
     }
+    if (!is_definition && elaborate_proof_async(mk_full_name(id), pre_type, pre_val, parameters))
+        return;
+    join_pending_proofs(); // the theorem is processed sequentially
     auto r = elaborate(id, pre_type, pre_val);
     expr type = std::get<0>(r);
     expr val  = std::get<1>(r);
@@ -901,11 +904,17 @@ void parser_imp::parse_enable_rewrite(bool flag) {
 
 /** \brief Parse a Lean command. */
 bool parser_imp::parse_command() {
+    name const & cmd_id = curr_name();
+    if (!m_pending_proofs.empty() && cmd_id != g_theorem_kwd) {
+        // The pending proofs are elaborated using m_env, so it must not be modified while they are running.
+        // Moreover, joining them here guarantees that errors are reported in source order.
+        join_pending_proofs();
+    }
     m_elaborator.clear();
-    m_expr_pos_info.clear();
+    // the previous table may be retained by error messages and pending proofs
+    m_pos_table = std::make_shared<pos_info_table>();
     m_tactic_hints.clear();
     m_last_cmd_pos = pos();
-    name const & cmd_id = curr_name();
     if (cmd_id == g_definition_kwd) {
         parse_definition();
     } else if (cmd_id == g_variable_kwd) {
@@ -27,15 +27,14 @@ void parser_imp::display_error(char const * msg, unsigned line, unsigned pos) {
 }
 
 std::pair<unsigned, unsigned> parser_imp::lean_pos_info_provider::get_pos_info(expr const & e) const {
-    expr const & o = m_parser->m_elaborator.get_original(e);
-    auto it = m_parser->m_expr_pos_info.find(o);
-    if (it == m_parser->m_expr_pos_info.end())
-        return m_pos;
-    return it->second;
+    expr const & o = m_elaborator.get_original(e);
+    if (auto p = m_pos_table->find(o))
+        return *p;
+    return m_pos;
 }
 
 char const * parser_imp::lean_pos_info_provider::get_file_name() const {
-    return m_parser->m_strm_name.c_str();
+    return m_strm_name.c_str();
 }
 
 void parser_imp::display_error(tactic_cmd_error const & ex) {
@@ -44,12 +43,12 @@ void parser_imp::display_error(tactic_cmd_error const & ex) {
 }
 
 void parser_imp::display_error(exception const & ex) {
-    lean_pos_info_provider pos_provider(m_this.lock(), m_last_cmd_pos);
+    lean_pos_info_provider pos_provider(*this, m_last_cmd_pos);
     ::lean::display_error(m_io_state, &pos_provider, ex);
 }
 
 void parser_imp::display_error(script_exception const & ex) {
-    lean_pos_info_provider pos_provider(m_this.lock(), m_last_script_pos);
+    lean_pos_info_provider pos_provider(*this, m_last_script_pos);
     ::lean::display_error(m_io_state, &pos_provider, ex);
 }
 
@@ -87,12 +86,12 @@ void parser_imp::protected_call(std::function<void()> && f, std::function<void()
         reset_interrupt();
         CATCH(display_error(ex),
               throw parser_nested_exception(std::shared_ptr<exception>(ex.clone()),
-                                            std::shared_ptr<pos_info_provider>(new lean_pos_info_provider(m_this.lock(), m_last_script_pos))));
+                                            std::shared_ptr<pos_info_provider>(new lean_pos_info_provider(*this, m_last_script_pos))));
     } catch (exception & ex) {
         reset_interrupt();
         CATCH(display_error(ex),
               throw parser_nested_exception(std::shared_ptr<exception>(ex.clone()),
-                                            std::shared_ptr<pos_info_provider>(new lean_pos_info_provider(m_this.lock(), m_last_cmd_pos))));
+                                            std::shared_ptr<pos_info_provider>(new lean_pos_info_provider(*this, m_last_cmd_pos))));
     }
 }
 }
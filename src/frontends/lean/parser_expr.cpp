@@ -10,7 +10,6 @@ Author: Leonardo de Moura
 #include <vector>
 #include "util/flet.h"
 #include "util/sstream.h"
-#include "kernel/for_each_fn.h"
 #include "kernel/free_vars.h"
 #include "kernel/kernel.h"
 #include "library/placeholder.h"
@@ -284,18 +283,18 @@ expr parser_imp::get_name_ref(name const & id, pos_info const & p, bool implicit
             }
         }
     }
+    if (!m_pending_proofs.empty()) {
+        // id may be a theorem whose proof is still being elaborated
+        join_pending_proofs();
+        return get_name_ref(id, p, implicit_args);
+    }
     throw parser_error(sstream() << "unknown identifier '" << id << "'", p);
 }
 
-void parser_imp::propagate_position(expr const & e, pos_info p) {
-    for_each(e, [&](expr const & e, unsigned) {
-            if (m_expr_pos_info.find(e) == m_expr_pos_info.end()) {
-                save(e, p);
-                return true;
-            } else {
-                return false; // do not search children...
-            }
-        });
+expr parser_imp::propagate_position(expr const & e, pos_info p) {
+    // Remark: the result of a macro may share subexpressions with expressions being elaborated
+    // by other threads, pos_info_table::propagate does not modify them.
+    return m_pos_table->propagate(e, p);
 }
 
 bool parser_imp::is_curr_begin_expr() const {
@@ -476,8 +475,7 @@ parser_imp::macro_result parser_imp::parse_macro(list<macro_arg_kind> const & ar
                 if (is_expr(L, -1)) {
                     expr r = to_expr(L, -1);
                     lua_pop(L, 1);
-                    propagate_position(r, p);
-                    return macro_result(r);
+                    return macro_result(propagate_position(r, p));
                 } else if (is_tactic(L, -1)) {
                     tactic t = to_tactic(L, -1);
                     lua_pop(L, 1);
@@ -1048,9 +1046,9 @@ expr parser_imp::parse_nud() {
 expr parser_imp::mk_app_left(expr const & left, expr const & arg) {
     if (is_type(left))
         throw parser_error("Type is not a function, use '(Type <universe>)' for specifying a particular type universe", pos());
-    auto it = m_expr_pos_info.find(left);
-    lean_assert(it != m_expr_pos_info.end());
-    return save(mk_app(left, arg), it->second);
+    auto p = m_pos_table->find(left);
+    lean_assert(p);
+    return save(mk_app(left, arg), *p);
 }
 
 /**
@@ -4,6 +4,7 @@ Released under Apache 2.0 license as described in the file LICENSE.
 
 Author: Leonardo de Moura
 */
+#include <algorithm>
 #include <utility>
 #include <string>
 #include <vector>
@@ -17,14 +18,22 @@ Author: Leonardo de Moura
 #define LEAN_DEFAULT_PARSER_SHOW_ERRORS true
 #endif
 
+#ifndef LEAN_DEFAULT_PARSER_PARALLEL_PROOFS
+#define LEAN_DEFAULT_PARSER_PARALLEL_PROOFS 0
+#endif
+
 namespace lean {
 // ==========================================
 // Parser configuration options
-static name g_parser_show_errors {"lean", "parser", "show_errors"};
+static name g_parser_show_errors    {"lean", "parser", "show_errors"};
+static name g_parser_parallel_proofs {"lean", "parser", "parallel_proofs"};
 
 RegisterBoolOption(g_parser_show_errors, LEAN_DEFAULT_PARSER_SHOW_ERRORS, "(lean parser) display error messages in the regular output channel");
+RegisterUnsignedOption(g_parser_parallel_proofs, LEAN_DEFAULT_PARSER_PARALLEL_PROOFS,
+                       "(lean parser) maximum number of theorem proofs elaborated in parallel with the rest of the file, 0 means proofs are elaborated sequentially");
 
 bool     get_parser_show_errors(options const & opts)  { return opts.get_bool(g_parser_show_errors, LEAN_DEFAULT_PARSER_SHOW_ERRORS); }
+unsigned get_parser_parallel_proofs(options const & opts) { return opts.get_unsigned(g_parser_parallel_proofs, LEAN_DEFAULT_PARSER_PARALLEL_PROOFS); }
 // ==========================================
 
 void parser_imp::code_with_callbacks(std::function<void()> && f) {
@@ -54,11 +63,10 @@ calc_proof_parser & parser_imp::get_calc_proof_parser() {
 }
 
 pos_info parser_imp::pos_of(expr const & e, pos_info default_pos) {
-    auto it = m_expr_pos_info.find(e);
-    if (it == m_expr_pos_info.end())
-        return default_pos;
+    if (auto p = m_pos_table->find(e))
+        return *p;
     else
-        return it->second;
+        return default_pos;
 }
 
 void parser_imp::check_next(scanner::token t, char const * msg) {
@@ -104,6 +112,7 @@ double parser_imp::parse_double() {
 void parser_imp::updt_options() {
     m_verbose = get_verbose(m_io_state.get_options());
     m_show_errors = get_parser_show_errors(m_io_state.get_options());
+    m_parallel_proofs = get_parser_parallel_proofs(m_io_state.get_options());
 }
 
 /**
@@ -111,6 +120,8 @@ void parser_imp::updt_options() {
    it appends the string "return " in front of the script.
 */
 void parser_imp::parse_script(bool as_expr) {
+    // the script may access the environment
+    join_pending_proofs();
     m_last_script_pos = mk_pair(m_scanner.get_script_block_line(), m_scanner.get_script_block_pos());
     if (!m_script_state)
         throw exception("failed to execute Lua script, parser does not have a Lua interpreter");
@@ -155,6 +166,7 @@ parser_imp::parser_imp(environment const & env, io_state const & st, std::istrea
     m_script_state(S),
     m_set_parser(m_script_state, this) {
     m_namespace_prefixes.push_back(name());
+    m_pos_table = std::make_shared<pos_info_table>();
     m_check_identifiers = true;
     updt_options();
     m_found_errors = false;
@@ -182,7 +194,17 @@ parser_imp::parser_imp(environment const & env, io_state const & st, std::istrea
                    [&]() { sync_command(); });
 }
 
-parser_imp::~parser_imp() {}
+parser_imp::~parser_imp() {
+    // The theorems were not added to the environment, we just stop the threads.
+    for (auto & t : m_pending_proofs) {
+        try {
+            t->m_thread->request_interrupt();
+        } catch (...) {
+        }
+        if (t->m_thread->joinable())
+            t->m_thread->join();
+    }
+}
 
 void parser_imp::show_prompt(bool interactive, io_state const & ios) {
     if (interactive) {
@@ -202,23 +224,136 @@ void parser_imp::show_tactic_prompt() {
     }
 }
 
+/**
+   \brief Elaborate the statement of the theorem \c full_id, and create a task for elaborating its
+   proof in a separate thread. Return false if the theorem must be processed sequentially.
+   This is the case when the proof uses tactics, or the statement cannot be elaborated
+   without the proof.
+
+   \remark The theorem is only added to the environment when the task is joined (see
+   #join_pending_proof). Identifiers are resolved by the main thread, and
+   #get_name_ref joins the pending proofs when an identifier is not found.
+   The tasks read \c m_env, so the pending proofs are joined before any command
+   other than \c Theorem is processed (see #parse_command).
+*/
+bool parser_imp::elaborate_proof_async(name const & full_id, expr const & pre_type, expr const & pre_val,
+                                       parameter_buffer const & parameters) {
+#if defined(LEAN_MULTI_THREAD)
+    if (m_parallel_proofs == 0 || m_interactive || !m_tactic_hints.empty())
+        return false;
+    expr type = elaborate(pre_type).first;
+    if (has_metavar(type))
+        return false;
+    if (m_pending_proofs.size() >= m_parallel_proofs)
+        join_pending_proofs();
+    std::unique_ptr<pending_proof> t(new pending_proof(full_id, type, m_env));
+    t->m_parameters    = parameters;
+    t->m_cmd_pos       = m_last_cmd_pos;
+    t->m_pos_table     = m_pos_table;
+    pending_proof * ptr = t.get();
+    options opts        = m_io_state.get_options();
+    t->m_thread.reset(new interruptible_thread([=]() {
+                try {
+                    ptr->m_elaborator.reset(new frontend_elaborator(ptr->m_env));
+                    auto r = (*ptr->m_elaborator)(ptr->m_name, ptr->m_type, pre_val, opts);
+                    ptr->m_val  = std::get<1>(r);
+                    ptr->m_menv = std::get<2>(r);
+                } catch (...) {
+                    // the exception is rethrown by join_pending_proof
+                    ptr->m_exception = std::current_exception();
+                }
+            }));
+    m_pending_proofs.push_back(std::move(t));
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+   \brief Add the theorem of the oldest pending proof to the environment.
+   Errors are reported using the position information of the theorem.
+
+   \pre The threads of all pending proofs have terminated, since they read \c m_env.
+*/
+void parser_imp::join_pending_proof() {
+    lean_assert(!m_pending_proofs.empty());
+    std::unique_ptr<pending_proof> t(std::move(m_pending_proofs.front()));
+    m_pending_proofs.pop_front();
+    /** \brief Auxiliary object for temporarily using the state of the given task. */
+    struct use_task_state {
+        parser_imp &    m_p;
+        pending_proof & m_t;
+        pos_info        m_old_cmd_pos;
+        tactic_hints    m_old_tactic_hints;
+        use_task_state(parser_imp & p, pending_proof & t):m_p(p), m_t(t), m_old_cmd_pos(p.m_last_cmd_pos) {
+            std::swap(m_p.m_pos_table, m_t.m_pos_table);
+            if (m_t.m_elaborator)
+                std::swap(m_p.m_elaborator, *m_t.m_elaborator);
+            std::swap(m_p.m_tactic_hints, m_old_tactic_hints);
+            m_p.m_last_cmd_pos = m_t.m_cmd_pos;
+        }
+        ~use_task_state() {
+            std::swap(m_p.m_pos_table, m_t.m_pos_table);
+            if (m_t.m_elaborator)
+                std::swap(m_p.m_elaborator, *m_t.m_elaborator);
+            std::swap(m_p.m_tactic_hints, m_old_tactic_hints);
+            m_p.m_last_cmd_pos = m_old_cmd_pos;
+        }
+    };
+    use_task_state s(*this, *t);
+    protected_call([&]() {
+            if (t->m_exception)
+                std::rethrow_exception(t->m_exception);
+            expr val = t->m_val;
+            if (has_metavar(val))
+                val = apply_tactics(val, t->m_menv);
+            check_no_metavar(val, t->m_menv, "invalid definition, value still contains metavariables after elaboration");
+            m_env->add_theorem(t->m_name, t->m_type, val);
+            if (m_verbose)
+                regular(m_io_state) << "  Proved: " << t->m_name << endl;
+            register_implicit_arguments(t->m_name, t->m_parameters);
+        },
+        []() {});
+}
+
+/**
+   \brief Join all pending proofs (in source order). We wait for all threads before we
+   modify the environment.
+*/
+void parser_imp::join_pending_proofs() {
+    for (auto & t : m_pending_proofs) {
+        if (t->m_thread->joinable())
+            t->m_thread->join();
+    }
+    while (!m_pending_proofs.empty())
+        join_pending_proof();
+}
+
 /** \brief Parse a sequence of commands. This method also perform error management. */
 bool parser_imp::parse_commands() {
     bool done = false;
     while (!done) {
         protected_call([&]() {
-                check_interrupted();
-                switch (curr()) {
-                case scanner::token::CommandId:   if (!parse_command()) done = true; break;
-                case scanner::token::ScriptBlock: parse_script(); break;
-                case scanner::token::Period:      show_prompt(); next(); break;
-                case scanner::token::Eof:         done = true; break;
-                default:
-                    throw parser_error("Command expected", pos());
+                try {
+                    check_interrupted();
+                    switch (curr()) {
+                    case scanner::token::CommandId:   if (!parse_command()) done = true; break;
+                    case scanner::token::ScriptBlock: parse_script(); break;
+                    case scanner::token::Period:      show_prompt(); next(); break;
+                    case scanner::token::Eof:         done = true; break;
+                    default:
+                        throw parser_error("Command expected", pos());
+                    }
+                } catch (...) {
+                    // The pending proofs precede the command that failed, so their errors must be reported first.
+                    join_pending_proofs();
+                    throw;
                 }
             },
             [&]() { sync_command(); });
     }
+    join_pending_proofs();
     return !m_found_errors;
 }
 
@@ -232,7 +367,7 @@ expr parser_imp::parse_expr_main() {
         throw parser_exception(ex.what(), m_strm_name.c_str(), ex.m_pos.first, ex.m_pos.second);
     } catch (exception & ex) {
         throw parser_nested_exception(std::shared_ptr<exception>(ex.clone()),
-                                      std::shared_ptr<pos_info_provider>(new lean_pos_info_provider(m_this.lock(), m_last_cmd_pos)));
+                                      std::shared_ptr<pos_info_provider>(new lean_pos_info_provider(*this, m_last_cmd_pos)));
     }
 }
 };
@@ -5,9 +5,13 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Author: Leonardo de Moura
 */
 #pragma once
+#include <deque>
+#include <memory>
+#include <exception>
 #include <utility>
 #include <string>
 #include <vector>
+#include "util/interrupt.h"
 #include "util/name_map.h"
 #include "util/scoped_map.h"
 #include "util/script_exception.h"
@@ -16,6 +20,7 @@ Author: Leonardo de Moura
 #include "kernel/io_state.h"
 #include "kernel/environment.h"
 #include "library/kernel_bindings.h"
+#include "library/pos_info_table.h"
 #include "library/tactic/tactic.h"
 #include "library/elaborator/elaborator_exception.h"
 #include "library/unsolved_metavar_exception.h"
@@ -42,6 +47,7 @@ class calc_proof_parser;
 
 bool get_parser_verbose(options const & opts);
 bool get_parser_show_errors(options const & opts);
+unsigned get_parser_parallel_proofs(options const & opts);
 
 /** \brief Auxiliary object that stores a reference to the parser object inside the Lua State */
 struct set_parser {
@@ -65,12 +71,10 @@ class parser_imp {
     friend int mk_cmd_macro(lua_State * L);
     typedef scoped_map<name, unsigned, name_hash, name_eq> local_decls;
     typedef name_map<expr> builtins;
-    typedef expr_map<pos_info> expr_pos_info;
     typedef expr_map<tactic>   tactic_hints; // a mapping from placeholder to tactic
     typedef scoped_map<name, name, name_hash, name_eq>      using_decls;
     enum class scope_kind { Scope, Namespace };
 
-    std::weak_ptr<parser_imp>          m_this;
     environment                        m_env;
     io_state                           m_io_state;
     scanner                            m_scanner;
@@ -85,7 +89,7 @@ class parser_imp {
     bool                               m_found_errors;
     local_decls                        m_local_decls;
     unsigned                           m_num_local_decls;
-    expr_pos_info                      m_expr_pos_info;
+    std::shared_ptr<pos_info_table>    m_pos_table; // positions of the expressions of the current command
     pos_info                           m_last_cmd_pos;
     pos_info                           m_last_script_pos;
     tactic_hints                       m_tactic_hints;
@@ -94,6 +98,30 @@ class parser_imp {
     std::vector<scope_kind>            m_scope_kinds;
     std::unique_ptr<calc_proof_parser> m_calc_proof_parser;
 
+    /**
+        \brief Theorem whose proof is being elaborated in a separate thread.
+        The statement was already elaborated by the main thread. The theorem is added to
+        the environment when the task is joined. Tasks are joined in source order, thus
+        errors are also reported in source order.
+
+        The elaborator (and its type checker and normalizer) is created by the worker thread,
+        since their memory shedders belong to the thread that creates them.
+    */
+    struct pending_proof {
+        name                                  m_name;
+        expr                                  m_type;
+        environment                           m_env;
+        parameter_buffer                      m_parameters;
+        pos_info                              m_cmd_pos;
+        std::shared_ptr<pos_info_table>       m_pos_table;
+        std::unique_ptr<frontend_elaborator>  m_elaborator;
+        expr                                  m_val;
+        metavar_env                           m_menv;
+        std::exception_ptr                    m_exception;
+        std::unique_ptr<interruptible_thread> m_thread;
+        pending_proof(name const & n, expr const & t, environment const & env):m_name(n), m_type(t), m_env(env) {}
+    };
+    std::deque<std::unique_ptr<pending_proof>> m_pending_proofs;
 
     // If true then return error when parsing identifiers and it is not local or global.
     // We set this flag off when parsing tactics. The apply_tac may reference
@@ -106,6 +134,7 @@ class parser_imp {
 
     bool                m_verbose;
     bool                m_show_errors;
+    unsigned            m_parallel_proofs; // maximum number of proofs being elaborated in parallel, 0 if disabled
 
     template<typename F>
     typename std::result_of<F(lua_State * L)>::type using_script(F && f) {
@@ -141,8 +170,11 @@ public:
     /** \brief Return the position associated with \c e. If there is none, then return \c default_pos. */
     pos_info pos_of(expr const & e, pos_info default_pos);
 
-    /** \brief Associate position \c p with \c e and return \c e */
-    expr save(expr const & e, pos_info p) { m_expr_pos_info[e] = p; return e; }
+    /**
+        \brief Associate position \c p with \c e and return \c e.
+        The result is a copy of \c e if it is shared (see \c pos_info_table::save).
+    */
+    expr save(expr const & e, pos_info p) { return m_pos_table->save(e, p); }
 
     /** \brief Read the next token. */
     void scan() { m_curr = m_scanner.scan(); }
@@ -218,10 +250,17 @@ private:
     void display_error_pos(pos_info const & p);
     void display_error(char const * msg, unsigned line, unsigned pos);
 
+    /**
+        \brief Position information for the expressions of the current command.
+        It does not reference the parser, thus it can be retained after parsing.
+    */
     struct lean_pos_info_provider : public pos_info_provider {
-        std::shared_ptr<parser_imp> m_parser;
-        pos_info                    m_pos;
-        lean_pos_info_provider(std::shared_ptr<parser_imp> const & p, pos_info const & pos):m_parser(p), m_pos(pos) {}
+        std::shared_ptr<pos_info_table const> m_pos_table;
+        frontend_elaborator                   m_elaborator;
+        std::string                           m_strm_name;
+        pos_info                              m_pos;
+        lean_pos_info_provider(parser_imp const & p, pos_info const & pos):
+            m_pos_table(p.m_pos_table), m_elaborator(p.m_elaborator), m_strm_name(p.m_strm_name), m_pos(pos) {}
         virtual std::pair<unsigned, unsigned> get_pos_info(expr const & e) const;
         virtual std::pair<unsigned, unsigned> get_some_pos() const { return m_pos; }
         virtual char const * get_file_name() const;
@@ -298,7 +337,7 @@ private:
     expr parse_mixfixr(expr const & left, operator_info const & op, pos_info const & op_pos);
     expr parse_mixfixo(expr const & left, operator_info const & op, pos_info const & op_pos);
     expr parse_mixfixc(operator_info const & op);
-    void propagate_position(expr const & e, pos_info p);
+    expr propagate_position(expr const & e, pos_info p);
     bool is_curr_begin_expr() const;
     bool is_curr_begin_tactic() const;
     typedef buffer<std::pair<macro_arg_kind, void*>> macro_arg_stack;
@@ -416,6 +455,9 @@ private:
     void check_no_metavar(expr const & e, metavar_env const & menv, char const * msg);
     void check_no_metavar(std::pair<expr, metavar_env> const & p, char const * msg);
     name mk_full_name(name const & n);
+    bool elaborate_proof_async(name const & full_id, expr const & pre_type, expr const & pre_val, parameter_buffer const & parameters);
+    void join_pending_proof();
+    void join_pending_proofs();
     void parse_def_core(bool is_definition);
     void parse_definition();
     void parse_theorem();
@@ -7,6 +7,7 @@ Author: Leonardo de Moura
 #include <limits>
 #include <memory>
 #include <tuple>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 #include "util/scoped_map.h"
@@ -186,7 +187,8 @@ class pp_fn {
     local_aliases_defs m_local_aliases_defs;
     local_names        m_local_names;
     unsigned           m_num_steps;
-    name               m_aux;
+    expr               m_root;             //!< expression being pretty printed
+    optional<name>     m_aux;              //!< prefix for local aliases, it is only computed if an alias is created
     expr_map<unsigned> m_num_occs;
     // Configuration
     unsigned           m_indent;
@@ -205,25 +207,49 @@ class pp_fn {
         unsigned           m_old_size;
         expr_map<unsigned> m_num_occs;
 
-        void update_num_occs(expr const & e) {
-            buffer<expr> todo;
-            todo.push_back(e);
+        /**
+           \brief Count the occurrences of the subterms of \c e (a term at the given depth).
+
+           We only visit the subterms that may be displayed, i.e., the ones that are not
+           replaced with an ellipsis because of the pp.max_depth and pp.max_steps
+           limits (see \c pp). Thus, the cost does not depend on the size of \c e.
+           The counters are only used to decide whether an alias should be created, so
+           an approximation is fine when a shared subterm is reached at different depths.
+        */
+        void update_num_occs(expr const & e, unsigned depth) {
+            unsigned num_steps = m_fn.m_num_steps;
+            buffer<std::pair<expr, unsigned>> todo;
+            todo.emplace_back(e, depth);
             while (!todo.empty()) {
-                expr e = todo.back();
+                auto p = todo.back();
                 todo.pop_back();
-                unsigned & n = m_num_occs[e];
+                expr const & e = p.first;
+                unsigned d     = p.second;
+                unsigned & n   = m_num_occs[e];
                 n++;
+                if (num_steps > m_fn.m_max_steps)
+                    continue;
+                num_steps++;
                 // we do not visit other composite expressions such as Let, Lambda and Pi, since they create new scopes
                 if (n == 1 && is_app(e)) {
-                    for (unsigned i = 0; i < num_args(e); i++)
-                        todo.push_back(arg(e, i));
+                    if (!m_fn.m_coercion && m_fn.is_coercion(e)) {
+                        // the coerced argument is displayed at the same depth (see pp_app)
+                        todo.emplace_back(arg(e, 1), d);
+                    } else if (d < m_fn.m_max_depth) {
+                        // push in reverse order, then the arguments are visited in the same order used by pp_app
+                        unsigned i = num_args(e);
+                        while (i > 0) {
+                            --i;
+                            todo.emplace_back(arg(e, i), d + 1);
+                        }
+                    }
                 }
             }
         }
 
-        mk_scope(pp_fn & fn, expr const & e):m_fn(fn), m_old_size(fn.m_local_aliases_defs.size()) {
+        mk_scope(pp_fn & fn, expr const & e, unsigned depth):m_fn(fn), m_old_size(fn.m_local_aliases_defs.size()) {
             m_fn.m_local_aliases.push();
-            update_num_occs(e);
+            update_num_occs(e, depth);
             swap(m_fn.m_num_occs, m_num_occs);
         }
         ~mk_scope() {
@@ -763,6 +789,13 @@ class pp_fn {
             unsigned r_weight = p.second;
             unsigned num      = app.get_num_args();
             for (unsigned i = 0; i < num; i++) {
+                if (m_num_steps > m_max_steps && i + 1 < num) {
+                    // The step budget is exhausted, we do not materialize the remaining arguments.
+                    // They are displayed as a single ellipsis.
+                    r_format += format{i == 0 && simple ? space() : line(), pp_ellipsis().first};
+                    r_weight += 1;
+                    break;
+                }
                 result p_arg = pp_child(app.get_arg(i), depth);
                 r_format += format{i == 0 && simple ? space() : line(), p_arg.first};
                 r_weight += p_arg.second;
@@ -798,7 +831,7 @@ class pp_fn {
         if (is_atomic(e)) {
             return pp(e, depth + 1, true);
         } else {
-            mk_scope s(*this, e);
+            mk_scope s(*this, e, depth + 1);
             result r = pp(e, depth + 1, true);
             if (m_local_aliases_defs.size() == s.m_old_size) {
                 if (prec <= get_operator_precedence(e))
@@ -1207,7 +1240,7 @@ class pp_fn {
                 }
             }
             if (!main && m_extra_lets && has_several_occs(e) && r.second > m_alias_min_weight) {
-                name new_aux = name(m_aux, m_local_aliases_defs.size()+1);
+                name new_aux = name(get_aux(), m_local_aliases_defs.size()+1);
                 m_local_aliases.insert(e, new_aux);
                 m_local_aliases_defs.emplace_back(new_aux, r.first);
                 return mk_result(format(new_aux), 1);
@@ -1228,36 +1261,133 @@ class pp_fn {
         m_alias_min_weight = get_pp_alias_min_weight(opts);
     }
 
-    bool uses_prefix(expr const & e, name const & prefix) {
-        return static_cast<bool>(find(e, [&](expr const & e) {
-                    return
-                        (is_constant(e) && is_prefix_of(prefix, const_name(e)))   ||
-                        (is_abstraction(e) && is_prefix_of(prefix, abst_name(e))) ||
-                        (is_let(e) && is_prefix_of(prefix, let_name(e)));
-                }));
-    }
-
+    /**
+       \brief Return a prefix for naming local aliases that is not used in the subterms of \c e
+       that may be displayed. As in \c mk_scope::update_num_occs, the subterms replaced with an
+       ellipsis because of the pp.max_depth and pp.max_steps limits are not visited, thus the cost
+       does not depend on the size of \c e. The names are collected in a single pass.
+
+       Remark: the walk visits at least the subterms displayed by \c pp (except the local contexts of
+       metavariables). A shared subterm is only counted as a step the first time, it is visited again
+       only if it is reached at a smaller depth, atomic subterms and coercions are not counted, and
+       nested binders are visited at the depth used by \c pp_abstraction.
+    */
     name find_unused_prefix(expr const & e) {
-        if (!uses_prefix(e, g_a)) {
+        bool uses_a = false;
+        bool uses_b = false;
+        std::unordered_set<unsigned> uses_c; // the i's such that c.i is used
+        auto visit_name = [&](name const & n) {
+            if (n.is_anonymous())
+                return;
+            name root = n;
+            name child;
+            while (!root.is_atomic()) {
+                child = root;
+                root  = root.get_prefix();
+            }
+            if (root == g_a)
+                uses_a = true;
+            else if (root == g_b)
+                uses_b = true;
+            else if (root == g_c && child && child.is_numeral())
+                uses_c.insert(child.get_numeral());
+        };
+        expr_map<unsigned> visited; // smallest depth a subterm was reached at
+        unsigned num_steps = 0;
+        buffer<std::pair<expr, unsigned>> todo;
+        todo.emplace_back(e, 1); // the root is displayed at depth 1, see operator()
+        while (!todo.empty()) {
+            auto p = todo.back();
+            todo.pop_back();
+            expr const & s = p.first;
+            unsigned d     = p.second;
+            auto it = visited.find(s);
+            if (it != visited.end() && it->second <= d)
+                continue;
+            bool first = it == visited.end();
+            visited[s] = d;
+            if (is_constant(s))
+                visit_name(const_name(s));
+            else if (is_abstraction(s))
+                visit_name(abst_name(s));
+            else if (is_let(s))
+                visit_name(let_name(s));
+            if (is_app(s) && !m_coercion && is_coercion(s)) {
+                // the coerced argument is displayed at the same depth (see pp_app)
+                todo.emplace_back(arg(s, 1), d);
+                continue;
+            }
+            if (is_atomic(s) || d > m_max_depth || num_steps > m_max_steps)
+                continue;
+            if (first)
+                num_steps++;
+            // children are pushed in reverse order, then they are visited in the same order used by pp
+            switch (s.kind()) {
+            case expr_kind::App: {
+                unsigned i = num_args(s);
+                while (i > 0) {
+                    --i;
+                    todo.emplace_back(arg(s, i), d + 1);
+                }
+                break;
+            }
+            case expr_kind::Lambda: case expr_kind::Pi: case expr_kind::Sigma:
+                // nested binders of the same kind are displayed together
+                todo.emplace_back(abst_body(s), abst_body(s).kind() == s.kind() ? d : d + 1);
+                todo.emplace_back(abst_domain(s), d + 1);
+                break;
+            case expr_kind::Let:
+                todo.emplace_back(let_body(s), is_let(let_body(s)) ? d : d + 1);
+                todo.emplace_back(let_value(s), d + 1);
+                if (let_type(s))
+                    todo.emplace_back(*let_type(s), d + 1);
+                break;
+            case expr_kind::HEq:
+                todo.emplace_back(heq_rhs(s), d + 1);
+                todo.emplace_back(heq_lhs(s), d + 1);
+                break;
+            case expr_kind::Pair:
+                todo.emplace_back(pair_type(s), d + 1);
+                todo.emplace_back(pair_second(s), d + 1);
+                todo.emplace_back(pair_first(s), d + 1);
+                break;
+            case expr_kind::Proj:
+                todo.emplace_back(proj_arg(s), d + 1);
+                break;
+            case expr_kind::Var: case expr_kind::Constant: case expr_kind::Value:
+            case expr_kind::Type: case expr_kind::MetaVar:
+                break;
+            }
+        }
+        if (!uses_a) {
             return g_a;
-        } else if (!uses_prefix(e, g_b)) {
+        } else if (!uses_b) {
             return g_b;
         } else {
             unsigned i = 1;
-            name n(g_c, i);
-            while (uses_prefix(e, n)) {
+            while (uses_c.find(i) != uses_c.end())
                 i++;
-                n = name(g_c, i);
-            }
-            return n;
+            return name(g_c, i);
         }
     }
 
+    /**
+       \brief Return the prefix for naming local aliases. It is computed on demand, since
+       it requires a traversal of the expression being pretty printed, and most
+       expressions do not need aliases.
+    */
+    name const & get_aux() {
+        if (!m_aux)
+            m_aux = find_unused_prefix(m_root);
+        return *m_aux;
+    }
+
     void init(expr const & e) {
         m_local_aliases.clear();
         m_local_aliases_defs.clear();
         m_num_steps = 0;
-        m_aux = find_unused_prefix(e);
+        m_root      = e;
+        m_aux       = optional<name>();
     }
 
 public:
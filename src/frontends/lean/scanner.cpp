@@ -99,6 +99,28 @@ char normalize(char c) {
     return g_normalized[static_cast<unsigned char>(c)];
 }
 
+/**
+   \brief Store in \c r the remaining contents of \c in, and return true.
+   Return false (and consume nothing) if \c in is not seekable (e.g., a terminal or a pipe).
+*/
+static bool read_all(std::istream & in, std::string & r) {
+    std::streampos begin = in.tellg();
+    if (begin == std::streampos(-1))
+        return false;
+    in.seekg(0, std::ios::end);
+    std::streampos end = in.tellg();
+    in.seekg(begin);
+    if (end == std::streampos(-1) || !in) {
+        in.clear();
+        in.seekg(begin);
+        return false;
+    }
+    r.resize(static_cast<size_t>(end - begin));
+    in.read(&r[0], r.size());
+    r.resize(static_cast<size_t>(in.gcount()));
+    return true;
+}
+
 scanner::scanner(std::istream& stream, char const * strm_name):
     m_spos(0),
     m_curr(0),
@@ -108,7 +130,15 @@ scanner::scanner(std::istream& stream, char const * strm_name):
     m_stream_name(strm_name),
     m_script_line(1),
     m_script_pos(0) {
-    next();
+    m_in_memory = read_all(stream, m_input);
+    m_idx       = 0;
+    m_tk_begin  = 0;
+    if (m_in_memory) {
+        m_curr = m_input.empty() ? EOF : m_input[0];
+        m_spos++;
+    } else {
+        next();
+    }
 }
 
 scanner::~scanner() {
@@ -124,23 +154,62 @@ void scanner::throw_exception(char const * msg) {
 
 void scanner::next() {
     lean_assert(m_curr != EOF);
-    m_curr = m_stream.get();
+    if (m_in_memory) {
+        lean_assert(m_idx < m_input.size());
+        m_idx++;
+        m_curr = m_idx < m_input.size() ? m_input[m_idx] : EOF;
+    } else {
+        m_curr = m_stream.get();
+    }
     m_spos++;
 }
 
 bool scanner::check_next(char c) {
     lean_assert(m_curr != EOF);
-    bool r = m_stream.get() == c;
-    m_stream.unget();
-    return r;
+    if (m_in_memory) {
+        return m_idx + 1 < m_input.size() && m_input[m_idx + 1] == c;
+    } else {
+        bool r = m_stream.get() == c;
+        m_stream.unget();
+        return r;
+    }
 }
 
 bool scanner::check_next_is_digit() {
     lean_assert(m_curr != EOF);
-    char c = m_stream.get();
-    bool r = '0' <= c && c <= '9';
-    m_stream.unget();
-    return r;
+    if (m_in_memory) {
+        if (m_idx + 1 >= m_input.size())
+            return false;
+        char c = m_input[m_idx + 1];
+        return '0' <= c && c <= '9';
+    } else {
+        char c = m_stream.get();
+        bool r = '0' <= c && c <= '9';
+        m_stream.unget();
+        return r;
+    }
+}
+
+/** \brief Mark the current character as the beginning of a token. */
+void scanner::start_token() {
+    m_buffer.clear();
+    m_tk_begin = m_idx;
+}
+
+/** \brief Move to the next character, the current one is part of the token. */
+void scanner::next_in_token() {
+    if (!m_in_memory)
+        m_buffer += curr();
+    next();
+}
+
+/**
+    \brief Store the token in \c m_buffer. The current character is not part of it.
+    When the whole input is in memory, the token is copied in a single step.
+*/
+void scanner::end_token() {
+    if (m_in_memory)
+        m_buffer.assign(m_input, m_tk_begin, m_idx - m_tk_begin);
 }
 
 void scanner::read_single_line_comment() {
@@ -178,28 +247,28 @@ name scanner::mk_name(name const & curr, std::string const & buf, bool only_digi
 
 scanner::token scanner::read_a_symbol() {
     lean_assert(normalize(curr()) == 'a');
-    m_buffer.clear();
-    m_buffer += curr();
+    start_token();
     m_name_val = name();
-    next();
+    next_in_token();
     bool only_digits = false;
     while (true) {
-        if (normalize(curr()) == 'a') {
+        char n = normalize(curr());
+        if (n == 'a') {
             if (only_digits)
                 throw_exception("invalid hierarchical name, digit expected");
-            m_buffer += curr();
-            next();
-        } else if (normalize(curr()) == '0') {
-            m_buffer += curr();
-            next();
+            next_in_token();
+        } else if (n == '0') {
+            next_in_token();
         } else if (curr() == ':' && check_next(':')) {
+            end_token();
+            m_name_val = mk_name(m_name_val, m_buffer, only_digits);
             next();
             lean_assert(curr() == ':');
             next();
-            m_name_val = mk_name(m_name_val, m_buffer, only_digits);
-            m_buffer.clear();
+            start_token();
             only_digits = (normalize(curr()) == '0');
         } else {
+            end_token();
             m_name_val = mk_name(m_name_val, m_buffer, only_digits);
             if (m_name_val == g_lambda_name) {
                 return token::Lambda;
@@ -241,16 +310,20 @@ scanner::token scanner::read_a_symbol() {
 
 scanner::token scanner::read_b_symbol(char prev) {
     lean_assert(normalize(curr()) == 'b' || curr() == '-');
-    m_buffer.clear();
-    if (prev != 0)
-        m_buffer += prev;
-    m_buffer += curr();
-    next();
+    start_token();
+    if (prev != 0) {
+        // prev is the character before the current one
+        if (m_in_memory)
+            m_tk_begin--;
+        else
+            m_buffer += prev;
+    }
+    next_in_token();
     while (true) {
         if (normalize(curr()) == 'b' || curr() == '-') {
-            m_buffer += curr();
-            next();
+            next_in_token();
         } else {
+            end_token();
             m_name_val = name(m_buffer.c_str());
             if (m_name_val == g_arrow_name)
                 return token::Arrow;
@@ -266,14 +339,13 @@ scanner::token scanner::read_b_symbol(char prev) {
 
 scanner::token scanner::read_c_symbol() {
     lean_assert(normalize(curr()) == 'c');
-    m_buffer.clear();
-    m_buffer += curr();
-    next();
+    start_token();
+    next_in_token();
     while (true) {
         if (normalize(curr()) == 'c') {
-            m_buffer += curr();
-            next();
+            next_in_token();
         } else {
+            end_token();
             m_name_val = name(m_buffer.c_str());
             if (m_name_val == g_arrow_unicode)
                 return token::Arrow;
@@ -15,6 +15,10 @@ Author: Leonardo de Moura
 namespace lean {
 /**
     \brief Lean scanner.
+
+    When the input stream is seekable (e.g., a file), its contents are read in a single
+    block, and the tokens are extracted directly from this buffer. Otherwise (e.g., the
+    standard input of an interactive session), the characters are read one by one.
 */
 class scanner {
 public:
@@ -41,12 +45,20 @@ protected:
 
     list<name>         m_commands;
 
+    bool               m_in_memory; // true if the whole input is stored in m_input
+    std::string        m_input;
+    size_t             m_idx;       // position of the current char in m_input
+    size_t             m_tk_begin;  // position of the first char of the current token in m_input
+
     void  throw_exception(char const * msg);
     char  curr() const { return m_curr; }
     void  new_line() { m_line++; m_spos = 0; }
     void  next();
     bool  check_next(char c);
     bool  check_next_is_digit();
+    void  start_token();
+    void  next_in_token();
+    void  end_token();
     void  read_single_line_comment();
     name  mk_name(name const & curr, std::string const & buf, bool only_digits);
     token read_a_symbol();
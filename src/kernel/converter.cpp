@@ -6,12 +6,21 @@ Author: Leonardo de Moura
 */
 #include "util/interrupt.h"
 #include "util/lbool.h"
+#include "util/memory.h"
+#include "util/perf.h"
 #include "kernel/converter.h"
 #include "kernel/expr_maps.h"
 #include "kernel/instantiate.h"
 #include "kernel/free_vars.h"
 
 namespace lean {
+static unsigned g_kernel_cache_alloc_tag = register_alloc_tag("kernel_cache");
+static perf_timer   g_whnf_timer("whnf");
+static perf_timer   g_is_def_eq_timer("is_def_eq");
+static perf_counter g_whnf_cache_hits("whnf_cache_hits");
+static perf_counter g_whnf_core_cache_hits("whnf_core_cache_hits");
+static perf_counter g_delta_counter("delta");
+
 bool converter::is_def_eq(expr const & t, expr const & s, context & c) {
     delayed_justification j([]() { return justification(); });
     return is_def_eq(t, s, c, j);
@@ -34,9 +43,12 @@ struct default_converter : public converter {
     name_set              m_extra_opaque;
     expr_struct_map<expr> m_whnf_core_cache;
     expr_struct_map<expr> m_whnf_cache;
+    unsigned              m_whnf_core_cache_hits;
+    unsigned              m_whnf_cache_hits;
 
     default_converter(environment const & env, optional<module_idx> mod_idx, bool memoize, name_set const & extra_opaque):
-        m_env(env), m_module_idx(mod_idx), m_memoize(memoize), m_extra_opaque(extra_opaque) {}
+        m_env(env), m_module_idx(mod_idx), m_memoize(memoize), m_extra_opaque(extra_opaque),
+        m_whnf_core_cache_hits(0), m_whnf_cache_hits(0) {}
 
     class extended_context : public extension_context {
         default_converter & m_conv;
@@ -98,8 +110,11 @@ struct default_converter : public converter {
         // check cache
         if (m_memoize) {
             auto it = m_whnf_core_cache.find(e);
-            if (it != m_whnf_core_cache.end())
+            if (it != m_whnf_core_cache.end()) {
+                g_whnf_core_cache_hits.inc();
+                m_whnf_core_cache_hits++;
                 return it->second;
+            }
         }
 
         // do the actual work
@@ -143,8 +158,10 @@ struct default_converter : public converter {
             break;
         }}
 
-        if (m_memoize)
+        if (m_memoize) {
+            LEAN_ALLOC_TAG(g_kernel_cache_alloc_tag);
             m_whnf_core_cache.insert(mk_pair(e, r));
+        }
         return r;
     }
 
@@ -181,8 +198,11 @@ struct default_converter : public converter {
     expr unfold_name_core(expr e, unsigned w) {
         if (is_constant(e)) {
             if (auto d = m_env.find(const_name(e))) {
-                if (d->is_definition() && !is_opaque(*d) && d->get_weight() >= w)
+                if (d->is_definition() && !is_opaque(*d) && d->get_weight() >= w) {
+                    g_delta_counter.inc();
+                    inc_perf_counter("delta", const_name(e));
                     return unfold_name_core(instantiate_params(d->get_value(), d->get_params(), const_level_params(e)), w);
+                }
             }
         }
         return e;
@@ -262,12 +282,16 @@ struct default_converter : public converter {
 
     /** \brief Put expression \c t in weak head normal form */
     virtual expr whnf(expr const & e_prime, context & c) {
+        scoped_perf_timer timer(g_whnf_timer);
         expr e = e_prime;
         // check cache
         if (m_memoize) {
             auto it = m_whnf_cache.find(e);
-            if (it != m_whnf_cache.end())
+            if (it != m_whnf_cache.end()) {
+                g_whnf_cache_hits.inc();
+                m_whnf_cache_hits++;
                 return it->second;
+            }
         }
 
         expr t = e;
@@ -277,8 +301,10 @@ struct default_converter : public converter {
             if (new_t) {
                 t = *new_t;
             } else {
-                if (m_memoize)
+                if (m_memoize) {
+                    LEAN_ALLOC_TAG(g_kernel_cache_alloc_tag);
                     m_whnf_cache.insert(mk_pair(e, t1));
+                }
                 return t1;
             }
         }
@@ -365,6 +391,7 @@ struct default_converter : public converter {
     /** Return true iff t is definitionally equal to s. */
     virtual bool is_def_eq(expr const & t, expr const & s, context & c, delayed_justification & jst) {
         check_system("is_definitionally_equal");
+        scoped_perf_timer timer(g_is_def_eq_timer);
         lbool r = quick_is_def_eq(t, s, c, jst);
         if (r != l_undef) return r == l_true;
 
@@ -457,6 +484,20 @@ struct default_converter : public converter {
     bool is_prop(expr const & e, context & c) {
         return whnf(c.infer_type(e), c) == Bool;
     }
+
+    virtual void clear_cache() {
+        m_whnf_core_cache.clear();
+        m_whnf_cache.clear();
+    }
+
+    virtual converter_stats get_stats() const {
+        converter_stats r;
+        r.m_whnf_cache_size      = m_whnf_cache.size();
+        r.m_whnf_cache_hits      = m_whnf_cache_hits;
+        r.m_whnf_core_cache_size = m_whnf_core_cache.size();
+        r.m_whnf_core_cache_hits = m_whnf_core_cache_hits;
+        return r;
+    }
 };
 
 std::unique_ptr<converter> mk_default_converter(environment const & env, optional<module_idx> mod_idx,
@@ -20,6 +20,15 @@ public:
 /** \brief Auxiliary exception used to sign that constraints cannot be created when \c m_cnstrs_enabled flag is false. */
 struct add_cnstr_exception {};
 
+/** \brief Statistics for the caches used by a converter. */
+struct converter_stats {
+    unsigned m_whnf_cache_size;
+    unsigned m_whnf_cache_hits;
+    unsigned m_whnf_core_cache_size;
+    unsigned m_whnf_core_cache_hits;
+    converter_stats():m_whnf_cache_size(0), m_whnf_cache_hits(0), m_whnf_core_cache_size(0), m_whnf_core_cache_hits(0) {}
+};
+
 class converter {
 public:
     /** \brief Abstract context that must be provided to a converter object. */
@@ -35,6 +44,9 @@ public:
     virtual expr whnf(expr const & e, context & c) = 0;
     virtual bool is_def_eq(expr const & t, expr const & s, context & c, delayed_justification & j) = 0;
     bool is_def_eq(expr const & t, expr const & s, context & c);
+    /** \brief Remove all cached results. */
+    virtual void clear_cache() {}
+    virtual converter_stats get_stats() const { return converter_stats(); }
 };
 
 std::unique_ptr<converter> mk_dummy_converter();
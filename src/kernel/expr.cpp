@@ -14,12 +14,20 @@ Author: Leonardo de Moura
 #include "util/hash.h"
 #include "util/buffer.h"
 #include "util/object_serializer.h"
+#include "util/memory.h"
 #include "kernel/expr.h"
 #include "kernel/expr_eq_fn.h"
 #include "kernel/free_vars.h"
 #include "kernel/max_sharing.h"
 
 namespace lean {
+static unsigned g_expr_alloc_tags[] = {
+    register_alloc_tag("expr_var"), register_alloc_tag("expr_sort"), register_alloc_tag("expr_constant"),
+    register_alloc_tag("expr_meta"), register_alloc_tag("expr_local"), register_alloc_tag("expr_app"),
+    register_alloc_tag("expr_lambda"), register_alloc_tag("expr_pi"), register_alloc_tag("expr_let"),
+    register_alloc_tag("expr_macro") };
+unsigned get_expr_alloc_tag(expr_kind k) { return g_expr_alloc_tags[static_cast<unsigned>(k)]; }
+
 static expr g_dummy(mk_var(0));
 expr::expr():expr(g_dummy) {}
 
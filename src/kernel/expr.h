@@ -19,6 +19,7 @@ Author: Leonardo de Moura
 #include "util/buffer.h"
 #include "util/list_fn.h"
 #include "util/optional.h"
+#include "util/memory.h"
 #include "util/serializer.h"
 #include "util/sexpr/format.h"
 #include "kernel/level.h"
@@ -392,16 +393,27 @@ bool is_meta(expr const & e);
 
 // =======================================
 // Constructors
-inline expr mk_var(unsigned idx) { return expr(new expr_var(idx)); }
+/** \brief Return the allocation tag (see \c LEAN_ALLOC_TAG) used for expressions of the given kind. */
+unsigned get_expr_alloc_tag(expr_kind k);
+inline expr mk_var(unsigned idx) { LEAN_ALLOC_TAG(get_expr_alloc_tag(expr_kind::Var)); return expr(new expr_var(idx)); }
 inline expr Var(unsigned idx) { return mk_var(idx); }
-inline expr mk_constant(name const & n, levels const & ls) { return expr(new expr_const(n, ls)); }
+inline expr mk_constant(name const & n, levels const & ls) {
+    LEAN_ALLOC_TAG(get_expr_alloc_tag(expr_kind::Constant));
+    return expr(new expr_const(n, ls));
+}
 inline expr mk_constant(name const & n) { return mk_constant(n, levels()); }
 inline expr Const(name const & n) { return mk_constant(n); }
-inline expr mk_macro(macro_definition const & m, unsigned num = 0, expr const * args = nullptr) { return expr(new expr_macro(m, num, args)); }
-inline expr mk_mlocal(bool is_meta, name const & n, expr const & t) { return expr(new expr_mlocal(is_meta, n, t)); }
+inline expr mk_macro(macro_definition const & m, unsigned num = 0, expr const * args = nullptr) {
+    LEAN_ALLOC_TAG(get_expr_alloc_tag(expr_kind::Macro));
+    return expr(new expr_macro(m, num, args));
+}
+inline expr mk_mlocal(bool is_meta, name const & n, expr const & t) {
+    LEAN_ALLOC_TAG(get_expr_alloc_tag(is_meta ? expr_kind::Meta : expr_kind::Local));
+    return expr(new expr_mlocal(is_meta, n, t));
+}
 inline expr mk_metavar(name const & n, expr const & t) { return mk_mlocal(true, n, t); }
 inline expr mk_local(name const & n, expr const & t) { return mk_mlocal(false, n, t); }
-inline expr mk_app(expr const & f, expr const & a) { return expr(new expr_app(f, a)); }
+inline expr mk_app(expr const & f, expr const & a) { LEAN_ALLOC_TAG(get_expr_alloc_tag(expr_kind::App)); return expr(new expr_app(f, a)); }
        expr mk_app(expr const & f, unsigned num_args, expr const * args);
        expr mk_app(unsigned num_args, expr const * args);
 inline expr mk_app(std::initializer_list<expr> const & l) { return mk_app(l.size(), l.begin()); }
@@ -411,6 +423,7 @@ template<typename T> expr mk_app(T const & args) { return mk_app(args.size(), ar
 template<typename T> expr mk_rev_app(T const & args) { return mk_rev_app(args.size(), args.data()); }
 template<typename T> expr mk_rev_app(expr const & f, T const & args) { return mk_rev_app(f, args.size(), args.data()); }
 inline expr mk_binder(expr_kind k, name const & n, expr const & t, expr const & e, expr_binder_info const & i = expr_binder_info()) {
+    LEAN_ALLOC_TAG(get_expr_alloc_tag(k));
     return expr(new expr_binder(k, n, t, e, i));
 }
 inline expr mk_lambda(name const & n, expr const & t, expr const & e, expr_binder_info const & i = expr_binder_info()) {
@@ -419,8 +432,11 @@ inline expr mk_lambda(name const & n, expr const & t, expr const & e, expr_binde
 inline expr mk_pi(name const & n, expr const & t, expr const & e, expr_binder_info const & i = expr_binder_info()) {
     return mk_binder(expr_kind::Pi, n, t, e, i);
 }
-inline expr mk_let(name const & n, expr const & t, expr const & v, expr const & e) { return expr(new expr_let(n, t, v, e)); }
-inline expr mk_sort(level const & l) { return expr(new expr_sort(l)); }
+inline expr mk_let(name const & n, expr const & t, expr const & v, expr const & e) {
+    LEAN_ALLOC_TAG(get_expr_alloc_tag(expr_kind::Let));
+    return expr(new expr_let(n, t, v, e));
+}
+inline expr mk_sort(level const & l) { LEAN_ALLOC_TAG(get_expr_alloc_tag(expr_kind::Sort)); return expr(new expr_sort(l)); }
 
 expr mk_Bool();
 expr mk_Type();
@@ -6,14 +6,18 @@ Author: Leonardo de Moura
 */
 #include <algorithm>
 #include <limits>
+#include "util/perf.h"
 #include "kernel/free_vars.h"
 #include "kernel/replace_fn.h"
 #include "kernel/instantiate.h"
 
 namespace lean {
+static perf_timer g_instantiate_timer("instantiate");
+
 expr instantiate(expr const & a, unsigned s, unsigned n, expr const * subst) {
     if (s >= get_free_var_range(a) || n == 0)
         return a;
+    scoped_perf_timer timer(g_instantiate_timer);
     return replace(a, [=](expr const & m, unsigned offset) -> optional<expr> {
             unsigned s1 = s + offset;
             if (s1 < s)
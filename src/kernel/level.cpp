@@ -15,10 +15,13 @@ Author: Leonardo de Moura
 #include "util/hash.h"
 #include "util/object_serializer.h"
 #include "util/interrupt.h"
+#include "util/memory.h"
 #include "kernel/level.h"
 #include "kernel/environment.h"
 
 namespace lean {
+static unsigned g_level_alloc_tag = register_alloc_tag("level");
+
 level_cell const & to_cell(level const & l) {
     return *l.m_ptr;
 }
@@ -189,6 +192,7 @@ bool is_explicit(level const & l) {
 }
 
 level mk_succ(level const & l) {
+    LEAN_ALLOC_TAG(g_level_alloc_tag);
     return level(new level_succ(l));
 }
 
@@ -218,11 +222,17 @@ level mk_max(level const & l1, level const & l2)  {
             lean_assert(p1.second != p2.second);
             return p1.second > p2.second ? l1 : l2;
         } else {
+            LEAN_ALLOC_TAG(g_level_alloc_tag);
             return level(new level_max_core(false, l1, l2));
         }
     }
 }
 
+static level mk_imax_core(level const & l1, level const & l2) {
+    LEAN_ALLOC_TAG(g_level_alloc_tag);
+    return level(new level_max_core(true,  l1, l2));
+}
+
 level mk_imax(level const & l1, level const & l2) {
     if (is_not_zero(l2))
         return mk_max(l1, l2);
@@ -231,12 +241,16 @@ level mk_imax(level const & l1, level const & l2) {
     else if (l1 == l2)
         return l1;
     else
-        return level(new level_max_core(true,  l1, l2));
+        return mk_imax_core(l1, l2);
 }
 
-level mk_param_univ(name const & n) { return level(new level_param_core(level_kind::Param, n)); }
-level mk_global_univ(name const & n) { return level(new level_param_core(level_kind::Global, n)); }
-level mk_meta_univ(name const & n) { return level(new level_param_core(level_kind::Meta, n)); }
+static level mk_param_core(level_kind k, name const & n) {
+    LEAN_ALLOC_TAG(g_level_alloc_tag);
+    return level(new level_param_core(k, n));
+}
+level mk_param_univ(name const & n) { return mk_param_core(level_kind::Param, n); }
+level mk_global_univ(name const & n) { return mk_param_core(level_kind::Global, n); }
+level mk_meta_univ(name const & n) { return mk_param_core(level_kind::Meta, n); }
 
 level const & mk_level_zero() {
     static LEAN_THREAD_LOCAL level g_zero(new level_cell(level_kind::Zero, 7u));
@@ -9,9 +9,13 @@ Author: Leonardo de Moura
 #include <functional>
 #include "util/buffer.h"
 #include "util/interrupt.h"
+#include "util/memory.h"
+#include "util/memory_budget.h"
 #include "kernel/max_sharing.h"
 
 namespace lean {
+static unsigned g_max_sharing_alloc_tag = register_alloc_tag("max_sharing_cache");
+
 /**
    \brief Implementation of the functional object for creating expressions with maximally
    shared sub-expressions.
@@ -19,7 +23,13 @@ namespace lean {
 struct max_sharing_fn::imp {
     typedef typename std::unordered_set<expr, expr_hash, std::equal_to<expr>> expr_cache;
 
-    expr_cache m_cache;
+    expr_cache                      m_cache;
+    /**
+       \brief Release the cache when the soft memory limit is exceeded. It is only set by \c max_sharing_fn,
+       the temporary object used by \c max_sharing does not register a shedder. It is executed at
+       \c max_sharing_fn::operator(), i.e., it is never executed in the middle of \c apply.
+    */
+    std::unique_ptr<memory_shedder> m_shedder;
 
     expr apply(expr const & a) {
         check_system("max_sharing");
@@ -51,7 +61,10 @@ struct max_sharing_fn::imp {
             res = update_macro(a, new_args.size(), new_args.data());
             break;
         }}
-        m_cache.insert(res);
+        {
+            LEAN_ALLOC_TAG(g_max_sharing_alloc_tag);
+            m_cache.insert(res);
+        }
         return res;
     }
 
@@ -63,9 +76,12 @@ struct max_sharing_fn::imp {
     }
 };
 
-max_sharing_fn::max_sharing_fn():m_ptr(new imp) {}
+max_sharing_fn::max_sharing_fn():m_ptr(new imp) {
+    imp * p = m_ptr.get();
+    p->m_shedder.reset(new memory_shedder([=]() { p->m_cache.clear(); }));
+}
 max_sharing_fn::~max_sharing_fn() {}
-expr max_sharing_fn::operator()(expr const & a) { return (*m_ptr)(a); }
+expr max_sharing_fn::operator()(expr const & a) { (*m_ptr->m_shedder)(); return (*m_ptr)(a); }
 void max_sharing_fn::clear() { m_ptr->m_cache.clear(); }
 bool max_sharing_fn::already_processed(expr const & a) const { return m_ptr->already_processed(a); }
 
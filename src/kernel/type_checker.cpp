@@ -10,6 +10,9 @@ Author: Leonardo de Moura
 #include "util/lbool.h"
 #include "util/flet.h"
 #include "util/sstream.h"
+#include "util/memory.h"
+#include "util/memory_budget.h"
+#include "util/perf.h"
 #include "kernel/type_checker.h"
 #include "kernel/expr_maps.h"
 #include "kernel/instantiate.h"
@@ -23,6 +26,9 @@ Author: Leonardo de Moura
 
 namespace lean {
 static name g_x_name("x");
+static unsigned g_kernel_cache_alloc_tag = register_alloc_tag("kernel_cache");
+static perf_timer   g_infer_type_timer("infer_type");
+static perf_counter g_infer_type_cache_hits("infer_type_cache_hits");
 
 no_constraints_allowed_exception::no_constraints_allowed_exception():exception("constraints are not allowed in this type checker") {}
 exception * no_constraints_allowed_exception::clone() const { return new no_constraints_allowed_exception(); }
@@ -63,13 +69,15 @@ struct type_checker::imp {
     expr_struct_map<expr>      m_infer_type_cache;
     converter_context          m_conv_ctx;
     type_checker_context       m_tc_ctx;
+    unsigned                   m_infer_type_cache_hits;
     bool                       m_memoize;
     // temp flag
     param_names                m_params;
+    memory_shedder             m_shedder; // clear the caches, it is only executed at the public methods of type_checker
 
     imp(environment const & env, name_generator const & g, constraint_handler & h, std::unique_ptr<converter> && conv, bool memoize):
         m_env(env), m_gen(g), m_chandler(h), m_conv(std::move(conv)), m_conv_ctx(*this), m_tc_ctx(*this),
-        m_memoize(memoize) {}
+        m_infer_type_cache_hits(0), m_memoize(memoize), m_shedder([=]() { clear_cache(); }) {}
 
     optional<expr> expand_macro(expr const & m) {
         lean_assert(is_macro(m));
@@ -287,11 +295,15 @@ struct type_checker::imp {
     expr infer_type_core(expr const & e, bool infer_only) {
         lean_assert(closed(e));
         check_system("type checker");
+        scoped_perf_timer timer(g_infer_type_timer);
 
         if (m_memoize) {
             auto it = m_infer_type_cache.find(e);
-            if (it != m_infer_type_cache.end())
+            if (it != m_infer_type_cache.end()) {
+                g_infer_type_cache_hits.inc();
+                m_infer_type_cache_hits++;
                 return it->second;
+            }
         }
 
         expr r;
@@ -386,8 +398,10 @@ struct type_checker::imp {
             break;
         }
 
-        if (m_memoize)
+        if (m_memoize) {
+            LEAN_ALLOC_TAG(g_kernel_cache_alloc_tag);
             m_infer_type_cache.insert(mk_pair(e, r));
+        }
 
         return r;
     }
@@ -399,6 +413,18 @@ struct type_checker::imp {
     }
     bool is_def_eq(expr const & t, expr const & s) { return m_conv->is_def_eq(t, s, m_conv_ctx); }
     expr whnf(expr const & t) { return m_conv->whnf(t, m_conv_ctx); }
+
+    void clear_cache() {
+        m_infer_type_cache.clear();
+        m_conv->clear_cache();
+    }
+
+    type_checker_stats get_stats() const {
+        type_checker_stats r(m_conv->get_stats());
+        r.m_infer_type_cache_size = m_infer_type_cache.size();
+        r.m_infer_type_cache_hits = m_infer_type_cache_hits;
+        return r;
+    }
 };
 
 no_constraint_handler g_no_constraint_handler;
@@ -415,13 +441,16 @@ type_checker::type_checker(environment const & env):
     type_checker(env, name_generator(g_tmp_prefix), g_no_constraint_handler, mk_default_converter(env), true) {}
 
 type_checker::~type_checker() {}
-expr type_checker::infer(expr const & t) { return m_ptr->infer_type(t); }
-expr type_checker::check(expr const & t, param_names const & ps) { return m_ptr->check(t, ps); }
-bool type_checker::is_def_eq(expr const & t, expr const & s) { return m_ptr->is_def_eq(t, s); }
-bool type_checker::is_prop(expr const & t) { return m_ptr->is_prop(t); }
-expr type_checker::whnf(expr const & t) { return m_ptr->whnf(t); }
-expr type_checker::ensure_pi(expr const & t) { return m_ptr->ensure_pi(t, t); }
-expr type_checker::ensure_sort(expr const & t) { return m_ptr->ensure_sort(t, t); }
+expr type_checker::infer(expr const & t) { m_ptr->m_shedder(); return m_ptr->infer_type(t); }
+expr type_checker::check(expr const & t, param_names const & ps) { m_ptr->m_shedder(); return m_ptr->check(t, ps); }
+bool type_checker::is_def_eq(expr const & t, expr const & s) { m_ptr->m_shedder(); return m_ptr->is_def_eq(t, s); }
+bool type_checker::is_prop(expr const & t) { m_ptr->m_shedder(); return m_ptr->is_prop(t); }
+expr type_checker::whnf(expr const & t) { m_ptr->m_shedder(); return m_ptr->whnf(t); }
+expr type_checker::ensure_pi(expr const & t) { m_ptr->m_shedder(); return m_ptr->ensure_pi(t, t); }
+expr type_checker::ensure_sort(expr const & t) { m_ptr->m_shedder(); return m_ptr->ensure_sort(t, t); }
+environment const & type_checker::env() const { return m_ptr->m_env; }
+void type_checker::clear_cache() { m_ptr->clear_cache(); }
+type_checker_stats type_checker::get_stats() const { return m_ptr->get_stats(); }
 
 static void check_no_metavar(environment const & env, expr const & e) {
     if (has_metavar(e))
@@ -34,6 +34,13 @@ public:
     virtual void rethrow() const;
 };
 
+/** \brief Statistics for the caches used by a type checker and its converter. */
+struct type_checker_stats : public converter_stats {
+    unsigned m_infer_type_cache_size;
+    unsigned m_infer_type_cache_hits;
+    type_checker_stats(converter_stats const & s):converter_stats(s), m_infer_type_cache_size(0), m_infer_type_cache_hits(0) {}
+};
+
 /**
    \brief Lean Type Checker. It can also be used to infer types, check whether a
    type \c A is convertible to a type \c B, etc.
@@ -95,6 +102,15 @@ public:
     expr ensure_pi(expr const & t);
     /** \brief Return a Sort if \c t is convertible to Sort. Throw an exception otherwise. */
     expr ensure_sort(expr const & t);
+
+    environment const & env() const;
+    /**
+       \brief Remove all cached results (inferred types, weak head normal forms, ...).
+       The caches are preserved between calls. So, a type checker object should be reused
+       when many related terms are processed.
+    */
+    void clear_cache();
+    type_checker_stats get_stats() const;
 };
 
 /**
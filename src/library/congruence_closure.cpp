@@ -0,0 +1,334 @@
+/*
+Copyright (c) 2014 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#include <vector>
+#include <algorithm>
+#include "util/hash.h"
+#include "library/congruence_closure.h"
+
+namespace lean {
+unsigned congruence_closure::signature_hash::operator()(std::vector<unsigned> const & s) const {
+    unsigned r = 17;
+    for (unsigned n : s)
+        r = hash(r, n);
+    return r;
+}
+
+congruence_closure::congruence_closure(is_congruence_app_fn const & is_congruence_app, std::shared_ptr<proof_builder> const & pb):
+    m_is_congruence_app(is_congruence_app), m_proof_builder(pb) {}
+
+congruence_closure::congruence_closure():
+    congruence_closure([](expr const &) { return true; }, nullptr) {}
+
+optional<unsigned> congruence_closure::find_node(expr const & e) const {
+    auto it = m_expr2node.find(e);
+    if (it != m_expr2node.end())
+        return optional<unsigned>(it->second);
+    else
+        return optional<unsigned>();
+}
+
+std::vector<unsigned> congruence_closure::get_signature(unsigned n) const {
+    std::vector<unsigned> r;
+    for (unsigned a : m_nodes[n].m_args)
+        r.push_back(m_nodes[a].m_root);
+    return r;
+}
+
+/** \brief Add the application \c n to the parents of the equivalence class \c r (if it is not already there). */
+void congruence_closure::add_parent(unsigned r, unsigned n) {
+    auto & ps = m_nodes[r].m_parents;
+    if (std::find(ps.begin(), ps.end(), n) != ps.end())
+        return;
+    ps.push_back(n);
+    if (!at_base_lvl())
+        m_actions.emplace_back(action_kind::AddParent, r);
+}
+
+/** \brief Insert the application \c n in the congruence table, or schedule the merge with a congruent application. */
+void congruence_closure::insert_parent(unsigned n) {
+    std::vector<unsigned> sig = get_signature(n);
+    auto it = m_table.find(sig);
+    if (it == m_table.end()) {
+        m_table.insert(sig, n);
+    } else if (m_nodes[it->second].m_root != m_nodes[n].m_root) {
+        m_todo.emplace_back(n, it->second, none_expr());
+    }
+}
+
+unsigned congruence_closure::mk_node(expr const & e) {
+    if (auto n = find_node(e))
+        return *n;
+    std::vector<unsigned> args;
+    if (is_app(e) && m_is_congruence_app(e)) {
+        args.push_back(mk_node(app_fn(e)));
+        args.push_back(mk_node(app_arg(e)));
+    }
+    unsigned n = m_nodes.size();
+    m_nodes.push_back(node(e, n));
+    if (!at_base_lvl())
+        m_actions.emplace_back(action_kind::MkNode, n);
+    m_expr2node.insert(e, n);
+    if (!args.empty()) {
+        m_nodes[n].m_args = args;
+        for (unsigned a : args)
+            add_parent(m_nodes[a].m_root, n);
+        insert_parent(n);
+    }
+    return n;
+}
+
+void congruence_closure::set_edge(unsigned n, unsigned target, optional<expr> const & pr, bool flipped) {
+    node & c = m_nodes[n];
+    if (!at_base_lvl()) {
+        m_actions.emplace_back(action_kind::SetEdge, n, c.m_target);
+        m_actions.back().m_proof   = c.m_proof;
+        m_actions.back().m_flipped = c.m_flipped;
+    }
+    c.m_target  = target;
+    c.m_proof   = pr;
+    c.m_flipped = flipped;
+}
+
+/** \brief Make \c n the root of its proof tree by reversing the edges in the path from \c n to the root. */
+void congruence_closure::invert_path(unsigned n) {
+    unsigned       curr       = n;
+    unsigned       new_target = n;
+    optional<expr> new_proof;
+    bool           new_flipped = false;
+    while (true) {
+        node const & c           = m_nodes[curr];
+        unsigned old_target      = c.m_target;
+        optional<expr> old_proof = c.m_proof;
+        bool old_flipped         = c.m_flipped;
+        set_edge(curr, new_target, new_proof, new_flipped);
+        if (old_target == curr)
+            return;
+        new_target  = curr;
+        new_proof   = old_proof;
+        new_flipped = !old_flipped;
+        curr        = old_target;
+    }
+}
+
+void congruence_closure::merge(unsigned lhs, unsigned rhs, optional<expr> const & pr) {
+    unsigned r1 = m_nodes[lhs].m_root;
+    unsigned r2 = m_nodes[rhs].m_root;
+    if (r1 == r2)
+        return;
+    bool flipped = false;
+    if (m_nodes[r1].m_size > m_nodes[r2].m_size) {
+        // the class of lhs is merged into the class of rhs, then it should be the smaller one
+        std::swap(lhs, rhs);
+        std::swap(r1, r2);
+        flipped = true;
+    }
+    // update the proof forest
+    invert_path(lhs);
+    set_edge(lhs, rhs, pr, flipped);
+    // the signatures of the parents of r1 will change
+    std::vector<unsigned> parents;
+    std::swap(parents, m_nodes[r1].m_parents);
+    for (unsigned p : parents) {
+        auto sig = get_signature(p);
+        auto it  = m_table.find(sig);
+        if (it != m_table.end() && it->second == p)
+            m_table.erase(sig);
+    }
+    if (!at_base_lvl()) {
+        m_actions.emplace_back(action_kind::Merge, r1, r2);
+        m_actions.back().m_parents = parents;
+    }
+    unsigned it = r1;
+    do {
+        m_nodes[it].m_root = r2;
+        it = m_nodes[it].m_next;
+    } while (it != r1);
+    std::swap(m_nodes[r1].m_next, m_nodes[r2].m_next);
+    m_nodes[r2].m_size += m_nodes[r1].m_size;
+    for (unsigned p : parents) {
+        insert_parent(p);
+        m_nodes[r2].m_parents.push_back(p);
+    }
+}
+
+void congruence_closure::process_todo() {
+    while (!m_todo.empty()) {
+        pending_eq eq = m_todo.back();
+        m_todo.pop_back();
+        merge(eq.m_lhs, eq.m_rhs, eq.m_proof);
+    }
+}
+
+void congruence_closure::add_term(expr const & e) {
+    mk_node(e);
+    process_todo();
+}
+
+void congruence_closure::add_eq(expr const & a, expr const & b, optional<expr> const & H) {
+    lean_assert(!m_proof_builder || H);
+    unsigned n1 = mk_node(a);
+    unsigned n2 = mk_node(b);
+    m_todo.emplace_back(n1, n2, m_proof_builder ? H : none_expr());
+    process_todo();
+}
+
+bool congruence_closure::is_eqv(expr const & a, expr const & b) const {
+    if (a == b)
+        return true;
+    auto n1 = find_node(a);
+    auto n2 = find_node(b);
+    return n1 && n2 && m_nodes[*n1].m_root == m_nodes[*n2].m_root;
+}
+
+expr congruence_closure::get_root(expr const & e) const {
+    if (auto n = find_node(e))
+        return m_nodes[m_nodes[*n].m_root].m_expr;
+    else
+        return e;
+}
+
+void congruence_closure::push() {
+    m_scopes.push_back(m_actions.size());
+    m_expr2node.push();
+    m_table.push();
+}
+
+void congruence_closure::undo(action & a) {
+    switch (a.m_kind) {
+    case action_kind::MkNode:
+        lean_assert(a.m_node + 1 == m_nodes.size());
+        m_nodes.pop_back();
+        break;
+    case action_kind::AddParent:
+        m_nodes[a.m_node].m_parents.pop_back();
+        break;
+    case action_kind::Merge: {
+        unsigned r1 = a.m_node;
+        unsigned r2 = a.m_other;
+        auto & ps   = m_nodes[r2].m_parents;
+        ps.resize(ps.size() - a.m_parents.size());
+        std::swap(m_nodes[r1].m_next, m_nodes[r2].m_next);
+        m_nodes[r2].m_size -= m_nodes[r1].m_size;
+        unsigned it = r1;
+        do {
+            m_nodes[it].m_root = r1;
+            it = m_nodes[it].m_next;
+        } while (it != r1);
+        m_nodes[r1].m_parents.swap(a.m_parents);
+        break;
+    }
+    case action_kind::SetEdge: {
+        node & c    = m_nodes[a.m_node];
+        c.m_target  = a.m_other;
+        c.m_proof   = a.m_proof;
+        c.m_flipped = a.m_flipped;
+        break;
+    }
+    }
+}
+
+void congruence_closure::pop(unsigned num) {
+    lean_assert(num <= num_scopes());
+    unsigned old_sz = m_scopes[num_scopes() - num];
+    while (m_actions.size() > old_sz) {
+        undo(m_actions.back());
+        m_actions.pop_back();
+    }
+    m_scopes.resize(num_scopes() - num);
+    m_expr2node.pop(num);
+    m_table.pop(num);
+    // the pending equalities are only nonempty if add_term or add_eq was interrupted by an exception
+    m_todo.clear();
+}
+
+/** \brief Return a proof of a = c using the proofs of a = b and b = c. The value none represents reflexivity. */
+optional<expr> congruence_closure::mk_trans(expr const & a, expr const & b, expr const & c,
+                                            optional<expr> const & H_ab, optional<expr> const & H_bc) const {
+    if (!H_ab)
+        return H_bc;
+    else if (!H_bc)
+        return H_ab;
+    else
+        return some_expr(m_proof_builder->mk_trans(a, b, c, *H_ab, *H_bc));
+}
+
+/** \brief Return a proof of b = a using the proof of a = b. The value none represents reflexivity. */
+optional<expr> congruence_closure::mk_symm(expr const & a, expr const & b, optional<expr> const & H_ab) const {
+    if (!H_ab)
+        return H_ab;
+    else
+        return some_expr(m_proof_builder->mk_symm(a, b, *H_ab));
+}
+
+/** \brief Return a proof of <tt>m_nodes[n].m_expr = m_nodes[m_nodes[n].m_target].m_expr</tt> */
+optional<expr> congruence_closure::get_edge_proof(unsigned n) {
+    unsigned target = m_nodes[n].m_target;
+    if (!m_nodes[n].m_proof) {
+        return get_congruence_proof(n, target);
+    } else if (m_nodes[n].m_flipped) {
+        return mk_symm(m_nodes[target].m_expr, m_nodes[n].m_expr, m_nodes[n].m_proof);
+    } else {
+        return m_nodes[n].m_proof;
+    }
+}
+
+/** \brief Return a proof that the congruent applications \c n1 and \c n2 are equal. */
+optional<expr> congruence_closure::get_congruence_proof(unsigned n1, unsigned n2) {
+    expr const & e1   = m_nodes[n1].m_expr;
+    expr const & e2   = m_nodes[n2].m_expr;
+    expr const & f1   = app_fn(e1);
+    expr const & f2   = app_fn(e2);
+    expr const & a1   = app_arg(e1);
+    expr const & a2   = app_arg(e2);
+    optional<expr> H1 = get_eqv_proof(f1, f2);
+    optional<expr> H2 = get_eqv_proof(a1, a2);
+    if (!H1 && !H2)
+        return none_expr();
+    return some_expr(m_proof_builder->mk_congr(f1, f2, a1, a2, H1, H2));
+}
+
+/** \brief Return a proof of <tt>m_nodes[n].m_expr = m_nodes[ancestor].m_expr</tt>, where \c ancestor is in the path from \c n to the root of the proof tree. */
+optional<expr> congruence_closure::get_path_proof(unsigned n, unsigned ancestor) {
+    optional<expr> pr;
+    unsigned it = n;
+    while (it != ancestor) {
+        unsigned next = m_nodes[it].m_target;
+        pr = mk_trans(m_nodes[n].m_expr, m_nodes[it].m_expr, m_nodes[next].m_expr, pr, get_edge_proof(it));
+        it = next;
+    }
+    return pr;
+}
+
+optional<expr> congruence_closure::get_proof(unsigned n1, unsigned n2) {
+    lean_assert(m_nodes[n1].m_root == m_nodes[n2].m_root);
+    // find the common ancestor of n1 and n2 in the proof tree
+    std::vector<bool> visited(m_nodes.size(), false);
+    unsigned it = n1;
+    while (true) {
+        visited[it] = true;
+        if (m_nodes[it].m_target == it)
+            break;
+        it = m_nodes[it].m_target;
+    }
+    unsigned ancestor = n2;
+    while (!visited[ancestor])
+        ancestor = m_nodes[ancestor].m_target;
+    expr const & a    = m_nodes[n1].m_expr;
+    expr const & b    = m_nodes[n2].m_expr;
+    expr const & c    = m_nodes[ancestor].m_expr;
+    optional<expr> H1 = get_path_proof(n1, ancestor); // a = c
+    optional<expr> H2 = get_path_proof(n2, ancestor); // b = c
+    return mk_trans(a, c, b, H1, mk_symm(b, c, H2));
+}
+
+optional<expr> congruence_closure::get_eqv_proof(expr const & a, expr const & b) {
+    lean_assert(is_eqv(a, b));
+    if (a == b || !m_proof_builder)
+        return none_expr();
+    return get_proof(*find_node(a), *find_node(b));
+}
+}
@@ -0,0 +1,181 @@
+/*
+Copyright (c) 2014 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#pragma once
+#include <vector>
+#include <memory>
+#include <functional>
+#include "util/optional.h"
+#include "util/scoped_map.h"
+#include "kernel/expr.h"
+
+namespace lean {
+/**
+   \brief Congruence closure for (homogeneous) equalities.
+
+   The equalities are added using \c add_eq, and the congruence rule
+   <tt>f = g, a = b  ==>  f a = g b</tt>
+   is used to propagate them. Applications that are not congruence applications
+   (see \c is_congruence_app_fn) are treated as atoms.
+
+   Proofs for the equalities are produced on demand using a proof forest (each equivalence
+   class is a tree whose edges are labeled with the proof of the equality or the two congruent
+   applications). The actual proof terms are built by a \c proof_builder provided by the caller.
+
+   The methods \c push and \c pop are used to implement backtracking
+   (e.g., when the simplifier enters and leaves the scope of a hypothesis).
+*/
+class congruence_closure {
+public:
+    /** \brief Return true iff the congruence rule should be used for the application \c e. */
+    typedef std::function<bool(expr const &)> is_congruence_app_fn; // NOLINT
+
+    /** \brief Procedures for building the proofs produced by \c get_eqv_proof. */
+    class proof_builder {
+    public:
+        virtual ~proof_builder() {}
+        /** \brief Return a proof of <tt>b = a</tt> using the proof \c H of <tt>a = b</tt>. */
+        virtual expr mk_symm(expr const & a, expr const & b, expr const & H) = 0;
+        /** \brief Return a proof of <tt>a = c</tt> using the proofs \c H1 of <tt>a = b</tt> and \c H2 of <tt>b = c</tt>. */
+        virtual expr mk_trans(expr const & a, expr const & b, expr const & c, expr const & H1, expr const & H2) = 0;
+        /**
+           \brief Return a proof of <tt>f a = g b</tt> using the proofs \c H1 of <tt>f = g</tt> and \c H2 of <tt>a = b</tt>.
+           The value none represents reflexivity, and at least one of them is not none.
+        */
+        virtual expr mk_congr(expr const & f, expr const & g, expr const & a, expr const & b,
+                              optional<expr> const & H1, optional<expr> const & H2) = 0;
+    };
+
+private:
+    struct node {
+        expr                  m_expr;
+        unsigned              m_root;
+        unsigned              m_next;     // next element in the equivalence class (circular list)
+        unsigned              m_size;     // size of the equivalence class (only meaningful for roots)
+        std::vector<unsigned> m_parents;  // applications containing an element of the class (only meaningful for roots)
+        std::vector<unsigned> m_args;     // function and argument of a congruence application, empty for atoms
+        // proof forest
+        unsigned              m_target;   // the node itself if it is the root of the proof tree
+        optional<expr>        m_proof;    // proof of m_expr = target, none for congruence edges
+        bool                  m_flipped;  // if true, then m_proof is a proof of target = m_expr
+        node(expr const & e, unsigned idx):
+            m_expr(e), m_root(idx), m_next(idx), m_size(1), m_target(idx), m_flipped(false) {}
+    };
+    struct signature_hash { unsigned operator()(std::vector<unsigned> const & s) const; };
+    struct pending_eq {
+        unsigned       m_lhs;
+        unsigned       m_rhs;
+        optional<expr> m_proof; // none for congruences
+        pending_eq(unsigned lhs, unsigned rhs, optional<expr> const & pr):m_lhs(lhs), m_rhs(rhs), m_proof(pr) {}
+    };
+    /**
+       \brief Updates to \c m_nodes that must be undone by \c pop. The congruence table and
+       the mapping from expressions to nodes are scoped maps, and restore themselves.
+    */
+    enum class action_kind { MkNode, AddParent, Merge, SetEdge };
+    struct action {
+        action_kind           m_kind;
+        unsigned              m_node;     // MkNode, AddParent: root; Merge: class merged (r1); SetEdge: node
+        unsigned              m_other;    // Merge: class r1 was merged into (r2); SetEdge: old target
+        std::vector<unsigned> m_parents;  // Merge: old parents of r1
+        optional<expr>        m_proof;    // SetEdge: old proof
+        bool                  m_flipped;  // SetEdge: old flipped flag
+        action(action_kind k, unsigned n, unsigned o = 0):m_kind(k), m_node(n), m_other(o), m_flipped(false) {}
+    };
+    typedef scoped_map<std::vector<unsigned>, unsigned, signature_hash> congruence_table;
+    typedef scoped_map<expr, unsigned, expr_hash>                       expr2node;
+
+    is_congruence_app_fn           m_is_congruence_app;
+    std::shared_ptr<proof_builder> m_proof_builder;
+    std::vector<node>              m_nodes;
+    expr2node                      m_expr2node;
+    congruence_table               m_table;
+    std::vector<pending_eq>        m_todo;
+    std::vector<action>            m_actions;
+    std::vector<unsigned>          m_scopes;
+
+    bool at_base_lvl() const { return m_scopes.empty(); }
+    unsigned mk_node(expr const & e);
+    std::vector<unsigned> get_signature(unsigned n) const;
+    void add_parent(unsigned r, unsigned n);
+    void insert_parent(unsigned n);
+    void set_edge(unsigned n, unsigned target, optional<expr> const & pr, bool flipped);
+    void invert_path(unsigned n);
+    void merge(unsigned lhs, unsigned rhs, optional<expr> const & pr);
+    void process_todo();
+    void undo(action & a);
+    optional<expr> mk_trans(expr const & a, expr const & b, expr const & c,
+                            optional<expr> const & H_ab, optional<expr> const & H_bc) const;
+    optional<expr> mk_symm(expr const & a, expr const & b, optional<expr> const & H_ab) const;
+    optional<expr> get_edge_proof(unsigned n);
+    optional<expr> get_congruence_proof(unsigned n1, unsigned n2);
+    optional<expr> get_path_proof(unsigned n, unsigned ancestor);
+    optional<expr> get_proof(unsigned n1, unsigned n2);
+    optional<unsigned> find_node(expr const & e) const;
+
+public:
+    /**
+       \brief Create a congruence closure object. The predicate \c is_congruence_app is only invoked
+       for applications, and it may be used to treat applications of dependent functions as atoms.
+       If \c pb is nullptr, then proofs are not enabled, and \c add_eq does not take proofs.
+    */
+    congruence_closure(is_congruence_app_fn const & is_congruence_app, std::shared_ptr<proof_builder> const & pb);
+    /** \brief Create a congruence closure object where all applications are congruence applications, and proofs are not enabled. */
+    congruence_closure();
+
+    /** \brief Register the term \c e (and its subterms). Congruences involving \c e are propagated. */
+    void add_term(expr const & e);
+
+    /**
+       \brief Add the equality <tt>a = b</tt>. The argument \c H must be a proof for it when proofs are enabled.
+       The terms \c a and \c b are registered if they were not already.
+    */
+    void add_eq(expr const & a, expr const & b, optional<expr> const & H);
+
+    /** \brief Return true iff the term \c e was registered. */
+    bool has_term(expr const & e) const { return static_cast<bool>(find_node(e)); }
+
+    /** \brief Return true iff <tt>a = b</tt> is implied by the equalities added so far. */
+    bool is_eqv(expr const & a, expr const & b) const;
+
+    /**
+       \brief Return a proof for <tt>a = b</tt>. The result is none if \c a and \c b are the same
+       expression (i.e., the proof is reflexivity), or proofs are not enabled.
+
+       \pre is_eqv(a, b)
+    */
+    optional<expr> get_eqv_proof(expr const & a, expr const & b);
+
+    /** \brief Return the representative of the equivalence class of \c e. */
+    expr get_root(expr const & e) const;
+
+    /** \brief Return the number of terms registered in this object. */
+    unsigned get_num_terms() const { return m_nodes.size(); }
+
+    /** \brief Return the number of scopes. */
+    unsigned num_scopes() const { return m_scopes.size(); }
+
+    /** \brief Create a new scope (it allows us to restore the current state of the object). */
+    void push();
+
+    /**
+       \brief Remove \c num scopes, and restore the terms and equalities of the corresponding state.
+       It can be used to recover from an exception thrown by \c add_term or \c add_eq.
+    */
+    void pop(unsigned num = 1);
+
+    /**
+       \brief Auxiliary class for automatically performing a \c push
+       in the constructor and a \c pop in the destructor.
+    */
+    class mk_scope {
+        congruence_closure & m_cc;
+    public:
+        explicit mk_scope(congruence_closure & cc):m_cc(cc) { m_cc.push(); }
+        ~mk_scope() { m_cc.pop(); }
+    };
+};
+}
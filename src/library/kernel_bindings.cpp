@@ -14,6 +14,9 @@ Author: Leonardo de Moura
 #include "util/luaref.h"
 #include "kernel/abstract.h"
 #include "kernel/for_each_fn.h"
+#include "kernel/replace_fn.h"
+#include "kernel/expr_maps.h"
+#include "kernel/expr_sets.h"
 #include "kernel/free_vars.h"
 #include "kernel/instantiate.h"
 #include "kernel/metavar.h"
@@ -22,6 +25,7 @@ Author: Leonardo de Moura
 #include "library/occurs.h"
 #include "library/io_state_stream.h"
 #include "library/expr_lt.h"
+#include "library/pos_info_table.h"
 #include "library/kernel_bindings.h"
 
 // Lua Bindings for the Kernel classes. We do not include the Lua
@@ -142,8 +146,19 @@ static const struct luaL_Reg level_m[] = {
     {0, 0}
 };
 
+static void level_migrate(lua_State * src, int i, lua_State * tgt) {
+    push_level(tgt, to_level(src, i));
+}
+
+static lua_pusher level_export(lua_State * src, int i) {
+    level v = to_level(src, i);
+    return lua_pusher([=](lua_State * tgt) { push_level(tgt, v); });
+}
+
 static void open_level(lua_State * L) {
     luaL_newmetatable(L, level_mt);
+    set_migrate_fn_field(L, -1, level_migrate);
+    set_export_fn_field(L, -1, level_export);
     lua_pushvalue(L, -1);
     lua_setfield(L, -2, "__index");
     setfuncs(L, level_m, 0);
@@ -189,8 +204,13 @@ static const struct luaL_Reg binder_info_m[] = {
     {"is_cast",         safe_function<binder_info_is_cast>},
     {0, 0}
 };
+static void binder_info_migrate(lua_State * src, int i, lua_State * tgt) {
+    push_expr_binder_info(tgt, to_expr_binder_info(src, i));
+}
+
 static void open_binder_info(lua_State * L) {
     luaL_newmetatable(L, expr_binder_info_mt);
+    set_migrate_fn_field(L, -1, binder_info_migrate);
     lua_pushvalue(L, -1);
     lua_setfield(L, -2, "__index");
     setfuncs(L, binder_info_m, 0);
@@ -245,8 +265,15 @@ static int expr_mk_constant(lua_State * L) {
         return push_expr(L, mk_constant(to_name_ext(L, 1), to_list_level_ext(L, 2)));
 }
 static int expr_mk_var(lua_State * L) { return push_expr(L, mk_var(luaL_checkinteger(L, 1))); }
+static void copy_lua_array(lua_State * L, int tidx, buffer<expr> & r);
 static int expr_mk_app(lua_State * L) {
     int nargs = lua_gettop(L);
+    if (nargs == 2 && lua_istable(L, 2)) {
+        // mk_app(f, {a_1, ..., a_n}): build the whole spine in a single call
+        buffer<expr> args;
+        copy_lua_array(L, 2, args);
+        return push_expr(L, mk_app(to_expr(L, 1), args.size(), args.data()));
+    }
     expr r;
     r = mk_app(to_expr(L, 1), to_expr(L, 2));
     for (int i = 3; i <= nargs; i++)
@@ -400,6 +427,110 @@ static int expr_for_each(lua_State * L) {
     return 0;
 }
 
+/** \brief Push a Lua array containing the given expressions. */
+static int push_expr_array(lua_State * L, unsigned num, expr const * es) {
+    lua_createtable(L, num, 0);
+    for (unsigned i = 0; i < num; i++) {
+        push_expr(L, es[i]);
+        lua_rawseti(L, -2, i + 1);
+    }
+    return 1;
+}
+
+// Given (f a_1 ... a_n), return f and the array {a_1, ..., a_n}
+static int expr_args(lua_State * L) {
+    expr const & e = to_expr(L, 1);
+    buffer<expr> args;
+    get_app_args(e, args);
+    expr const * f = &e;
+    while (is_app(*f))
+        f = &app_fn(*f);
+    push_expr(L, *f);
+    push_expr_array(L, args.size(), args.data());
+    return 2;
+}
+
+/**
+   \brief Native predicate for subexpressions described by a Lua table of named parameters:
+   <tt>kind</tt> (an expr_kind), <tt>names</tt> (the name of constants, metavariables and local constants, a name_set),
+   and <tt>closed</tt> (expression does not contain free variables).
+   An expression satisfies the predicate if it satisfies all given fields.
+*/
+struct lua_expr_pred {
+    optional<unsigned> m_kind;
+    bool               m_use_names;
+    name_set           m_names;
+    bool               m_only_closed;
+    lua_expr_pred(lua_State * L, int idx) {
+        luaL_checktype(L, idx, LUA_TTABLE);
+        m_kind        = get_opt_uint_named_param(L, idx, "kind");
+        m_names       = get_name_set_named_param(L, idx, "names");
+        m_use_names   = !m_names.empty();
+        m_only_closed = get_bool_named_param(L, idx, "closed", false);
+    }
+    bool operator()(expr const & e) const {
+        if (m_kind && static_cast<unsigned>(e.kind()) != *m_kind)
+            return false;
+        if (m_use_names) {
+            if (is_constant(e)) {
+                if (!m_names.contains(const_name(e)))
+                    return false;
+            } else if (is_mlocal(e)) {
+                if (!m_names.contains(mlocal_name(e)))
+                    return false;
+            } else {
+                return false;
+            }
+        }
+        if (m_only_closed && !closed(e))
+            return false;
+        return true;
+    }
+};
+
+// e:find_all(pred): return (without duplicates) the subexpressions of e satisfying pred.
+static int expr_find_all(lua_State * L) {
+    expr const & e = to_expr(L, 1);
+    lua_expr_pred pred(L, 2);
+    buffer<expr>    r;
+    expr_struct_set found;
+    for_each(e, [&](expr const & a, unsigned) {
+            if (pred(a) && found.insert(a).second)
+                r.push_back(a);
+            return true;
+        });
+    return push_expr_array(L, r.size(), r.data());
+}
+
+// e:replace({{a_1, b_1}, ..., {a_n, b_n}}): replace all occurrences of a_i with b_i.
+// The expressions a_i and b_i are in the context of e. Thus, under k binders, an occurrence of a_i is
+// a_i with its free variables lifted by k, and it is replaced with b_i with its free variables lifted by k.
+static int expr_replace(lua_State * L) {
+    expr const & e = to_expr(L, 1);
+    luaL_checktype(L, 2, LUA_TTABLE);
+    int n = objlen(L, 2);
+    expr_struct_map<expr> m;
+    bool has_open_pattern = false;
+    for (int i = 1; i <= n; i++) {
+        auto p = get_expr_pair_from_table(L, 2, i);
+        if (has_free_vars(p.first))
+            has_open_pattern = true;
+        m.insert(p);
+    }
+    return push_expr(L, replace(e, [&](expr const & a, unsigned offset) {
+                auto it = m.end();
+                if (offset == 0 || closed(a)) {
+                    it = m.find(a);
+                } else if (has_open_pattern && !has_free_var(a, 0, offset)) {
+                    it = m.find(lower_free_vars(a, offset));
+                }
+                if (it != m.end())
+                    return some_expr(lift_free_vars(it->second, offset));
+                else
+                    return none_expr();
+            }));
+}
+
 static int expr_has_free_var(lua_State * L) {
     int nargs = lua_gettop(L);
     if (nargs == 2)
@@ -481,7 +612,13 @@ static int macro_def(lua_State * L) { return push_macro_definition(L, macro_def(
 static int macro_num_args(lua_State * L) { return push_integer(L, macro_num_args(to_macro_app(L, 1))); }
 static int macro_arg(lua_State * L) { return push_expr(L, macro_arg(to_macro_app(L, 1), luaL_checkinteger(L, 2))); }
 
-static int expr_set_tag(lua_State * L) { to_expr(L, 1).set_tag(luaL_checkinteger(L, 2)); return 0; }
+static int expr_set_tag(lua_State * L) {
+    tag t = luaL_checkinteger(L, 2);
+    if (t == nulltag || is_pos_info_tag(t))
+        throw exception(sstream() << "invalid tag " << t << ", the tags used by the position tables are reserved");
+    to_expr(L, 1).set_tag(t);
+    return 0;
+}
 static int expr_tag(lua_State * L) {
     auto t = to_expr(L, 1).get_tag();
     return (t == nulltag) ? push_nil(L) : push_integer(L, t);
@@ -523,7 +660,10 @@ static const struct luaL_Reg expr_m[] = {
     {"macro_def",        safe_function<macro_def>},
     {"macro_num_args",   safe_function<macro_num_args>},
     {"macro_arg",        safe_function<macro_arg>},
+    {"args",             safe_function<expr_args>},
     {"for_each",         safe_function<expr_for_each>},
+    {"find_all",         safe_function<expr_find_all>},
+    {"replace",          safe_function<expr_replace>},
     {"has_free_var",     safe_function<expr_has_free_var>},
     {"lift_free_vars",   safe_function<expr_lift_free_vars>},
     {"lower_free_vars",  safe_function<expr_lower_free_vars>},
@@ -542,9 +682,15 @@ static void expr_migrate(lua_State * src, int i, lua_State * tgt) {
     push_expr(tgt, to_expr(src, i));
 }
 
+static lua_pusher expr_export(lua_State * src, int i) {
+    expr v = to_expr(src, i);
+    return lua_pusher([=](lua_State * tgt) { push_expr(tgt, v); });
+}
+
 static void open_expr(lua_State * L) {
     luaL_newmetatable(L, expr_mt);
     set_migrate_fn_field(L, -1, expr_migrate);
+    set_export_fn_field(L, -1, expr_export);
     lua_pushvalue(L, -1);
     lua_setfield(L, -2, "__index");
     setfuncs(L, expr_m, 0);
@@ -714,8 +860,13 @@ static const struct luaL_Reg definition_m[] = {
     {0, 0}
 };
 
+static void definition_migrate(lua_State * src, int i, lua_State * tgt) {
+    push_definition(tgt, to_definition(src, i));
+}
+
 static void open_definition(lua_State * L) {
     luaL_newmetatable(L, definition_mt);
+    set_migrate_fn_field(L, -1, definition_migrate);
     lua_pushvalue(L, -1);
     lua_setfield(L, -2, "__index");
     setfuncs(L, definition_m, 0);
@@ -940,9 +1091,15 @@ static void environment_migrate(lua_State * src, int i, lua_State * tgt) {
     push_environment(tgt, to_environment(src, i));
 }
 
+static lua_pusher environment_export(lua_State * src, int i) {
+    environment v = to_environment(src, i);
+    return lua_pusher([=](lua_State * tgt) { push_environment(tgt, v); });
+}
+
 static void open_environment(lua_State * L) {
     luaL_newmetatable(L, environment_mt);
     set_migrate_fn_field(L, -1, environment_migrate);
+    set_export_fn_field(L, -1, environment_export);
     lua_pushvalue(L, -1);
     lua_setfield(L, -2, "__index");
     setfuncs(L, environment_m, 0);
@@ -1485,6 +1642,45 @@ int type_checker_check(lua_State * L) {
 int type_checker_infer(lua_State * L) { return push_expr(L, to_type_checker_ref(L, 1)->infer(to_expr(L, 2))); }
 int type_checker_is_def_eq(lua_State * L) { return push_boolean(L, to_type_checker_ref(L, 1)->is_def_eq(to_expr(L, 2), to_expr(L, 3))); }
 int type_checker_is_prop(lua_State * L) { return push_boolean(L, to_type_checker_ref(L, 1)->is_prop(to_expr(L, 2))); }
+int type_checker_env(lua_State * L) { return push_environment(L, to_type_checker_ref(L, 1)->env()); }
+int type_checker_clear(lua_State * L) { to_type_checker_ref(L, 1)->clear_cache(); return 0; }
+static void set_stats_field(lua_State * L, char const * fname, unsigned v) {
+    lua_pushinteger(L, v);
+    lua_setfield(L, -2, fname);
+}
+int type_checker_get_stats(lua_State * L) {
+    type_checker_stats s = to_type_checker_ref(L, 1)->get_stats();
+    lua_newtable(L);
+    set_stats_field(L, "infer_type_cache_size", s.m_infer_type_cache_size);
+    set_stats_field(L, "infer_type_cache_hits", s.m_infer_type_cache_hits);
+    set_stats_field(L, "whnf_cache_size",       s.m_whnf_cache_size);
+    set_stats_field(L, "whnf_cache_hits",       s.m_whnf_cache_hits);
+    set_stats_field(L, "whnf_core_cache_size",  s.m_whnf_core_cache_size);
+    set_stats_field(L, "whnf_core_cache_hits",  s.m_whnf_core_cache_hits);
+    return 1;
+}
+
+// Batch versions: process a Lua array of expressions using the same type checker (and its caches).
+template<typename F>
+static int type_checker_map(lua_State * L, F && f) {
+    type_checker & tc = *to_type_checker_ref(L, 1);
+    buffer<expr> es;
+    copy_lua_array(L, 2, es);
+    for (expr & e : es)
+        e = f(tc, e);
+    return push_expr_array(L, es.size(), es.data());
+}
+int type_checker_whnf_all(lua_State * L) {
+    return type_checker_map(L, [](type_checker & tc, expr const & e) { return tc.whnf(e); });
+}
+int type_checker_infer_all(lua_State * L) {
+    return type_checker_map(L, [](type_checker & tc, expr const & e) { return tc.infer(e); });
+}
+int type_checker_check_all(lua_State * L) {
+    int nargs = lua_gettop(L);
+    param_names ps = nargs <= 2 ? param_names() : to_list_name(L, 3);
+    return type_checker_map(L, [&](type_checker & tc, expr const & e) { return tc.check(e, ps); });
+}
 
 static const struct luaL_Reg type_checker_ref_m[] = {
     {"__gc",        type_checker_ref_gc},
@@ -1495,6 +1691,12 @@ static const struct luaL_Reg type_checker_ref_m[] = {
     {"infer",       safe_function<type_checker_infer>},
     {"is_def_eq",   safe_function<type_checker_is_def_eq>},
     {"is_prop",     safe_function<type_checker_is_prop>},
+    {"env",         safe_function<type_checker_env>},
+    {"clear",       safe_function<type_checker_clear>},
+    {"stats",       safe_function<type_checker_get_stats>},
+    {"whnf_all",    safe_function<type_checker_whnf_all>},
+    {"infer_all",   safe_function<type_checker_infer_all>},
+    {"check_all",   safe_function<type_checker_check_all>},
     {0, 0}
 };
 
@@ -1526,6 +1728,31 @@ static int add_declaration(lua_State * L) {
     return push_environment(L, to_environment(L, 1).add(*d));
 }
 
+// add_decls(env, {d_1, ..., d_n}, [ngen], [extra_opaque], [memoize])
+// Type check and add a sequence of declarations in a single call.
+static int add_declarations(lua_State * L) {
+    int nargs = lua_gettop(L);
+    environment env = to_environment(L, 1);
+    luaL_checktype(L, 2, LUA_TTABLE);
+    int n = objlen(L, 2);
+    for (int i = 1; i <= n; i++) {
+        lua_rawgeti(L, 2, i);
+        definition const & d = to_definition(L, -1);
+        optional<certified_definition> cd;
+        if (nargs == 2)
+            cd = check(env, d);
+        else if (nargs == 3)
+            cd = check(env, d, to_name_generator(L, 3));
+        else if (nargs == 4)
+            cd = check(env, d, to_name_generator(L, 3), to_name_set(L, 4));
+        else
+            cd = check(env, d, to_name_generator(L, 3), to_name_set(L, 4), lua_toboolean(L, 5));
+        lua_pop(L, 1);
+        env = env.add(*cd);
+    }
+    return push_environment(L, env);
+}
+
 static void open_type_checker(lua_State * L) {
     luaL_newmetatable(L, type_checker_ref_mt);
     lua_pushvalue(L, -1);
@@ -1537,6 +1764,7 @@ static void open_type_checker(lua_State * L) {
     SET_GLOBAL_FUN(type_check, "type_check");
     SET_GLOBAL_FUN(type_check, "check");
     SET_GLOBAL_FUN(add_declaration, "add_decl");
+    SET_GLOBAL_FUN(add_declarations, "add_decls");
 }
 
 void open_kernel_module(lua_State * L) {
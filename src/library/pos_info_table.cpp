@@ -0,0 +1,173 @@
+/*
+Copyright (c) 2014 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#include <utility>
+#include <vector>
+#include "util/thread.h"
+#include "util/buffer.h"
+#include "kernel/expr_maps.h"
+#include "library/pos_info_table.h"
+
+namespace lean {
+static unsigned const g_block_size = 256;
+static unsigned const g_checkpoint = 32;
+/** \brief The tags in <tt>[g_first_tag, g_first_tag + g_num_blocks * g_block_size)</tt> are reserved for position tables. */
+static tag const g_first_tag       = 1u << 31;
+static unsigned const g_num_blocks = (nulltag - g_first_tag) / g_block_size;
+static atomic<unsigned> g_next_block(0);
+
+bool is_pos_info_tag(tag t) { return t != nulltag && t >= g_first_tag; }
+
+pos_info_table::pos_info_table():m_size(0), m_next_tag(nulltag), m_last(0, 0) {}
+
+tag pos_info_table::mk_tag() {
+    if (m_blocks.empty() || m_next_tag - m_blocks.back().m_first_tag == g_block_size) {
+        unsigned i = atomic_fetch_add_explicit(&g_next_block, 1u, memory_order_relaxed) % g_num_blocks;
+        tag first  = g_first_tag + i * g_block_size;
+        m_blocks.emplace_back(first, m_size);
+        m_next_tag = first;
+    }
+    return m_next_tag++;
+}
+
+optional<unsigned> pos_info_table::find_entry(tag t) const {
+    if (!is_pos_info_tag(t))
+        return optional<unsigned>();
+    // Remark: the last blocks are the most likely ones. All blocks but the last one are full.
+    unsigned i = m_blocks.size();
+    while (i > 0) {
+        --i;
+        block const & b = m_blocks[i];
+        unsigned used   = i + 1 == m_blocks.size() ? m_next_tag - b.m_first_tag : g_block_size;
+        if (t - b.m_first_tag < used)
+            return optional<unsigned>(b.m_first_entry + (t - b.m_first_tag));
+    }
+    return optional<unsigned>();
+}
+
+/** \brief Encode \c v as a delta with respect to \c prev. Small deltas (positive or negative) are small numbers. */
+static unsigned encode_delta(unsigned v, unsigned prev) {
+    return v >= prev ? 2 * (v - prev) : 2 * (prev - v) - 1;
+}
+
+static unsigned decode_delta(unsigned d, unsigned prev) {
+    return d % 2 == 0 ? prev + d / 2 : prev - (d + 1) / 2;
+}
+
+void pos_info_table::write(unsigned v) {
+    while (v >= 128) {
+        m_data.push_back(static_cast<unsigned char>(v | 128));
+        v >>= 7;
+    }
+    m_data.push_back(static_cast<unsigned char>(v));
+}
+
+static unsigned read(std::vector<unsigned char> const & data, unsigned & offset) {
+    unsigned r     = 0;
+    unsigned shift = 0;
+    while (true) {
+        unsigned char c = data[offset];
+        offset++;
+        r |= static_cast<unsigned>(c & 127) << shift;
+        if (c < 128)
+            return r;
+        shift += 7;
+    }
+}
+
+expr pos_info_table::save(expr const & e, pos_info const & p) {
+    if (m_size % g_checkpoint == 0)
+        m_checkpoints.emplace_back(m_data.size(), m_last);
+    // If the line did not change, we store the delta of the column. Otherwise, we store the column.
+    unsigned dl = encode_delta(p.first, m_last.first);
+    write(dl);
+    if (dl == 0)
+        write(encode_delta(p.second, m_last.second));
+    else
+        write(p.second);
+    m_last = p;
+    // Remark: if e is not shared, then no other thread can reach it.
+    expr r = is_shared(e) ? copy(e) : e;
+    r.set_tag(mk_tag());
+    m_size++;
+    return r;
+}
+
+/** \brief Functional object for implementing \c pos_info_table::propagate. */
+class propagate_pos_fn {
+    typedef std::pair<unsigned, unsigned> pos_info;
+    pos_info_table &    m_table;
+    pos_info const &    m_pos;
+    expr_cell_map<expr> m_cache;
+
+    expr apply(expr const & a) {
+        if (m_table.contains(a))
+            return a;
+        bool sh = false;
+        if (is_shared(a)) {
+            auto r = m_cache.find(a.raw());
+            if (r != m_cache.end())
+                return r->second;
+            sh = true;
+        }
+        expr r;
+        switch (a.kind()) {
+        case expr_kind::Var: case expr_kind::Constant: case expr_kind::Sort:
+            r = a;
+            break;
+        case expr_kind::App:
+            r = update_app(a, apply(app_fn(a)), apply(app_arg(a)));
+            break;
+        case expr_kind::Lambda: case expr_kind::Pi:
+            r = update_binder(a, apply(binder_domain(a)), apply(binder_body(a)));
+            break;
+        case expr_kind::Let:
+            r = update_let(a, apply(let_type(a)), apply(let_value(a)), apply(let_body(a)));
+            break;
+        case expr_kind::Meta: case expr_kind::Local:
+            r = update_mlocal(a, apply(mlocal_type(a)));
+            break;
+        case expr_kind::Macro: {
+            buffer<expr> new_args;
+            for (unsigned i = 0; i < macro_num_args(a); i++)
+                new_args.push_back(apply(macro_arg(a, i)));
+            r = update_macro(a, new_args.size(), new_args.data());
+            break;
+        }}
+        r = m_table.save(r, m_pos);
+        if (sh)
+            m_cache.insert(mk_pair(a.raw(), r));
+        return r;
+    }
+public:
+    propagate_pos_fn(pos_info_table & t, pos_info const & p):m_table(t), m_pos(p) {}
+    expr operator()(expr const & e) { return apply(e); }
+};
+
+expr pos_info_table::propagate(expr const & e, pos_info const & p) {
+    return propagate_pos_fn(*this, p)(e);
+}
+
+auto pos_info_table::find(expr const & e) const -> optional<pos_info> {
+    optional<unsigned> i = find_entry(e.get_tag());
+    if (!i)
+        return optional<pos_info>();
+    unsigned j         = (*i / g_checkpoint) * g_checkpoint;
+    checkpoint const & c = m_checkpoints[*i / g_checkpoint];
+    unsigned offset    = c.m_offset;
+    pos_info p         = c.m_prev;
+    for (; j <= *i; j++) {
+        unsigned dl = read(m_data, offset);
+        if (dl == 0) {
+            p.second = decode_delta(read(m_data, offset), p.second);
+        } else {
+            p.first  = decode_delta(dl, p.first);
+            p.second = read(m_data, offset);
+        }
+    }
+    return optional<pos_info>(p);
+}
+}
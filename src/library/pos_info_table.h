@@ -0,0 +1,87 @@
+/*
+Copyright (c) 2014 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#pragma once
+#include <utility>
+#include <vector>
+#include "util/optional.h"
+#include "kernel/expr.h"
+
+namespace lean {
+/**
+   \brief Compact table for associating source positions (line and column) with expressions.
+
+   Positions are associated with expression tags (see \c expr::get_tag), so the table does not
+   keep the expressions alive, and it can be retained after parsing (e.g., for error reporting).
+   Tables only use the tags in a reserved range (see \c is_pos_info_tag), and these tags are
+   reserved in blocks from a global counter. Thus, the tags of different tables do not overlap,
+   and tags set by other tables (or other clients) are ignored.
+
+   The table never modifies the tag of an expression that may be visible to other threads
+   (e.g., a theorem being elaborated in parallel), see \c save.
+
+   The positions are stored in a byte buffer, encoded as deltas with respect to the previous
+   entry. An absolute position is stored every \c g_checkpoint entries, thus \c find decodes
+   a bounded number of entries.
+
+   \remark Since the tag is stored in the expression, an (unshared) expression saved by two
+   tables is only associated with a position in the last one that saved it.
+*/
+class pos_info_table {
+    typedef std::pair<unsigned, unsigned> pos_info;
+    /** \brief The tags <tt>[m_first_tag, m_first_tag + block_size)</tt> are mapped to the entries starting at \c m_first_entry */
+    struct block {
+        tag      m_first_tag;
+        unsigned m_first_entry;
+        block(tag t, unsigned e):m_first_tag(t), m_first_entry(e) {}
+    };
+    struct checkpoint {
+        unsigned m_offset; // offset in m_data
+        pos_info m_prev;   // position of the previous entry
+        checkpoint(unsigned o, pos_info const & p):m_offset(o), m_prev(p) {}
+    };
+    std::vector<block>         m_blocks;
+    std::vector<checkpoint>    m_checkpoints;
+    std::vector<unsigned char> m_data;
+    unsigned                   m_size;      // number of entries
+    tag                        m_next_tag;  // next available tag in the last block
+    pos_info                   m_last;      // last position stored
+
+    tag mk_tag();
+    optional<unsigned> find_entry(tag t) const;
+    void write(unsigned v);
+public:
+    pos_info_table();
+
+    /**
+       \brief Associate the position \c p with \c e, and return the expression that must be used
+       instead of \c e. If \c e is not shared, then its tag is updated and \c e is returned.
+       Otherwise, the position is associated with a shallow copy of \c e.
+    */
+    expr save(expr const & e, pos_info const & p);
+    /**
+       \brief Associate the position \c p with the subexpressions of \c e that are not in the table,
+       and return the resulting expression. The subexpressions in the table (and their children)
+       are not modified.
+    */
+    expr propagate(expr const & e, pos_info const & p);
+    /** \brief Return true iff the table contains a position for \c e. */
+    bool contains(expr const & e) const { return static_cast<bool>(find_entry(e.get_tag())); }
+    /** \brief Return the position associated with \c e (if any). */
+    optional<pos_info> find(expr const & e) const;
+
+    /** \brief Number of positions stored in the table. */
+    unsigned size() const { return m_size; }
+    /** \brief Number of bytes used to store the positions. */
+    unsigned data_size() const { return m_data.size(); }
+};
+
+/**
+   \brief Return true iff \c t is one of the tags reserved for \c pos_info_table.
+   Other clients of \c expr::set_tag must not use them.
+*/
+bool is_pos_info_tag(tag t);
+}
@@ -7,6 +7,7 @@ Author: Leonardo de Moura
 #include "util/splay_tree.h"
 #include "util/list_fn.h"
 #include "util/sstream.h"
+#include "util/thread.h"
 #include "kernel/environment.h"
 #include "library/io_state_stream.h"
 #include "library/equality.h"
@@ -16,16 +17,78 @@ Author: Leonardo de Moura
 
 namespace lean {
 rewrite_rule::rewrite_rule(name const & id, expr const & lhs, expr const & rhs, expr const & ceq, expr const & proof,
-                           unsigned num_args, bool is_permutation, bool must_check):
+                           unsigned num_args, bool is_permutation, bool must_check, unsigned idx):
     m_id(id), m_lhs(lhs), m_rhs(rhs), m_ceq(ceq), m_proof(proof), m_num_args(num_args),
-    m_is_permutation(is_permutation), m_must_check_types(must_check) {
+    m_is_permutation(is_permutation), m_must_check_types(must_check), m_idx(idx) {
 }
 
-rewrite_rule_set::rewrite_rule_set(ro_environment const & env):m_env(env.to_weak_ref()) {}
+rewrite_rule_set::rewrite_rule_set(ro_environment const & env):
+    m_env(env.to_weak_ref()), m_next_idx(0), m_version(0), m_has_metavar(false) {}
 rewrite_rule_set::rewrite_rule_set(rewrite_rule_set const & other):
-    m_env(other.m_env), m_rule_set(other.m_rule_set), m_disabled_rules(other.m_disabled_rules), m_congr_thms(other.m_congr_thms) {}
+    m_env(other.m_env), m_rule_set(other.m_rule_set), m_index(other.m_index), m_unindexed_rules(other.m_unindexed_rules),
+    m_next_idx(other.m_next_idx), m_version(other.m_version), m_has_metavar(other.m_has_metavar),
+    m_disabled_rules(other.m_disabled_rules), m_congr_thms(other.m_congr_thms) {}
 rewrite_rule_set::~rewrite_rule_set() {}
 
+/** \brief Return the name used to index \c e, \c e must be a constant or a value. */
+static name const & get_index_key(expr const & e) {
+    lean_assert(is_constant(e) || is_value(e));
+    return is_constant(e) ? const_name(e) : to_value(e).get_name();
+}
+
+/** \brief Number of arguments of the applications matched by \c lhs. */
+static unsigned get_lhs_arity(expr const & lhs) {
+    return is_app(lhs) ? num_args(lhs) : 0;
+}
+
+/**
+   \brief Store in \c keys the names of the constants and values that may be the head symbol of an
+   expression matched by \c lhs. That is, the head symbol of \c lhs and everything it unfolds to.
+   Return false if \c lhs may match expressions with any head symbol.
+*/
+bool rewrite_rule_set::get_index_keys(ro_environment const & env, expr const & lhs, buffer<name> & keys) const {
+    expr h = is_app(lhs) ? arg(lhs, 0) : lhs;
+    while (true) {
+        if (is_value(h)) {
+            keys.push_back(get_index_key(h));
+            return true;
+        } else if (is_constant(h)) {
+            keys.push_back(get_index_key(h));
+            auto obj = env->find_object(const_name(h));
+            if (!obj || !(obj->is_definition() || obj->is_builtin()))
+                return true;
+            h = obj->get_value();
+        } else {
+            // The head is a variable, or the unfolding produced an expression that is not a constant
+            // nor a value (e.g., an application that may take extra arguments).
+            return false;
+        }
+    }
+}
+
+static atomic<unsigned> g_next_version(1);
+
+void rewrite_rule_set::updt_version() {
+    m_version = atomic_fetch_add_explicit(&g_next_version, 1u, memory_order_relaxed);
+}
+
+void rewrite_rule_set::insert_core(rewrite_rule const & rule) {
+    m_rule_set = cons(rule, m_rule_set);
+    updt_version();
+    if (has_metavar(rule.get_ceq()))
+        m_has_metavar = true;
+    ro_environment env(m_env);
+    buffer<name> keys;
+    if (get_index_keys(env, rule.get_lhs(), keys)) {
+        for (name const & k : keys) {
+            list<rewrite_rule> const * rules = m_index.find(k);
+            m_index.insert(k, cons(rule, rules ? *rules : list<rewrite_rule>()));
+        }
+    } else {
+        m_unindexed_rules = cons(rule, m_unindexed_rules);
+    }
+}
+
 void rewrite_rule_set::insert(name const & id, expr const & th, expr const & proof, optional<ro_metavar_env> const & menv) {
     ro_environment env(m_env);
     for (auto const & p : to_ceqs(env, menv, th, proof)) {
@@ -40,9 +103,9 @@ void rewrite_rule_set::insert(name const & id, expr const & th, expr const & pro
         }
         lean_assert(is_equality(eq));
         bool must_check = !is_safe_to_skip_check_ceq_types(m_env, menv, ceq);
-        m_rule_set = cons(rewrite_rule(id, arg(eq, num_args(eq) - 2), arg(eq, num_args(eq) - 1),
-                                       ceq, proof, num, is_perm, must_check),
-                          m_rule_set);
+        insert_core(rewrite_rule(id, arg(eq, num_args(eq) - 2), arg(eq, num_args(eq) - 1),
+                                 ceq, proof, num, is_perm, must_check, m_next_idx));
+        m_next_idx++;
     }
 }
 
@@ -65,25 +128,59 @@ bool rewrite_rule_set::enabled(name const & id) const {
 }
 
 void rewrite_rule_set::enable(name const & id, bool f) {
+    if (f == enabled(id))
+        return;
     if (f)
         m_disabled_rules.erase(id);
     else
         m_disabled_rules.insert(id);
+    updt_version();
 }
 
 void rewrite_rule_set::insert_congr(expr const & e) {
     ro_environment env(m_env);
     m_congr_thms.emplace_front(check_congr_theorem(env, e));
+    updt_version();
 }
 
 void rewrite_rule_set::insert_congr(name const & th_name) {
     insert_congr(mk_constant(th_name));
 }
 
-bool rewrite_rule_set::find_match(expr const &, match_fn const & fn) const {
-    auto l = m_rule_set;
-    for (auto const & rule : l) {
-        if (enabled(rule) && fn(rule))
+bool rewrite_rule_set::find_match(expr const & e, match_fn const & fn) const {
+    expr const & h = is_app(e) ? arg(e, 0) : e;
+    if (is_app(e) && !is_constant(h) && !is_value(h)) {
+        // The head of e may be the result of unfolding the head of any rule.
+        auto l = m_rule_set;
+        for (auto const & rule : l) {
+            if (enabled(rule) && fn(rule))
+                return true;
+        }
+        return false;
+    }
+    list<rewrite_rule> indexed;
+    if (is_app(e) || is_constant(e) || is_value(e)) {
+        if (list<rewrite_rule> const * rules = m_index.find(get_index_key(h)))
+            indexed = *rules;
+    }
+    unsigned arity = get_lhs_arity(e);
+    auto l1 = indexed;
+    auto l2 = m_unindexed_rules;
+    // Both lists are sorted by decreasing insertion order, we merge them to preserve the rule priorities.
+    auto it1 = l1.begin(); auto end1 = l1.end();
+    auto it2 = l2.begin(); auto end2 = l2.end();
+    while (it1 != end1 || it2 != end2) {
+        rewrite_rule const * rule;
+        if (it2 == end2 || (it1 != end1 && it1->m_idx > it2->m_idx)) {
+            rule = &*it1;
+            ++it1;
+            if (get_lhs_arity(rule->get_lhs()) != arity)
+                continue;
+        } else {
+            rule = &*it2;
+            ++it2;
+        }
+        if (enabled(*rule) && fn(*rule))
             return true;
     }
     return false;
@@ -9,7 +9,9 @@ Author: Leonardo de Moura
 #include <functional>
 #include "util/lua.h"
 #include "util/list.h"
+#include "util/buffer.h"
 #include "util/splay_tree.h"
+#include "util/rb_map.h"
 #include "util/name.h"
 #include "kernel/environment.h"
 #include "kernel/metavar.h"
@@ -29,8 +31,9 @@ class rewrite_rule {
     unsigned m_num_args;
     bool     m_is_permutation;
     bool     m_must_check_types; // if true, then we must check if the given types are convertible to the expected types
+    unsigned m_idx;              // insertion order in the rule set, newer rules have bigger indices
     rewrite_rule(name const & id, expr const & lhs, expr const & rhs, expr const & ceq, expr const & proof,
-                 unsigned num_args, bool is_permutation, bool must_check);
+                 unsigned num_args, bool is_permutation, bool must_check, unsigned idx);
 public:
     name const & get_id() const { return m_id; }
     expr const & get_lhs() const { return m_lhs; }
@@ -44,15 +47,30 @@ public:
 
 /**
    \brief Actual implementation of the \c rewrite_rule_set class.
+
+   The rules are indexed by the head symbol and number of arguments of their left-hand-side.
+   A left-hand-side <tt>(f a_1 ... a_n)</tt> may only match applications <tt>(g b_1 ... b_n)</tt>
+   where \c g is \c f or a constant that \c f unfolds to (see \c hop_match).
+   Rules whose left-hand-side does not have this form (e.g., its head is a variable) are
+   stored in a separate list, they are candidates for every expression.
 */
 class rewrite_rule_set {
     typedef splay_tree<name, name_quick_cmp> name_set;
+    typedef rb_map<name, list<rewrite_rule>, name_quick_cmp> rule_index;
     ro_environment::weak_ref m_env;
-    list<rewrite_rule>       m_rule_set; // TODO(Leo): use better data-structure, e.g., discrimination trees
+    list<rewrite_rule>       m_rule_set;       // all rules, the most recent ones first
+    rule_index               m_index;          // head symbol -> rules, the most recent ones first
+    list<rewrite_rule>       m_unindexed_rules;
+    unsigned                 m_next_idx;
+    unsigned                 m_version;        // see get_version
+    bool                     m_has_metavar;    // true if some rule contains metavariables
     name_set                 m_disabled_rules;
     list<congr_theorem_info> m_congr_thms; // This is probably ok since we usually have very few congruence theorems
 
     bool enabled(rewrite_rule const & rule) const;
+    bool get_index_keys(ro_environment const & env, expr const & lhs, buffer<name> & keys) const;
+    void insert_core(rewrite_rule const & rule);
+    void updt_version();
 public:
     rewrite_rule_set(ro_environment const & env);
     rewrite_rule_set(rewrite_rule_set const & other);
@@ -102,7 +120,25 @@ public:
 
     /** \brief Pretty print this rule set. */
     format pp(formatter const & fmt, options const & opts) const;
+
+    /**
+       \brief Return the version of this rule set. Empty rule sets have version 0, and every update
+       (new rule, new congruence theorem, enabling/disabling rules) assigns a new unique version.
+       Copies share the version of the original object. Thus, two rule sets with the same version
+       contain the same rules, disabled rules, and congruence theorems.
+    */
+    unsigned get_version() const { return m_version; }
+
+    /** \brief Return true iff some rule in this rule set contains metavariables. */
+    bool has_metavar_rules() const { return m_has_metavar; }
+
+    /**
+       \brief Return true iff \c a and \c b have the same version (see \c get_version).
+       It is a conservative approximation of "contain the same rules" that takes constant time.
+    */
+    friend bool operator==(rewrite_rule_set const & a, rewrite_rule_set const & b) { return a.m_version == b.m_version; }
 };
+inline bool operator!=(rewrite_rule_set const & a, rewrite_rule_set const & b) { return !(a == b); }
 io_state_stream const & operator<<(io_state_stream const & out, rewrite_rule_set const & rs);
 
 name const & get_default_rewrite_rule_set_id();
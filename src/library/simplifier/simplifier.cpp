@@ -6,9 +6,15 @@ Author: Leonardo de Moura
 */
 #include <utility>
 #include <vector>
+#include <list>
+#include <memory>
+#include <algorithm>
 #include "util/flet.h"
+#include "util/thread.h"
 #include "util/freset.h"
+#include "util/hash.h"
 #include "util/interrupt.h"
+#include "util/memory_budget.h"
 #include "util/luaref.h"
 #include "util/script_state.h"
 #include "kernel/type_checker.h"
@@ -62,6 +68,18 @@ Author: Leonardo de Moura
 #define LEAN_SIMPLIFIER_MEMOIZE true
 #endif
 
+#ifndef LEAN_SIMPLIFIER_SHARED_CACHE
+#define LEAN_SIMPLIFIER_SHARED_CACHE true
+#endif
+
+#ifndef LEAN_SIMPLIFIER_SHARED_CACHE_SIZE
+#define LEAN_SIMPLIFIER_SHARED_CACHE_SIZE 32
+#endif
+
+#ifndef LEAN_SIMPLIFIER_SHARED_CACHE_SLOT_SIZE
+#define LEAN_SIMPLIFIER_SHARED_CACHE_SLOT_SIZE 16384
+#endif
+
 #ifndef LEAN_SIMPLIFIER_HEQ
 #define LEAN_SIMPLIFIER_HEQ false
 #endif
@@ -84,6 +102,7 @@ static name g_simplifier_eval         {"simplifier", "eval"};
 static name g_simplifier_unfold       {"simplifier", "unfold"};
 static name g_simplifier_conditional  {"simplifier", "conditional"};
 static name g_simplifier_memoize      {"simplifier", "memoize"};
+static name g_simplifier_shared_cache {"simplifier", "shared_cache"};
 static name g_simplifier_max_steps    {"simplifier", "max_steps"};
 static name g_simplifier_heq          {"simplifier", "heq"};
 static name g_simplifier_preserve_binder_names {"simplifier", "preserve_binder_names"};
@@ -97,6 +116,8 @@ RegisterBoolOption(g_simplifier_eval, LEAN_SIMPLIFIER_EVAL, "(simplifier) apply
 RegisterBoolOption(g_simplifier_unfold, LEAN_SIMPLIFIER_UNFOLD, "(simplifier) unfolds non-opaque definitions");
 RegisterBoolOption(g_simplifier_conditional, LEAN_SIMPLIFIER_CONDITIONAL, "(simplifier) conditional rewriting");
 RegisterBoolOption(g_simplifier_memoize, LEAN_SIMPLIFIER_MEMOIZE, "(simplifier) memoize/cache intermediate results");
+RegisterBoolOption(g_simplifier_shared_cache, LEAN_SIMPLIFIER_SHARED_CACHE,
+                   "(simplifier) reuse results produced by other simplifier objects (with the same rule sets and options) in the same environment");
 RegisterBoolOption(g_simplifier_preserve_binder_names, LEAN_SIMPLIFIER_PRESERVE_BINDER_NAMES,
                    "(simplifier) (try to) preserve binder names when applying higher-order rewrite rules");
 RegisterBoolOption(g_simplifier_heq, LEAN_SIMPLIFIER_HEQ, "(simplifier) use heterogeneous equality support");
@@ -111,6 +132,7 @@ bool get_simplifier_eval(options const & opts) { return opts.get_bool(g_simplifi
 bool get_simplifier_unfold(options const & opts) { return opts.get_bool(g_simplifier_unfold, LEAN_SIMPLIFIER_UNFOLD); }
 bool get_simplifier_conditional(options const & opts) { return opts.get_bool(g_simplifier_conditional, LEAN_SIMPLIFIER_CONDITIONAL); }
 bool get_simplifier_memoize(options const & opts) { return opts.get_bool(g_simplifier_memoize, LEAN_SIMPLIFIER_MEMOIZE); }
+bool get_simplifier_shared_cache(options const & opts) { return opts.get_bool(g_simplifier_shared_cache, LEAN_SIMPLIFIER_SHARED_CACHE); }
 bool get_simplifier_heq(options const & opts) { return opts.get_bool(g_simplifier_heq, LEAN_SIMPLIFIER_HEQ); }
 bool get_simplifier_preserve_binder_names(options const & opts) {
     return opts.get_bool(g_simplifier_preserve_binder_names, LEAN_SIMPLIFIER_PRESERVE_BINDER_NAMES);
@@ -122,6 +144,108 @@ static name g_C("C");
 static name g_H("H");
 static name g_x("x");
 static name g_unique = name::mk_internal_unique_name();
+static atomic<unsigned> g_next_fresh_idx(0);
+
+/**
+   \brief Simplification results shared by all simplifier objects that use the same environment
+   (e.g., the simplifier tactic is usually applied several times to the same hypotheses).
+
+   The results are grouped in slots. Each slot is associated with the rule sets and configuration
+   used to produce its results. Thus, nothing needs to be invalidated when a rule set is modified,
+   the simplifier objects using the modified rule set will just use a different slot.
+   Only the last \c LEAN_SIMPLIFIER_SHARED_CACHE_SIZE slots used are kept, and a slot is
+   reset when it contains \c LEAN_SIMPLIFIER_SHARED_CACHE_SLOT_SIZE results.
+*/
+class simplifier_cache {
+public:
+    typedef simplifier_cell::result result;
+    class slot {
+        friend class simplifier_cache;
+        std::vector<unsigned> m_versions; // versions of the rule sets (see rewrite_rule_set::get_version)
+        unsigned              m_fingerprint;
+        unsigned              m_config;
+        mutex                 m_mutex;
+        expr_map<result>      m_results;
+    public:
+        slot(std::vector<unsigned> const & vs, unsigned fingerprint, unsigned config):
+            m_versions(vs), m_fingerprint(fingerprint), m_config(config) {}
+        optional<result> find(expr const & e) {
+            lock_guard<mutex> lock(m_mutex);
+            auto it = m_results.find(e);
+            if (it != m_results.end())
+                return optional<result>(it->second);
+            else
+                return optional<result>();
+        }
+        void insert(expr const & e, result const & r) {
+            lock_guard<mutex> lock(m_mutex);
+            if (m_results.size() >= LEAN_SIMPLIFIER_SHARED_CACHE_SLOT_SIZE)
+                m_results.clear();
+            m_results.insert(mk_pair(e, r));
+        }
+        void clear() {
+            lock_guard<mutex> lock(m_mutex);
+            m_results.clear();
+        }
+    };
+private:
+    mutex                             m_mutex;
+    std::list<std::shared_ptr<slot>>  m_slots; // most recently used first
+public:
+    std::shared_ptr<slot> get_slot(std::vector<rewrite_rule_set> const & rs, unsigned config) {
+        std::vector<unsigned> vs;
+        unsigned fingerprint = config;
+        for (auto const & s : rs) {
+            vs.push_back(s.get_version());
+            fingerprint = hash(fingerprint, s.get_version());
+        }
+        lock_guard<mutex> lock(m_mutex);
+        for (auto it = m_slots.begin(); it != m_slots.end(); ++it) {
+            slot const & s = **it;
+            if (s.m_fingerprint == fingerprint && s.m_config == config && s.m_versions == vs) {
+                std::shared_ptr<slot> r = *it;
+                m_slots.erase(it);
+                m_slots.push_front(r);
+                return r;
+            }
+        }
+        m_slots.push_front(std::make_shared<slot>(vs, fingerprint, config));
+        if (m_slots.size() > LEAN_SIMPLIFIER_SHARED_CACHE_SIZE)
+            m_slots.pop_back();
+        return m_slots.front();
+    }
+    void clear() {
+        lock_guard<mutex> lock(m_mutex);
+        m_slots.clear();
+    }
+};
+
+/**
+   \brief Environment extension for storing the simplifier cache shared by the simplifier objects
+   that use the environment.
+*/
+struct simplifier_cache_extension : public environment_extension {
+    mutable simplifier_cache m_cache;
+};
+
+struct simplifier_cache_extension_initializer {
+    unsigned m_extid;
+    simplifier_cache_extension_initializer() {
+        m_extid = environment_cell::register_extension([](){
+                return std::unique_ptr<environment_extension>(new simplifier_cache_extension());
+            });
+    }
+};
+
+static simplifier_cache_extension_initializer g_simplifier_cache_extension_initializer;
+
+static simplifier_cache & get_simplifier_cache(ro_environment const & env) {
+    return env->get_extension<simplifier_cache_extension>(g_simplifier_cache_extension_initializer.m_extid).m_cache;
+}
+
+void clear_simplifier_cache(ro_environment const & env) {
+    get_simplifier_cache(env).clear();
+}
 
 class simplifier_cell::imp {
     friend class simplifier_cell;
@@ -131,18 +255,24 @@ class simplifier_cell::imp {
     typedef expr_map<result> cache;
     typedef std::vector<congr_theorem_info const *> congr_thms;
     typedef cache const_map;
+    typedef std::shared_ptr<simplifier_cache::slot> shared_cache;
     std::weak_ptr<simplifier_cell> m_this;
     ro_environment m_env;
     options        m_options;
     type_checker   m_tc;
     rule_sets      m_rule_sets;
     cache          m_cache;
+    expr_map<bool> m_fresh_cache;  // see has_fresh_const
+    shared_cache   m_shared_cache; // results shared with other simplifier objects (see simplifier_cache)
+    bool           m_use_shared_cache;
+    unsigned       m_local_scopes; // number of hypotheses added to m_rule_sets[0] (see updt_rule_set)
     max_sharing_fn m_max_sharing;
     const_map      m_const_map;  // mapping from old to new constants in hfunext and hpiext
     congr_thms     m_congr_thms;
     unsigned       m_next_idx;  // index used to create fresh constants
     unsigned       m_num_steps; // number of steps performed
     unsigned       m_depth;     // recursion depth
+    memory_shedder m_shedder;   // clear the caches when the soft memory limit is exceeded, it is executed at operator()
     name_map<name> m_name_subst;
     cached_ro_metavar_env m_menv;
     std::shared_ptr<simplifier_monitor> m_monitor;
@@ -174,8 +304,10 @@ class simplifier_cell::imp {
             m_fn(fn), m_old(m_fn.m_rule_sets[0]), m_reset_cache(m_fn.m_cache) {
             lean_assert(const_type(H));
             m_fn.m_rule_sets[0].insert(g_local, *const_type(H), H, m_fn.m_menv.to_some_menv());
+            m_fn.m_local_scopes++;
         }
         ~updt_rule_set() {
+            m_fn.m_local_scopes--;
             m_fn.m_rule_sets[0] = m_old;
             // Remark: m_reset_cache destructor will restore the cache
         }
@@ -221,9 +353,56 @@ class simplifier_cell::imp {
     expr instantiate(expr const & e, unsigned n, expr const * s) { return ::lean::instantiate(e, n, s, m_menv.to_some_menv()); }
     expr head_beta_reduce(expr const & t) { return ::lean::head_beta_reduce(t, m_menv.to_some_menv()); }
 
+    /**
+       \brief Create a fresh constant. The names are unique across simplifier objects, since the
+       cached results may be reused by other simplifier objects.
+    */
     expr mk_fresh_const(expr const & type) {
         m_next_idx++;
-        return mk_constant(name(g_unique, m_next_idx), type);
+        unsigned idx = atomic_fetch_add_explicit(&g_next_fresh_idx, 1u, memory_order_relaxed);
+        return mk_constant(name(g_unique, idx), type);
+    }
+
+    bool use_shared_cache() const { return m_use_shared_cache && m_local_scopes == 0; }
+
+    static bool is_fresh_const(expr const & e) { return is_constant(e) && const_name(e).get_prefix() == g_unique; }
+
+    /**
+       \brief Return true iff \c e contains a constant created using \c mk_fresh_const.
+       The results for these expressions are not shared, since the fresh constants are never used again.
+       The results are cached in \c m_fresh_cache, \c e is maximally shared (see \c simplify).
+    */
+    bool has_fresh_const(expr const & e) {
+        switch (e.kind()) {
+        case expr_kind::Var: case expr_kind::Type: case expr_kind::Value: case expr_kind::MetaVar:
+            return false;
+        case expr_kind::Constant:
+            return is_fresh_const(e);
+        default:
+            break;
+        }
+        auto it = m_fresh_cache.find(e);
+        if (it != m_fresh_cache.end())
+            return it->second;
+        bool r = false;
+        switch (e.kind()) {
+        case expr_kind::App:
+            r = std::any_of(begin_args(e), end_args(e), [&](expr const & a) { return has_fresh_const(a); });
+            break;
+        case expr_kind::Lambda: case expr_kind::Pi:
+            r = has_fresh_const(abst_domain(e)) || has_fresh_const(abst_body(e));
+            break;
+        case expr_kind::Let:
+            r = (let_type(e) && has_fresh_const(*let_type(e))) || has_fresh_const(let_value(e)) || has_fresh_const(let_body(e));
+            break;
+        case expr_kind::HEq:
+            r = has_fresh_const(heq_lhs(e)) || has_fresh_const(heq_rhs(e));
+            break;
+        default:
+            lean_unreachable(); // LCOV_EXCL_LINE
+        }
+        m_fresh_cache.insert(mk_pair(e, r));
+        return r;
     }
 
     /**
@@ -1443,6 +1622,8 @@ class simplifier_cell::imp {
         if (m_memoize) {
             result new_r = r.update_expr(m_max_sharing(r.m_expr));
             m_cache.insert(mk_pair(e, new_r));
+            if (use_shared_cache() && !has_fresh_const(e))
+                m_shared_cache->insert(e, new_r);
             if (m_monitor)
                 m_monitor->step_eh(ro_simplifier(m_this), e, new_r.m_expr, new_r.m_proof);
             return new_r;
@@ -1463,6 +1644,12 @@ class simplifier_cell::imp {
             if (it != m_cache.end()) {
                 return it->second;
             }
+            if (use_shared_cache()) {
+                if (auto r = m_shared_cache->find(e)) {
+                    m_cache.insert(mk_pair(e, *r));
+                    return *r;
+                }
+            }
         }
         if (m_monitor)
             m_monitor->pre_eh(ro_simplifier(m_this), e);
@@ -1510,10 +1697,31 @@ class simplifier_cell::imp {
         m_preserve_binder_names = get_simplifier_preserve_binder_names(o);
     }
 
+    /** \brief Encode the options that affect the simplification results. */
+    unsigned get_config() const {
+        bool flags[] = { m_proofs_enabled, m_contextual, m_single_pass, m_beta, m_eta, m_eval,
+                         m_unfold, m_conditional, m_use_heq, m_preserve_binder_names };
+        unsigned r = 0;
+        for (bool f : flags)
+            r = 2*r + (f ? 1 : 0);
+        return r;
+    }
+
+    /**
+       \brief Return true if the rule sets contain rules with metavariables. The results produced using
+       these rules depend on the metavariable environment, then they must not be shared.
+    */
+    bool has_metavar_rules() const {
+        return std::any_of(m_rule_sets.begin(), m_rule_sets.end(),
+                           [](rewrite_rule_set const & rs) { return rs.has_metavar_rules(); });
+    }
+
 public:
     imp(ro_environment const & env, options const & o, unsigned num_rs, rewrite_rule_set const * rs,
         std::shared_ptr<simplifier_monitor> const & monitor):
-        m_env(env), m_options(o), m_tc(env), m_monitor(monitor) {
+        m_env(env), m_options(o), m_tc(env), m_use_shared_cache(false), m_local_scopes(0),
+        m_shedder([=]() { m_cache.clear(); m_fresh_cache.clear(); if (m_shared_cache) m_shared_cache->clear(); }),
+        m_monitor(monitor) {
         set_options(o);
         if (m_contextual) {
             // We need an extra rule set if we are performing contextual rewriting
@@ -1522,13 +1730,18 @@ public:
         m_rule_sets.insert(m_rule_sets.end(), rs, rs + num_rs);
         collect_congr_thms();
         m_next_idx = 0;
+        if (m_memoize && get_simplifier_shared_cache(o) && !has_metavar_rules())
+            m_shared_cache = get_simplifier_cache(env).get_slot(m_rule_sets, get_config());
     }
 
     result operator()(expr const & e, optional<ro_metavar_env> const & menv) {
+        m_shedder();
         if (m_menv.update(menv))
             m_cache.clear();
         m_num_steps = 0;
         m_depth     = 0;
+        // The results for expressions containing metavariables depend on the metavariable environment.
+        m_use_shared_cache = m_shared_cache && !has_metavar(e);
         try {
             auto r = simplify(e);
             if (m_proofs_enabled && !r.get_proof())
@@ -144,6 +144,12 @@ simplifier::result simplify(expr const & e, ro_environment const & env, options
                             unsigned num_ns, name const * ns,
                             optional<ro_metavar_env> const & menv = none_ro_menv(),
                             std::shared_ptr<simplifier_monitor> const & monitor = std::shared_ptr<simplifier_monitor>());
+/**
+   \brief Remove the simplification results shared by the simplifier objects that use \c env.
+   The shared results are associated with the rule sets used to produce them, so this is only
+   needed to release memory.
+*/
+void clear_simplifier_cache(ro_environment const & env);
 void open_simplifier(lua_State * L);
 /**
    \brief Associate the given simplifier monitor with the lua_State object \c L.
@@ -0,0 +1,114 @@
+/*
+Copyright (c) 2014 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#include <vector>
+#include <algorithm>
+#include "util/hash.h"
+#include "util/buffer.h"
+#include "library/term_index.h"
+
+namespace lean {
+/**
+   \brief Positions used to build fingerprints, they are encoded as sequences of argument indices
+   terminated by -1. The root, the first three arguments, and the first two arguments of the first two arguments.
+*/
+static int const g_positions[][3] = {
+    {-1, 0, 0}, {0, -1, 0}, {1, -1, 0}, {2, -1, 0}, {0, 0, -1}, {0, 1, -1}, {1, 0, -1}, {1, 1, -1}
+};
+
+static expr const & get_head(expr const & e) {
+    expr const * it = &e;
+    while (is_app(*it))
+        it = &app_fn(*it);
+    return *it;
+}
+
+static bool is_pattern_var(expr const & e) {
+    expr const & h = get_head(e);
+    return is_var(h) || is_metavar(h);
+}
+
+static void get_args(expr const & e, buffer<expr> & args) {
+    expr const * it = &e;
+    while (is_app(*it)) {
+        args.push_back(app_arg(*it));
+        it = &app_fn(*it);
+    }
+    std::reverse(args.begin(), args.end());
+}
+
+/** \brief Return the feature for the head symbol of \c e, it takes into account the number of arguments. */
+static unsigned get_symbol_feature(expr const & e, unsigned num_args) {
+    expr const & h = get_head(e);
+    unsigned code;
+    switch (h.kind()) {
+    case expr_kind::Constant: code = const_name(h).hash(); break;
+    case expr_kind::Local:    code = mlocal_name(h).hash(); break;
+    case expr_kind::Macro:    code = macro_def(h).hash(); break;
+    default:                  code = static_cast<unsigned>(h.kind()); break;
+    }
+    unsigned r = hash(code, num_args);
+    if (r < TF_FIRST_SYMBOL)
+        r += TF_FIRST_SYMBOL;
+    return r;
+}
+
+static unsigned get_feature(expr const & e, int const * pos) {
+    expr t = e;
+    buffer<expr> args;
+    for (; *pos >= 0; pos++) {
+        if (is_pattern_var(t))
+            return TF_BELOW_VAR;
+        args.clear();
+        get_args(t, args);
+        if (static_cast<unsigned>(*pos) >= args.size())
+            return TF_NONE;
+        t = args[*pos];
+    }
+    if (is_pattern_var(t))
+        return TF_VAR;
+    args.clear();
+    get_args(t, args);
+    return get_symbol_feature(t, args.size());
+}
+
+term_fingerprint get_term_fingerprint(expr const & e) {
+    term_fingerprint r;
+    for (auto const & pos : g_positions)
+        r.push_back(get_feature(e, pos));
+    return r;
+}
+
+/**
+   \brief Return true iff a term with feature \c f2 may be an instance of a term with feature \c f1.
+   Remark: variables in the instance are treated as constants.
+*/
+static bool may_be_instance(unsigned f1, unsigned f2) {
+    switch (f1) {
+    case TF_VAR:       return f2 == TF_VAR || f2 >= TF_FIRST_SYMBOL;
+    case TF_BELOW_VAR: return true;
+    case TF_NONE:      return f2 == TF_NONE || f2 == TF_BELOW_VAR;
+    default:           return f1 == f2;
+    }
+}
+
+static bool may_be_unifiable(unsigned f1, unsigned f2) {
+    if (f1 == TF_BELOW_VAR || f2 == TF_BELOW_VAR)
+        return true;
+    if (f1 == TF_NONE || f2 == TF_NONE)
+        return f1 == f2;
+    return f1 == TF_VAR || f2 == TF_VAR || f1 == f2;
+}
+
+bool is_compatible_feature(unsigned f1, unsigned f2, term_index_query k) {
+    switch (k) {
+    case term_index_query::Generalizations: return may_be_instance(f1, f2);
+    case term_index_query::Instances:       return may_be_instance(f2, f1);
+    case term_index_query::Unifiables:      return may_be_unifiable(f1, f2);
+    }
+    lean_unreachable(); // LCOV_EXCL_LINE
+}
+}
@@ -0,0 +1,181 @@
+/*
+Copyright (c) 2014 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#pragma once
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <utility>
+#include <unordered_map>
+#include "kernel/expr.h"
+
+namespace lean {
+/** \brief Fingerprint features that are not function symbols. */
+enum term_feature { TF_VAR = 0, TF_BELOW_VAR = 1, TF_NONE = 2, TF_FIRST_SYMBOL = 3 };
+typedef std::vector<unsigned> term_fingerprint;
+enum class term_index_query { Generalizations, Instances, Unifiables };
+
+/**
+   \brief Return the fingerprint of \c e. It contains a feature for each position in a fixed set of
+   positions (a position is a sequence of argument indices). The feature at a position \c p is:
+     - a code for the head symbol and number of arguments of the subterm at \c p, if it exists and it is not a variable;
+     - \c TF_VAR if the subterm at \c p is a variable;
+     - \c TF_BELOW_VAR if \c p is below a variable (i.e., it may exist in an instance of \c e);
+     - \c TF_NONE otherwise (\c p does not exist in any instance of \c e).
+
+   Free variables and metavariables are pattern variables. An application whose function is a
+   pattern variable (i.e., a higher-order pattern) is also considered a variable.
+*/
+term_fingerprint get_term_fingerprint(expr const & e);
+
+/**
+   \brief Return true iff the feature \c f1 of an indexed term and feature \c f2 of the query term
+   (at the same position) are compatible with respect to the query \c k.
+   For generalizations, the query term is an instance of the indexed term; for instances, the indexed
+   term is an instance of the query term.
+*/
+bool is_compatible_feature(unsigned f1, unsigned f2, term_index_query k);
+
+/**
+   \brief Index mapping terms (patterns) to values of type \c T. It supports retrieving the entries whose
+   term is a generalization of, an instance of, or may be unifiable with a given term.
+
+   The index is a trie of fingerprints (see \c get_term_fingerprint). The retrieval operations return
+   a superset of the entries satisfying the query, the caller is still responsible for matching (or unifying)
+   the retrieved terms. They only visit the branches of the trie that are compatible with the query.
+
+   The trie nodes are shared by copies of the index, and are copied on demand when the index is updated.
+*/
+template<typename T>
+class term_index {
+    struct node;
+    typedef std::shared_ptr<node> node_ptr;
+    struct node {
+        std::unordered_map<unsigned, node_ptr> m_children;
+        std::vector<std::pair<expr, T>>        m_entries;
+    };
+    node_ptr m_root;
+    unsigned m_size;
+
+    static node & ensure_unique(node_ptr & n) {
+        if (!n)
+            n = std::make_shared<node>();
+        else if (n.use_count() > 1)
+            n = std::make_shared<node>(*n);
+        return *n;
+    }
+
+    node & get_leaf(expr const & e) {
+        node_ptr * it = &m_root;
+        for (unsigned f : get_term_fingerprint(e))
+            it = &(ensure_unique(*it).m_children[f]);
+        return ensure_unique(*it);
+    }
+
+    typedef typename std::vector<std::pair<expr, T>>::const_iterator entry_iterator;
+    static entry_iterator find_entry(node const & n, expr const & e, T const & v) {
+        return std::find_if(n.m_entries.begin(), n.m_entries.end(),
+                            [&](std::pair<expr, T> const & p) { return p.first == e && p.second == v; });
+    }
+
+    /** \brief Return the leaf for the fingerprint \c fp (if it exists). The nodes are not modified. */
+    node const * find_leaf(term_fingerprint const & fp) const {
+        node const * n = m_root.get();
+        for (unsigned f : fp) {
+            if (!n)
+                return nullptr;
+            auto it = n->m_children.find(f);
+            n = it == n->m_children.end() ? nullptr : it->second.get();
+        }
+        return n;
+    }
+
+    /**
+       \brief Remove the entry <tt>(e, v)</tt> from the trie \c n, and remove the nodes that become empty.
+       Return true iff \c n became empty.
+
+       \pre The entry is in the leaf for \c fp.
+    */
+    static bool erase_core(node_ptr & n, term_fingerprint const & fp, unsigned i, expr const & e, T const & v) {
+        node & c = ensure_unique(n);
+        if (i == fp.size()) {
+            c.m_entries.erase(find_entry(c, e, v));
+        } else {
+            auto it = c.m_children.find(fp[i]);
+            lean_assert(it != c.m_children.end());
+            if (erase_core(it->second, fp, i+1, e, v))
+                c.m_children.erase(it);
+        }
+        if (c.m_children.empty() && c.m_entries.empty()) {
+            n.reset();
+            return true;
+        }
+        return false;
+    }
+
+    template<typename F>
+    static void for_each_compatible(node const & n, term_fingerprint const & q, unsigned i, term_index_query k, F & fn) {
+        if (i == q.size()) {
+            for (auto const & p : n.m_entries)
+                fn(p.first, p.second);
+            return;
+        }
+        unsigned f = q[i];
+        if (f >= TF_FIRST_SYMBOL) {
+            // Only the children for f and the non-symbol features may be compatible.
+            for (unsigned c : {f, static_cast<unsigned>(TF_VAR), static_cast<unsigned>(TF_BELOW_VAR), static_cast<unsigned>(TF_NONE)}) {
+                auto it = n.m_children.find(c);
+                if (it != n.m_children.end() && is_compatible_feature(c, f, k))
+                    for_each_compatible(*(it->second), q, i+1, k, fn);
+            }
+        } else {
+            for (auto const & p : n.m_children) {
+                if (is_compatible_feature(p.first, f, k))
+                    for_each_compatible(*(p.second), q, i+1, k, fn);
+            }
+        }
+    }
+
+    template<typename F>
+    void find(expr const & e, term_index_query k, F && fn) const {
+        if (m_root)
+            for_each_compatible(*m_root, get_term_fingerprint(e), 0, k, fn);
+    }
+
+public:
+    term_index():m_size(0) {}
+
+    /** \brief Associate the value \c v with the term \c e. */
+    void insert(expr const & e, T const & v) {
+        get_leaf(e).m_entries.emplace_back(e, v);
+        m_size++;
+    }
+
+    /**
+       \brief Remove an entry <tt>(e, v)</tt> (if there is one). The nodes shared with copies of the index
+       are only copied if the entry is found, and the nodes that become empty are removed.
+    */
+    void erase(expr const & e, T const & v) {
+        term_fingerprint fp = get_term_fingerprint(e);
+        node const * leaf   = find_leaf(fp);
+        if (!leaf || find_entry(*leaf, e, v) == leaf->m_entries.end())
+            return;
+        erase_core(m_root, fp, 0, e, v);
+        m_size--;
+    }
+
+    /** \brief Number of entries in the index. */
+    unsigned size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    /** \brief Execute <tt>fn(p, v)</tt> for each entry <tt>(p, v)</tt> such that \c e may be an instance of \c p. */
+    template<typename F> void find_generalizations(expr const & e, F && fn) const { find(e, term_index_query::Generalizations, fn); }
+    /** \brief Execute <tt>fn(t, v)</tt> for each entry <tt>(t, v)</tt> such that \c t may be an instance of \c e. */
+    template<typename F> void find_instances(expr const & e, F && fn) const { find(e, term_index_query::Instances, fn); }
+    /** \brief Execute <tt>fn(t, v)</tt> for each entry <tt>(t, v)</tt> such that \c t and \c e may be unifiable. */
+    template<typename F> void find_unifiables(expr const & e, F && fn) const { find(e, term_index_query::Unifiables, fn); }
+};
+}
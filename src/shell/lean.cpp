@@ -16,6 +16,10 @@ Author: Leonardo de Moura
 #include "util/script_state.h"
 #include "util/thread.h"
 #include "util/lean_path.h"
+#include "util/memory.h"
+#include "util/memory_budget.h"
+#include "util/perf.h"
+#include "util/lua_bytecode_cache.h"
 #include "kernel/environment.h"
 #include "kernel/kernel_exception.h"
 #include "kernel/formatter.h"
@@ -75,11 +79,22 @@ static void display_help(std::ostream & out) {
     std::cout << "  --luahook=num -c  how often the Lua interpreter checks the interrupted flag,\n";
     std::cout << "                    it is useful for interrupting non-terminating user scripts,\n";
     std::cout << "                    0 means 'do not check'.\n";
+    std::cout << "  --luacache=dir    store precompiled Lua files in the given directory\n";
     std::cout << "  --trust -t        trust imported modules\n";
     std::cout << "  --quiet -q        do not print verbose messages\n";
 #if defined(LEAN_USE_BOOST)
     std::cout << "  --tstack=num -s   thread stack size in Kb\n";
 #endif
+#if defined(LEAN_ALLOC_PROFILER)
+    std::cout << "  --memprof -M      display the memory allocation profile at exit\n";
+#endif
+    std::cout << "  --perf -P         display performance counters and timers at exit\n";
+    std::cout << "  --perftrace=file  save the timed events in the given file using the Chrome\n";
+    std::cout << "                    trace format (see chrome://tracing)\n";
+#if defined(LEAN_TRACK_MEMORY)
+    std::cout << "  --memory=num -m   maximum amount of memory in Mb, caches are released when\n";
+    std::cout << "                    3/4 of this amount is used\n";
+#endif
 }
 
 static char const * get_file_extension(char const * fname) {
@@ -107,10 +122,19 @@ static struct option g_long_options[] = {
     {"luahook",    required_argument, 0, 'c'},
     {"githash",    no_argument,       0, 'g'},
     {"output",     required_argument, 0, 'o'},
+    {"luacache",   required_argument, 0, 'L'},
     {"trust",      no_argument,       0, 't'},
     {"quiet",      no_argument,       0, 'q'},
 #if defined(LEAN_USE_BOOST)
     {"tstack",     required_argument, 0, 's'},
+#endif
+#if defined(LEAN_ALLOC_PROFILER)
+    {"memprof",    no_argument,       0, 'M'},
+#endif
+    {"perf",       no_argument,       0, 'P'},
+    {"perftrace",  required_argument, 0, 'T'},
+#if defined(LEAN_TRACK_MEMORY)
+    {"memory",     required_argument, 0, 'm'},
 #endif
     {0, 0, 0, 0}
 };
@@ -125,7 +149,7 @@ int main(int argc, char ** argv) {
     std::string output;
     input_kind default_k = input_kind::Lean; // default
     while (true) {
-        int c = getopt_long(argc, argv, "qtnlupgvhc:012s:012o:", g_long_options, NULL);
+        int c = getopt_long(argc, argv, "qtnlupgvhMPc:012s:012o:m:T:L:", g_long_options, NULL);
         if (c == -1)
             break; // end of command line
         switch (c) {
@@ -170,6 +194,24 @@ int main(int argc, char ** argv) {
         case 'q':
             // quiet = true;
             break;
+        case 'M':
+            lean::set_display_alloc_profile_at_exit(true);
+            break;
+        case 'L':
+            lean::set_lua_bytecode_cache_dir(optarg);
+            break;
+        case 'P':
+            lean::set_display_perf_summary_at_exit(true);
+            break;
+        case 'T':
+            lean::set_perf_trace_file(optarg);
+            break;
+        case 'm': {
+            size_t max_memory = static_cast<size_t>(atoi(optarg)) * 1024 * 1024;
+            lean::set_hard_memory_limit(max_memory);
+            lean::set_soft_memory_limit(max_memory / 4 * 3);
+            break;
+        }
         default:
             std::cerr << "Unknown command line option\n";
             display_help(std::cerr);
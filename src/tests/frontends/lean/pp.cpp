@@ -4,7 +4,9 @@ Released under Apache 2.0 license as described in the file LICENSE.
 
 Author: Leonardo de Moura
 */
+#include <string>
 #include "util/test.h"
+#include "util/buffer.h"
 #include "kernel/abstract.h"
 #include "kernel/kernel.h"
 #include "library/printer.h"
@@ -104,6 +106,40 @@ static void tst6() {
     lean_assert(out->str() == "f (f (f (f (f (...)))))");
 }
 
+static void tst7() {
+    environment env; io_state ios = init_frontend(env);
+    std::shared_ptr<string_output_channel> out(std::make_shared<string_output_channel>());
+    ios.set_regular_channel(out);
+    ios.set_option(name{"pp", "colors"}, false);
+    ios.set_option(name{"pp", "unicode"}, false);
+    // pp.max_steps: the arguments that are not displayed are replaced with a single ellipsis
+    buffer<expr> args;
+    args.push_back(Const("g"));
+    for (unsigned i = 0; i < 100; i++)
+        args.push_back(Const(name(("x" + std::to_string(i)).c_str())));
+    expr t = mk_app(args);
+    ios.set_option(name{"lean", "pp", "max_steps"}, 10);
+    regular(ios) << t;
+    std::string r = out->str();
+    lean_assert(r.find("x0") != std::string::npos);
+    lean_assert(r.find("...") != std::string::npos);
+    lean_assert(r.find("...") == r.rfind("..."));
+    lean_assert(r.find("x99") == std::string::npos);
+    // pp.max_depth: the subterms below the given depth are replaced with an ellipsis
+    std::shared_ptr<string_output_channel> out2(std::make_shared<string_output_channel>());
+    ios.set_regular_channel(out2);
+    ios.set_option(name{"lean", "pp", "max_depth"}, 2);
+    regular(ios) << mk_deep(10);
+    lean_assert(out2->str() == "f (f (...))");
+    // huge shared terms are displayed, and the cost only depends on the displayed region
+    std::shared_ptr<string_output_channel> out3(std::make_shared<string_output_channel>());
+    ios.set_regular_channel(out3);
+    ios.set_option(name{"lean", "pp", "max_depth"}, 4);
+    regular(ios) << Const("h")(mk_shared_expr(1000), mk_deep(10));
+    lean_assert(out3->str().find("...") != std::string::npos);
+    lean_assert(out3->str().size() < 1000);
+}
+
 int main() {
     save_stack_info();
     register_modules();
@@ -113,5 +149,6 @@ int main() {
     tst4();
     tst5();
     tst6();
+    tst7();
     return has_violations() ? 1 : 0;
 }
@@ -5,6 +5,7 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Author: Leonardo de Moura
 */
 #include <sstream>
+#include <string>
 #include "util/test.h"
 #include "util/exception.h"
 #include "util/escaped.h"
@@ -69,7 +70,7 @@ static void check_name(char const * str, name const & expected) {
 }
 
 static void tst1() {
-    scan("fun(x: forall A : Type, A -> A), x+1 = 2.0 λ");
+    scan("fun(x: forall A : Type, A -> A), x+1 = 2.0 \u03BB");
 }
 
 static void tst2() {
@@ -117,10 +118,100 @@ static void tst3() {
     lean_assert_eq(out.str(), "EOF");
 }
 
+/** \brief Stream buffer that cannot be repositioned (e.g., a pipe or a terminal). */
+class non_seekable_buf : public std::stringbuf {
+public:
+    non_seekable_buf(char const * str):std::stringbuf(str, std::ios_base::in) {}
+protected:
+    virtual pos_type seekoff(off_type, std::ios_base::seekdir, std::ios_base::openmode) { return pos_type(off_type(-1)); }
+    virtual pos_type seekpos(pos_type, std::ios_base::openmode) { return pos_type(off_type(-1)); }
+};
+
+/** \brief Return the tokens (and their values and positions) produced for \c in, or the error message. */
+static std::string tokens(std::istream & in, list<name> const & cmds) {
+    std::ostringstream out;
+    try {
+        scanner s(in, "[string]");
+        for (name const & n : cmds) s.add_command_keyword(n);
+        while (true) {
+            st t = s.scan();
+            out << t << "@" << s.get_line() << ":" << s.get_pos();
+            if (t == st::Eof)
+                break;
+            if (t == st::Id || t == st::CommandId)
+                out << "[" << s.get_name_val() << "]";
+            else if (t == st::IntVal || t == st::DecimalVal)
+                out << "[" << s.get_num_val() << "]";
+            else if (t == st::StringVal)
+                out << "[\"" << escaped(s.get_str_val().c_str()) << "\"]";
+            out << " ";
+        }
+    } catch (exception & ex) {
+        out << "error: " << ex.what();
+    }
+    return out.str();
+}
+
+/**
+   \brief Check whether the scanner produces the same tokens when the input is read in memory
+   (seekable stream), and when it is read from the stream (non-seekable stream).
+*/
+static void check_non_seekable(char const * str, list<name> const & cmds = list<name>()) {
+    std::istringstream in1(str);
+    non_seekable_buf buf(str);
+    std::istream in2(&buf);
+    lean_assert(in2.tellg() == std::streampos(-1));
+    std::string r1 = tokens(in1, cmds);
+    std::string r2 = tokens(in2, cmds);
+    lean_assert_eq(r1, r2);
+}
+
+static void tst4() {
+    check_non_seekable("fun(x: forall A : Type, A -> A), x+1 = 2.0 \u03BB");
+    check_non_seekable("x::name");
+    check_non_seekable("x::10::foo");
+    check_non_seekable("fun (x : Bool), x");
+    check_non_seekable("+++ x+y -- testing");
+    check_non_seekable("-- testing");
+    check_non_seekable(" 2.31  \n 333 22");
+    check_non_seekable("Int -+-> Int := 10\n(x+1):Int {x}");
+    check_non_seekable("\u03BB \u2200 \u2192");
+    check_non_seekable("++\u2295++x\u2296\u2296");
+    check_non_seekable("x10 ... == (* print('hello') *) have by");
+    check_non_seekable("x::10::bla::0 0::1");
+    check_non_seekable("x::1000000000000000000");
+    check_non_seekable("Theorem a : Bool Axiom b : Int", list<name>({"Theorem", "Axiom"}));
+    check_non_seekable("foo \"tst\\\"\" : Int");
+    check_non_seekable("\"foo");
+    check_non_seekable("2.13 1.2 0.5 10.0.");
+    check_non_seekable("\"\\");
+    check_non_seekable("\"\naaa\"");
+    check_non_seekable("foo::0a::1");
+    check_non_seekable("{ } . forall exists let in \u2200 \u2203 := _");
+    check_non_seekable("");
+    check_non_seekable("x");
+}
+
+static void tst5() {
+    // only the remaining contents of a seekable stream are scanned
+    std::istringstream in("skip x + 1");
+    std::string w;
+    in >> w;
+    lean_assert(w == "skip");
+    scanner s(in, "[string]");
+    lean_assert(s.scan() == st::Id);
+    lean_assert(s.get_name_val() == name("x"));
+    lean_assert(s.scan() == st::Id);
+    lean_assert(s.scan() == st::IntVal);
+    lean_assert(s.scan() == st::Eof);
+}
+
 int main() {
     save_stack_info();
     tst1();
     tst2();
     tst3();
+    tst4();
+    tst5();
     return has_violations() ? 1 : 0;
 }
@@ -0,0 +1,297 @@
+/*
+Copyright (c) 2014 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#include <vector>
+#include <random>
+#include <utility>
+#include <memory>
+#include <stdexcept>
+#include "util/test.h"
+#include "kernel/expr.h"
+#include "kernel/expr_maps.h"
+#include "library/congruence_closure.h"
+using namespace lean;
+
+static expr g_symm  = Const("symm");
+static expr g_trans = Const("trans");
+static expr g_congr = Const("congr");
+static expr g_refl  = Const("refl");
+
+/**
+   \brief Proof builder that uses the (uninterpreted) constants symm, trans, congr and refl.
+   The method \c check computes the equality proved by a proof term, and is used to
+   check the proofs produced by the congruence closure object.
+*/
+class test_proof_builder : public congruence_closure::proof_builder {
+    expr_struct_map<std::pair<expr, expr>> m_hyps;
+public:
+    void add_hyp(expr const & H, expr const & a, expr const & b) { m_hyps.insert(mk_pair(H, mk_pair(a, b))); }
+
+    std::pair<expr, expr> check(expr const & H) const {
+        if (is_constant(H)) {
+            auto it = m_hyps.find(H);
+            lean_assert(it != m_hyps.end());
+            return it->second;
+        }
+        lean_assert(is_app(H));
+        if (app_fn(H) == g_refl)
+            return mk_pair(app_arg(H), app_arg(H));
+        if (app_fn(H) == g_symm) {
+            auto p = check(app_arg(H));
+            return mk_pair(p.second, p.first);
+        }
+        lean_assert(is_app(app_fn(H)));
+        expr const & fn = app_fn(app_fn(H));
+        auto p1 = check(app_arg(app_fn(H)));
+        auto p2 = check(app_arg(H));
+        if (fn == g_trans) {
+            lean_assert(p1.second == p2.first);
+            return mk_pair(p1.first, p2.second);
+        }
+        lean_assert(fn == g_congr);
+        return mk_pair(mk_app(p1.first, p2.first), mk_app(p1.second, p2.second));
+    }
+
+    bool proves(expr const & H, expr const & a, expr const & b) const {
+        auto p = check(H);
+        return p.first == a && p.second == b;
+    }
+
+    virtual expr mk_symm(expr const & a, expr const & b, expr const & H) {
+        lean_assert(proves(H, a, b));
+        return mk_app(g_symm, H);
+    }
+    virtual expr mk_trans(expr const & a, expr const & b, expr const & c, expr const & H1, expr const & H2) {
+        lean_assert(proves(H1, a, b));
+        lean_assert(proves(H2, b, c));
+        return mk_app(g_trans, H1, H2);
+    }
+    virtual expr mk_congr(expr const & f, expr const & g, expr const & a, expr const & b,
+                          optional<expr> const & H1, optional<expr> const & H2) {
+        lean_assert(H1 || H2);
+        lean_assert(!H1 || proves(*H1, f, g));
+        lean_assert(!H2 || proves(*H2, a, b));
+        return mk_app(g_congr, H1 ? *H1 : mk_app(g_refl, f), H2 ? *H2 : mk_app(g_refl, a));
+    }
+};
+
+static bool check_proof(congruence_closure & cc, test_proof_builder const & pb, expr const & a, expr const & b) {
+    if (!cc.is_eqv(a, b))
+        return false;
+    if (auto H = cc.get_eqv_proof(a, b))
+        return pb.proves(*H, a, b);
+    else
+        return a == b;
+}
+
+static void tst1() {
+    expr f = Const("f");
+    expr g = Const("g");
+    expr a = Const("a");
+    expr b = Const("b");
+    expr c = Const("c");
+    congruence_closure cc;
+    lean_assert(cc.is_eqv(f(a), f(a)));
+    lean_assert(!cc.is_eqv(a, b));
+    cc.add_term(f(a, c));
+    cc.add_term(f(b, c));
+    cc.add_term(g(f(a, a)));
+    cc.add_term(g(f(b, b)));
+    lean_assert(cc.has_term(f(a)));
+    lean_assert(!cc.has_term(f(c)));
+    lean_assert(!cc.is_eqv(f(a, c), f(b, c)));
+    cc.add_eq(a, b, none_expr());
+    lean_assert(cc.is_eqv(a, b));
+    lean_assert(cc.is_eqv(b, a));
+    lean_assert(cc.is_eqv(f(a), f(b)));
+    lean_assert(cc.is_eqv(f(a, c), f(b, c)));
+    lean_assert(cc.is_eqv(g(f(a, a)), g(f(b, b))));
+    lean_assert(cc.get_root(f(a, c)) == cc.get_root(f(b, c)));
+    lean_assert(!cc.is_eqv(f(a, c), g(f(a, a))));
+    lean_assert(!cc.is_eqv(f(c), f(a)));
+    // the function is also taken into account
+    cc.add_term(g(a, c));
+    lean_assert(!cc.is_eqv(g(a, c), f(b, c)));
+    cc.add_eq(f, g, none_expr());
+    lean_assert(cc.is_eqv(g(a, c), f(b, c)));
+    lean_assert(!cc.is_eqv(g(f(a, a)), f(g(b, b)))); // f(g(b, b)) was not registered
+    cc.add_term(f(g(b, b)));
+    lean_assert(cc.is_eqv(g(f(a, a)), f(g(b, b))));
+    lean_assert(cc.get_root(c) == c);
+}
+
+static void tst2() {
+    expr f  = Const("f");
+    expr g  = Const("g");
+    expr a  = Const("a");
+    expr b  = Const("b");
+    expr c  = Const("c");
+    expr d  = Const("d");
+    expr H1 = Const("H1");
+    expr H2 = Const("H2");
+    expr H3 = Const("H3");
+    expr H4 = Const("H4");
+    auto pb = std::make_shared<test_proof_builder>();
+    pb->add_hyp(H1, a, b);
+    pb->add_hyp(H2, c, b);
+    pb->add_hyp(H3, f, g);
+    pb->add_hyp(H4, g(c), d);
+    congruence_closure cc([](expr const &) { return true; }, pb);
+    cc.add_term(f(f(a), d));
+    cc.add_term(g(g(c), f(b)));
+    cc.add_eq(a, b, some_expr(H1));
+    cc.add_eq(c, b, some_expr(H2));
+    lean_assert(!cc.get_eqv_proof(a, a));
+    lean_assert(check_proof(cc, *pb, a, c));
+    lean_assert(check_proof(cc, *pb, c, a));
+    lean_assert(!cc.is_eqv(f(a), g(c)));
+    cc.add_eq(f, g, some_expr(H3));
+    lean_assert(check_proof(cc, *pb, f(a), g(c)));
+    lean_assert(check_proof(cc, *pb, g(c), f(b)));
+    lean_assert(!cc.is_eqv(f(f(a), d), g(g(c), f(b))));
+    cc.add_eq(g(c), d, some_expr(H4));
+    lean_assert(check_proof(cc, *pb, f(a), d));
+    lean_assert(check_proof(cc, *pb, f(f(a), d), g(g(c), f(b))));
+    lean_assert(check_proof(cc, *pb, g(g(c), f(b)), f(f(a), d)));
+    lean_assert(check_proof(cc, *pb, f(f(a)), g(g(c))));
+}
+
+static void tst3() {
+    expr f  = Const("f");
+    expr a  = Const("a");
+    expr b  = Const("b");
+    expr c  = Const("c");
+    expr H1 = Const("H1");
+    expr H2 = Const("H2");
+    expr H3 = Const("H3");
+    auto pb = std::make_shared<test_proof_builder>();
+    pb->add_hyp(H1, a, b);
+    pb->add_hyp(H2, b, c);
+    pb->add_hyp(H3, f(a), c);
+    congruence_closure cc([](expr const & e) {
+            if (app_fn(e) == Const("bad"))
+                throw std::runtime_error("not a congruence application");
+            return true;
+        }, pb);
+    cc.add_eq(a, b, some_expr(H1));
+    cc.add_term(f(a));
+    cc.add_term(f(b));
+    unsigned num_terms = cc.get_num_terms();
+    cc.push();
+    cc.add_eq(b, c, some_expr(H2));
+    cc.add_term(f(c));
+    lean_assert(check_proof(cc, *pb, f(a), f(c)));
+    {
+        congruence_closure::mk_scope scope(cc);
+        lean_assert(cc.num_scopes() == 2);
+        cc.add_eq(f(a), c, some_expr(H3));
+        cc.add_term(f(f(c)));
+        lean_assert(check_proof(cc, *pb, f(f(c)), f(a)));
+        lean_assert(check_proof(cc, *pb, f(b), b));
+    }
+    lean_assert(cc.num_scopes() == 1);
+    lean_assert(!cc.has_term(f(f(c))));
+    lean_assert(!cc.is_eqv(f(a), c));
+    lean_assert(check_proof(cc, *pb, f(a), f(c)));
+    cc.pop();
+    lean_assert(cc.get_num_terms() == num_terms);
+    lean_assert(!cc.has_term(c));
+    lean_assert(!cc.has_term(f(c)));
+    lean_assert(!cc.is_eqv(a, c));
+    lean_assert(check_proof(cc, *pb, f(b), f(a)));
+    // pop restores the state after an exception
+    cc.push();
+    try {
+        cc.add_term(f(c, Const("bad")(a)));
+        lean_unreachable();
+    } catch (std::runtime_error &) {
+        cc.pop();
+    }
+    lean_assert(cc.get_num_terms() == num_terms);
+    lean_assert(!cc.has_term(f(c)));
+    cc.add_eq(b, c, some_expr(H2));
+    cc.add_term(f(c));
+    lean_assert(check_proof(cc, *pb, f(c), f(a)));
+}
+
+static expr mk_random_term(std::mt19937 & rng, unsigned depth) {
+    static expr fs[] = { Const("f"), Const("g") };
+    static expr cs[] = { Const("a"), Const("b"), Const("c"), Const("d") };
+    if (depth == 0 || rng() % 3 == 0)
+        return cs[rng() % 4];
+    expr r = fs[rng() % 2];
+    unsigned n = 1 + rng() % 2;
+    for (unsigned i = 0; i < n; i++)
+        r = mk_app(r, mk_random_term(rng, depth - 1));
+    return r;
+}
+
+static void tst4() {
+    // after pop, the object behaves as a new object containing the terms and equalities of the restored scope
+    std::mt19937 rng;
+    rng.seed(7);
+    auto pb = std::make_shared<test_proof_builder>();
+    auto is_app_fn = [](expr const &) { return true; };
+    congruence_closure cc(is_app_fn, pb);
+    std::vector<std::pair<expr, expr>> terms;   // terms and equalities added so far, equalities are pairs (lhs, rhs)
+    std::vector<optional<expr>>        hyps;    // proofs of the equalities
+    std::vector<unsigned>              scopes;
+    unsigned next_idx = 0;
+    for (unsigned step = 0; step < 300; step++) {
+        unsigned k = rng() % 10;
+        if (k < 2) {
+            cc.push();
+            scopes.push_back(terms.size());
+        } else if (k < 4 && !scopes.empty()) {
+            cc.pop();
+            terms.resize(scopes.back());
+            hyps.resize(scopes.back());
+            scopes.pop_back();
+            congruence_closure cc2(is_app_fn, pb);
+            for (unsigned i = 0; i < terms.size(); i++) {
+                if (hyps[i])
+                    cc2.add_eq(terms[i].first, terms[i].second, hyps[i]);
+                else
+                    cc2.add_term(terms[i].first);
+            }
+            lean_assert(cc.get_num_terms() == cc2.get_num_terms());
+            for (auto const & p1 : terms) {
+                for (auto const & p2 : terms) {
+                    lean_assert(cc.is_eqv(p1.first, p2.first) == cc2.is_eqv(p1.first, p2.first));
+                    lean_assert(cc.is_eqv(p1.first, p2.second) == cc2.is_eqv(p1.first, p2.second));
+                }
+            }
+        } else if (k < 6) {
+            expr t = mk_random_term(rng, 3);
+            cc.add_term(t);
+            terms.emplace_back(t, t);
+            hyps.push_back(none_expr());
+        } else {
+            expr lhs = mk_random_term(rng, 2);
+            expr rhs = mk_random_term(rng, 2);
+            expr H   = Const(name("H", next_idx++));
+            pb->add_hyp(H, lhs, rhs);
+            cc.add_eq(lhs, rhs, some_expr(H));
+            terms.emplace_back(lhs, rhs);
+            hyps.push_back(some_expr(H));
+        }
+        for (unsigned i = 0; i < 5 && !terms.empty(); i++) {
+            auto const & p1 = terms[rng() % terms.size()];
+            auto const & p2 = terms[rng() % terms.size()];
+            if (cc.is_eqv(p1.first, p2.second))
+                lean_assert(check_proof(cc, *pb, p1.first, p2.second));
+        }
+    }
+}
+
+int main() {
+    save_stack_info();
+    tst1();
+    tst2();
+    tst3();
+    tst4();
+    return has_violations() ? 1 : 0;
+}
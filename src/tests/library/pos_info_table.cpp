@@ -0,0 +1,131 @@
+/*
+Copyright (c) 2014 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#include <vector>
+#include <utility>
+#include <random>
+#include "util/test.h"
+#include "kernel/expr.h"
+#include "library/pos_info_table.h"
+using namespace lean;
+
+typedef std::pair<unsigned, unsigned> pos_info;
+
+static void tst1() {
+    pos_info_table t;
+    expr a = mk_constant("a");
+    expr b = mk_constant("b");
+    lean_assert(!t.contains(a));
+    a = t.save(a, pos_info(1, 10));
+    expr f = t.save(mk_app({mk_constant("f"), a, b}), pos_info(1, 5));
+    lean_assert(t.contains(a));
+    lean_assert(!t.contains(b));
+    lean_assert(t.find(a) && *t.find(a) == pos_info(1, 10));
+    lean_assert(t.find(f) && *t.find(f) == pos_info(1, 5));
+    lean_assert(is_pos_info_tag(a.get_tag()));
+    // the tag is stored in the expression
+    expr a2 = a;
+    lean_assert(*t.find(a2) == pos_info(1, 10));
+    // structurally equal expressions are different entries
+    lean_assert(!t.find(mk_constant("a")));
+    // shared expressions are not modified, the position is associated with a copy
+    expr a3 = t.save(a, pos_info(3, 2));
+    lean_assert(!is_eqp(a, a3));
+    lean_assert(a == a3);
+    lean_assert(*t.find(a) == pos_info(1, 10));
+    lean_assert(*t.find(a3) == pos_info(3, 2));
+    // unshared expressions are updated
+    expr g  = mk_constant("g");
+    expr g2 = t.save(g, pos_info(4, 1));
+    lean_assert(is_eqp(g, g2));
+    lean_assert(*t.find(g) == pos_info(4, 1));
+    lean_assert(t.size() == 4);
+}
+
+static void tst2() {
+    // positions of different tables do not interfere with each other
+    pos_info_table t1;
+    pos_info_table t2;
+    expr a = t1.save(mk_constant("a"), pos_info(1, 1));
+    expr b = t2.save(mk_constant("b"), pos_info(2, 2));
+    lean_assert(t1.contains(a) && !t1.contains(b));
+    lean_assert(t2.contains(b) && !t2.contains(a));
+    expr fa = mk_app(mk_constant("f"), a); // a is now shared
+    expr a2 = t2.save(a, pos_info(3, 3));
+    lean_assert(is_eqp(app_arg(fa), a));
+    lean_assert(t1.contains(a) && !t1.contains(a2));
+    lean_assert(!t2.contains(a));
+    lean_assert(*t2.find(a2) == pos_info(3, 3));
+    // tags set by other clients are ignored
+    expr c = mk_constant("c");
+    c.set_tag(0);
+    lean_assert(!t1.contains(c) && !t2.contains(c));
+    lean_assert(!is_pos_info_tag(0));
+    lean_assert(!is_pos_info_tag(nulltag));
+}
+
+static void tst3() {
+    // many entries, the positions are not monotonic
+    pos_info_table t;
+    std::vector<expr>     es;
+    std::vector<pos_info> ps;
+    std::mt19937          rng;
+    rng.seed(17);
+    unsigned line = 1, col = 0;
+    for (unsigned i = 0; i < 10000; i++) {
+        if (rng() % 10 == 0) {
+            line += rng() % 3;
+            col   = rng() % 80;
+        } else {
+            col   = rng() % 4 == 0 && col > 5 ? col - rng() % 5 : col + rng() % 10;
+        }
+        if (rng() % 50 == 0)
+            line = rng() % 100000;
+        expr e = t.save(mk_var(i), pos_info(line, col));
+        es.push_back(e);
+        ps.push_back(pos_info(line, col));
+    }
+    lean_assert(t.size() == 10000);
+    for (unsigned i = 0; i < es.size(); i++) {
+        lean_assert(t.find(es[i]));
+        lean_assert(*t.find(es[i]) == ps[i]);
+    }
+    // the positions are delta encoded
+    lean_assert(t.data_size() < 3 * t.size());
+}
+
+static void tst4() {
+    // propagate does not modify the subexpressions that are shared or in the table
+    pos_info_table t;
+    expr a   = t.save(mk_constant("a"), pos_info(1, 2));
+    expr b   = mk_constant("b");
+    expr f   = mk_constant("f");
+    expr fab = mk_app(f, a, b);
+    expr e   = mk_app(fab, fab);
+    expr r   = t.propagate(e, pos_info(5, 5));
+    lean_assert(r == e);
+    lean_assert(!t.contains(e) && !t.contains(fab) && !t.contains(b));
+    lean_assert(*t.find(r) == pos_info(5, 5));
+    lean_assert(*t.find(app_fn(r)) == pos_info(5, 5));
+    lean_assert(*t.find(app_arg(app_fn(r))) == pos_info(5, 5));
+    lean_assert(!is_eqp(app_arg(app_fn(r)), b));
+    // shared subexpressions are copied only once
+    lean_assert(is_eqp(app_fn(r), app_arg(r)));
+    // positions in the table are preserved
+    lean_assert(is_eqp(app_arg(app_fn(app_fn(r))), a));
+    lean_assert(*t.find(app_arg(app_fn(app_fn(r)))) == pos_info(1, 2));
+    // expressions in the table are returned as is
+    lean_assert(is_eqp(t.propagate(r, pos_info(6, 6)), r));
+}
+
+int main() {
+    save_stack_info();
+    tst1();
+    tst2();
+    tst3();
+    tst4();
+    return has_violations() ? 1 : 0;
+}
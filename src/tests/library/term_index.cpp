@@ -0,0 +1,160 @@
+/*
+Copyright (c) 2014 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#include <vector>
+#include <random>
+#include <algorithm>
+#include "util/test.h"
+#include "kernel/expr.h"
+#include "library/term_index.h"
+using namespace lean;
+
+static std::vector<unsigned> find_generalizations(term_index<unsigned> const & idx, expr const & e) {
+    std::vector<unsigned> r;
+    idx.find_generalizations(e, [&](expr const &, unsigned v) { r.push_back(v); });
+    std::sort(r.begin(), r.end());
+    return r;
+}
+
+static std::vector<unsigned> find_instances(term_index<unsigned> const & idx, expr const & e) {
+    std::vector<unsigned> r;
+    idx.find_instances(e, [&](expr const &, unsigned v) { r.push_back(v); });
+    std::sort(r.begin(), r.end());
+    return r;
+}
+
+static std::vector<unsigned> find_unifiables(term_index<unsigned> const & idx, expr const & e) {
+    std::vector<unsigned> r;
+    idx.find_unifiables(e, [&](expr const &, unsigned v) { r.push_back(v); });
+    std::sort(r.begin(), r.end());
+    return r;
+}
+
+static void tst1() {
+    expr f = Const("f");
+    expr g = Const("g");
+    expr a = Const("a");
+    expr b = Const("b");
+    expr x = Var(0);
+    expr y = Var(1);
+    term_index<unsigned> idx;
+    idx.insert(f(x, a), 0);
+    idx.insert(f(x, y), 1);
+    idx.insert(g(x), 2);
+    idx.insert(x, 3);
+    idx.insert(f(g(a), b), 4);
+    idx.insert(f(a), 5);
+    lean_assert(idx.size() == 6);
+    lean_assert(find_generalizations(idx, f(b, a)) == std::vector<unsigned>({0, 1, 3}));
+    lean_assert(find_generalizations(idx, f(g(a), b)) == std::vector<unsigned>({1, 3, 4}));
+    lean_assert(find_generalizations(idx, g(b)) == std::vector<unsigned>({2, 3}));
+    lean_assert(find_generalizations(idx, f(a)) == std::vector<unsigned>({3, 5}));
+    lean_assert(find_instances(idx, f(x, y)) == std::vector<unsigned>({0, 1, 4}));
+    lean_assert(find_instances(idx, f(x, a)) == std::vector<unsigned>({0}));
+    lean_assert(find_unifiables(idx, f(g(x), y)) == std::vector<unsigned>({0, 1, 3, 4}));
+    // the higher-order pattern (y x) behaves like a variable
+    lean_assert(find_generalizations(idx, y(x)) == std::vector<unsigned>({3}));
+    lean_assert(find_unifiables(idx, y(x)).size() == 6);
+    // copies are not affected by updates
+    term_index<unsigned> idx2(idx);
+    idx2.erase(f(x, y), 1);
+    idx2.insert(g(a), 6);
+    lean_assert(idx2.size() == 6);
+    lean_assert(find_generalizations(idx2, f(b, a)) == std::vector<unsigned>({0, 3}));
+    lean_assert(find_generalizations(idx, f(b, a)) == std::vector<unsigned>({0, 1, 3}));
+    lean_assert(find_generalizations(idx, g(a)) == std::vector<unsigned>({2, 3}));
+    lean_assert(find_generalizations(idx2, g(a)) == std::vector<unsigned>({2, 3, 6}));
+    // erasing entries that are not in the index does not change it
+    term_index<unsigned> idx3(idx);
+    idx3.erase(f(x, y), 0);
+    idx3.erase(f(b, b), 0);
+    idx3.erase(g(g(a)), 2);
+    lean_assert(idx3.size() == 6);
+    lean_assert(find_generalizations(idx3, f(b, a)) == std::vector<unsigned>({0, 1, 3}));
+    // the index becomes empty after erasing all entries, and it can be reused
+    idx3.erase(f(x, a), 0);
+    idx3.erase(f(x, y), 1);
+    idx3.erase(g(x), 2);
+    idx3.erase(x, 3);
+    idx3.erase(f(g(a), b), 4);
+    idx3.erase(f(a), 5);
+    lean_assert(idx3.empty());
+    lean_assert(find_unifiables(idx3, y(x)).empty());
+    lean_assert(find_generalizations(idx, f(b, a)) == std::vector<unsigned>({0, 1, 3}));
+    idx3.insert(g(x), 7);
+    lean_assert(find_generalizations(idx3, g(b)) == std::vector<unsigned>({7}));
+    lean_assert(find_unifiables(idx3, y(x)) == std::vector<unsigned>({7}));
+}
+
+/** \brief First-order matching, \c Var(i) in \c p is a pattern variable. */
+static bool match(expr const & p, expr const & t, std::vector<optional<expr>> & s) {
+    if (is_var(p)) {
+        unsigned i = var_idx(p);
+        if (s[i])
+            return *s[i] == t;
+        s[i] = t;
+        return true;
+    }
+    if (is_app(p))
+        return is_app(t) && match(app_fn(p), app_fn(t), s) && match(app_arg(p), app_arg(t), s);
+    return p == t;
+}
+
+static expr mk_random_term(std::mt19937 & rng, unsigned depth, bool vars) {
+    static expr fs[] = { Const("f"), Const("g"), Const("h") };
+    static expr cs[] = { Const("a"), Const("b"), Const("c") };
+    if (vars && rng() % 5 == 0)
+        return Var(rng() % 2);
+    if (depth == 0 || rng() % 3 == 0)
+        return cs[rng() % 3];
+    expr r = fs[rng() % 3];
+    unsigned n = 1 + rng() % 3;
+    for (unsigned i = 0; i < n; i++)
+        r = mk_app(r, mk_random_term(rng, depth - 1, vars));
+    return r;
+}
+
+static void tst2() {
+    // the retrieved patterns are a superset of the patterns that match the term
+    std::mt19937 rng;
+    rng.seed(11);
+    term_index<unsigned> idx;
+    std::vector<expr> patterns;
+    for (unsigned i = 0; i < 1000; i++) {
+        expr p = mk_random_term(rng, 3, true);
+        if (is_var(p))
+            continue; // it is retrieved for every term
+        idx.insert(p, patterns.size());
+        patterns.push_back(p);
+    }
+    unsigned num_retrieved = 0;
+    for (unsigned i = 0; i < 200; i++) {
+        expr t = mk_random_term(rng, 4, false);
+        std::vector<unsigned> r = find_generalizations(idx, t);
+        num_retrieved += r.size();
+        for (unsigned j = 0; j < patterns.size(); j++) {
+            std::vector<optional<expr>> s(2);
+            if (match(patterns[j], t, s)) {
+                lean_assert(std::binary_search(r.begin(), r.end(), j));
+            }
+        }
+        std::vector<unsigned> r2 = find_instances(idx, t);
+        for (unsigned j = 0; j < patterns.size(); j++) {
+            if (patterns[j] == t) {
+                lean_assert(std::binary_search(r2.begin(), r2.end(), j));
+            }
+        }
+    }
+    // the index filters most of the patterns
+    lean_assert(num_retrieved < 200 * patterns.size() / 10);
+}
+
+int main() {
+    save_stack_info();
+    tst1();
+    tst2();
+    return has_violations() ? 1 : 0;
+}
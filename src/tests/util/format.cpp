@@ -120,6 +120,51 @@ static void tst5() {
     std::cout << "{" << format() << "}" << "\n";
 }
 
+static std::string pp_str(format const & f, unsigned w) {
+    std::ostringstream out;
+    pretty(out, w, false, f);
+    return out.str();
+}
+
+static void tst6() {
+    format f("x");
+    for (int i = 0; i < 4; i++)
+        f = paren(format("f") + line() + f + line() + format(i));
+    lean_assert_eq(pp_str(f, 10), "(f\n (f\n  (f\n   (f x 0)\n   1)\n  2)\n 3)");
+    lean_assert_eq(pp_str(f, 20), "(f\n (f (f (f x 0) 1) 2)\n 3)");
+    lean_assert_eq(pp_str(f, 30), "(f (f (f (f x 0) 1) 2) 3)");
+    // the text after a group (up to the next line break) must also fit
+    format g = group(format("a") + nest(2, line() + format("bbbb"))) + group(format("cccc") + nest(2, line() + format("d")));
+    lean_assert_eq(pp_str(g, 9),  "a\n  bbbbcccc\n  d");
+    lean_assert_eq(pp_str(g, 10), "a bbbbcccc\n  d");
+    // deeply nested groups
+    format h("x");
+    for (int i = 0; i < 2000; i++)
+        h = paren(format("f") + line() + h + line() + format(i));
+    std::string r = pp_str(h, 80);
+    lean_assert(r.size() > 2000);
+    lean_assert_eq(r.substr(0, 6), "(f\n (f");
+}
+
+static void tst7() {
+    // legacy S-expression encoding
+    sexpr txt(static_cast<int>(format::TEXT), sexpr("foo"));
+    sexpr ln{sexpr(static_cast<int>(format::LINE))};
+    sexpr nst(static_cast<int>(format::NEST), sexpr(2, sexpr{sexpr(static_cast<int>(format::COMPOSE)), txt, ln, txt}));
+    format f(nst);
+    lean_assert_eq(pp_str(f, 80), "foo\n  foo");
+    lean_assert(is_name(format(name({"foo", "bar"}))));
+    lean_assert(!is_name(format("foo")));
+    lean_assert(format(sexpr(static_cast<int>(format::TEXT), sexpr(name("bla")))).kind() == format::TEXT);
+    lean_assert(is_name(format(sexpr(static_cast<int>(format::TEXT), sexpr(name("bla"))))));
+    lean_assert(format("foo").hash() == format("foo").hash());
+    // deep format objects are deleted without using the system stack
+    format r;
+    for (unsigned i = 0; i < 1000000; i++)
+        r += format("a");
+    lean_assert(r.kind() == format::COMPOSE);
+}
+
 int main() {
     save_stack_info();
     tst1();
@@ -127,5 +172,7 @@ int main() {
     tst3();
     tst4();
     tst5();
+    tst6();
+    tst7();
     return has_violations() ? 1 : 0;
 }
@@ -4,6 +4,7 @@ Released under Apache 2.0 license as described in the file LICENSE.
 
 Author: Soonho Kong
 */
+#include <cfenv>
 #include "util/test.h"
 #include "util/trace.h"
 #include "util/numerics/double.h"
@@ -1030,8 +1031,37 @@ static void double_interval_trans() {
     check_uop(double, atanh, oi15);
 }
 
+static void double_interval_rounding() {
+    // 0.1, 0.2 and 0.3 are not representable, so the bounds must be different
+    di i1(0.1, 0.1);
+    di i2(0.2, 0.2);
+    di r1 = i1 + i2;
+    lean_assert(r1.lower() < r1.upper());
+    lean_assert(r1.lower() <= 0.1 + 0.2 && 0.1 + 0.2 <= r1.upper());
+    di r2 = i1 * i2;
+    lean_assert(r2.lower() < r2.upper());
+    di r3 = di(1.0, 1.0) - di(1e-20, 1e-20);
+    lean_assert(r3.lower() < r3.upper());
+    di r4 = i1 / di(3.0, 3.0);
+    lean_assert(r4.lower() < r4.upper());
+    di r5 = power(di(-0.1, 0.3), 3);
+    lean_assert(r5.lower() <= -0.1 * 0.1 * 0.1 && 0.3 * 0.3 * 0.3 <= r5.upper());
+    // the processor rounding mode is restored
+    lean_assert(std::fegetround() == FE_TONEAREST);
+    {
+        scoped_upward_rounding scope;
+        di s1 = i1 + i2;
+        di s2 = i1 * i2;
+        lean_assert(s1 == r1);
+        lean_assert(s2 == r2);
+        lean_assert(std::fegetround() == FE_UPWARD);
+    }
+    lean_assert(std::fegetround() == FE_TONEAREST);
+}
+
 int main() {
     enable_trace("numerics");
+    double_interval_rounding();
     double_interval_arith();
     double_interval_inf1();
     double_interval_inf2();
@@ -0,0 +1,111 @@
+/*
+Copyright (c) 2014 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#include <random>
+#include <iostream>
+#include <algorithm>
+#include "util/test.h"
+#include "util/interval/interval_batch.h"
+using namespace lean;
+
+typedef interval<double> di;
+typedef double_interval_batch dib;
+
+static std::mt19937 g_rng;
+
+static double mk_random_double() {
+    std::uniform_real_distribution<double> dist(-10.0, 10.0);
+    return dist(g_rng);
+}
+
+/** \brief Create a random interval, when \c only_closed is false, it may have open and infinite endpoints. */
+static di mk_random_interval(bool only_closed) {
+    double l = mk_random_double();
+    double u = mk_random_double();
+    if (l > u) std::swap(l, u);
+    if (only_closed)
+        return di(l, u);
+    switch (g_rng() % 6) {
+    case 0:  return di(l, u, true, false);
+    case 1:  return di(l, u, false, true);
+    case 2:  return di(u, true);  // (-oo, u)
+    case 3:  return di(false, l); // [l, +oo)
+    default: return di(l, u);
+    }
+}
+
+/** \brief Create a random interval that does not contain zero. */
+static di mk_random_nonzero_interval(bool only_closed) {
+    while (true) {
+        di r = mk_random_interval(only_closed);
+        if (!r.contains_zero())
+            return r;
+    }
+}
+
+static void check_eq(dib const & r, unsigned i, di const & expected) {
+    di v = r.get(i);
+    if (v != expected)
+        std::cout << "batch: " << v << ", expected: " << expected << "\n";
+    lean_assert(v == expected);
+}
+
+static void tst1(unsigned n, bool only_closed) {
+    dib a, b, c;
+    for (unsigned i = 0; i < n; i++) {
+        a.push_back(mk_random_interval(only_closed));
+        b.push_back(mk_random_interval(only_closed));
+        c.push_back(mk_random_nonzero_interval(only_closed));
+    }
+    dib r;
+    add(r, a, b);
+    for (unsigned i = 0; i < n; i++) check_eq(r, i, a.get(i) + b.get(i));
+    sub(r, a, b);
+    for (unsigned i = 0; i < n; i++) check_eq(r, i, a.get(i) - b.get(i));
+    mul(r, a, b);
+    for (unsigned i = 0; i < n; i++) check_eq(r, i, a.get(i) * b.get(i));
+    div(r, a, c);
+    for (unsigned i = 0; i < n; i++) check_eq(r, i, a.get(i) / c.get(i));
+    for (unsigned k = 1; k <= 6; k++) {
+        power(r, a, k);
+        for (unsigned i = 0; i < n; i++) check_eq(r, i, power(a.get(i), k));
+    }
+    exp(r, a);
+    for (unsigned i = 0; i < n; i++) check_eq(r, i, exp(a.get(i)));
+    dib p;
+    power(p, c, 2);
+    log(r, p);
+    for (unsigned i = 0; i < n; i++) check_eq(r, i, log(power(c.get(i), 2)));
+    // the result may be one of the arguments
+    dib a2 = a;
+    mul(a2, a2, b);
+    for (unsigned i = 0; i < n; i++) check_eq(a2, i, a.get(i) * b.get(i));
+}
+
+static void tst2() {
+    dib a(3);
+    a.set(0, di(1.0, 2.0));
+    a.set(1, di(-3.0, 0.5));
+    lean_assert(a.get(2) == di());
+    lean_assert(a.lower(0) == 1.0 && a.upper(0) == 2.0);
+    lean_assert(a.flags(2) == (dib::LOWER_OPEN | dib::UPPER_OPEN | dib::LOWER_INF | dib::UPPER_INF));
+    dib r;
+    add(r, a, a);
+    lean_assert(r.get(0) == di(2.0, 4.0));
+    lean_assert(r.get(1) == di(-6.0, 1.0));
+    lean_assert(r.get(2) == di());
+    power(r, a, 2);
+    lean_assert(r.get(1) == di(0.0, 9.0));
+}
+
+int main() {
+    tst1(1, true);
+    tst1(7, true);
+    tst1(1000, true);
+    tst1(1000, false);
+    tst2();
+    return has_violations() ? 1 : 0;
+}
@@ -0,0 +1,139 @@
+/*
+Copyright (c) 2014 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#include <vector>
+#include <iostream>
+#include "util/test.h"
+#include "util/numerics/mpq.h"
+#include "util/numerics/double.h"
+#include "util/numerics/float.h"
+#include "util/numerics/mpfp.h"
+#include "util/interval/interval_plan.h"
+using namespace lean;
+
+typedef interval<double> di;
+typedef interval<float>  fi;
+typedef interval<mpq>    qi;
+typedef interval_plan_builder builder;
+
+static void tst1() {
+    builder b;
+    auto x  = b.mk_var(0);
+    auto y  = b.mk_var(1);
+    auto s1 = b.mk_add(x, y);
+    auto s2 = b.mk_add(y, x);
+    lean_assert(s1 == s2);
+    auto e  = b.mk_add(b.mk_mul(s1, s2), b.mk_exp(b.mk_add(x, y)));
+    lean_assert(b.mk_var(0) == x);
+    b.mk_sin(y); // not used by e
+    interval_plan p = b.compile(e);
+    // x, y, x+y, (x+y)*(x+y), exp(x+y), (x+y)*(x+y) + exp(x+y)
+    lean_assert(p.size() == 6);
+    lean_assert(p.num_vars() == 2);
+    lean_assert(p.num_outputs() == 1);
+    std::vector<di> vars({di(1.0, 2.0), di(-1.0, 0.5)});
+    di r = p.eval(vars);
+    di s = vars[0] + vars[1];
+    di expected = s * s + exp(s);
+    std::cout << r << "\n";
+    lean_assert(r == expected);
+    // reuse the registers
+    std::vector<di> regs;
+    for (unsigned i = 0; i < 10; i++) {
+        vars[0] = di(static_cast<double>(i), static_cast<double>(i) + 0.5);
+        p.eval(vars, regs);
+        s = vars[0] + vars[1];
+        lean_assert(regs[p.output(0)] == s * s + exp(s));
+    }
+    std::vector<fi> fvars({fi(1.0f, 2.0f), fi(-1.0f, 0.5f)});
+    fi fs = fvars[0] + fvars[1];
+    lean_assert(p.eval(fvars) == fs * fs + exp(fs));
+}
+
+static void tst2() {
+    builder b;
+    auto x = b.mk_var(0);
+    auto y = b.mk_var(1);
+    auto e1 = b.mk_sub(b.mk_power(x, 3), b.mk_div(y, b.mk_num(3.0)));
+    auto e2 = b.mk_neg(b.mk_inv(b.mk_mul(x, y)));
+    interval_plan p = b.compile(std::vector<builder::node>({e1, e2}));
+    lean_assert(p.num_outputs() == 2);
+    std::vector<qi> vars({qi(mpq(1, 2), mpq(2)), qi(mpq(1), mpq(3))});
+    std::vector<qi> regs;
+    p.eval(vars, regs);
+    lean_assert(regs[p.output(0)] == power(vars[0], 3) - vars[1] / qi(mpq(3)));
+    lean_assert(regs[p.output(1)] == neg(inv(vars[0] * vars[1])));
+    // 1/3 is not a float
+    interval_plan p2 = b.compile(b.mk_num(1.0/3.0));
+    fi c = p2.eval(std::vector<fi>());
+    lean_assert(c.lower() < c.upper());
+    lean_assert(c.contains(static_cast<float>(1.0/3.0)));
+}
+
+static void tst3() {
+    builder b;
+    auto x = b.mk_var(0);
+    auto y = b.mk_var(1);
+    auto z = b.mk_var(2);
+    // x*y + z
+    interval_plan p = b.compile(b.mk_add(b.mk_mul(x, y), z));
+    std::vector<di> vars({di(1.0, 2.0), di(3.0, 4.0), di(0.0, 1.0)});
+    std::vector<di> regs;
+    std::vector<interval_deps> deps;
+    p.eval(vars, regs, deps);
+    lean_assert(regs[p.output(0)] == vars[0] * vars[1] + vars[2]);
+    std::vector<bound_deps> var_deps;
+    // x and y are positive, the lower bound depends only on the lower bounds
+    p.propagate_deps(deps, 0, var_deps, DEP_IN_LOWER1);
+    lean_assert(var_deps.size() == 3);
+    lean_assert(var_deps[0] == DEP_IN_LOWER1);
+    lean_assert(var_deps[1] == DEP_IN_LOWER1);
+    lean_assert(var_deps[2] == DEP_IN_LOWER1);
+    // the upper bound also depends on the lower bound of x (it justifies that x is positive)
+    p.propagate_deps(deps, 0, var_deps, DEP_IN_UPPER1);
+    lean_assert(var_deps[0] == (DEP_IN_LOWER1 | DEP_IN_UPPER1));
+    lean_assert(var_deps[1] == DEP_IN_UPPER1);
+    lean_assert(var_deps[2] == DEP_IN_UPPER1);
+    // x is negative now, then the lower bound depends on the upper bound of y
+    vars[0] = di(-2.0, -1.0);
+    p.eval(vars, regs, deps);
+    p.propagate_deps(deps, 0, var_deps, DEP_IN_LOWER1);
+    lean_assert(dep_in_lower1(var_deps[0]));
+    lean_assert(var_deps[1] == DEP_IN_UPPER1);
+    lean_assert(var_deps[2] == DEP_IN_LOWER1);
+    // -z does not depend on x and y
+    interval_plan p2 = b.compile(b.mk_neg(z));
+    p2.eval(vars, regs, deps);
+    p2.propagate_deps(deps, 0, var_deps);
+    lean_assert(var_deps.size() == 3);
+    lean_assert(var_deps[0] == 0);
+    lean_assert(var_deps[1] == 0);
+    lean_assert(var_deps[2] == (DEP_IN_LOWER1 | DEP_IN_UPPER1));
+}
+
+static void tst4() {
+    builder b;
+    interval_plan p = b.compile(b.mk_num(0.1));
+    {
+        // 0.1 is not representable with 24 bits
+        scoped_mpfp_context ctx(mpfp_context(24));
+        interval<mpfp> c = p.eval(std::vector<interval<mpfp>>());
+        lean_assert(c.lower() < c.upper());
+        lean_assert(c.lower() <= 0.1);
+        lean_assert(0.1 <= c.upper());
+    }
+    interval<mpfp> c = p.eval(std::vector<interval<mpfp>>());
+    lean_assert(c.lower() == c.upper());
+    lean_assert(c.lower() == 0.1);
+}
+
+int main() {
+    tst1();
+    tst2();
+    tst3();
+    tst4();
+    return has_violations() ? 1 : 0;
+}
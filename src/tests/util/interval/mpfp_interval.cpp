@@ -4,7 +4,9 @@ Released under Apache 2.0 license as described in the file LICENSE.
 
 Author: Soonho Kong
 */
+#include <vector>
 #include "util/test.h"
+#include "util/thread.h"
 #include "util/trace.h"
 #include "util/numerics/mpfp.h"
 #include "util/interval/interval.h"
@@ -1030,8 +1032,85 @@ static void mpfp_interval_trans() {
     check_uop(mpfp, atanh, oi15);
 }
 
+static void check_sin_cos(mpfr_prec_t prec) {
+    scoped_mpfp_context ctx(prec);
+    for (unsigned i = 0; i < 20; i++) {
+        fi x(mpfp(0.1 * i), mpfp(0.1 * i + 0.05));
+        fi s = sin(x);
+        fi c = cos(x);
+        lean_assert(s.lower().get_prec() == prec);
+        lean_assert(s.lower() <= s.upper());
+        lean_assert(c.lower() <= c.upper());
+        // sin(x)^2 + cos(x)^2 = 1
+        fi one = s * s + c * c;
+        lean_assert(one.contains(mpfp(1.0)));
+    }
+    lean_assert(numeric_traits<mpfp>::pi_lower().get_prec() == prec);
+    lean_assert(numeric_traits<mpfp>::pi_lower() < numeric_traits<mpfp>::pi_upper());
+}
+
+static void mpfp_interval_threads() {
+    // each thread uses its own precision
+#if !defined(__APPLE__) && defined(LEAN_MULTI_THREAD)
+    std::vector<thread> threads;
+    for (unsigned i = 0; i < 8; i++)
+        threads.push_back(thread([i]() { check_sin_cos(32 + 48 * i); }));
+    for (thread & t : threads)
+        t.join();
+    for (unsigned i = 0; i < 8; i++)
+        check_sin_cos(32 + 48 * i);
+#else
+    for (unsigned i = 0; i < 8; i++)
+        check_sin_cos(32 + 48 * i);
+#endif
+    lean_assert(get_mpfp_prec() == 53);
+}
+
+static void check_width(fi const & r, mpfr_prec_t prec) {
+    lean_assert(r.lower().get_prec() == prec);
+    lean_assert(r.upper().get_prec() == prec);
+    lean_assert(r.lower() <= r.upper());
+    lean_assert(r.upper() - r.lower() < mpfp(1e-70));
+}
+
+static void mpfp_interval_prec() {
+    // the thread-local temporaries of the interval operations are first used at 53 bits
+    fi a(1.0, 2.0);
+    fi b(3.0, 4.0);
+    fi r = a - b;
+    r = a * b;
+    r = a / b;
+    r = a + b;
+    lean_assert(r.lower().get_prec() == 53);
+    scoped_mpfp_context ctx(256);
+    mpfp third_lower(1.0, 256);
+    mpfp third_upper(1.0, 256);
+    third_lower.div(3lu, MPFR_RNDD);
+    third_upper.div(3lu, MPFR_RNDU);
+    fi x(third_lower, third_upper);
+    fi y(x);
+    check_width(x + y, 256);
+    check_width(x - y, 256);
+    check_width(x * y, 256);
+    check_width(x / y, 256);
+    check_width(inv(x), 256);
+    lean_assert((x - y).contains(fi(0.0)));
+    lean_assert((x / y).contains(fi(1.0)));
+    lean_assert(inv(x).contains(fi(3.0)));
+    mpfp ninth(1.0, 256);
+    ninth /= 9lu;
+    lean_assert((x * y).contains(fi(ninth)));
+    // copies are exact, each bound keeps its value
+    fi z(1.0, 2.0);
+    z = x;
+    lean_assert(z.lower() == third_lower && z.upper() == third_upper);
+    check_width(z, 256);
+}
+
 int main() {
     enable_trace("numerics");
+    mpfp_interval_threads();
+    mpfp_interval_prec();
     mpfp_interval_arith();
     mpfp_interval_inf1();
     mpfp_interval_inf2();
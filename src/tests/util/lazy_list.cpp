@@ -6,6 +6,7 @@ Author: Leonardo de Moura
 */
 #include <iostream>
 #include <utility>
+#include <stdexcept>
 #include "util/interrupt.h"
 #include "util/test.h"
 #include "util/optional.h"
@@ -168,11 +169,73 @@ static void tst4() {
           list<int>({ 1, 2, 2, 4, 2, 4, 4, 8, 2, 4, 4, 8, 4, 8, 8, 16 }));
 }
 
+static lazy_list<int> counted_from(int begin, int end, unsigned & counter) {
+    if (begin > end)
+        return lazy_list<int>();
+    else
+        return mk_lazy_list<int>([=, &counter]() {
+                counter++;
+                return some(mk_pair(begin, counted_from(begin + 1, end, counter)));
+            });
+}
+
+static void tst5() {
+    unsigned counter = 0;
+    lazy_list<int> l = memoize(counted_from(1, 10, counter));
+    check(l, list<int>({1, 2, 3, 4, 5, 6, 7, 8, 9, 10}));
+    lean_assert(counter == 10);
+    check(l, list<int>({1, 2, 3, 4, 5, 6, 7, 8, 9, 10}));
+    lean_assert(counter == 10);
+    check(orelse(l, seq(100)), list<int>({1, 2, 3, 4, 5, 6, 7, 8, 9, 10}));
+    lean_assert(counter == 10);
+    unsigned counter2 = 0;
+    lazy_list<int> l2 = counted_from(1, 5, counter2);
+    check(l2, list<int>({1, 2, 3, 4, 5}));
+    check(l2, list<int>({1, 2, 3, 4, 5}));
+    lean_assert(counter2 == 20); // check traverses the list twice
+    unsigned counter3 = 0;
+    lazy_list<int> l3 = mk_memo_lazy_list<int>([&]() {
+            counter3++;
+            return some(mk_pair(static_cast<int>(counter3), lazy_list<int>()));
+        });
+    lean_assert(head(l3) == 1);
+    lean_assert(head(l3) == 1);
+    lean_assert(counter3 == 1);
+}
+
+static void tst6() {
+    check(prefetch(from(1, 1, 10), 3), list<int>({1, 2, 3, 4, 5, 6, 7, 8, 9, 10}));
+    check(prefetch(lazy_list<int>(), 3), list<int>());
+    check(take(5, prefetch(seq(1), 4)), list<int>({1, 2, 3, 4, 5}));
+    check(map(prefetch(from(1, 1, 5), 2), [](int v) { return 2*v; }), list<int>({2, 4, 6, 8, 10}));
+    unsigned counter = 0;
+    lazy_list<int> l = prefetch(counted_from(1, 5, counter), 1);
+    check(l, list<int>({1, 2, 3, 4, 5}));
+    lean_assert(counter == 5);
+    // Exceptions thrown by the producer are propagated to the consumer.
+    lazy_list<int> bad = append(take(2, seq(1)), mk_lazy_list<int>([]() -> lazy_list<int>::maybe_pair {
+                throw std::runtime_error("producer failure");
+            }));
+    bool failed = false;
+    try {
+        for_each(prefetch(bad, 2), [](int v) { lean_assert(v > 0); });
+    } catch (std::runtime_error &) {
+        failed = true;
+    }
+    lean_assert(failed);
+#if !defined(__APPLE__) && defined(LEAN_MULTI_THREAD)
+    // The producer is interrupted when the consumer stops pulling.
+    check(take(3, prefetch(append(take(3, seq(1)), loop()), 2)), list<int>({1, 2, 3}));
+#endif
+}
+
 int main() {
     save_stack_info();
     tst1();
     tst2();
     tst3();
     tst4();
+    tst5();
+    tst6();
     return has_violations() ? 1 : 0;
 }
@@ -5,7 +5,10 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Author: Leonardo de Moura
 */
 #include <iostream>
+#include <vector>
 #include "util/test.h"
+#include "util/exception.h"
+#include "util/memory_budget.h"
 #include "util/memory.cpp"
 
 static void tst1() {
@@ -32,7 +35,112 @@ static void tst1() {
     lean_assert_eq(old_mem, lean::get_allocated_memory());
 }
 
+static void tst2() {
+    size_t old_peak = lean::get_peak_memory();
+    void * a = lean::malloc(1024*1024);
+    lean_assert(lean::get_peak_memory() >= old_peak);
+    lean_assert(lean::get_peak_memory() >= lean::get_allocated_memory());
+    lean_assert(lean::get_thread_peak_memory() >= lean::get_thread_allocated_memory());
+    lean::free(a);
+    lean::display_alloc_profile(std::cout);
+}
+
+#if defined(LEAN_ALLOC_PROFILER)
+static void tst3() {
+    unsigned t1 = lean::register_alloc_tag("test1");
+    unsigned t2 = lean::register_alloc_tag("test2");
+    lean_assert(t1 != 0 && t2 != 0 && t1 != t2);
+    lean_assert(lean::register_alloc_tag("test1") == t1);
+    void * a;
+    void * b;
+    {
+        LEAN_ALLOC_TAG(t1);
+        a = lean::malloc(100);
+        {
+            LEAN_ALLOC_TAG(t2);
+            b = lean::malloc(200);
+        }
+        b = lean::realloc(b, 300);
+    }
+    std::vector<lean::alloc_tag_info> tags;
+    lean::get_alloc_profile(tags);
+    lean_assert(tags[t1].m_live == 400);
+    lean_assert(tags[t1].m_num_allocs == 2);
+    lean_assert(tags[t2].m_live == 0);
+    lean_assert(tags[t2].m_peak == 200);
+    lean_assert(tags[t2].m_num_frees == 1);
+    lean::free(a);
+    lean::free(b);
+    tags.clear();
+    lean::get_alloc_profile(tags);
+    lean_assert(tags[t1].m_live == 0);
+    lean_assert(tags[t1].m_peak == 400);
+    lean::display_alloc_profile(std::cout);
+}
+#endif
+
+#if defined(LEAN_TRACK_MEMORY)
+static void tst4() {
+    unsigned counter = 0;
+    void * a = lean::malloc(1024*1024);
+    {
+        lean::memory_shedder shedder([&]() { counter++; lean::free(a); a = nullptr; });
+        lean::check_memory("test");
+        shedder();
+        lean_assert(counter == 0);
+        size_t mem = lean::get_allocated_memory();
+        lean::set_soft_memory_limit(mem - 512*1024);
+        // check_memory does not execute the shedder, it is executed by its owner
+        lean::check_memory("test");
+        lean_assert(counter == 0);
+        lean_assert(a != nullptr);
+        shedder();
+        lean_assert(counter == 1);
+        lean_assert(a == nullptr);
+        shedder();
+        lean_assert(counter == 1);
+        lean::check_memory("test");
+        shedder();
+        lean_assert(counter == 1);
+        lean::set_soft_memory_limit(0);
+        lean::set_hard_memory_limit(lean::get_allocated_memory() + 512*1024);
+        a = lean::malloc(1024*1024);
+        // the exception is thrown, and the memory is released the next time the owner executes the shedder
+        try {
+            lean::check_memory("test");
+            lean_assert(false);
+        } catch (lean::memory_exception & ex) {
+            std::cout << ex.what() << "\n";
+        }
+        lean_assert(counter == 1);
+        shedder();
+        lean_assert(counter == 2);
+        lean_assert(a == nullptr);
+        lean::check_memory("test");
+        a = lean::malloc(1024*1024);
+    }
+    // shedders are removed at the end of their scope
+    try {
+        lean::check_memory("test");
+        lean_assert(false);
+    } catch (lean::memory_exception & ex) {
+        std::cout << ex.what() << "\n";
+    }
+    lean_assert(counter == 2);
+    lean::free(a);
+    lean::check_memory("test");
+    lean::set_hard_memory_limit(0);
+}
+#endif
+
 int main() {
     tst1();
+    tst2();
+#if defined(LEAN_ALLOC_PROFILER)
+    tst3();
+#endif
+#if defined(LEAN_TRACK_MEMORY)
+    tst4();
+#endif
     return lean::has_violations() ? 1 : 0;
 }
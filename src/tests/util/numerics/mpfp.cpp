@@ -56,8 +56,48 @@ static void tst2() {
     }
 }
 
+static void tst3() {
+    lean_assert(mpfp(1.0).get_prec() == get_mpfp_prec());
+    mpfr_rnd_t rnd = get_mpfp_rnd();
+    {
+        scoped_mpfp_context ctx(mpfp_context(256, MPFR_RNDU));
+        lean_assert(get_mpfp_prec() == 256);
+        lean_assert(get_mpfp_rnd() == MPFR_RNDU);
+        mpfp a(1.0);
+        lean_assert(a.get_prec() == 256);
+        {
+            scoped_mpfp_context ctx2(64);
+            lean_assert(get_mpfp_prec() == 64);
+            lean_assert(get_mpfp_rnd() == MPFR_RNDU);
+            // the assignment copies the precision
+            mpfp b;
+            b = a;
+            lean_assert(b.get_prec() == 256);
+            lean_assert(b == a);
+        }
+        lean_assert(get_mpfp_prec() == 256);
+        set_mpfp_rnd(false);
+    }
+    lean_assert(get_mpfp_rnd() == rnd);
+    mpfp third(1.0, 200);
+    third /= 3lu;
+    mpfp c(0.0, 24);
+    {
+        // the assignment is exact, it does not depend on the rounding mode of the current thread
+        scoped_mpfp_context ctx(mpfp_context(53, MPFR_RNDD));
+        c = third;
+    }
+    lean_assert(c.get_prec() == 200);
+    lean_assert(c == third);
+    mpfp d(0.0, 24);
+    d = mpfp(third);
+    lean_assert(d.get_prec() == 200);
+    lean_assert(d == third);
+}
+
 int main() {
     tst1();
     tst2();
+    tst3();
     return has_violations() ? 1 : 0;
 }
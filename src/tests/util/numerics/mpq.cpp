@@ -6,6 +6,7 @@ Author: Leonardo de Moura
 */
 #include <iostream>
 #include <sstream>
+#include <limits>
 #include "util/test.h"
 #include "util/serializer.h"
 #include "util/numerics/mpq.h"
@@ -195,6 +196,50 @@ static void tst7() {
     lean_assert(n5 == m5);
 }
 
+static void tst8() {
+    // values around the boundary between the small and GMP representations
+    long M = std::numeric_limits<long>::max();
+    mpq a(M, 3l);
+    mpq b(3l, M);
+    lean_assert(a * b == 1);
+    lean_assert(a / a == 1);
+    mpq c = a + b;
+    lean_assert(c - b == a);
+    lean_assert(c > a);
+    mpq d(M - 1, M);
+    lean_assert(d < 1);
+    lean_assert(cmp(d, mpq(M - 2, M - 1)) > 0);
+    lean_assert(d + mpq(1l, M) == 1);
+    mpq e(M);
+    e += 1u;
+    lean_assert(e == mpz(M) + 1);
+    lean_assert(e.is_integer());
+    e -= 1;
+    lean_assert(e == mpz(M));
+    mpq f(std::numeric_limits<long>::min(), -4l);
+    lean_assert(f == mpq(-(std::numeric_limits<long>::min() / 4)));
+    mpq g(-7, 2);
+    lean_assert(floor(g) == -4);
+    lean_assert(ceil(g) == -3);
+    g.floor();
+    lean_assert(g == -4);
+    lean_assert(pow(mpq(-2, 3), 3) == mpq(-8, 27));
+    lean_assert(pow(mpq(2, 3), 70) * pow(mpq(3, 2), 70) == 1);
+    mpq h(1, 3);
+    h /= mpz(-4);
+    lean_assert(h == mpq(-1, 12));
+    h *= -6;
+    lean_assert(h == mpq(1, 2));
+    lean_assert(h.get_numerator() == 1 && h.get_denominator() == 2);
+    h.inv();
+    lean_assert(h == 2);
+    mpq i(2, -6);
+    lean_assert(i == mpq(-1, 3));
+    std::ostringstream out;
+    out << i << " " << mpq(M) * mpq(M);
+    lean_assert(out.str() == "-1/3 85070591730234615847396907784232501249" || sizeof(long) != 8);
+}
+
 int main() {
     tst0();
     tst1();
@@ -204,5 +249,6 @@ int main() {
     tst5();
     tst6();
     tst7();
+    tst8();
     return has_violations() ? 1 : 0;
 }
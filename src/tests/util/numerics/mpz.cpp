@@ -7,6 +7,7 @@ Author: Leonardo de Moura
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <limits>
 #include "util/test.h"
 #include "util/serializer.h"
 #include "util/numerics/mpz.h"
@@ -63,8 +64,67 @@ static void tst2() {
     lean_assert(n4 == m4);
 }
 
+static void tst3() {
+    // values around the boundary between the small and GMP representations
+    long M = std::numeric_limits<long>::max();
+    long m = std::numeric_limits<long>::min();
+    mpz a(M);
+    mpz b(m);
+    lean_assert(b < a);
+    lean_assert(b + a == -1);
+    mpz c = a + 1;
+    lean_assert(c > a);
+    lean_assert(c - 1 == a);
+    lean_assert(c == neg(b));
+    lean_assert(neg(c) == b);
+    lean_assert(b.is_neg());
+    lean_assert(b.is_long_int());
+    lean_assert(b.get_long_int() == m);
+    lean_assert(!c.is_long_int());
+    lean_assert(c.is_unsigned_long_int());
+    mpz d = a * a;
+    lean_assert(d / a == a);
+    lean_assert(rem(d, a) == 0);
+    lean_assert(gcd(d, a) == a);
+    lean_assert(gcd(mpz(12), mpz(-18)) == 6);
+    lean_assert(abs(b) == c);
+    mpz e(1);
+    for (unsigned i = 0; i < 100; i++) {
+        lean_assert(e.log2() == i);
+        lean_assert(e.is_power_of_two());
+        mpz f;
+        mul2k(f, mpz(1), i);
+        lean_assert(f == e);
+        div2k(f, e, i);
+        lean_assert(f == 1);
+        e *= 2;
+    }
+    lean_assert(pow(mpz(-3), 41) == mpz("-36472996377170786403"));
+    lean_assert(pow(mpz(-3), 39) == mpz(-4052555153018976267l));
+    lean_assert(pow(mpz(-1), 1000001) == -1);
+    mpz g(M);
+    g.addmul(mpz(2), mpz(3));
+    lean_assert(g == a + 6);
+    g.submul(mpz(2), mpz(3));
+    lean_assert(g == a);
+    lean_assert((mpz(-6) & mpz(5)) == 0);
+    lean_assert((mpz(-6) | mpz(5)) == -1);
+    mpz h(M);
+    h.comp();
+    lean_assert(h == b);
+    lean_assert(mpz(std::numeric_limits<unsigned long>::max()) == 2*c - 1);
+    // INT_MIN is LONG_MIN when long is a 32-bit type
+    mpz i(std::numeric_limits<int>::min());
+    lean_assert(i == mpz(static_cast<long>(std::numeric_limits<int>::min())));
+    lean_assert(neg(i) - 1 == std::numeric_limits<int>::max());
+    std::ostringstream out;
+    out << b << " " << c;
+    lean_assert(out.str() == "-9223372036854775808 9223372036854775808" || sizeof(long) != 8);
+}
+
 int main() {
     tst1();
     tst2();
+    tst3();
     return has_violations() ? 1 : 0;
 }
@@ -0,0 +1,56 @@
+/*
+Copyright (c) 2014 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "util/test.h"
+#include "util/name.h"
+#include "util/perf.h"
+using namespace lean;
+
+static perf_counter g_counter("test_counter");
+static perf_timer   g_timer("test_timer");
+
+static unsigned fact(unsigned n) {
+    scoped_perf_timer timer(g_timer);
+    g_counter.inc();
+    return n == 0 ? 1 : n * fact(n - 1);
+}
+
+static void tst1() {
+    // counters and timers are ignored when disabled
+    fact(5);
+    std::ostringstream out1;
+    display_perf_summary(out1);
+    lean_assert(out1.str().find("test_counter") == std::string::npos);
+    lean_assert(out1.str().find("test_timer") == std::string::npos);
+    enable_perf(true, true);
+    lean_assert(fact(5) == 120);
+    inc_perf_counter("delta", name({"foo", "bar"}));
+    inc_perf_counter("delta", name({"foo", "bar"}));
+    enable_perf(false);
+    fact(5);
+    std::ostringstream out2;
+    display_perf_summary(out2);
+    std::cout << out2.str();
+    lean_assert(out2.str().find("test_counter") != std::string::npos);
+    lean_assert(out2.str().find("test_timer") != std::string::npos);
+    lean_assert(out2.str().find("delta foo::bar") != std::string::npos);
+    std::ostringstream out3;
+    export_perf_trace(out3);
+    std::cout << out3.str();
+    lean_assert(out3.str().find("\"name\":\"test_timer\"") != std::string::npos);
+    reset_perf();
+    std::ostringstream out4;
+    display_perf_summary(out4);
+    lean_assert(out4.str().find("test_counter") == std::string::npos);
+}
+
+int main() {
+    tst1();
+    return has_violations() ? 1 : 0;
+}
@@ -45,6 +45,14 @@ char const * stack_space_exception::what() const noexcept {
     return buffer.c_str();
 }
 
+char const * memory_exception::what() const noexcept {
+    static LEAN_THREAD_LOCAL std::string buffer;
+    std::ostringstream s;
+    s << "memory limit was exceeded at '" << m_component_name << "'";
+    buffer = s.str();
+    return buffer.c_str();
+}
+
 constexpr char const * exception_mt = "exception_mt";
 exception const & to_exception(lua_State * L, int i) {
     return *(*static_cast<exception**>(luaL_checkudata(L, i, exception_mt)));
@@ -63,6 +63,15 @@ public:
     virtual exception * clone() const { return new stack_space_exception(m_component_name.c_str()); }
     virtual void rethrow() const { throw *this; }
 };
+/** \brief Exception used to sign that the hard memory limit was exceeded (see \c set_hard_memory_limit). */
+class memory_exception : public exception {
+    std::string m_component_name;
+public:
+    memory_exception(char const * component_name):m_component_name(component_name) {}
+    virtual char const * what() const noexcept;
+    virtual exception * clone() const { return new memory_exception(m_component_name.c_str()); }
+    virtual void rethrow() const { throw *this; }
+};
 int push_exception(lua_State * L, exception const & e);
 exception const & to_exception(lua_State * L, int i);
 bool is_exception(lua_State * L, int i);
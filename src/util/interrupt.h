@@ -9,6 +9,7 @@ Author: Leonardo de Moura
 #include "util/thread.h"
 #include "util/stackinfo.h"
 #include "util/exception.h"
+#include "util/memory_budget.h"
 
 namespace lean {
 /**
@@ -30,7 +31,12 @@ bool interrupt_requested();
 */
 void check_interrupted();
 
-inline void check_system(char const * component_name) { check_stack(component_name); check_interrupted(); }
+/** \brief Check the stack space, the interruption flag and the memory limits. */
+inline void check_system(char const * component_name) {
+    check_stack(component_name);
+    check_interrupted();
+    check_memory(component_name);
+}
 
 constexpr unsigned g_small_sleep = 50;
 
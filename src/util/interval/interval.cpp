@@ -257,6 +257,7 @@ interval<T> & interval<T>::operator/=(interval<T> const & o) {
 template<typename T>
 template<bool compute_intv, bool compute_deps>
 interval<T> & interval<T>::add(interval<T> const & o, interval_deps & deps) {
+    rounding_scope scope;
     if (compute_intv) {
         xnumeral_kind new_l_kind, new_u_kind;
         round_to_minus_inf();
@@ -278,6 +279,7 @@ interval<T> & interval<T>::add(interval<T> const & o, interval_deps & deps) {
 template<typename T>
 template<bool compute_intv, bool compute_deps>
 interval<T> & interval<T>::sub(interval<T> const & o, interval_deps & deps) {
+    rounding_scope scope;
     if (compute_intv) {
         using std::swap;
         static LEAN_THREAD_LOCAL T new_l_val;
@@ -307,6 +309,7 @@ interval<T> & interval<T>::sub(interval<T> const & o, interval_deps & deps) {
 template<typename T>
 template<bool compute_intv, bool compute_deps>
 interval<T> & interval<T>::mul(interval<T> const & o, interval_deps & deps) {
+    rounding_scope scope;
     using std::swap;
     interval<T> const & i1 = *this;
     interval<T> const & i2 = o;
@@ -558,6 +561,7 @@ interval<T> & interval<T>::mul(interval<T> const & o, interval_deps & deps) {
 template<typename T>
 template<bool compute_intv, bool compute_deps>
 interval<T> & interval<T>::div(interval<T> const & o, interval_deps & deps) {
+    rounding_scope scope;
     using std::swap;
     interval<T> const & i1 = *this;
     interval<T> const & i2 = o;
@@ -666,9 +670,9 @@ interval<T> & interval<T>::div(interval<T> const & o, interval_deps & deps) {
                     deps.m_upper_deps = DEP_IN_LOWER1 | DEP_IN_UPPER2;
                 }
             } else {
-                // 0 < a <= x <= b < 0, 0 < c <= y  --> a/c <= x/y
-                // 0 < a <= x <= b < 0, 0 < c <= y  -->        x/y <= b/c
-                lean_assert(i1.is_P1());
+                // a < 0, a <= x <= b, b > 0, 0 < c <= y  --> a/c <= x/y
+                // a < 0, a <= x <= b, b > 0, 0 < c <= y  -->        x/y <= b/c
+                lean_assert(i2.is_P1());
                 if (compute_intv) {
                     set_is_lower_open(a_o || c_o);
                     set_is_upper_open(b_o || c_o);
@@ -768,6 +772,7 @@ template<typename T> void interval<T>::div_jst(interval<T> const & o, interval_d
 
 template<typename T>
 interval<T> & interval<T>::operator+=(T const & o) {
+    rounding_scope scope;
     xnumeral_kind new_l_kind, new_u_kind;
     round_to_minus_inf();
     lean::add(m_lower, new_l_kind, m_lower, lower_kind(), o, XN_NUMERAL);
@@ -781,6 +786,7 @@ interval<T> & interval<T>::operator+=(T const & o) {
 
 template<typename T>
 interval<T> & interval<T>::operator-=(T const & o) {
+    rounding_scope scope;
     xnumeral_kind new_l_kind, new_u_kind;
     round_to_minus_inf();
     lean::sub(m_lower, new_l_kind, m_lower, lower_kind(), o, XN_NUMERAL);
@@ -794,6 +800,7 @@ interval<T> & interval<T>::operator-=(T const & o) {
 
 template<typename T>
 interval<T> & interval<T>::operator*=(T const & o) {
+    rounding_scope scope;
     xnumeral_kind new_l_kind, new_u_kind;
     static LEAN_THREAD_LOCAL T tmp1;
     if (this->is_zero()) {
@@ -830,6 +837,7 @@ interval<T> & interval<T>::operator*=(T const & o) {
 
 template<typename T>
 interval<T> & interval<T>::operator/=(T const & o) {
+    rounding_scope scope;
     xnumeral_kind new_l_kind, new_u_kind;
     static LEAN_THREAD_LOCAL T tmp1;
     if (this->is_zero()) {
@@ -867,6 +875,7 @@ interval<T> & interval<T>::operator/=(T const & o) {
 template<typename T>
 template<bool compute_intv, bool compute_deps>
 void interval<T>::inv(interval_deps & deps) {
+    rounding_scope scope;
     // If the interval [l, u] does not contain 0, then 1/[l, u] = [1/u, 1/l]
     lean_assert(!contains_zero());
 
@@ -952,6 +961,7 @@ void interval<T>::inv(interval_deps & deps) {
 template<typename T>
 template<bool compute_intv, bool compute_deps>
 void interval<T>::power(unsigned n, interval_deps & deps) {
+    rounding_scope scope;
     using std::swap;
     lean_assert(n > 0);
     if (n == 1) {
@@ -1416,7 +1426,7 @@ void interval<T>::sin(interval_deps & deps) {
     m_lower_open = m_upper_open = false;
     m_lower_inf  = m_upper_inf = false;
 
-    T const pi_twice = numeric_traits<T>::pi_twice();
+    T const & pi_twice = numeric_traits<T>::pi_twice();
     fmod(interval<T>(numeric_traits<T>::pi_twice_lower(), numeric_traits<T>::pi_twice_upper()));
     if (m_upper - m_lower >= pi_twice) {
         // If the input width is bigger than 2pi,
@@ -1437,8 +1447,8 @@ void interval<T>::sin(interval_deps & deps) {
     // l \in [-pi, pi]
     *this -= interval<T>(numeric_traits<T>::pi_lower(), numeric_traits<T>::pi_upper());
 
-    T const pi_half = numeric_traits<T>::pi_half();
-    T const pi = numeric_traits<T>::pi();
+    T const & pi_half = numeric_traits<T>::pi_half();
+    T const & pi = numeric_traits<T>::pi();
 
     if (m_lower <= - pi_half) {
         if (m_upper <= - pi_half) {
@@ -1644,7 +1654,7 @@ void interval<T>::cos  (interval_deps & deps) {
 
     m_lower_open = m_upper_open = false;
     m_lower_inf  = m_upper_inf = false;
-    T const pi_twice = numeric_traits<T>::pi_twice();
+    T const & pi_twice = numeric_traits<T>::pi_twice();
     fmod(interval<T>(numeric_traits<T>::pi_twice_lower(), numeric_traits<T>::pi_twice_upper()));
     if (m_upper - m_lower >= pi_twice) {
         // If the input width is bigger than 2pi,
@@ -1743,7 +1753,7 @@ void interval<T>::tan(interval_deps & deps) {
         return;
     }
 
-    T const pi_half_lower = numeric_traits<T>::pi_half_lower();
+    T const & pi_half_lower = numeric_traits<T>::pi_half_lower();
     fmod(interval<T>(numeric_traits<T>::pi_lower(), numeric_traits<T>::pi_upper()));
 
     if (m_lower >= pi_half_lower) {
@@ -1804,8 +1814,8 @@ void interval<T>::csc  (interval_deps & deps) {
         }
         return;
     }
-    T const pi_half = numeric_traits<T>::pi_half();
-    T const pi = numeric_traits<T>::pi();
+    T const & pi_half = numeric_traits<T>::pi_half();
+    T const & pi = numeric_traits<T>::pi();
     fmod(interval<T>(numeric_traits<T>::pi_twice_lower(), numeric_traits<T>::pi_twice_upper()));
     if (m_upper > numeric_traits<T>::pi_twice() ||
        (m_lower < pi && pi < m_upper)) {
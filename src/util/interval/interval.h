@@ -55,13 +55,19 @@ class interval {
     xnumeral_kind upper_kind() const { return m_upper_inf ? XN_PLUS_INFINITY  : XN_NUMERAL; }
     void set_closed_endpoints();
 
+    /**
+       \brief Object created by the arithmetic operations. For native floating point numbers,
+       it keeps the processor in upward rounding mode, and \c round_to_minus_inf only selects
+       the direction used by \c bound_arith.
+    */
+    typedef typename bound_arith<T>::scope rounding_scope;
     static void round_to_plus_inf() { numeric_traits<T>::set_rounding(true); }
     static void round_to_minus_inf() { numeric_traits<T>::set_rounding(false); }
     static void reset(T & v) { numeric_traits<T>::reset(v); }
-    static void inv(T & v) { numeric_traits<T>::inv(v); }
+    static void inv(T & v) { bound_arith<T>::inv(v); }
     static void neg(T & v) { numeric_traits<T>::neg(v); }
     static bool is_zero(T const & v) { return numeric_traits<T>::is_zero(v); }
-    static void power(T & v, unsigned k) { return numeric_traits<T>::power(v, k); }
+    static void power(T & v, unsigned k) { return bound_arith<T>::power(v, k); }
     void _swap(interval & b);
     bool _eq(interval const & b) const;
 
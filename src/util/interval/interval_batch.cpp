@@ -0,0 +1,368 @@
+/*
+Copyright (c) 2014 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#include <limits>
+#include <utility>
+#include <vector>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "util/debug.h"
+#include "util/interval/interval_batch.h"
+
+namespace lean {
+/*
+   Vectors of doubles used to implement the batch operations. All of them provide the same
+   interface, and the kernels below are parametrized by them.
+   Remark: the kernels assume the processor is in upward rounding mode.
+*/
+struct vd1 {
+    enum { size = 1 };
+    double m;
+    vd1(double v):m(v) {}
+    static vd1 load(double const * p) { return vd1(*p); }
+    void store(double * p) const { *p = m; }
+    static vd1 zero() { return vd1(0.0); }
+    static vd1 one() { return vd1(1.0); }
+    friend vd1 operator+(vd1 a, vd1 b) { return vd1(a.m + b.m); }
+    friend vd1 operator*(vd1 a, vd1 b) { return vd1(a.m * b.m); }
+    friend vd1 operator/(vd1 a, vd1 b) { return vd1(a.m / b.m); }
+    friend vd1 operator-(vd1 a) { return vd1(-a.m); }
+    friend vd1 max(vd1 a, vd1 b) { return vd1(a.m > b.m ? a.m : b.m); }
+    friend vd1 abs(vd1 a) { return vd1(a.m < 0.0 ? -a.m : a.m); }
+    /** \brief <tt>x >= 0 ? a : b</tt> */
+    friend vd1 select_ge0(vd1 x, vd1 a, vd1 b) { return x.m >= 0.0 ? a : b; }
+    /** \brief <tt>x <= 0 ? a : b</tt> */
+    friend vd1 select_le0(vd1 x, vd1 a, vd1 b) { return x.m <= 0.0 ? a : b; }
+};
+
+#if defined(__AVX__)
+struct vd4 {
+    enum { size = 4 };
+    __m256d m;
+    vd4(__m256d v):m(v) {}
+    static vd4 load(double const * p) { return vd4(_mm256_loadu_pd(p)); }
+    void store(double * p) const { _mm256_storeu_pd(p, m); }
+    static vd4 zero() { return vd4(_mm256_setzero_pd()); }
+    static vd4 one() { return vd4(_mm256_set1_pd(1.0)); }
+    friend vd4 operator+(vd4 a, vd4 b) { return vd4(_mm256_add_pd(a.m, b.m)); }
+    friend vd4 operator*(vd4 a, vd4 b) { return vd4(_mm256_mul_pd(a.m, b.m)); }
+    friend vd4 operator/(vd4 a, vd4 b) { return vd4(_mm256_div_pd(a.m, b.m)); }
+    friend vd4 operator-(vd4 a) { return vd4(_mm256_xor_pd(a.m, _mm256_set1_pd(-0.0))); }
+    friend vd4 max(vd4 a, vd4 b) { return vd4(_mm256_max_pd(a.m, b.m)); }
+    friend vd4 abs(vd4 a) { return vd4(_mm256_andnot_pd(_mm256_set1_pd(-0.0), a.m)); }
+    friend vd4 select_ge0(vd4 x, vd4 a, vd4 b) {
+        return vd4(_mm256_blendv_pd(b.m, a.m, _mm256_cmp_pd(x.m, _mm256_setzero_pd(), _CMP_GE_OQ)));
+    }
+    friend vd4 select_le0(vd4 x, vd4 a, vd4 b) {
+        return vd4(_mm256_blendv_pd(b.m, a.m, _mm256_cmp_pd(x.m, _mm256_setzero_pd(), _CMP_LE_OQ)));
+    }
+};
+typedef vd4 vdw;
+#elif defined(__SSE2__)
+struct vd2 {
+    enum { size = 2 };
+    __m128d m;
+    vd2(__m128d v):m(v) {}
+    static vd2 load(double const * p) { return vd2(_mm_loadu_pd(p)); }
+    void store(double * p) const { _mm_storeu_pd(p, m); }
+    static vd2 zero() { return vd2(_mm_setzero_pd()); }
+    static vd2 one() { return vd2(_mm_set1_pd(1.0)); }
+    static vd2 select(__m128d mask, vd2 a, vd2 b) { return vd2(_mm_or_pd(_mm_and_pd(mask, a.m), _mm_andnot_pd(mask, b.m))); }
+    friend vd2 operator+(vd2 a, vd2 b) { return vd2(_mm_add_pd(a.m, b.m)); }
+    friend vd2 operator*(vd2 a, vd2 b) { return vd2(_mm_mul_pd(a.m, b.m)); }
+    friend vd2 operator/(vd2 a, vd2 b) { return vd2(_mm_div_pd(a.m, b.m)); }
+    friend vd2 operator-(vd2 a) { return vd2(_mm_xor_pd(a.m, _mm_set1_pd(-0.0))); }
+    friend vd2 max(vd2 a, vd2 b) { return vd2(_mm_max_pd(a.m, b.m)); }
+    friend vd2 abs(vd2 a) { return vd2(_mm_andnot_pd(_mm_set1_pd(-0.0), a.m)); }
+    friend vd2 select_ge0(vd2 x, vd2 a, vd2 b) { return select(_mm_cmpge_pd(x.m, _mm_setzero_pd()), a, b); }
+    friend vd2 select_le0(vd2 x, vd2 a, vd2 b) { return select(_mm_cmple_pd(x.m, _mm_setzero_pd()), a, b); }
+};
+typedef vd2 vdw;
+#else
+typedef vd1 vdw;
+#endif
+
+/** \brief Pointers to the arrays of the batches involved in an operation. */
+struct batch_arrays {
+    double *       m_r_nl;
+    double *       m_r_u;
+    double const * m_nl1;
+    double const * m_u1;
+    double const * m_nl2;
+    double const * m_u2;
+    unsigned       m_n;
+};
+
+/** \brief -down(a + b) == up(-a + -b) */
+template<typename V> void add_lanes(batch_arrays const & s, unsigned i) {
+    (V::load(s.m_nl1 + i) + V::load(s.m_nl2 + i)).store(s.m_r_nl + i);
+    (V::load(s.m_u1 + i)  + V::load(s.m_u2 + i)).store(s.m_r_u + i);
+}
+
+/** \brief [a, b] - [c, d] == [a - d, b - c] */
+template<typename V> void sub_lanes(batch_arrays const & s, unsigned i) {
+    V nl1 = V::load(s.m_nl1 + i); V u1 = V::load(s.m_u1 + i);
+    V nl2 = V::load(s.m_nl2 + i); V u2 = V::load(s.m_u2 + i);
+    (nl1 + u2).store(s.m_r_nl + i);
+    (u1 + nl2).store(s.m_r_u + i);
+}
+
+/**
+   \brief [a, b] * [c, d] for closed and finite intervals.
+   The bounds are the minimum and maximum of the four products, and down(x*y) == -up((-x)*y).
+*/
+template<typename V> void mul_lanes(batch_arrays const & s, unsigned i) {
+    V nl1 = V::load(s.m_nl1 + i); V b = V::load(s.m_u1 + i);
+    V nl2 = V::load(s.m_nl2 + i); V d = V::load(s.m_u2 + i);
+    V a = -nl1; V c = -nl2; V nb = -b;
+    max(max(nl1 * c, nl1 * d), max(nb * c, nb * d)).store(s.m_r_nl + i);
+    max(max(a * c, a * d), max(b * c, b * d)).store(s.m_r_u + i);
+}
+
+/** \brief Similar to \c mul_lanes. Remark: [c, d] does not contain zero. */
+template<typename V> void div_lanes(batch_arrays const & s, unsigned i) {
+    V nl1 = V::load(s.m_nl1 + i); V b = V::load(s.m_u1 + i);
+    V nl2 = V::load(s.m_nl2 + i); V d = V::load(s.m_u2 + i);
+    V a = -nl1; V c = -nl2; V nb = -b;
+    max(max(nl1 / c, nl1 / d), max(nb / c, nb / d)).store(s.m_r_nl + i);
+    max(max(a / c, a / d), max(b / c, b / d)).store(s.m_r_u + i);
+}
+
+/**
+   \brief Return up(m^k) and -down(m^k) for m >= 0. We use the same repeated squaring
+   procedure used by \c native_bound_arith::power. So, the results are the same.
+*/
+template<typename V> std::pair<V, V> power_lanes_core(V m, unsigned k) {
+    V ru = V::one(); V bu = m; // rounded to +oo
+    V rd = V::one(); V bd = m; // rounded to -oo
+    while (k > 0) {
+        if (k % 2 == 1) {
+            ru = ru * bu;
+            rd = -((-rd) * bd);
+        }
+        k /= 2;
+        if (k > 0) {
+            bu = bu * bu;
+            bd = -((-bd) * bd);
+        }
+    }
+    return std::make_pair(ru, -rd);
+}
+
+/** \brief [a, b]^k for closed and finite intervals. The exponent is stored in \c m_n. */
+template<typename V> void power_lanes(batch_arrays const & s, unsigned i) {
+    V nl = V::load(s.m_nl1 + i);
+    V a  = -nl;
+    V b  = V::load(s.m_u1 + i);
+    unsigned k = s.m_n;
+    if (k % 2 == 0) {
+        // [l, u]^k == [m_lo^k, m_hi^k] where m_lo is 0 if the interval contains 0, and m_hi == max(|l|, |u|)
+        V m_lo = select_ge0(a, a, select_le0(b, -b, V::zero()));
+        V m_hi = max(abs(a), abs(b));
+        power_lanes_core(m_lo, k).second.store(s.m_r_nl + i);
+        power_lanes_core(m_hi, k).first.store(s.m_r_u + i);
+    } else {
+        // x^k is monotonic, and x^k == -(|x|^k) when x is negative
+        auto pa = power_lanes_core(abs(a), k);
+        auto pb = power_lanes_core(abs(b), k);
+        select_ge0(a, pa.second, pa.first).store(s.m_r_nl + i);
+        select_ge0(b, pb.first, pb.second).store(s.m_r_u + i);
+    }
+}
+
+typedef void (*lanes_fn)(batch_arrays const &, unsigned);
+
+template<lanes_fn FW, lanes_fn F1>
+void for_each_lanes(batch_arrays const & s, unsigned n) {
+    unsigned i = 0;
+    for (; i + vdw::size <= n; i += vdw::size)
+        FW(s, i);
+    for (; i < n; i++)
+        F1(s, i);
+}
+
+/** \brief Swap the lower and upper flags. */
+static unsigned char swap_flags(unsigned char f) {
+    return ((f & (double_interval_batch::LOWER_OPEN | double_interval_batch::LOWER_INF)) << 1) |
+        ((f & (double_interval_batch::UPPER_OPEN | double_interval_batch::UPPER_INF)) >> 1);
+}
+
+class interval_batch_fn {
+    typedef double_interval_batch batch;
+    typedef std::vector<std::pair<unsigned, interval<double>>> slow_results;
+
+    static batch_arrays mk_arrays(batch & r, batch const & a, batch const & b) {
+        batch_arrays s;
+        s.m_r_nl = r.m_neg_lower.data(); s.m_r_u = r.m_upper.data();
+        s.m_nl1  = a.m_neg_lower.data(); s.m_u1  = a.m_upper.data();
+        s.m_nl2  = b.m_neg_lower.data(); s.m_u2  = b.m_upper.data();
+        s.m_n    = 0;
+        return s;
+    }
+
+    /**
+       \brief The vectorized kernels for multiplication, division and power only handle closed and
+       finite intervals. The other elements are computed using \c interval<double> in \c F.
+       We compute them before executing the kernels because \c r may be one of the arguments.
+    */
+    template<typename F>
+    static void compute_slow(batch const & a, batch const & b, slow_results & slow, F && f) {
+        unsigned n = a.size();
+        for (unsigned i = 0; i < n; i++) {
+            if ((a.m_flags[i] | b.m_flags[i]) != 0) {
+                interval<double> v = a.get(i);
+                f(v, b.get(i));
+                slow.emplace_back(i, v);
+            }
+        }
+    }
+
+    static void set_slow(batch & r, slow_results const & slow) {
+        unsigned n = r.size();
+        for (unsigned i = 0; i < n; i++)
+            r.m_flags[i] = 0;
+        for (auto const & p : slow)
+            r.set(p.first, p.second);
+    }
+
+public:
+    static void add(batch & r, batch const & a, batch const & b) {
+        lean_assert(a.size() == b.size());
+        r.resize(a.size());
+        unsigned n = a.size();
+        {
+            scoped_upward_rounding scope;
+            for_each_lanes<add_lanes<vdw>, add_lanes<vd1>>(mk_arrays(r, a, b), n);
+        }
+        for (unsigned i = 0; i < n; i++)
+            r.m_flags[i] = a.m_flags[i] | b.m_flags[i];
+    }
+
+    static void sub(batch & r, batch const & a, batch const & b) {
+        lean_assert(a.size() == b.size());
+        r.resize(a.size());
+        unsigned n = a.size();
+        {
+            scoped_upward_rounding scope;
+            for_each_lanes<sub_lanes<vdw>, sub_lanes<vd1>>(mk_arrays(r, a, b), n);
+        }
+        for (unsigned i = 0; i < n; i++)
+            r.m_flags[i] = a.m_flags[i] | swap_flags(b.m_flags[i]);
+    }
+
+    static void mul(batch & r, batch const & a, batch const & b) {
+        lean_assert(a.size() == b.size());
+        scoped_upward_rounding scope;
+        slow_results slow;
+        compute_slow(a, b, slow, [](interval<double> & v, interval<double> const & w) { v *= w; });
+        r.resize(a.size());
+        for_each_lanes<mul_lanes<vdw>, mul_lanes<vd1>>(mk_arrays(r, a, b), a.size());
+        set_slow(r, slow);
+    }
+
+    static void div(batch & r, batch const & a, batch const & b) {
+        lean_assert(a.size() == b.size());
+        DEBUG_CODE(for (unsigned i = 0; i < b.size(); i++) lean_assert(!b.get(i).contains_zero()););
+        scoped_upward_rounding scope;
+        slow_results slow;
+        compute_slow(a, b, slow, [](interval<double> & v, interval<double> const & w) { v /= w; });
+        r.resize(a.size());
+        for_each_lanes<div_lanes<vdw>, div_lanes<vd1>>(mk_arrays(r, a, b), a.size());
+        set_slow(r, slow);
+    }
+
+    static void power(batch & r, batch const & a, unsigned k) {
+        lean_assert(k > 0);
+        scoped_upward_rounding scope;
+        slow_results slow;
+        compute_slow(a, a, slow, [=](interval<double> & v, interval<double> const &) { v.power(k); });
+        r.resize(a.size());
+        batch_arrays s = mk_arrays(r, a, a);
+        s.m_n = k;
+        for_each_lanes<power_lanes<vdw>, power_lanes<vd1>>(s, a.size());
+        set_slow(r, slow);
+    }
+
+    template<typename F>
+    static void map(batch & r, batch const & a, F && f) {
+        r.resize(a.size());
+        scoped_upward_rounding scope;
+        for (unsigned i = 0; i < a.size(); i++) {
+            interval<double> v = a.get(i);
+            f(v);
+            r.set(i, v);
+        }
+    }
+};
+
+double_interval_batch::double_interval_batch(unsigned n) {
+    resize(n);
+}
+
+void double_interval_batch::resize(unsigned n) {
+    m_neg_lower.resize(n, std::numeric_limits<double>::infinity());
+    m_upper.resize(n, std::numeric_limits<double>::infinity());
+    m_flags.resize(n, LOWER_OPEN | UPPER_OPEN | LOWER_INF | UPPER_INF);
+}
+
+void double_interval_batch::set(unsigned i, interval<double> const & v) {
+    unsigned char f = 0;
+    if (v.is_lower_open()) f |= LOWER_OPEN;
+    if (v.is_upper_open()) f |= UPPER_OPEN;
+    if (v.is_lower_inf())  f |= LOWER_INF;
+    if (v.is_upper_inf())  f |= UPPER_INF;
+    m_neg_lower[i] = v.is_lower_inf() ? std::numeric_limits<double>::infinity() : -v.lower();
+    m_upper[i]     = v.is_upper_inf() ? std::numeric_limits<double>::infinity() : v.upper();
+    m_flags[i]     = f;
+}
+
+interval<double> double_interval_batch::get(unsigned i) const {
+    interval<double> r; // (-oo, +oo)
+    unsigned char f = m_flags[i];
+    if ((f & LOWER_INF) == 0) {
+        r.set_lower(-m_neg_lower[i]);
+        r.set_is_lower_inf(false);
+        r.set_is_lower_open((f & LOWER_OPEN) != 0);
+    }
+    if ((f & UPPER_INF) == 0) {
+        r.set_upper(m_upper[i]);
+        r.set_is_upper_inf(false);
+        r.set_is_upper_open((f & UPPER_OPEN) != 0);
+    }
+    return r;
+}
+
+void double_interval_batch::push_back(interval<double> const & v) {
+    unsigned n = size();
+    resize(n + 1);
+    set(n, v);
+}
+
+void add(double_interval_batch & r, double_interval_batch const & a, double_interval_batch const & b) {
+    interval_batch_fn::add(r, a, b);
+}
+void sub(double_interval_batch & r, double_interval_batch const & a, double_interval_batch const & b) {
+    interval_batch_fn::sub(r, a, b);
+}
+void mul(double_interval_batch & r, double_interval_batch const & a, double_interval_batch const & b) {
+    interval_batch_fn::mul(r, a, b);
+}
+void div(double_interval_batch & r, double_interval_batch const & a, double_interval_batch const & b) {
+    interval_batch_fn::div(r, a, b);
+}
+void power(double_interval_batch & r, double_interval_batch const & a, unsigned n) {
+    interval_batch_fn::power(r, a, n);
+}
+void exp(double_interval_batch & r, double_interval_batch const & a) {
+    interval_batch_fn::map(r, a, [](interval<double> & v) { v.exp(); });
+}
+void log(double_interval_batch & r, double_interval_batch const & a) {
+    interval_batch_fn::map(r, a, [](interval<double> & v) { v.log(); });
+}
+}
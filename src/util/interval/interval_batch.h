@@ -0,0 +1,66 @@
+/*
+Copyright (c) 2014 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#pragma once
+#include <vector>
+#include "util/numerics/double.h"
+#include "util/interval/interval.h"
+
+namespace lean {
+/**
+   \brief Sequence of double intervals stored as a structure of arrays.
+   It is used to evaluate the same operation on many intervals (e.g., branch-and-bound over boxes).
+
+   The lower bounds are stored negated. Thus, all bounds are computed with the processor in
+   upward rounding mode, and the operations can be vectorized (SSE2/AVX).
+   The results are the same produced by \c interval<double>.
+
+   Infinite bounds are represented by <tt>+oo</tt> in the arrays, and the flags
+   (open/infinite endpoints) are stored as bitmasks.
+*/
+class double_interval_batch {
+public:
+    enum flag { LOWER_OPEN = 1, UPPER_OPEN = 2, LOWER_INF = 4, UPPER_INF = 8 };
+private:
+    std::vector<double>        m_neg_lower;
+    std::vector<double>        m_upper;
+    std::vector<unsigned char> m_flags;
+    friend class interval_batch_fn;
+public:
+    double_interval_batch(unsigned n = 0);
+
+    unsigned size() const { return m_upper.size(); }
+    /** \brief Resize the batch, new elements are the interval (-oo, +oo). */
+    void resize(unsigned n);
+    void set(unsigned i, interval<double> const & v);
+    interval<double> get(unsigned i) const;
+    void push_back(interval<double> const & v);
+
+    double lower(unsigned i) const { return -m_neg_lower[i]; }
+    double upper(unsigned i) const { return m_upper[i]; }
+    unsigned char flags(unsigned i) const { return m_flags[i]; }
+};
+
+/**
+   \brief The following procedures store in \c r the result of applying the given
+   operation to each element of the input batches. The input batches must have the same size,
+   and \c r may be one of them.
+
+   The rounding mode is switched at most once per call.
+*/
+void add(double_interval_batch & r, double_interval_batch const & a, double_interval_batch const & b);
+void sub(double_interval_batch & r, double_interval_batch const & a, double_interval_batch const & b);
+void mul(double_interval_batch & r, double_interval_batch const & a, double_interval_batch const & b);
+/** \brief Division, the intervals in \c b must not contain zero. */
+void div(double_interval_batch & r, double_interval_batch const & a, double_interval_batch const & b);
+void power(double_interval_batch & r, double_interval_batch const & a, unsigned n);
+/**
+   \brief Exponential and logarithm. Remark: these functions rely on MPFR to produce correctly
+   rounded bounds, so they are not vectorized, but they are still computed in a single pass.
+*/
+void exp(double_interval_batch & r, double_interval_batch const & a);
+void log(double_interval_batch & r, double_interval_batch const & a);
+}
@@ -17,9 +17,15 @@ template void interval<mpq>::neg<true, false>(interval_deps &);
 template void interval<mpq>::neg<false, true>(interval_deps &);
 template void interval<mpq>::inv<true, false>(interval_deps &);
 template void interval<mpq>::power<true, false>(unsigned, interval_deps &);
+// Remark: the following are only needed to evaluate interval_plan objects, they are not supported by mpq.
+template void interval<mpq>::exp<true, false>(interval_deps &);
+template void interval<mpq>::log<true, false>(interval_deps &);
+template void interval<mpq>::sin<true, false>(interval_deps &);
+template void interval<mpq>::cos<true, false>(interval_deps &);
 
 template class interval<double>;
 template void interval<double>::neg<true, false>(interval_deps &);
+template void interval<double>::neg<false, true>(interval_deps &);
 template void interval<double>::inv<true, false>(interval_deps &);
 template void interval<double>::power<true, false>(unsigned, interval_deps &);
 template void interval<double>::exp<true, false>(interval_deps &);
@@ -46,6 +52,7 @@ template void interval<double>::atanh<true, false>(interval_deps &);
 
 template class interval<float>;
 template void interval<float>::neg<true, false>(interval_deps &);
+template void interval<float>::neg<false, true>(interval_deps &);
 template void interval<float>::inv<true, false>(interval_deps &);
 template void interval<float>::power<true, false>(unsigned, interval_deps &);
 template void interval<float>::exp<true, false>(interval_deps &);
@@ -72,6 +79,7 @@ template void interval<float>::atanh<true, false>(interval_deps &);
 
 template class interval<mpfp>;
 template void interval<mpfp>::neg<true, false>(interval_deps &);
+template void interval<mpfp>::neg<false, true>(interval_deps &);
 template void interval<mpfp>::inv<true, false>(interval_deps &);
 template void interval<mpfp>::power<true, false>(unsigned, interval_deps &);
 template void interval<mpfp>::exp<true, false>(interval_deps &);
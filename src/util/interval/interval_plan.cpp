@@ -0,0 +1,200 @@
+/*
+Copyright (c) 2014 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include "util/hash.h"
+#include "util/numerics/mpq.h"
+#include "util/numerics/double.h"
+#include "util/numerics/float.h"
+#include "util/numerics/mpfp.h"
+#include "util/interval/interval_plan.h"
+
+namespace lean {
+static bool is_binary(interval_op op) {
+    switch (op) {
+    case interval_op::Add: case interval_op::Sub: case interval_op::Mul: case interval_op::Div:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool has_args(interval_op op) {
+    return op != interval_op::Var && op != interval_op::Num;
+}
+
+unsigned interval_plan_builder::instr_hash::operator()(instr const & i) const {
+    unsigned h = hash(static_cast<unsigned>(i.m_op), hash(i.m_arg1, i.m_arg2));
+    if (i.m_op == interval_op::Num)
+        h = hash(h, static_cast<unsigned>(std::hash<double>()(i.m_num)));
+    return h;
+}
+
+bool interval_plan_builder::instr_eq::operator()(instr const & i1, instr const & i2) const {
+    return i1.m_op == i2.m_op && i1.m_arg1 == i2.m_arg1 && i1.m_arg2 == i2.m_arg2 && i1.m_num == i2.m_num;
+}
+
+auto interval_plan_builder::mk(interval_op op, node a1, node a2, double n) -> node {
+    if (has_args(op)) {
+        lean_assert(a1 < m_nodes.size());
+        lean_assert(!is_binary(op) || a2 < m_nodes.size());
+        // normalize commutative operations, then a+b and b+a are shared
+        if ((op == interval_op::Add || op == interval_op::Mul) && a2 < a1)
+            std::swap(a1, a2);
+    }
+    instr i(op, a1, a2, n);
+    auto it = m_cache.find(i);
+    if (it != m_cache.end())
+        return it->second;
+    node r = m_nodes.size();
+    m_nodes.push_back(i);
+    m_cache.insert(std::make_pair(i, r));
+    return r;
+}
+
+interval_plan interval_plan_builder::compile(std::vector<node> const & outputs) const {
+    // The nodes are already in topological order, we just remove the ones that are not needed.
+    std::vector<bool> needed(m_nodes.size(), false);
+    for (node n : outputs) {
+        lean_assert(n < m_nodes.size());
+        needed[n] = true;
+    }
+    for (unsigned i = m_nodes.size(); i-- > 0;) {
+        if (!needed[i])
+            continue;
+        instr const & c = m_nodes[i];
+        if (has_args(c.m_op))
+            needed[c.m_arg1] = true;
+        if (is_binary(c.m_op))
+            needed[c.m_arg2] = true;
+    }
+    interval_plan r;
+    std::vector<unsigned> new_idx(m_nodes.size(), 0);
+    for (unsigned i = 0; i < m_nodes.size(); i++) {
+        if (!needed[i])
+            continue;
+        instr c = m_nodes[i];
+        if (has_args(c.m_op))
+            c.m_arg1 = new_idx[c.m_arg1];
+        if (is_binary(c.m_op))
+            c.m_arg2 = new_idx[c.m_arg2];
+        if (c.m_op == interval_op::Var)
+            r.m_num_vars = std::max(r.m_num_vars, c.m_arg1 + 1);
+        new_idx[i] = r.m_instrs.size();
+        r.m_instrs.push_back(c);
+    }
+    for (node n : outputs)
+        r.m_outputs.push_back(new_idx[n]);
+    return r;
+}
+
+template<typename T> static interval<T> mk_num_interval(double v) { return interval<T>(T(v)); }
+/** \brief The constants are doubles, they may not be representable as floats. */
+template<> interval<float> mk_num_interval<float>(double v) {
+    float f = static_cast<float>(v);
+    if (static_cast<double>(f) == v)
+        return interval<float>(f);
+    float l = f, u = f;
+    if (static_cast<double>(f) < v)
+        u = std::nextafter(f, HUGE_VALF);
+    else
+        l = std::nextafter(f, -HUGE_VALF);
+    return interval<float>(l, u);
+}
+/** \brief The constants are doubles, they may not be representable with the precision of the current mpfp context. */
+template<> interval<mpfp> mk_num_interval<mpfp>(double v) {
+    mpfp l(v, get_mpfp_prec(), MPFR_RNDD);
+    mpfp u(v, get_mpfp_prec(), MPFR_RNDU);
+    if (l == u)
+        return interval<mpfp>(l);
+    return interval<mpfp>(l, u);
+}
+
+template<typename T>
+void interval_plan::eval_core(std::vector<interval<T>> const & vars, std::vector<interval<T>> & regs,
+                              std::vector<interval_deps> * deps) const {
+    lean_assert(vars.size() >= m_num_vars);
+    // switch the rounding mode only once for the whole plan
+    typename bound_arith<T>::scope scope;
+    unsigned sz = m_instrs.size();
+    regs.resize(sz);
+    if (deps)
+        deps->resize(sz);
+    interval_deps dummy;
+    for (unsigned i = 0; i < sz; i++) {
+        instr const & c = m_instrs[i];
+        interval<T> & r = regs[i];
+        interval_deps & d = deps ? (*deps)[i] : dummy;
+        d.m_lower_deps = 0;
+        d.m_upper_deps = 0;
+        // Remark: the justifications are computed before updating r.
+        switch (c.m_op) {
+        case interval_op::Var:   r = vars[c.m_arg1]; break;
+        case interval_op::Num:   r = mk_num_interval<T>(c.m_num); break;
+        case interval_op::Add:
+            r = regs[c.m_arg1]; if (deps) r.add_jst(regs[c.m_arg2], d); r += regs[c.m_arg2]; break;
+        case interval_op::Sub:
+            r = regs[c.m_arg1]; if (deps) r.sub_jst(regs[c.m_arg2], d); r -= regs[c.m_arg2]; break;
+        case interval_op::Mul:
+            r = regs[c.m_arg1]; if (deps) r.mul_jst(regs[c.m_arg2], d); r *= regs[c.m_arg2]; break;
+        case interval_op::Div:
+            r = regs[c.m_arg1]; if (deps) r.div_jst(regs[c.m_arg2], d); r /= regs[c.m_arg2]; break;
+        case interval_op::Neg:
+            r = regs[c.m_arg1]; if (deps) r.neg_jst(d); r.neg(); break;
+        case interval_op::Inv:
+            r = regs[c.m_arg1]; if (deps) r.inv_jst(d); r.inv(); break;
+        case interval_op::Power:
+            r = regs[c.m_arg1]; if (deps) r.power_jst(c.m_arg2, d); r.power(c.m_arg2); break;
+        case interval_op::Exp:
+            r = regs[c.m_arg1]; if (deps) r.exp_jst(d); r.exp(); break;
+        case interval_op::Log:
+            r = regs[c.m_arg1]; if (deps) r.log_jst(d); r.log(); break;
+        case interval_op::Sin:
+            r = regs[c.m_arg1]; if (deps) r.sin_jst(d); r.sin(); break;
+        case interval_op::Cos:
+            r = regs[c.m_arg1]; if (deps) r.cos_jst(d); r.cos(); break;
+        }
+    }
+}
+
+void interval_plan::propagate_deps(std::vector<interval_deps> const & deps, unsigned o, std::vector<bound_deps> & var_deps,
+                                   bound_deps which) const {
+    lean_assert(deps.size() == m_instrs.size());
+    var_deps.assign(m_num_vars, 0);
+    // used[i] contains the bounds of the i-th register (DEP_IN_LOWER1/DEP_IN_UPPER1) that are needed
+    std::vector<bound_deps> used(m_instrs.size(), 0);
+    used[m_outputs[o]] = which;
+    for (unsigned i = m_instrs.size(); i-- > 0;) {
+        bound_deps u = used[i];
+        if (u == 0)
+            continue;
+        instr const & c = m_instrs[i];
+        if (c.m_op == interval_op::Var) {
+            var_deps[c.m_arg1] |= u;
+            continue;
+        }
+        bound_deps d = 0;
+        if (dep_in_lower1(u)) d |= deps[i].m_lower_deps;
+        if (dep_in_upper1(u)) d |= deps[i].m_upper_deps;
+        if (has_args(c.m_op))
+            used[c.m_arg1] |= d & (DEP_IN_LOWER1 | DEP_IN_UPPER1);
+        if (is_binary(c.m_op))
+            used[c.m_arg2] |= (d >> 2) & (DEP_IN_LOWER1 | DEP_IN_UPPER1);
+    }
+}
+
+template void interval_plan::eval_core<mpq>(std::vector<interval<mpq>> const &, std::vector<interval<mpq>> &,
+                                            std::vector<interval_deps> *) const;
+template void interval_plan::eval_core<double>(std::vector<interval<double>> const &, std::vector<interval<double>> &,
+                                               std::vector<interval_deps> *) const;
+template void interval_plan::eval_core<float>(std::vector<interval<float>> const &, std::vector<interval<float>> &,
+                                              std::vector<interval_deps> *) const;
+template void interval_plan::eval_core<mpfp>(std::vector<interval<mpfp>> const &, std::vector<interval<mpfp>> &,
+                                             std::vector<interval_deps> *) const;
+}
@@ -0,0 +1,120 @@
+/*
+Copyright (c) 2014 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include "util/interval/interval.h"
+
+namespace lean {
+enum class interval_op { Var, Num, Add, Sub, Mul, Div, Neg, Inv, Power, Exp, Log, Sin, Cos };
+
+/**
+   \brief Flat evaluation plan for an interval expression.
+
+   The plan is a sequence of instructions in topological order, the arguments of an
+   instruction are the indices of previous instructions. The i-th instruction stores its
+   result in the i-th register. Common subexpressions are shared, so they are evaluated
+   only once. A plan is created by \c interval_plan_builder, and it can be evaluated
+   many times (e.g., for different boxes) using any \c interval<T>.
+
+   \remark Transcendental functions are not supported by <tt>interval<mpq></tt>.
+*/
+class interval_plan {
+public:
+    struct instr {
+        interval_op m_op;
+        unsigned    m_arg1;  // variable index for interval_op::Var
+        unsigned    m_arg2;  // exponent for interval_op::Power
+        double      m_num;   // value for interval_op::Num
+        instr(interval_op op, unsigned a1, unsigned a2, double n):m_op(op), m_arg1(a1), m_arg2(a2), m_num(n) {}
+    };
+private:
+    std::vector<instr>    m_instrs;
+    std::vector<unsigned> m_outputs;
+    unsigned              m_num_vars;
+    friend class interval_plan_builder;
+
+    template<typename T>
+    void eval_core(std::vector<interval<T>> const & vars, std::vector<interval<T>> & regs, std::vector<interval_deps> * deps) const;
+public:
+    interval_plan():m_num_vars(0) {}
+
+    /** \brief Number of instructions (and registers) in the plan. */
+    unsigned size() const { return m_instrs.size(); }
+    instr const & get_instr(unsigned i) const { return m_instrs[i]; }
+    /** \brief Number of input variables, i.e., <tt>1 + max variable index</tt>. */
+    unsigned num_vars() const { return m_num_vars; }
+    unsigned num_outputs() const { return m_outputs.size(); }
+    /** \brief Register containing the i-th output. */
+    unsigned output(unsigned i) const { return m_outputs[i]; }
+
+    /**
+       \brief Evaluate the plan for the given variable assignment, and store the value of
+       every instruction in \c regs. The vector \c regs can be reused between calls to avoid
+       allocations.
+    */
+    template<typename T>
+    void eval(std::vector<interval<T>> const & vars, std::vector<interval<T>> & regs) const { eval_core(vars, regs, nullptr); }
+    /** \brief Return the value of the first output. */
+    template<typename T>
+    interval<T> eval(std::vector<interval<T>> const & vars) const {
+        std::vector<interval<T>> regs;
+        eval(vars, regs);
+        return regs[output(0)];
+    }
+    /**
+       \brief Similar to \c eval, but also store in \c deps the dependencies of the bounds of
+       each instruction on the bounds of its arguments. They are computed in the same pass.
+    */
+    template<typename T>
+    void eval(std::vector<interval<T>> const & vars, std::vector<interval<T>> & regs, std::vector<interval_deps> & deps) const {
+        eval_core(vars, regs, &deps);
+    }
+
+    /**
+       \brief Backward propagation of the dependencies produced by \c eval. Store in
+       <tt>var_deps[x]</tt> which bounds of the variable \c x (\c DEP_IN_LOWER1 and
+       \c DEP_IN_UPPER1) were used to compute the bounds \c which of the i-th output.
+    */
+    void propagate_deps(std::vector<interval_deps> const & deps, unsigned i, std::vector<bound_deps> & var_deps,
+                        bound_deps which = DEP_IN_LOWER1 | DEP_IN_UPPER1) const;
+};
+
+/**
+   \brief Builder for interval expressions. Nodes are hash-consed, thus structurally equal
+   subexpressions are represented by the same node.
+*/
+class interval_plan_builder {
+    typedef interval_plan::instr instr;
+    struct instr_hash { unsigned operator()(instr const & i) const; };
+    struct instr_eq { bool operator()(instr const & i1, instr const & i2) const; };
+    std::vector<instr>                                        m_nodes;
+    std::unordered_map<instr, unsigned, instr_hash, instr_eq> m_cache;
+public:
+    typedef unsigned node;
+    unsigned size() const { return m_nodes.size(); }
+
+    node mk(interval_op op, node a1 = 0, node a2 = 0, double n = 0.0);
+    node mk_var(unsigned i) { return mk(interval_op::Var, i); }
+    node mk_num(double v) { return mk(interval_op::Num, 0, 0, v); }
+    node mk_add(node a, node b) { return mk(interval_op::Add, a, b); }
+    node mk_sub(node a, node b) { return mk(interval_op::Sub, a, b); }
+    node mk_mul(node a, node b) { return mk(interval_op::Mul, a, b); }
+    node mk_div(node a, node b) { return mk(interval_op::Div, a, b); }
+    node mk_neg(node a) { return mk(interval_op::Neg, a); }
+    node mk_inv(node a) { return mk(interval_op::Inv, a); }
+    node mk_power(node a, unsigned k) { return mk(interval_op::Power, a, k); }
+    node mk_exp(node a) { return mk(interval_op::Exp, a); }
+    node mk_log(node a) { return mk(interval_op::Log, a); }
+    node mk_sin(node a) { return mk(interval_op::Sin, a); }
+    node mk_cos(node a) { return mk(interval_op::Cos, a); }
+
+    /** \brief Create a plan for computing the given nodes. Nodes that are not needed are not included. */
+    interval_plan compile(std::vector<node> const & outputs) const;
+    interval_plan compile(node n) const { return compile(std::vector<node>({n})); }
+};
+}
@@ -9,6 +9,7 @@ Author: Leonardo de Moura
 #include "util/debug.h"
 #include "util/rc.h"
 #include "util/optional.h"
+#include "util/thread.h"
 
 namespace lean {
 /**
@@ -37,6 +38,33 @@ private:
         virtual maybe_pair pull() const { return m_f(); }
     };
 
+    /**
+       \brief Cell that invokes the thunk \c m_f at most once, and caches the result.
+       The cell is thread-safe: concurrent calls to \c pull wait for the thread
+       computing the result. If \c m_f throws an exception (e.g., interrupted),
+       then nothing is cached, and the next \c pull will try again.
+    */
+    template<typename F>
+    class cell_memo : public cell_base {
+        F                    m_f;
+        mutable mutex        m_mutex;
+        mutable atomic<bool> m_done;
+        mutable maybe_pair   m_result;
+    public:
+        cell_memo(F && f):cell_base(), m_f(f), m_done(false) {}
+        virtual ~cell_memo() {}
+        virtual maybe_pair pull() const {
+            if (!m_done) {
+                lock_guard<mutex> lock(m_mutex);
+                if (!m_done) {
+                    m_result = m_f();
+                    m_done   = true;
+                }
+            }
+            return m_result;
+        }
+    };
+
     class cell_singleton : public cell_base {
         T m_val;
     public:
@@ -90,9 +118,25 @@ public:
         r.m_ptr->inc_ref();
         return r;
     }
+
+    template<typename F>
+    static lazy_list mk_memo_lazy_list_core(F && f) {
+        lazy_list r;
+        r.m_ptr = new cell_memo<F>(std::forward<F>(f));
+        r.m_ptr->inc_ref();
+        return r;
+    }
 };
 template<typename T, typename F>
 lazy_list<T> mk_lazy_list(F && f) {
     return lazy_list<T>::mk_lazy_list_core(std::forward<F>(f));
 }
+/**
+   \brief Similar to \c mk_lazy_list, but \c f is invoked at most once
+   (the result is cached).
+*/
+template<typename T, typename F>
+lazy_list<T> mk_memo_lazy_list(F && f) {
+    return lazy_list<T>::mk_memo_lazy_list_core(std::forward<F>(f));
+}
 }
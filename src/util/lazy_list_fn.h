@@ -6,6 +6,10 @@ Author: Leonardo de Moura
 */
 #pragma once
 #include <utility>
+#include <memory>
+#include <deque>
+#include <algorithm>
+#include <exception>
 #include "util/interrupt.h"
 #include "util/lazy_list.h"
 #include "util/list.h"
@@ -43,6 +47,23 @@ lazy_list<T> take(unsigned sz, lazy_list<T> const & l) {
     }
 }
 
+/**
+   \brief Create a lazy list that contains the same elements of \c l,
+   but where each element is computed at most once. That is, if the
+   resultant lazy list is traversed more than once, the thunks in
+   \c l are not re-executed.
+*/
+template<typename T>
+lazy_list<T> memoize(lazy_list<T> const & l) {
+    return mk_memo_lazy_list<T>([=]() {
+            auto p = l.pull();
+            if (p)
+                return some(mk_pair(p->first, memoize(p->second)));
+            else
+                return p;
+        });
+}
+
 /**
    \brief Create a lazy list based on the list \c l.
 */
@@ -218,6 +239,9 @@ lazy_list<T> repeat_at_most(T const & v, F && f, unsigned k, char const * cname
 
    \remark \c check_ms is how often the main thread checks whether the child
    thread finished.
+
+   \remark The cells of the resultant lazy list are memoized. Thus, pulling
+   the same cell twice does not create a new execution thread.
 */
 #if !defined(LEAN_MULTI_THREAD)
 template<typename T>
@@ -229,7 +253,7 @@ template<typename T>
 lazy_list<T> timeout(lazy_list<T> const & l, unsigned ms, unsigned check_ms = g_small_sleep) {
     if (check_ms == 0)
         check_ms = 1;
-    return mk_lazy_list<T>([=]() {
+    return mk_memo_lazy_list<T>([=]() {
             typename lazy_list<T>::maybe_pair r;
             atomic<bool> done(false);
             interruptible_thread th([&]() {
@@ -270,6 +294,8 @@ lazy_list<T> timeout(lazy_list<T> const & l, unsigned ms, unsigned check_ms = g_
    \brief Similar to interleave, but the heads are computed in parallel.
    Moreover, when pulling results from the lists, if one finishes before the other,
    then the other one is interrupted.
+
+   \remark The cells of the resultant lazy list are memoized.
 */
 #if !defined(LEAN_MULTI_THREAD)
 template<typename T>
@@ -279,7 +305,7 @@ lazy_list<T> par(lazy_list<T> const & l1, lazy_list<T> const & l2, unsigned = g_
 #else
 template<typename T>
 lazy_list<T> par(lazy_list<T> const & l1, lazy_list<T> const & l2, unsigned check_ms = g_small_sleep) {
-    return mk_lazy_list<T>([=]() {
+    return mk_memo_lazy_list<T>([=]() {
             typename lazy_list<T>::maybe_pair r1;
             typename lazy_list<T>::maybe_pair r2;
             atomic<bool>  done1(false);
@@ -330,4 +356,142 @@ lazy_list<T> par(lazy_list<T> const & l1, lazy_list<T> const & l2, unsigned chec
         });
 }
 #endif
+
+/**
+   \brief Return a lazy list with the same elements of \c l, but where up to \c k
+   elements are computed ahead of time by a background execution thread. That is,
+   the thread pulling elements from the resultant lazy list (the consumer) and the
+   background thread (the producer) run in parallel.
+
+   \remark The background thread is created when the first element is pulled.
+   It is interrupted (using \c interruptible_thread::request_interrupt) when the
+   resultant lazy list is not referenced anymore. The elements of a lazy list
+   are computed sequentially, thus a single producer thread is used.
+
+   \remark Exceptions produced by the producer thread are propagated to the consumer.
+
+   \remark \c check_ms is how often the consumer checks whether it was interrupted
+   while waiting for the producer.
+*/
+#if !defined(LEAN_MULTI_THREAD)
+template<typename T>
+lazy_list<T> prefetch(lazy_list<T> const & l, unsigned, unsigned = g_small_sleep) {
+    return l;
+}
+#else
+/**
+   \brief Auxiliary class for \c prefetch. It stores the elements
+   computed by the producer thread that were not consumed yet.
+*/
+template<typename T>
+class prefetch_buffer {
+    lazy_list<T>                          m_list;       // elements that were not pulled by the producer yet
+    unsigned                              m_capacity;
+    unsigned                              m_check_ms;
+    mutex                                 m_mutex;
+    condition_variable                    m_cv;
+    std::deque<T>                         m_buffer;
+    bool                                  m_done;
+    bool                                  m_stop;
+    std::exception_ptr                    m_exception;
+    std::unique_ptr<interruptible_thread> m_thread;
+
+    void producer() {
+        lazy_list<T> l;
+        {
+            lock_guard<mutex> lock(m_mutex);
+            std::swap(l, m_list);
+        }
+        try {
+            while (true) {
+                {
+                    unique_lock<mutex> lock(m_mutex);
+                    while (!m_stop && m_buffer.size() >= m_capacity)
+                        m_cv.wait(lock);
+                    if (m_stop)
+                        return;
+                }
+                auto p = l.pull();
+                lock_guard<mutex> lock(m_mutex);
+                if (p) {
+                    m_buffer.push_back(p->first);
+                    l = p->second;
+                } else {
+                    m_done = true;
+                }
+                m_cv.notify_all();
+                if (m_done)
+                    return;
+            }
+        } catch (...) {
+            // the exception is rethrown by the consumer, see next
+            lock_guard<mutex> lock(m_mutex);
+            m_exception = std::current_exception();
+            m_done = true;
+            m_cv.notify_all();
+        }
+    }
+
+public:
+    prefetch_buffer(lazy_list<T> const & l, unsigned k, unsigned check_ms):
+        m_list(l), m_capacity(k), m_check_ms(check_ms == 0 ? 1 : check_ms), m_done(false), m_stop(false) {}
+
+    ~prefetch_buffer() {
+        if (m_thread) {
+            {
+                lock_guard<mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_cv.notify_all();
+            try {
+                m_thread->request_interrupt();
+            } catch (...) {
+            }
+            m_thread->join();
+        }
+    }
+
+    /**
+       \brief Return the next element, and wait for the producer if it is not available yet.
+       Return none if there are no more elements.
+    */
+    optional<T> next() {
+        if (!m_thread)
+            m_thread.reset(new interruptible_thread([=]() { producer(); }));
+        unique_lock<mutex> lock(m_mutex);
+        while (m_buffer.empty() && !m_done) {
+            m_cv.wait_for(lock, chrono::milliseconds(m_check_ms));
+            check_interrupted();
+        }
+        if (!m_buffer.empty()) {
+            optional<T> r(m_buffer.front());
+            m_buffer.pop_front();
+            m_cv.notify_all();
+            return r;
+        } else if (m_exception) {
+            std::rethrow_exception(m_exception);
+        }
+        return optional<T>();
+    }
+};
+
+template<typename T>
+lazy_list<T> prefetch_core(std::shared_ptr<prefetch_buffer<T>> const & b) {
+    // Remark: we must use memoized cells, each element can be removed from the buffer only once.
+    return mk_memo_lazy_list<T>([=]() {
+            optional<T> v = b->next();
+            if (v)
+                return some(mk_pair(*v, prefetch_core(b)));
+            else
+                return typename lazy_list<T>::maybe_pair();
+        });
+}
+
+template<typename T>
+lazy_list<T> prefetch(lazy_list<T> const & l, unsigned k, unsigned check_ms = g_small_sleep) {
+    if (k == 0)
+        return l;
+    return prefetch_core(std::make_shared<prefetch_buffer<T>>(l, k, check_ms));
+}
+#endif
 }
@@ -195,5 +195,26 @@ lua_migrate_fn get_migrate_fn(lua_State * L, int i) {
     }
     return nullptr;
 }
+
+void set_export_fn_field(lua_State * L, int i, lua_export_fn fn) {
+    lean_assert(lua_istable(L, i));
+    lua_pushvalue(L, i); // copy table to the top of the stack
+    lua_pushlightuserdata(L, reinterpret_cast<void*>(fn));
+    lua_setfield(L, -2, "___export");
+    lua_pop(L, 1); // remove table from the stack
+}
+
+lua_export_fn get_export_fn(lua_State * L, int i) {
+    if (lua_getmetatable(L, i)) {
+        lua_getfield(L, -1, "___export");
+        if (lua_islightuserdata(L, -1)) {
+            lua_export_fn r = reinterpret_cast<lua_export_fn>(lua_touserdata(L, -1));
+            lua_pop(L, 2);
+            return r;
+        }
+        lua_pop(L, 2);
+    }
+    return nullptr;
+}
 }
 
@@ -5,6 +5,7 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Author: Leonardo de Moura
 */
 #pragma once
+#include <functional>
 #include <lua.hpp>
 
 namespace lean {
@@ -128,6 +129,25 @@ void set_migrate_fn_field(lua_State * src, int i, lua_migrate_fn fn);
    for the userdata at position \c i.
 */
 lua_migrate_fn get_migrate_fn(lua_State * src, int i);
+
+/** \brief Closure for pushing a value into a Lua stack. */
+typedef std::function<void(lua_State * tgt)> lua_pusher;
+/**
+   \brief Export functions are similar to migrate functions, but they capture the object
+   at position \c i in a closure that can push it into another lua_State object later,
+   even if \c src was modified or destroyed. The object is not copied, only its reference
+   counter is updated.
+*/
+typedef lua_pusher (*lua_export_fn)(lua_State * src, int i);
+/**
+   \brief Set the field ___export in the metatable at position \c i with \c fn.
+*/
+void set_export_fn_field(lua_State * src, int i, lua_export_fn fn);
+/**
+   \brief Return the value of the ___export field from metatable
+   for the userdata at position \c i.
+*/
+lua_export_fn get_export_fn(lua_State * src, int i);
 // =======================================
 
 // =======================================
@@ -0,0 +1,197 @@
+/*
+Copyright (c) 2014 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iterator>
+#include <functional>
+#include <unordered_map>
+#include "util/thread.h"
+#include "util/lua.h"
+#include "util/script_exception.h"
+#include "util/lua_bytecode_cache.h"
+
+namespace lean {
+/** \brief Header of precompiled files stored on disk, it is used to detect stale files. */
+static std::string mk_bytecode_header(std::string const & fname, long long mtime) {
+    std::ostringstream out;
+    out << "lean-luac " << LUA_VERSION_NUM << " " << mtime << " " << fname << "\n";
+    return out.str();
+}
+
+class lua_bytecode_cache {
+    struct entry {
+        long long   m_mtime;
+        std::string m_code;
+        entry():m_mtime(0) {}
+        entry(long long mtime, std::string const & code):m_mtime(mtime), m_code(code) {}
+    };
+    mutex                                  m_mutex;
+    std::string                            m_dir;
+    std::unordered_map<std::string, entry> m_entries;
+
+    static std::string disk_file_name(std::string const & dir, std::string const & fname) {
+        std::ostringstream out;
+        out << dir << "/" << std::hex << std::hash<std::string>()(fname) << ".luac";
+        return out.str();
+    }
+
+    static bool read_disk(std::string const & dir, std::string const & fname, long long mtime, std::string & code) {
+        std::ifstream in(disk_file_name(dir, fname), std::ios::binary);
+        if (!in)
+            return false;
+        std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::string header = mk_bytecode_header(fname, mtime);
+        if (contents.compare(0, header.size(), header) != 0)
+            return false; // file is stale, or there is a collision
+        code = contents.substr(header.size());
+        return true;
+    }
+
+    static void write_disk(std::string const & dir, std::string const & fname, long long mtime, std::string const & code) {
+        // Remark: we ignore failures, the on-disk cache is just an optimization.
+        std::string tmp_name = disk_file_name(dir, fname) + ".tmp";
+        {
+            std::ofstream out(tmp_name, std::ios::binary);
+            if (!out)
+                return;
+            out << mk_bytecode_header(fname, mtime) << code;
+            if (!out)
+                return;
+        }
+        // rename is atomic, so concurrent Lean processes never observe a partially written file.
+        std::rename(tmp_name.c_str(), disk_file_name(dir, fname).c_str());
+    }
+
+public:
+    void set_dir(std::string const & dir) {
+        lock_guard<mutex> lock(m_mutex);
+        m_dir = dir;
+    }
+
+    std::string get_dir() {
+        lock_guard<mutex> lock(m_mutex);
+        return m_dir;
+    }
+
+    void clear() {
+        lock_guard<mutex> lock(m_mutex);
+        m_entries.clear();
+    }
+
+    // Remark: the file I/O is performed without holding the lock.
+
+    bool find(std::string const & fname, long long mtime, std::string & code) {
+        std::string dir;
+        {
+            lock_guard<mutex> lock(m_mutex);
+            auto it = m_entries.find(fname);
+            if (it != m_entries.end() && it->second.m_mtime == mtime) {
+                code = it->second.m_code;
+                return true;
+            }
+            dir = m_dir;
+        }
+        if (!dir.empty() && read_disk(dir, fname, mtime, code)) {
+            lock_guard<mutex> lock(m_mutex);
+            m_entries[fname] = entry(mtime, code);
+            return true;
+        }
+        return false;
+    }
+
+    void insert(std::string const & fname, long long mtime, std::string const & code) {
+        std::string dir;
+        {
+            lock_guard<mutex> lock(m_mutex);
+            m_entries[fname] = entry(mtime, code);
+            dir = m_dir;
+        }
+        if (!dir.empty())
+            write_disk(dir, fname, mtime, code);
+    }
+
+    /** \brief Remove the precompiled code for \c fname from the cache (e.g., it is corrupted). */
+    void erase(std::string const & fname) {
+        std::string dir;
+        {
+            lock_guard<mutex> lock(m_mutex);
+            m_entries.erase(fname);
+            dir = m_dir;
+        }
+        if (!dir.empty())
+            std::remove(disk_file_name(dir, fname).c_str());
+    }
+};
+
+static lua_bytecode_cache & get_lua_bytecode_cache() {
+    static lua_bytecode_cache g_cache;
+    return g_cache;
+}
+
+void set_lua_bytecode_cache_dir(std::string const & dir) { get_lua_bytecode_cache().set_dir(dir); }
+std::string get_lua_bytecode_cache_dir() { return get_lua_bytecode_cache().get_dir(); }
+void clear_lua_bytecode_cache() { get_lua_bytecode_cache().clear(); }
+
+static int string_writer(lua_State *, void const * p, size_t sz, void * buf) {
+    static_cast<std::string*>(buf)->append(static_cast<char const *>(p), sz);
+    return 0;
+}
+
+struct string_reader_data {
+    std::string const & m_code;
+    bool                m_done;
+    string_reader_data(std::string const & c):m_code(c), m_done(false) {}
+};
+
+static char const * string_reader(lua_State *, void * data, size_t * sz) {
+    string_reader_data & d = *static_cast<string_reader_data*>(data);
+    if (d.m_done) {
+        *sz = 0;
+        return nullptr;
+    } else {
+        d.m_done = true;
+        *sz = d.m_code.size();
+        return d.m_code.data();
+    }
+}
+
+void dofile_cached(lua_State * L, char const * fname) {
+    struct stat st;
+    if (stat(fname, &st) != 0) {
+        // let Lua produce the error message
+        dofile(L, fname);
+        return;
+    }
+    long long mtime = static_cast<long long>(st.st_mtime);
+    std::string code;
+    std::string source = std::string("@") + fname; // same chunk name used by luaL_loadfile
+    lua_bytecode_cache & cache = get_lua_bytecode_cache();
+    bool loaded = false;
+    if (cache.find(fname, mtime, code)) {
+        string_reader_data data(code);
+        if (load(L, string_reader, &data, source.c_str()) == 0) {
+            loaded = true;
+        } else {
+            // The precompiled code is corrupted (or was produced by an incompatible Lua), use the source.
+            lua_pop(L, 1);
+            cache.erase(fname);
+        }
+    }
+    if (!loaded) {
+        if (luaL_loadfile(L, fname) != 0)
+            throw script_exception(lua_tostring(L, -1));
+        code.clear();
+        if (lua_dump(L, string_writer, &code) == 0)
+            cache.insert(fname, mtime, code);
+    }
+    pcall(L, 0, LUA_MULTRET, 0);
+}
+}
@@ -0,0 +1,27 @@
+/*
+Copyright (c) 2014 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#pragma once
+#include <string>
+#include <lua.hpp>
+
+namespace lean {
+/**
+   \brief Set the directory where precompiled Lua files are stored.
+   The empty string (default) means that precompiled files are only cached in memory.
+*/
+void set_lua_bytecode_cache_dir(std::string const & dir);
+std::string get_lua_bytecode_cache_dir();
+/** \brief Remove all precompiled Lua files cached in memory. */
+void clear_lua_bytecode_cache();
+
+/**
+   \brief Similar to <tt>dofile(L, fname)</tt>, but the compiled code is cached.
+   The cache is keyed by file name and modification time. Thus, a file is
+   only compiled again if it was modified.
+*/
+void dofile_cached(lua_State * L, char const * fname);
+}
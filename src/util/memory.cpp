@@ -6,6 +6,10 @@ Author: Leonardo de Moura
 */
 #include <new>
 #include <cstdlib>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include "util/memory.h"
 
 #if !defined(LEAN_TRACK_MEMORY)
 
@@ -18,6 +22,14 @@ long long  get_thread_allocated_memory() {
     return 0;
 }
 
+size_t     get_peak_memory() {
+    return 0;
+}
+
+long long  get_thread_peak_memory() {
+    return 0;
+}
+
 void * malloc(size_t sz)  {
     void * r = ::malloc(sz);
     if (r || sz == 0)
@@ -40,15 +52,44 @@ void free(void * ptr) {
 }
 
 #else
+#include <cstring>
 #include "util/thread.h"
 
-#if defined(HAS_MALLOC_USABLE_SIZE)
+#if defined(LEAN_ALLOC_PROFILER)
+// The allocation profiler stores the size and the allocation tag of each block in a header.
+// We do not need to use malloc_usable_size and friends in this mode.
+namespace lean {
+struct alloc_header {
+    size_t   m_size;
+    unsigned m_tag;
+};
+constexpr size_t g_alloc_header_size = 16; // we use 16 to preserve the alignment of the blocks returned by ::malloc
+static_assert(sizeof(alloc_header) <= g_alloc_header_size, "invalid allocation header size");
+inline alloc_header * get_alloc_header(void * ptr) {
+    return reinterpret_cast<alloc_header*>(static_cast<char*>(ptr) - g_alloc_header_size);
+}
+void * save_alloc_header(void * ptr, size_t sz) {
+    if (ptr) {
+        alloc_header * h = static_cast<alloc_header*>(ptr);
+        h->m_size = sz;
+        h->m_tag  = 0;
+        return static_cast<char*>(ptr) + g_alloc_header_size;
+    } else {
+        return ptr;
+    }
+}
+inline size_t malloc_size(void * ptr)             { return ptr ? get_alloc_header(ptr)->m_size : 0; }
+inline void * malloc_core(size_t sz)              { return save_alloc_header(::malloc(sz + g_alloc_header_size), sz); }
+inline void * realloc_core(void * ptr, size_t sz) { return save_alloc_header(::realloc(get_alloc_header(ptr), sz + g_alloc_header_size), sz); }
+inline void   free_core(void * ptr)               { if (ptr) ::free(get_alloc_header(ptr)); }
+}
+#elif defined(HAS_MALLOC_USABLE_SIZE)
 #include <malloc.h> // NOLINT
 namespace lean {
 inline size_t malloc_size(void * ptr)             { return malloc_usable_size(ptr); }
 inline void * malloc_core(size_t sz)              { return ::malloc(sz); }
-inline void * realloc_core(void * ptr, size_t sz) { return realloc(ptr, sz); }
-inline void   free_core(void * ptr)               { free(ptr); }
+inline void * realloc_core(void * ptr, size_t sz) { return ::realloc(ptr, sz); }
+inline void   free_core(void * ptr)               { ::free(ptr); }
 }
 // REMARK: We commented the following piece of code because tc_malloc_size is hanging
 
@@ -65,16 +106,16 @@ inline void   free_core(void * ptr)               { free(ptr); }
 namespace lean {
 inline size_t malloc_size(void * ptr)             { return ::malloc_size(ptr); }
 inline void * malloc_core(size_t sz)              { return ::malloc(sz); }
-inline void * realloc_core(void * ptr, size_t sz) { return realloc(ptr, sz); }
-inline void   free_core(void * ptr)               { free(ptr); }
+inline void * realloc_core(void * ptr, size_t sz) { return ::realloc(ptr, sz); }
+inline void   free_core(void * ptr)               { ::free(ptr); }
 }
 #elif defined(HAS_MSIZE)
 #include <malloc.h> // NOLINT
 namespace lean {
 inline size_t malloc_size(void * ptr)             { return _msize(ptr); }
 inline void * malloc_core(size_t sz)              { return ::malloc(sz); }
-inline void * realloc_core(void * ptr, size_t sz) { return realloc(ptr, sz); }
-inline void   free_core(void * ptr)               { free(ptr); }
+inline void * realloc_core(void * ptr, size_t sz) { return ::realloc(ptr, sz); }
+inline void   free_core(void * ptr)               { ::free(ptr); }
 }
 #else
 namespace lean {
@@ -97,21 +138,34 @@ inline void   free_core(void * ptr)               { ::free(static_cast<size_t*>(
 namespace lean {
 class alloc_info {
     atomic<size_t> m_size;
+    atomic<size_t> m_peak;
 public:
-    alloc_info():m_size(0) {}
+    alloc_info():m_size(0), m_peak(0) {}
     ~alloc_info() {}
-    void inc(size_t sz) { m_size += sz; }
+    void inc(size_t sz) {
+        size_t new_sz = (m_size += sz);
+        // Remark: m_peak is only an approximation when there is contention.
+        if (new_sz > m_peak)
+            m_peak = new_sz;
+    }
     void dec(size_t sz) { m_size -= sz; }
     size_t size() const { return m_size; }
+    size_t peak() const { return m_peak; }
 };
 
 class thread_alloc_info {
-    size_t m_size; // It can be negative
+    size_t    m_size; // It can be negative
+    long long m_peak;
 public:
-    thread_alloc_info():m_size(0) {}
-    void inc(size_t sz) { m_size += sz; }
+    thread_alloc_info():m_size(0), m_peak(0) {}
+    void inc(size_t sz) {
+        m_size += sz;
+        if (size() > m_peak)
+            m_peak = size();
+    }
     void dec(size_t sz) { m_size -= sz; }
     long long size() const { return static_cast<long long>(m_size); }
+    long long peak() const { return m_peak; }
 };
 
 static alloc_info                          g_global_memory;
@@ -119,6 +173,67 @@ static LEAN_THREAD_LOCAL thread_alloc_info g_thread_memory;
 
 size_t     get_allocated_memory() { return g_global_memory.size(); }
 long long  get_thread_allocated_memory() { return g_thread_memory.size(); }
+size_t     get_peak_memory() { return g_global_memory.peak(); }
+long long  get_thread_peak_memory() { return g_thread_memory.peak(); }
+
+#if defined(LEAN_ALLOC_PROFILER)
+#define LEAN_MAX_ALLOC_TAGS 64
+// Remark: the following variables are statically initialized.
+// So, they can be safely used by allocations performed by static initializers.
+static mutex                          g_alloc_tags_mutex;
+static atomic<unsigned>               g_num_alloc_tags(1);
+static char const *                   g_alloc_tag_names[LEAN_MAX_ALLOC_TAGS] = { "other" };
+static atomic<size_t>                 g_alloc_tag_live[LEAN_MAX_ALLOC_TAGS];
+static atomic<size_t>                 g_alloc_tag_peak[LEAN_MAX_ALLOC_TAGS];
+static atomic<size_t>                 g_alloc_tag_num_allocs[LEAN_MAX_ALLOC_TAGS];
+static atomic<size_t>                 g_alloc_tag_num_frees[LEAN_MAX_ALLOC_TAGS];
+static LEAN_THREAD_LOCAL unsigned     g_alloc_tag = 0;
+
+unsigned register_alloc_tag(char const * name) {
+    lock_guard<mutex> lock(g_alloc_tags_mutex);
+    unsigned num = g_num_alloc_tags;
+    for (unsigned i = 0; i < num; i++) {
+        if (strcmp(g_alloc_tag_names[i], name) == 0)
+            return i;
+    }
+    if (num == LEAN_MAX_ALLOC_TAGS)
+        return 0;
+    g_alloc_tag_names[num] = name;
+    g_num_alloc_tags       = num + 1;
+    return num;
+}
+
+bool has_alloc_profiler() { return true; }
+
+scoped_alloc_tag::scoped_alloc_tag(unsigned tag):m_old_tag(g_alloc_tag) { g_alloc_tag = tag; }
+scoped_alloc_tag::~scoped_alloc_tag() { g_alloc_tag = m_old_tag; }
+
+void get_alloc_profile(std::vector<alloc_tag_info> & r) {
+    unsigned num = g_num_alloc_tags;
+    for (unsigned i = 0; i < num; i++)
+        r.emplace_back(g_alloc_tag_names[i], g_alloc_tag_live[i], g_alloc_tag_peak[i],
+                       g_alloc_tag_num_allocs[i], g_alloc_tag_num_frees[i]);
+}
+
+static void profile_alloc(void * ptr, size_t sz) {
+    unsigned tag = g_alloc_tag;
+    get_alloc_header(ptr)->m_tag = tag;
+    size_t live = (g_alloc_tag_live[tag] += sz);
+    // Remark: the peak is only an approximation when there is contention.
+    if (live > g_alloc_tag_peak[tag])
+        g_alloc_tag_peak[tag] = live;
+    g_alloc_tag_num_allocs[tag]++;
+}
+
+static void profile_free(void * ptr, size_t sz) {
+    unsigned tag = get_alloc_header(ptr)->m_tag;
+    g_alloc_tag_live[tag] -= sz;
+    g_alloc_tag_num_frees[tag]++;
+}
+#else
+inline void profile_alloc(void *, size_t) {}
+inline void profile_free(void *, size_t) {}
+#endif
 
 void * malloc(size_t sz)  {
     void * r = malloc_core(sz);
@@ -126,6 +241,8 @@ void * malloc(size_t sz)  {
         size_t rsz = malloc_size(r);
         g_global_memory.inc(rsz);
         g_thread_memory.inc(rsz);
+        if (r)
+            profile_alloc(r, rsz);
         return r;
     } else {
         throw std::bad_alloc();
@@ -142,14 +259,17 @@ void * realloc(void * ptr, size_t sz) {
     size_t old_sz = malloc_size(ptr);
     g_global_memory.dec(old_sz);
     g_thread_memory.dec(old_sz);
+    profile_free(ptr, old_sz);
     void * r = realloc_core(ptr, sz);
     size_t new_sz = malloc_size(r);
     g_global_memory.inc(new_sz);
     g_thread_memory.inc(new_sz);
-    if (r || sz == 0)
+    if (r) {
+        profile_alloc(r, new_sz);
         return r;
-    else
+    } else {
         throw std::bad_alloc();
+    }
 }
 
 void free(void * ptr) {
@@ -157,6 +277,7 @@ void free(void * ptr) {
         size_t sz = malloc_size(ptr);
         g_global_memory.dec(sz);
         g_thread_memory.dec(sz);
+        profile_free(ptr, sz);
     }
     free_core(ptr);
 }
@@ -167,3 +288,42 @@ void  operator delete(void * ptr) throw() { return lean::free(ptr); }
 void* operator new[](std::size_t sz) throw(std::bad_alloc) { return lean::malloc(sz); }
 void  operator delete[](void * ptr) throw() { return lean::free(ptr); }
 #endif
+
+namespace lean {
+#if !defined(LEAN_ALLOC_PROFILER)
+unsigned register_alloc_tag(char const *) { return 0; }
+bool has_alloc_profiler() { return false; }
+void get_alloc_profile(std::vector<alloc_tag_info> &) {}
+#endif
+
+void display_alloc_profile(std::ostream & out) {
+    out << "allocated memory: " << get_allocated_memory() << " bytes, peak: " << get_peak_memory() << " bytes\n";
+    if (!has_alloc_profiler())
+        return;
+    std::vector<alloc_tag_info> tags;
+    get_alloc_profile(tags);
+    out << std::left << std::setw(20) << "tag" << std::right
+        << std::setw(16) << "live" << std::setw(16) << "peak"
+        << std::setw(14) << "#allocs" << std::setw(14) << "#frees" << "\n";
+    for (alloc_tag_info const & info : tags) {
+        out << std::left << std::setw(20) << info.m_name << std::right
+            << std::setw(16) << info.m_live << std::setw(16) << info.m_peak
+            << std::setw(14) << info.m_num_allocs << std::setw(14) << info.m_num_frees << "\n";
+    }
+}
+
+static bool g_display_alloc_profile_at_exit = false;
+static void display_alloc_profile_at_exit() {
+    if (g_display_alloc_profile_at_exit)
+        display_alloc_profile(std::cerr);
+}
+
+void set_display_alloc_profile_at_exit(bool flag) {
+    static bool registered = false;
+    if (!registered) {
+        registered = true;
+        std::atexit(display_alloc_profile_at_exit);
+    }
+    g_display_alloc_profile_at_exit = flag;
+}
+}
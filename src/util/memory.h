@@ -5,15 +5,64 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Author: Leonardo de Moura
 */
 #pragma once
+#include <cstddef>
+#include <iosfwd>
+#include <vector>
 
 namespace lean {
 size_t get_allocated_memory();
 long long get_thread_allocated_memory();
+/** \brief Return the maximum value of \c get_allocated_memory() so far. */
+size_t get_peak_memory();
+/** \brief Return the maximum value of \c get_thread_allocated_memory() for the current thread so far. */
+long long get_thread_peak_memory();
 void * malloc(size_t sz);
 void * realloc(void * ptr, size_t sz);
 void free(void * ptr);
-}
 
+/**
+   \brief Allocation tags are used by the allocation profiler to attribute memory
+   to subsystems (expressions, names, caches, Lua, ...). The allocation profiler is
+   only available when Lean is compiled with LEAN_ALLOC_PROFILER.
 
+   Return the tag associated with the given name. The same tag is returned
+   if the name was already registered. The tag 0 ("other") is used for untagged
+   allocations, and it is also returned when the profiler is not available, or
+   the maximum number of tags has been reached.
+*/
+unsigned register_alloc_tag(char const * name);
+/** \brief Return true iff Lean was compiled with the allocation profiler. */
+bool has_alloc_profiler();
 
+/** \brief Allocation statistics for an allocation tag. */
+struct alloc_tag_info {
+    char const * m_name;
+    size_t       m_live;       // number of bytes currently allocated
+    size_t       m_peak;       // maximum value of m_live
+    size_t       m_num_allocs;
+    size_t       m_num_frees;
+    alloc_tag_info(char const * n, size_t l, size_t p, size_t a, size_t f):
+        m_name(n), m_live(l), m_peak(p), m_num_allocs(a), m_num_frees(f) {}
+};
+/** \brief Store in \c r the allocation statistics of each registered tag. */
+void get_alloc_profile(std::vector<alloc_tag_info> & r);
+void display_alloc_profile(std::ostream & out);
+/** \brief When \c flag is true, the allocation profile is displayed in the standard error at exit. */
+void set_display_alloc_profile_at_exit(bool flag);
 
+#if defined(LEAN_ALLOC_PROFILER)
+/**
+   \brief Set the allocation tag of the current thread.
+   The previous tag is restored when this object is destructed.
+*/
+class scoped_alloc_tag {
+    unsigned m_old_tag;
+public:
+    scoped_alloc_tag(unsigned tag);
+    ~scoped_alloc_tag();
+};
+#define LEAN_ALLOC_TAG(T) ::lean::scoped_alloc_tag _alloc_tag_scope(T)
+#else
+#define LEAN_ALLOC_TAG(T)
+#endif
+}
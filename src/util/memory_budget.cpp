@@ -0,0 +1,81 @@
+/*
+Copyright (c) 2014 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#include <list>
+#include <functional>
+#include "util/thread.h"
+#include "util/exception.h"
+#include "util/memory.h"
+#include "util/memory_budget.h"
+
+namespace lean {
+static atomic<size_t> g_soft_memory_limit(0);
+static atomic<size_t> g_hard_memory_limit(0);
+/**
+   \brief Amount of allocated memory the last time the memory shedders were requested to release memory.
+   We use it to avoid requesting them in every \c check_memory when the amount of
+   allocated memory remains above the soft limit.
+*/
+static atomic<size_t> g_last_shed_memory(0);
+
+void set_soft_memory_limit(size_t sz) { g_soft_memory_limit = sz; }
+void set_hard_memory_limit(size_t sz) { g_hard_memory_limit = sz; }
+size_t get_soft_memory_limit() { return g_soft_memory_limit; }
+size_t get_hard_memory_limit() { return g_hard_memory_limit; }
+
+/** \brief Shedders registered by all threads. */
+class memory_shedder::registry {
+    mutex                      m_mutex;
+    std::list<memory_shedder*> m_shedders;
+public:
+    typedef std::list<memory_shedder*>::iterator iterator;
+
+    iterator add(memory_shedder * s) {
+        lock_guard<mutex> lock(m_mutex);
+        return m_shedders.insert(m_shedders.end(), s);
+    }
+
+    void remove(iterator it) {
+        lock_guard<mutex> lock(m_mutex);
+        m_shedders.erase(it);
+    }
+
+    void request() {
+        lock_guard<mutex> lock(m_mutex);
+        for (memory_shedder * s : m_shedders)
+            s->m_requested = true;
+    }
+
+    static registry & get() {
+        static registry g_registry;
+        return g_registry;
+    }
+};
+
+memory_shedder::memory_shedder(std::function<void()> const & fn):m_fn(fn), m_requested(false) {
+    m_it = registry::get().add(this);
+}
+memory_shedder::~memory_shedder() { registry::get().remove(m_it); }
+
+void check_memory(char const * component_name) {
+    size_t soft = g_soft_memory_limit;
+    size_t hard = g_hard_memory_limit;
+    if (soft == 0 && hard == 0)
+        return;
+    size_t mem = get_allocated_memory();
+    if (hard != 0 && mem > hard) {
+        // The owners will release their caches when they are used again.
+        memory_shedder::registry::get().request();
+        g_last_shed_memory = mem;
+        throw memory_exception(component_name);
+    } else if (soft != 0 && mem <= soft) {
+        g_last_shed_memory = 0;
+    } else if (soft != 0 && mem > g_last_shed_memory + soft / 16) {
+        memory_shedder::registry::get().request();
+        g_last_shed_memory = mem;
+    }
+}
+}
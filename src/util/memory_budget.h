@@ -0,0 +1,67 @@
+/*
+Copyright (c) 2014 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#pragma once
+#include <cstddef>
+#include <list>
+#include <functional>
+#include "util/thread.h"
+
+namespace lean {
+/**
+   \brief Set the soft memory limit (in bytes). When the amount of allocated memory
+   (see \c get_allocated_memory) exceeds this limit, \c check_memory requests the
+   registered memory shedders to release memory. The value 0 means "no limit".
+
+   \remark Memory limits are only enforced if Lean was compiled with LEAN_TRACK_MEMORY.
+*/
+void set_soft_memory_limit(size_t sz);
+/**
+   \brief Set the hard memory limit (in bytes). When the amount of allocated memory
+   exceeds this limit, \c check_memory throws a \c memory_exception.
+   The value 0 means "no limit".
+*/
+void set_hard_memory_limit(size_t sz);
+size_t get_soft_memory_limit();
+size_t get_hard_memory_limit();
+
+/**
+   \brief Memory shedders are used to release memory (e.g., clear caches) when the
+   soft memory limit is exceeded. A shedder is registered in the scope of this object.
+
+   \c check_memory does not execute the shedder function, it only sets a flag.
+   The owner of the shedder must invoke \c operator() at quiescent points (e.g., at the
+   top of its public entry points), and the function is executed there if the flag is set.
+   Thus, the function can safely reset data-structures that are not thread safe, even
+   if \c check_memory is invoked by a different thread or while the owner is busy.
+*/
+class memory_shedder {
+    class registry;
+    std::function<void()>                m_fn;
+    atomic<bool>                         m_requested; // set by check_memory
+    std::list<memory_shedder*>::iterator m_it;
+    friend void check_memory(char const * component_name);
+public:
+    memory_shedder(std::function<void()> const & fn);
+    ~memory_shedder();
+    /** \brief Execute the shedder function if \c check_memory requested it since the last call. */
+    void operator()() {
+        if (m_requested) {
+            m_requested = false;
+            m_fn();
+        }
+    }
+};
+
+/**
+   \brief Request the memory shedders to release memory if the soft (or hard) memory limit
+   was exceeded, and throw a \c memory_exception if the hard memory limit was exceeded.
+
+   \remark The optional argument \c component_name is used to inform the
+   user which module is the potential offender.
+*/
+void check_memory(char const * component_name);
+}
@@ -15,6 +15,7 @@ Author: Leonardo de Moura
 #include "util/debug.h"
 #include "util/rc.h"
 #include "util/buffer.h"
+#include "util/memory.h"
 #include "util/hash.h"
 #include "util/trace.h"
 #include "util/ascii.h"
@@ -89,11 +90,14 @@ name::name(imp * p) {
         m_ptr->inc_ref();
 }
 
+static unsigned g_name_alloc_tag = register_alloc_tag("name");
+
 name::name() {
     m_ptr = nullptr;
 }
 
 name::name(name const & prefix, char const * name) {
+    LEAN_ALLOC_TAG(g_name_alloc_tag);
     size_t sz  = strlen(name);
     lean_assert(sz < (1u << 31));
     char * mem = new char[sizeof(imp) + sz + 1];
@@ -107,6 +111,7 @@ name::name(name const & prefix, char const * name) {
 }
 
 name::name(name const & prefix, unsigned k, bool) {
+    LEAN_ALLOC_TAG(g_name_alloc_tag);
     m_ptr      = new imp(false, prefix.m_ptr);
     m_ptr->m_k = k;
     if (m_ptr->m_prefix)
@@ -521,11 +526,17 @@ static void name_migrate(lua_State * src, int i, lua_State * tgt) {
     push_name(tgt, to_name(src, i));
 }
 
+static lua_pusher name_export(lua_State * src, int i) {
+    name n = to_name(src, i);
+    return lua_pusher([=](lua_State * tgt) { push_name(tgt, n); });
+}
+
 DEFINE_LUA_LIST(name, push_name, to_name_ext)
 
 void open_name(lua_State * L) {
     luaL_newmetatable(L, name_mt);
     set_migrate_fn_field(L, -1, name_migrate);
+    set_export_fn_field(L, -1, name_export);
     lua_pushvalue(L, -1);
     lua_setfield(L, -2, "__index");
     setfuncs(L, name_m, 0);
@@ -28,6 +28,9 @@ void double_floor(double & v);
 
 void set_double_rnd(bool plus_inf);
 mpfr_rnd_t get_double_rnd();
+inline bool is_double_rnd_up() { return get_double_rnd() == MPFR_RNDU; }
+
+template<> class bound_arith<double> : public native_bound_arith<double, is_double_rnd_up> {};
 
 template<>
 class numeric_traits<double> {
@@ -28,6 +28,9 @@ void float_floor(float & v);
 
 void set_float_rnd(bool plus_inf);
 mpfr_rnd_t get_float_rnd();
+inline bool is_float_rnd_up() { return get_float_rnd() == MPFR_RNDU; }
+
+template<> class bound_arith<float> : public native_bound_arith<float, is_float_rnd_up> {};
 
 template<>
 class numeric_traits<float> {
@@ -11,11 +11,19 @@ Author: Soonho Kong
 #include "util/numerics/mpfp.h"
 
 namespace lean {
-static LEAN_THREAD_LOCAL mpfr_rnd_t g_mpfp_rnd = MPFR_RNDN;
+// 53 is the MPFR default precision
+static LEAN_THREAD_LOCAL mpfr_prec_t g_mpfp_prec = 53;
+static LEAN_THREAD_LOCAL mpfr_rnd_t  g_mpfp_rnd  = MPFR_RNDN;
 
-mpfp numeric_traits<mpfp>::pi_l;
-mpfp numeric_traits<mpfp>::pi_n;
-mpfp numeric_traits<mpfp>::pi_u;
+mpfp_context get_mpfp_context() {
+    return mpfp_context(g_mpfp_prec, g_mpfp_rnd);
+}
+
+void set_mpfp_context(mpfp_context const & c) {
+    lean_assert(c.m_prec > 0);
+    g_mpfp_prec = c.m_prec;
+    g_mpfp_rnd  = c.m_rnd;
+}
 
 void set_mpfp_rnd(bool plus_inf) {
     g_mpfp_rnd = plus_inf ? MPFR_RNDU : MPFR_RNDD;
@@ -25,6 +33,22 @@ mpfr_rnd_t get_mpfp_rnd() {
     return g_mpfp_rnd;
 }
 
+mpfr_prec_t get_mpfp_prec() {
+    return g_mpfp_prec;
+}
+
+scoped_mpfp_context::scoped_mpfp_context(mpfp_context const & c):m_old(get_mpfp_context()) {
+    set_mpfp_context(c);
+}
+
+scoped_mpfp_context::scoped_mpfp_context(mpfr_prec_t prec):m_old(get_mpfp_context()) {
+    set_mpfp_context(mpfp_context(prec, m_old.m_rnd));
+}
+
+scoped_mpfp_context::~scoped_mpfp_context() {
+    set_mpfp_context(m_old);
+}
+
 /**
     \brief Auxiliary class for invoking mpfr_free_cache before
     exiting and avoiding Valgrind memory leak warnings.
@@ -51,6 +75,53 @@ std::ostream & operator<<(std::ostream & out, mpfp const & v) {
     return out;
 }
 
+/**
+   \brief Constants used by the interval transcendental functions. Each thread has its own copy,
+   and it is only recomputed when the precision of the current context changes.
+*/
+struct mpfp_constants {
+    mpfr_prec_t m_prec;
+    mpfp m_pi_lower, m_pi, m_pi_upper;
+    mpfp m_pi_half_lower, m_pi_half, m_pi_half_upper;
+    mpfp m_pi_twice_lower, m_pi_twice, m_pi_twice_upper;
+    mpfp_constants():m_prec(0) {}
+    // release the MPFR caches (e.g., pi) of the current thread
+    ~mpfp_constants() { mpfr_free_cache(); }
+    void update() {
+        mpfr_prec_t prec = get_mpfp_prec();
+        if (m_prec == prec)
+            return;
+        m_prec = prec;
+        m_pi_lower = mpfp(prec); m_pi = mpfp(prec); m_pi_upper = mpfp(prec);
+        numeric_traits<mpfp>::set_pi(m_pi_lower, MPFR_RNDD);
+        numeric_traits<mpfp>::set_pi(m_pi,       MPFR_RNDN);
+        numeric_traits<mpfp>::set_pi(m_pi_upper, MPFR_RNDU);
+        // multiplication and division by 2 are exact
+        m_pi_half_lower  = m_pi_lower; m_pi_half_lower  /= 2lu;
+        m_pi_half        = m_pi;       m_pi_half        /= 2lu;
+        m_pi_half_upper  = m_pi_upper; m_pi_half_upper  /= 2lu;
+        m_pi_twice_lower = m_pi_lower; m_pi_twice_lower *= 2lu;
+        m_pi_twice       = m_pi;       m_pi_twice       *= 2lu;
+        m_pi_twice_upper = m_pi_upper; m_pi_twice_upper *= 2lu;
+    }
+};
+
+static mpfp_constants const & get_constants() {
+    static LEAN_THREAD_LOCAL mpfp_constants c;
+    c.update();
+    return c;
+}
+
+mpfp const & numeric_traits<mpfp>::pi_lower()       { return get_constants().m_pi_lower; }
+mpfp const & numeric_traits<mpfp>::pi()             { return get_constants().m_pi; }
+mpfp const & numeric_traits<mpfp>::pi_upper()       { return get_constants().m_pi_upper; }
+mpfp const & numeric_traits<mpfp>::pi_half_lower()  { return get_constants().m_pi_half_lower; }
+mpfp const & numeric_traits<mpfp>::pi_half()        { return get_constants().m_pi_half; }
+mpfp const & numeric_traits<mpfp>::pi_half_upper()  { return get_constants().m_pi_half_upper; }
+mpfp const & numeric_traits<mpfp>::pi_twice_lower() { return get_constants().m_pi_twice_lower; }
+mpfp const & numeric_traits<mpfp>::pi_twice()       { return get_constants().m_pi_twice; }
+mpfp const & numeric_traits<mpfp>::pi_twice_upper() { return get_constants().m_pi_twice_upper; }
+
 static mpfp g_zero(0.0);
 mpfp const & numeric_traits<mpfp>::zero() {
     lean_assert(is_zero(g_zero));
@@ -13,8 +13,40 @@ Author: Soonho Kong
 
 namespace lean {
 
+/**
+   \brief Precision and rounding mode used by the mpfp operations that do not take them
+   as arguments. Each thread has its own context, thus <tt>interval<mpfp></tt> computations
+   with different settings can be executed concurrently.
+
+   \remark The precision is used for creating mpfp objects with the default precision,
+   and for the constants (e.g., pi) used by the interval transcendental functions.
+*/
+struct mpfp_context {
+    mpfr_prec_t m_prec;
+    mpfr_rnd_t  m_rnd;
+    mpfp_context(mpfr_prec_t prec, mpfr_rnd_t rnd = MPFR_RNDN):m_prec(prec), m_rnd(rnd) {}
+};
+
+/** \brief Return the mpfp context of the current thread. */
+mpfp_context get_mpfp_context();
+/** \brief Set the mpfp context of the current thread, see \c scoped_mpfp_context. */
+void set_mpfp_context(mpfp_context const & c);
 void set_mpfp_rnd(bool plus_inf);
 mpfr_rnd_t get_mpfp_rnd();
+mpfr_prec_t get_mpfp_prec();
+
+/**
+   \brief Set the mpfp context of the current thread in the scope of this object.
+   The previous context is restored when the object is destroyed.
+*/
+class scoped_mpfp_context {
+    mpfp_context m_old;
+public:
+    scoped_mpfp_context(mpfp_context const & c);
+    /** \brief Only change the precision. */
+    explicit scoped_mpfp_context(mpfr_prec_t prec);
+    ~scoped_mpfp_context();
+};
 
 /**
    \brief Wrapper for MPFR
@@ -23,10 +55,9 @@ class mpfp {
     friend numeric_traits<mpfp>;
     mpfr_t m_val;
 
-    static mpz_t const & zval(mpz const & v) { return v.m_val; }
-    static mpz_t & zval(mpz & v) { return v.m_val; }
-    static mpq_t const & qval(mpq const & v) { return v.m_val; }
-    static mpq_t & qval(mpq & v) { return v.m_val; }
+    // read-only GMP views of mpz and mpq objects, they must only be used as temporary objects
+    typedef mpz::view zval;
+    typedef mpq::view qval;
 
 public:
     friend void swap(mpfp & a, mpfp & b) { mpfr_swap(a.m_val, b.m_val); }
@@ -60,19 +91,26 @@ public:
         mpfr_set_f(m_val, v, rnd); return *this;
     }
     mpfp & set(mpz   const & v, mpfr_rnd_t rnd = MPFR_RNDN) {
-        mpfr_set_z(m_val, v.m_val, rnd); return *this;
+        mpfr_set_z(m_val, zval(v), rnd); return *this;
     }
     mpfp & set(mpq   const & v, mpfr_rnd_t rnd = MPFR_RNDN) {
-        mpfr_set_q(m_val, v.m_val, rnd); return *this;
+        mpfr_set_q(m_val, qval(v), rnd); return *this;
     }
     mpfp & set(mpbq  const & v, mpfr_rnd_t rnd = MPFR_RNDN) {
-        mpfr_set_z(m_val, v.m_num.m_val, rnd);   // this = m_num
+        mpfr_set_z(m_val, zval(v.m_num), rnd);   // this = m_num
         mpfr_div_2ui(m_val, m_val, v.m_k, rnd);  // this = m_num / (2^k)
         return *this;
     }
 
     // Assignment operators
-    mpfp & operator=(mpfp const & v)            { return set(v); }
+    // Remark: mpfp objects are values, the assignment also copies the precision of \c v.
+    // Thus, it is exact, and the memory of \c m_val is only reallocated when the precisions are different.
+    mpfp & operator=(mpfp const & v) {
+        if (mpfr_get_prec(m_val) != mpfr_get_prec(v.m_val))
+            mpfr_set_prec(m_val, mpfr_get_prec(v.m_val));
+        return set(v);
+    }
+    mpfp & operator=(mpfp && v)                 { mpfr_swap(m_val, v.m_val); return *this; }
     mpfp & operator=(unsigned long int const v) { return set(v); }
     mpfp & operator=(long int const v)          { return set(v); }
     mpfp & operator=(float const v)             { return set(v); }
@@ -86,7 +124,7 @@ public:
     mpfp & operator=(mpbq  const & v)           { return set(v); }
 
     // Basic Constructors
-    mpfp() { mpfr_init(m_val); } // with default precision
+    mpfp() { mpfr_init2(m_val, get_mpfp_prec()); } // with the precision of the current context
     explicit mpfp(int prec)         { mpfr_init2(m_val, prec); }
     explicit mpfp(unsigned prec)    { mpfr_init2(m_val, prec); }
     explicit mpfp(mpfr_prec_t prec) { mpfr_init2(m_val, prec); }
@@ -128,7 +166,9 @@ public:
     mpfp(mpfp const & v     , mpfr_prec_t p, mpfr_rnd_t rnd):mpfp(p) { set(v, rnd); }
 
     mpfp(mpfp && s):mpfp(mpfr_get_prec(s.m_val)) { mpfr_swap(m_val, s.m_val); }
-    ~mpfp() { mpfr_clear(m_val); mpfr_free_cache(); }
+    ~mpfp() { mpfr_clear(m_val); }
+
+    mpfr_prec_t get_prec() const { return mpfr_get_prec(m_val); }
 
     unsigned hash() const { return static_cast<unsigned>(mpfr_get_si(m_val, MPFR_RNDN)); }
 
@@ -322,8 +362,8 @@ public:
     mpfp & add(double const o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_add_d(m_val, m_val, o, rnd); return *this; }
     mpfp & add(mpz_t const & o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_add_z(m_val, m_val, o, rnd); return *this; }
     mpfp & add(mpq_t const & o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_add_q(m_val, m_val, o, rnd); return *this; }
-    mpfp & add(mpz const & o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_add_z(m_val, m_val, o.m_val, rnd); return *this; }
-    mpfp & add(mpq const & o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_add_q(m_val, m_val, o.m_val, rnd); return *this; }
+    mpfp & add(mpz const & o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_add_z(m_val, m_val, zval(o), rnd); return *this; }
+    mpfp & add(mpq const & o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_add_q(m_val, m_val, qval(o), rnd); return *this; }
     mpfp & operator+=(mpfp const & o) { return add(o); }
     mpfp & operator+=(unsigned long int o) { return add(o); }
     mpfp & operator+=(long int const o) { return add(o); }
@@ -347,13 +387,13 @@ public:
     mpfp & sub(double const o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_sub_d(m_val, m_val, o, rnd); return *this; }
     mpfp & sub(mpz_t const & o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_sub_z(m_val, m_val, o, rnd); return *this; }
     mpfp & sub(mpq_t const & o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_sub_q(m_val, m_val, o, rnd); return *this; }
-    mpfp & sub(mpz const & o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_sub_z(m_val, m_val, o.m_val, rnd); return *this; }
-    mpfp & sub(mpq const & o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_sub_q(m_val, m_val, o.m_val, rnd); return *this; }
+    mpfp & sub(mpz const & o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_sub_z(m_val, m_val, zval(o), rnd); return *this; }
+    mpfp & sub(mpq const & o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_sub_q(m_val, m_val, qval(o), rnd); return *this; }
     mpfp & rsub(unsigned long int const o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_ui_sub(m_val, o, m_val, rnd); return *this; }
     mpfp & rsub(long int const o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_si_sub(m_val, o, m_val, rnd); return *this; }
     mpfp & rsub(double const o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_d_sub(m_val, o, m_val, rnd); return *this; }
     mpfp & rsub(mpz_t const & o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_z_sub(m_val, o, m_val, rnd); return *this; }
-    mpfp & rsub(mpz const & o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_z_sub(m_val, o.m_val, m_val, rnd); return *this; }
+    mpfp & rsub(mpz const & o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_z_sub(m_val, zval(o), m_val, rnd); return *this; }
     mpfp & operator-=(mpfp const & o) { return sub(o); }
     mpfp & operator-=(unsigned long int o) { return sub(o); }
     mpfp & operator-=(long int const o) { return sub(o); }
@@ -384,8 +424,8 @@ public:
     mpfp & mul(double const o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_mul_d(m_val, m_val, o, rnd); return *this; }
     mpfp & mul(mpz_t const & o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_mul_z(m_val, m_val, o, rnd); return *this; }
     mpfp & mul(mpq_t const & o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_mul_q(m_val, m_val, o, rnd); return *this; }
-    mpfp & mul(mpz const & o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_mul_z(m_val, m_val, o.m_val, rnd); return *this; }
-    mpfp & mul(mpq const & o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_mul_q(m_val, m_val, o.m_val, rnd); return *this; }
+    mpfp & mul(mpz const & o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_mul_z(m_val, m_val, zval(o), rnd); return *this; }
+    mpfp & mul(mpq const & o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_mul_q(m_val, m_val, qval(o), rnd); return *this; }
     mpfp & operator*=(mpfp const & o) { return mul(o); }
     mpfp & operator*=(unsigned long int o) { return mul(o); }
     mpfp & operator*=(long int const o) { return mul(o); }
@@ -409,8 +449,8 @@ public:
     mpfp & div(double const o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_div_d(m_val, m_val, o, rnd); return *this; }
     mpfp & div(mpz_t const & o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_div_z(m_val, m_val, o, rnd); return *this; }
     mpfp & div(mpq_t const & o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_div_q(m_val, m_val, o, rnd); return *this; }
-    mpfp & div(mpz const & o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_div_z(m_val, m_val, o.m_val, rnd); return *this; }
-    mpfp & div(mpq const & o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_div_q(m_val, m_val, o.m_val, rnd); return *this; }
+    mpfp & div(mpz const & o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_div_z(m_val, m_val, zval(o), rnd); return *this; }
+    mpfp & div(mpq const & o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_div_q(m_val, m_val, qval(o), rnd); return *this; }
     mpfp & rdiv(unsigned long int const o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_ui_div(m_val, o, m_val, rnd); return *this; }
     mpfp & rdiv(long int const o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_si_div(m_val, o, m_val, rnd); return *this; }
     mpfp & rdiv(double const o, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_d_div(m_val, o, m_val, rnd); return *this; }
@@ -479,7 +519,7 @@ public:
     void power(unsigned long int b, mpfr_rnd_t rnd = get_mpfp_rnd()) { mpfr_pow_ui(m_val, m_val, b, rnd); }
     void power(long int b, mpfr_rnd_t rnd = get_mpfp_rnd())          { mpfr_pow_si(m_val, m_val, b, rnd); }
     void power(mpz_t const & b, mpfr_rnd_t rnd = get_mpfp_rnd())     { mpfr_pow_z(m_val, m_val, b, rnd); }
-    void power(mpz const & b, mpfr_rnd_t rnd = get_mpfp_rnd())       { mpfr_pow_z(m_val, m_val, b.m_val, rnd); }
+    void power(mpz const & b, mpfr_rnd_t rnd = get_mpfp_rnd())       { mpfr_pow_z(m_val, m_val, zval(b), rnd); }
 
     friend mpfp pow(mpfp a, mpfp const & b, mpfr_rnd_t rnd = get_mpfp_rnd())      { a.power(b, rnd); return a; }
     friend mpfp pow(mpfp a, unsigned long int b, mpfr_rnd_t rnd = get_mpfp_rnd()) { a.power(b, rnd); return a; }
@@ -513,28 +553,18 @@ public:
     static void ceil(mpfp & v) { v.ceil(); }
     static void floor(mpfp & v) { v.floor(); }
 
-    // constants
-    static mpfp pi_l;
-    static mpfp pi_n;
-    static mpfp pi_u;
-    static inline mpfp pi_lower()       {
-        mpfr_const_pi(pi_l.m_val, MPFR_RNDD);
-        return pi_l;
-    }
-    static inline mpfp pi()             {
-        mpfr_const_pi(pi_n.m_val, MPFR_RNDN);
-        return pi_n;
-    }
-    static inline mpfp pi_upper()       {
-        mpfr_const_pi(pi_u.m_val, MPFR_RNDU);
-        return pi_u;
-    }
-    static inline mpfp pi_half_lower()  { return pi_lower() / 2lu; }
-    static inline mpfp pi_half()        { return pi() / 2lu; }
-    static inline mpfp pi_half_upper()  { return pi_upper() / 2lu; }
-    static inline mpfp pi_twice_lower() { return pi_lower() * 2lu; }
-    static inline mpfp pi_twice()       { return pi() * 2lu; }
-    static inline mpfp pi_twice_upper() { return pi_upper() * 2lu; }
+    // constants, they are computed using the precision of the current context,
+    // and cached per thread
+    static void set_pi(mpfp & v, mpfr_rnd_t rnd) { mpfr_const_pi(v.m_val, rnd); }
+    static mpfp const & pi_lower();
+    static mpfp const & pi();
+    static mpfp const & pi_upper();
+    static mpfp const & pi_half_lower();
+    static mpfp const & pi_half();
+    static mpfp const & pi_half_upper();
+    static mpfp const & pi_twice_lower();
+    static mpfp const & pi_twice();
+    static mpfp const & pi_twice_upper();
 
     // Transcendental functions
     static void exp(mpfp & v)   { LEAN_TRANS_MPFP_FUNC(exp,   v, rnd()); }
@@ -559,4 +589,14 @@ public:
     static void acosh(mpfp & v) { LEAN_TRANS_MPFP_FUNC(acosh, v, rnd()); }
     static void atanh(mpfp & v) { LEAN_TRANS_MPFP_FUNC(atanh, v, rnd()); }
 };
+
+/**
+   \brief The interval operations modify the rounding mode of the current thread,
+   the scope restores it on exit.
+*/
+template<>
+struct bound_arith<mpfp>::scope {
+    scoped_mpfp_context m_ctx;
+    scope():m_ctx(get_mpfp_context()) {}
+};
 }
@@ -8,6 +8,7 @@ Author: Leonardo de Moura
 #include "util/thread.h"
 #include "util/numerics/mpq.h"
 #include "util/numerics/mpbq.h"
+#include "util/numerics/gcd.h"
 
 namespace lean {
 
@@ -23,41 +24,372 @@ mpq & mpq::operator=(mpbq const & b) {
     return *this;
 }
 
+static bool fits_long(unsigned k) { return (static_cast<unsigned long>(k) >> (sizeof(long) * 8 - 1)) == 0; }
+static long labs_(long v) { return v < 0 ? -v : v; }
+static long lgcd(long a, long b) {
+    return static_cast<long>(gcd<unsigned long>(static_cast<unsigned long>(labs_(a)), static_cast<unsigned long>(labs_(b))));
+}
+
+void mpq::set_small(long n, long d) {
+    lean_assert(d != 0);
+    if (n == LONG_MIN || d == LONG_MIN) {
+        mpq_ptr t = big();
+        mpz_set_si(mpq_numref(t), n);
+        mpz_set_si(mpq_denref(t), d);
+        mpq_canonicalize(t);
+        normalize();
+        return;
+    }
+    if (d < 0) {
+        n = -n;
+        d = -d;
+    }
+    if (d != 1) {
+        long g = lgcd(n, d);
+        if (g != 1) {
+            n /= g;
+            d /= g;
+        }
+    }
+    set_reduced(n, d);
+}
+
+void swap_numerator(mpq & a, mpz & b) {
+    mpq_ptr t = a.big();
+    mpz_swap(mpq_numref(t), b.big());
+    mpq_canonicalize(t);
+    a.normalize();
+    b.normalize();
+}
+
+void swap_denominator(mpq & a, mpz & b) {
+    mpq_ptr t = a.big();
+    mpz_swap(mpq_denref(t), b.big());
+    mpq_canonicalize(t);
+    a.normalize();
+    b.normalize();
+}
+
+void mpq::inv() {
+    if (m_big || m_small.m_num == 0) {
+        // Remark: GMP reports the division by zero
+        mpq_inv(big(), m_val);
+        normalize();
+    } else if (m_small.m_num < 0) {
+        set_reduced(-m_small.m_den, -m_small.m_num);
+    } else {
+        set_reduced(m_small.m_den, m_small.m_num);
+    }
+}
+
+double mpq::get_double() const {
+    // Remark: mpq_get_d truncates, then we only use the native conversion when it is exact.
+    if (!m_big && m_small.m_den == 1 && labs_(m_small.m_num) <= (1l << 53))
+        return static_cast<double>(m_small.m_num);
+    return mpq_get_d(view(*this));
+}
+
+int cmp(mpq const & a, mpq const & b) {
+    if (both_small(a, b)) {
+        long n1 = a.m_small.m_num, n2 = b.m_small.m_num;
+        if (a.m_small.m_den == b.m_small.m_den ||
+            (checked_mul(n1, b.m_small.m_den, n1) && checked_mul(n2, a.m_small.m_den, n2)))
+            return (n1 > n2) - (n1 < n2);
+    }
+    return mpq_cmp(mpq::view(a), mpq::view(b));
+}
+
 int cmp(mpq const & a, mpz const & b) {
+    long t;
+    if (!a.m_big && !b.m_big && checked_mul(b.m_small, a.m_small.m_den, t))
+        return (a.m_small.m_num > t) - (a.m_small.m_num < t);
+    mpq::view va(a);
+    mpz::view vb(b);
     if (a.is_integer()) {
-        return mpz_cmp(mpq_numref(a.m_val), mpq::zval(b));
+        return mpz_cmp(mpq_numref(static_cast<mpq_srcptr>(va)), vb);
     } else {
         static LEAN_THREAD_LOCAL mpz tmp;
-        mpz_mul(mpq::zval(tmp), mpq_denref(a.m_val), mpq::zval(b));
-        return mpz_cmp(mpq_numref(a.m_val), mpq::zval(tmp));
+        mpz_mul(tmp.big(), mpq_denref(static_cast<mpq_srcptr>(va)), vb);
+        return mpz_cmp(mpq_numref(static_cast<mpq_srcptr>(va)), tmp.m_val);
+    }
+}
+
+int cmp(mpq const & a, unsigned b) {
+    long t;
+    if (!a.m_big && fits_long(b) && checked_mul(static_cast<long>(b), a.m_small.m_den, t))
+        return (a.m_small.m_num > t) - (a.m_small.m_num < t);
+    return mpq_cmp_ui(static_cast<mpq_srcptr>(mpq::view(a)), b, 1);
+}
+
+int cmp(mpq const & a, int b) {
+    long t;
+    if (!a.m_big && checked_mul(b, a.m_small.m_den, t))
+        return (a.m_small.m_num > t) - (a.m_small.m_num < t);
+    return mpq_cmp_si(static_cast<mpq_srcptr>(mpq::view(a)), b, 1);
+}
+
+mpq & mpq::operator+=(mpq const & o) {
+    if (both_small(*this, o)) {
+        long n1 = m_small.m_num, d1 = m_small.m_den;
+        long n2 = o.m_small.m_num, d2 = o.m_small.m_den;
+        long n, d;
+        if (d1 == d2) {
+            if (checked_add(n1, n2, n)) {
+                set_small(n, d1);
+                return *this;
+            }
+        } else if (checked_mul(n1, d2, n1) && checked_mul(n2, d1, n2) && checked_add(n1, n2, n) && checked_mul(d1, d2, d)) {
+            set_small(n, d);
+            return *this;
+        }
+    }
+    mpq_ptr t = big();
+    mpq_add(t, t, view(o));
+    normalize();
+    return *this;
+}
+
+mpq & mpq::operator-=(mpq const & o) {
+    if (both_small(*this, o)) {
+        long n1 = m_small.m_num, d1 = m_small.m_den;
+        long n2 = o.m_small.m_num, d2 = o.m_small.m_den;
+        long n, d;
+        if (d1 == d2) {
+            if (checked_sub(n1, n2, n)) {
+                set_small(n, d1);
+                return *this;
+            }
+        } else if (checked_mul(n1, d2, n1) && checked_mul(n2, d1, n2) && checked_sub(n1, n2, n) && checked_mul(d1, d2, d)) {
+            set_small(n, d);
+            return *this;
+        }
     }
+    mpq_ptr t = big();
+    mpq_sub(t, t, view(o));
+    normalize();
+    return *this;
+}
+
+mpq & mpq::operator+=(mpz const & o) {
+    long n;
+    // Remark: gcd(n + o*d, d) == gcd(n, d) == 1
+    if (!m_big && !o.m_big && checked_mul(o.m_small, m_small.m_den, n) && checked_add(m_small.m_num, n, n)) {
+        set_reduced(n, m_small.m_den);
+    } else {
+        mpq_ptr t = big();
+        mpz_addmul(mpq_numref(t), mpq_denref(t), mpz::view(o));
+        mpq_canonicalize(t);
+        normalize();
+    }
+    return *this;
+}
+
+mpq & mpq::operator-=(mpz const & o) {
+    long n;
+    if (!m_big && !o.m_big && checked_mul(o.m_small, m_small.m_den, n) && checked_sub(m_small.m_num, n, n)) {
+        set_reduced(n, m_small.m_den);
+    } else {
+        mpq_ptr t = big();
+        mpz_submul(mpq_numref(t), mpq_denref(t), mpz::view(o));
+        mpq_canonicalize(t);
+        normalize();
+    }
+    return *this;
+}
+
+mpq & mpq::operator+=(unsigned int k) {
+    long n;
+    if (!m_big && fits_long(k) && checked_mul(static_cast<long>(k), m_small.m_den, n) && checked_add(m_small.m_num, n, n)) {
+        set_reduced(n, m_small.m_den);
+    } else {
+        mpq_ptr t = big();
+        mpz_addmul_ui(mpq_numref(t), mpq_denref(t), k);
+        mpq_canonicalize(t);
+        normalize();
+    }
+    return *this;
+}
+
+mpq & mpq::operator-=(unsigned int k) {
+    long n;
+    if (!m_big && fits_long(k) && checked_mul(static_cast<long>(k), m_small.m_den, n) && checked_sub(m_small.m_num, n, n)) {
+        set_reduced(n, m_small.m_den);
+    } else {
+        mpq_ptr t = big();
+        mpz_submul_ui(mpq_numref(t), mpq_denref(t), k);
+        mpq_canonicalize(t);
+        normalize();
+    }
+    return *this;
+}
+
+/** \brief Store (n1/d1)*(n2/d2) in r, the arguments must be canonical. Return false if there is an overflow. */
+static bool mul_small(long n1, long d1, long n2, long d2, long & n, long & d) {
+    // cancel the common factors first, then the result is canonical
+    long g1 = lgcd(n1, d2);
+    long g2 = lgcd(n2, d1);
+    if (g1 > 1) { n1 /= g1; d2 /= g1; }
+    if (g2 > 1) { n2 /= g2; d1 /= g2; }
+    return checked_mul(n1, n2, n) && checked_mul(d1, d2, d);
+}
+
+mpq & mpq::operator*=(mpq const & o) {
+    long n, d;
+    if (both_small(*this, o) && mul_small(m_small.m_num, m_small.m_den, o.m_small.m_num, o.m_small.m_den, n, d)) {
+        set_reduced(n, d);
+    } else {
+        mpq_ptr t = big();
+        mpq_mul(t, t, view(o));
+        normalize();
+    }
+    return *this;
+}
+
+mpq & mpq::operator/=(mpq const & o) {
+    long n, d;
+    if (both_small(*this, o) && o.m_small.m_num != 0) {
+        long n2 = o.m_small.m_den, d2 = o.m_small.m_num;
+        if (d2 < 0) { n2 = -n2; d2 = -d2; }
+        if (mul_small(m_small.m_num, m_small.m_den, n2, d2, n, d)) {
+            set_reduced(n, d);
+            return *this;
+        }
+    }
+    mpq_ptr t = big();
+    mpq_div(t, t, view(o));
+    normalize();
+    return *this;
+}
+
+mpq & mpq::operator*=(mpz const & o) {
+    long n, d;
+    if (!m_big && !o.m_big && mul_small(m_small.m_num, m_small.m_den, o.m_small, 1, n, d)) {
+        set_reduced(n, d);
+    } else {
+        mpq_ptr t = big();
+        mpz_mul(mpq_numref(t), mpq_numref(t), mpz::view(o));
+        mpq_canonicalize(t);
+        normalize();
+    }
+    return *this;
+}
+
+mpq & mpq::operator*=(unsigned int k) {
+    long n, d;
+    if (!m_big && fits_long(k) && mul_small(m_small.m_num, m_small.m_den, static_cast<long>(k), 1, n, d)) {
+        set_reduced(n, d);
+    } else {
+        mpq_ptr t = big();
+        mpz_mul_ui(mpq_numref(t), mpq_numref(t), k);
+        mpq_canonicalize(t);
+        normalize();
+    }
+    return *this;
+}
+
+mpq & mpq::operator*=(int k) {
+    long n, d;
+    if (!m_big && mul_small(m_small.m_num, m_small.m_den, k, 1, n, d)) {
+        set_reduced(n, d);
+    } else {
+        mpq_ptr t = big();
+        mpz_mul_si(mpq_numref(t), mpq_numref(t), k);
+        mpq_canonicalize(t);
+        normalize();
+    }
+    return *this;
+}
+
+mpq & mpq::operator/=(mpz const & o) {
+    long n, d;
+    if (!m_big && !o.m_big && o.m_small != 0 &&
+        mul_small(m_small.m_num, m_small.m_den, o.m_small < 0 ? -1 : 1, labs_(o.m_small), n, d)) {
+        set_reduced(n, d);
+    } else {
+        mpq_ptr t = big();
+        mpz_mul(mpq_denref(t), mpq_denref(t), mpz::view(o));
+        mpq_canonicalize(t);
+        normalize();
+    }
+    return *this;
+}
+
+mpq & mpq::operator/=(unsigned int k) {
+    long n, d;
+    if (!m_big && k != 0 && fits_long(k) && mul_small(m_small.m_num, m_small.m_den, 1, static_cast<long>(k), n, d)) {
+        set_reduced(n, d);
+    } else {
+        mpq_ptr t = big();
+        mpz_mul_ui(mpq_denref(t), mpq_denref(t), k);
+        mpq_canonicalize(t);
+        normalize();
+    }
+    return *this;
+}
+
+mpq & mpq::operator/=(int k) {
+    long n, d;
+    if (!m_big && k != 0 && mul_small(m_small.m_num, m_small.m_den, k < 0 ? -1 : 1, labs_(k), n, d)) {
+        set_reduced(n, d);
+    } else {
+        mpq_ptr t = big();
+        mpz_mul_si(mpq_denref(t), mpq_denref(t), k);
+        mpq_canonicalize(t);
+        normalize();
+    }
+    return *this;
+}
+
+/** \brief Return floor(n/d) (ceil(n/d) if \c up is true), \c d must be positive */
+static long div_small(long n, long d, bool up) {
+    long q = n / d;
+    if (n % d != 0) {
+        if (up && n > 0)
+            q++;
+        else if (!up && n < 0)
+            q--;
+    }
+    return q;
 }
 
 void mpq::floor() {
     if (is_integer())
         return;
+    if (!m_big) {
+        set_reduced(div_small(m_small.m_num, m_small.m_den, false), 1);
+        return;
+    }
     bool neg = is_neg();
     mpz_tdiv_q(mpq_numref(m_val), mpq_numref(m_val), mpq_denref(m_val));
     mpz_set_ui(mpq_denref(m_val), 1);
     if (neg)
         mpz_sub_ui(mpq_numref(m_val), mpq_numref(m_val), 1);
+    normalize();
 }
 
 void mpq::ceil() {
     if (is_integer())
         return;
+    if (!m_big) {
+        set_reduced(div_small(m_small.m_num, m_small.m_den, true), 1);
+        return;
+    }
     bool pos = is_pos();
     mpz_tdiv_q(mpq_numref(m_val), mpq_numref(m_val), mpq_denref(m_val));
     mpz_set_ui(mpq_denref(m_val), 1);
     if (pos)
         mpz_add_ui(mpq_numref(m_val), mpq_numref(m_val), 1);
+    normalize();
 }
 
 mpz floor(mpq const & a) {
     if (a.is_integer())
         return a.get_numerator();
+    if (!a.m_big)
+        return mpz(div_small(a.m_small.m_num, a.m_small.m_den, false));
     mpz r;
-    mpz_tdiv_q(mpq::zval(r), mpq_numref(a.m_val), mpq_denref(a.m_val));
+    mpz_tdiv_q(r.big(), mpq_numref(a.m_val), mpq_denref(a.m_val));
+    r.normalize();
     if (a.is_neg())
         --r;
     return r;
@@ -66,23 +398,39 @@ mpz floor(mpq const & a) {
 mpz ceil(mpq const & a) {
     if (a.is_integer())
         return a.get_numerator();
+    if (!a.m_big)
+        return mpz(div_small(a.m_small.m_num, a.m_small.m_den, true));
     mpz r;
-    mpz_tdiv_q(mpq::zval(r), mpq_numref(a.m_val), mpq_denref(a.m_val));
+    mpz_tdiv_q(r.big(), mpq_numref(a.m_val), mpq_denref(a.m_val));
+    r.normalize();
     if (a.is_pos())
         ++r;
     return r;
 }
 
 void power(mpq & a, mpq const & b, unsigned k) {
-    mpz_pow_ui(mpq_numref(a.m_val), mpq_numref(b.m_val), k);
-    mpz_pow_ui(mpq_denref(a.m_val), mpq_denref(b.m_val), k);
-    mpq_canonicalize(a.m_val);
+    long n, d;
+    // Remark: the powers of coprime numbers are coprime
+    if (!b.m_big && checked_power(b.m_small.m_num, k, n) && checked_power(b.m_small.m_den, k, d)) {
+        a.set_reduced(n, d);
+        return;
+    }
+    mpq::view vb(b);
+    mpq_ptr t = a.big();
+    mpz_pow_ui(mpq_numref(t), mpq_numref(static_cast<mpq_srcptr>(vb)), k);
+    mpz_pow_ui(mpq_denref(t), mpq_denref(static_cast<mpq_srcptr>(vb)), k);
+    mpq_canonicalize(t);
+    a.normalize();
 }
 
 extern void display(std::ostream & out, __mpz_struct const * v);
 
 std::ostream & operator<<(std::ostream & out, mpq const & v) {
-    if (v.is_integer()) {
+    if (!v.m_big) {
+        out << v.m_small.m_num;
+        if (v.m_small.m_den != 1)
+            out << "/" << v.m_small.m_den;
+    } else if (v.is_integer()) {
         display(out, mpq_numref(v.m_val));
     } else {
         display(out, mpq_numref(v.m_val));
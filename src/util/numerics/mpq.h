@@ -5,6 +5,8 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Author: Leonardo de Moura
 */
 #pragma once
+#include <climits>
+#include <algorithm>
 #include "util/lua.h"
 #include "util/numerics/mpz.h"
 
@@ -12,42 +14,133 @@ namespace lean {
 class mpbq;
 
 /**
-   \brief Wrapper for GMP rationals
+   \brief Wrapper for GMP rationals.
+
+   Similarly to \c mpz, rationals whose numerator and denominator fit in a machine
+   word are stored inline, and GMP is only used when an operation overflows.
 */
 class mpq {
     friend class mpfp;
-    mpq_t m_val;
-    static mpz_t const & zval(mpz const & v) { return v.m_val; }
-    static mpz_t & zval(mpz & v) { return v.m_val; }
-public:
-    friend void swap(mpq & a, mpq & b) { mpq_swap(a.m_val, b.m_val); }
-    friend void swap_numerator(mpq & a, mpz & b) { mpz_swap(mpq_numref(a.m_val), zval(b)); mpq_canonicalize(a.m_val); }
-    friend void swap_denominator(mpq & a, mpz & b) { mpz_swap(mpq_denref(a.m_val), zval(b)); mpq_canonicalize(a.m_val); }
+    struct small_val {
+        long m_num;
+        long m_den;
+    };
+    // When m_big is false, the value is m_small.m_num/m_small.m_den, where m_den > 0,
+    // gcd(m_num, m_den) == 1, and m_num != LONG_MIN. Otherwise, m_val is the value.
+    bool m_big;
+    union {
+        small_val    m_small;
+        __mpq_struct m_val[1];
+    };
+
+    /** \brief Read-only GMP view of a mpq object, see \c mpz::view. */
+    class view {
+        mp_limb_t    m_limbs[2];
+        __mpq_struct m_tmp;
+        mpq_srcptr   m_ptr;
+    public:
+        view(mpq const & v) {
+            if (v.m_big) {
+                m_ptr = v.m_val;
+            } else {
+                long n = v.m_small.m_num;
+                m_limbs[0] = static_cast<mp_limb_t>(n < 0 ? -n : n);
+                m_limbs[1] = static_cast<mp_limb_t>(v.m_small.m_den);
+                mpz_roinit_n(mpq_numref(&m_tmp), m_limbs, n < 0 ? -1 : (n > 0 ? 1 : 0));
+                mpz_roinit_n(mpq_denref(&m_tmp), m_limbs + 1, 1);
+                m_ptr = &m_tmp;
+            }
+        }
+        view(view const &) = delete;
+        operator mpq_srcptr() const { return m_ptr; }
+    };
 
-    mpq & operator=(mpz const & v) { mpq_set_z(m_val, v.m_val); return *this; }
-    mpq & operator=(mpq const & v) { mpq_set(m_val, v.m_val); return *this; }
+    mpq_ptr big() {
+        if (!m_big) {
+            small_val v = m_small;
+            mpz_init_set_si(mpq_numref(m_val), v.m_num);
+            mpz_init_set_si(mpq_denref(m_val), v.m_den);
+            m_big = true;
+        }
+        return m_val;
+    }
+    void normalize() {
+        if (m_big && mpz_fits_slong_p(mpq_numref(m_val)) && mpz_fits_slong_p(mpq_denref(m_val))) {
+            long n = mpz_get_si(mpq_numref(m_val));
+            if (n != LONG_MIN) {
+                long d = mpz_get_si(mpq_denref(m_val));
+                mpq_clear(m_val);
+                m_big = false;
+                m_small.m_num = n;
+                m_small.m_den = d;
+            }
+        }
+    }
+    /** \brief Store n/d, \c d must be positive, and \c n and \c d must be coprime. */
+    void set_reduced(long n, long d) {
+        lean_assert(d > 0);
+        if (n == LONG_MIN) {
+            mpq_ptr t = big();
+            mpz_set_si(mpq_numref(t), n);
+            mpz_set_si(mpq_denref(t), d);
+        } else {
+            if (m_big)
+                mpq_clear(m_val);
+            m_big = false;
+            m_small.m_num = n;
+            m_small.m_den = d;
+        }
+    }
+    /** \brief Store n/d, \c d must not be zero. */
+    void set_small(long n, long d);
+    friend bool both_small(mpq const & a, mpq const & b) { return !a.m_big && !b.m_big; }
+public:
+    friend void swap(mpq & a, mpq & b) {
+        std::swap(a.m_big, b.m_big);
+        std::swap(a.m_val[0], b.m_val[0]);
+    }
+    friend void swap_numerator(mpq & a, mpz & b);
+    friend void swap_denominator(mpq & a, mpz & b);
+
+    mpq & operator=(mpz const & v) {
+        if (v.m_big) mpq_set_z(big(), v.m_val); else set_reduced(v.m_small, 1);
+        return *this;
+    }
+    mpq & operator=(mpq const & v) {
+        if (v.m_big) mpq_set(big(), v.m_val); else set_reduced(v.m_small.m_num, v.m_small.m_den);
+        return *this;
+    }
     mpq & operator=(mpq && v) { swap(*this, v); return *this; }
     mpq & operator=(mpbq const & b);
-    mpq & operator=(char const * v) { mpq_set_str(m_val, v, 10); return *this; }
-    mpq & operator=(unsigned long int v) { mpq_set_ui(m_val, v, 1u); return *this; }
-    mpq & operator=(long int v) { mpq_set_si(m_val, v, 1); return *this; }
+    mpq & operator=(char const * v) { mpq_ptr t = big(); mpq_set_str(t, v, 10); mpq_canonicalize(t); normalize(); return *this; }
+    mpq & operator=(unsigned long int v) {
+        if (v <= static_cast<unsigned long int>(LONG_MAX)) set_reduced(static_cast<long int>(v), 1); else mpq_set_ui(big(), v, 1u);
+        return *this;
+    }
+    mpq & operator=(long int v) { set_reduced(v, 1); return *this; }
     mpq & operator=(unsigned int v) { return operator=(static_cast<unsigned long int>(v)); }
     mpq & operator=(int v) { return operator=(static_cast<long int>(v)); }
-    mpq & operator=(double v) { mpq_set_d(m_val, v); return *this; }
+    mpq & operator=(double v) { mpq_set_d(big(), v); normalize(); return *this; }
 
-    mpq() { mpq_init(m_val); }
+    mpq():m_big(false) { m_small.m_num = 0; m_small.m_den = 1; }
     mpq(mpq const & v):mpq() { operator=(v); }
-    mpq(mpq && s):mpq() { mpq_swap(m_val, s.m_val); }
+    mpq(mpq && s):mpq() { swap(*this, s); }
     template<typename T> explicit mpq(T const & v):mpq() { operator=(v); }
-    mpq(unsigned long int n, unsigned long int d):mpq() { mpq_set_ui(m_val, n, d); mpq_canonicalize(m_val); }
-    mpq(long int n, long int d):mpq() { mpq_set_si(m_val, n, d); mpq_canonicalize(m_val); }
-    mpq(unsigned int n, unsigned int d):mpq() { mpq_set_ui(m_val, n, d); mpq_canonicalize(m_val); }
-    mpq(int n, int d):mpq() { mpq_set_si(m_val, n, d); mpq_canonicalize(m_val); }
-    ~mpq() { mpq_clear(m_val); }
-
-    unsigned hash() const { return static_cast<unsigned>(mpz_get_si(mpq_numref(m_val))); }
-
-    int sgn() const { return mpq_sgn(m_val); }
+    mpq(unsigned long int n, unsigned long int d):mpq() {
+        if (n <= static_cast<unsigned long int>(LONG_MAX) && d <= static_cast<unsigned long int>(LONG_MAX)) {
+            set_small(static_cast<long int>(n), static_cast<long int>(d));
+        } else {
+            mpq_set_ui(big(), n, d); mpq_canonicalize(m_val); normalize();
+        }
+    }
+    mpq(long int n, long int d):mpq() { set_small(n, d); }
+    mpq(unsigned int n, unsigned int d):mpq(static_cast<unsigned long int>(n), static_cast<unsigned long int>(d)) {}
+    mpq(int n, int d):mpq() { set_small(n, d); }
+    ~mpq() { if (m_big) mpq_clear(m_val); }
+
+    unsigned hash() const { return static_cast<unsigned>(m_big ? mpz_get_si(mpq_numref(m_val)) : m_small.m_num); }
+
+    int sgn() const { return m_big ? mpq_sgn(m_val) : (m_small.m_num > 0) - (m_small.m_num < 0); }
     friend int sgn(mpq const & a) { return a.sgn(); }
     bool is_pos() const { return sgn() > 0; }
     bool is_neg() const { return sgn() < 0; }
@@ -55,23 +148,23 @@ public:
     bool is_nonpos() const { return !is_pos(); }
     bool is_nonneg() const { return !is_neg(); }
 
-    void neg() { mpq_neg(m_val, m_val); }
+    void neg() { if (m_big) mpq_neg(m_val, m_val); else m_small.m_num = -m_small.m_num; }
     friend mpq neg(mpq a) { a.neg(); return a; }
 
-    void abs() { mpq_abs(m_val, m_val); }
+    void abs() { if (m_big) mpq_abs(m_val, m_val); else if (m_small.m_num < 0) m_small.m_num = -m_small.m_num; }
     friend mpq abs(mpq a) { a.abs(); return a; }
 
-    void inv() { mpq_inv(m_val, m_val); }
+    void inv();
     friend mpq inv(mpq a) { a.inv(); return a; }
 
-    double get_double() const { return mpq_get_d(m_val); }
+    double get_double() const;
 
-    bool is_integer() const { return mpz_cmp_ui(mpq_denref(m_val), 1u) == 0; }
+    bool is_integer() const { return m_big ? mpz_cmp_ui(mpq_denref(m_val), 1u) == 0 : m_small.m_den == 1; }
 
-    friend int cmp(mpq const & a, mpq const & b) { return mpq_cmp(a.m_val, b.m_val); }
+    friend int cmp(mpq const & a, mpq const & b);
     friend int cmp(mpq const & a, mpz const & b);
-    friend int cmp(mpq const & a, unsigned b) { return mpq_cmp_ui(a.m_val, b, 1); }
-    friend int cmp(mpq const & a, int b) { return mpq_cmp_si(a.m_val, b, 1); }
+    friend int cmp(mpq const & a, unsigned b);
+    friend int cmp(mpq const & a, int b);
     friend int cmp(mpq const & a, double b) { return a.get_double() - b; }
 
     friend bool operator<(mpq const & a, mpq const & b) { return cmp(a, b) < 0; }
@@ -114,10 +207,14 @@ public:
     friend bool operator>=(int a, mpq const & b) { return cmp(b, a) <= 0; }
     friend bool operator>=(double a, mpq const & b) { return cmp(b, a) <= 0; }
 
-    friend bool operator==(mpq const & a, mpq const & b) { return mpq_equal(a.m_val, b.m_val) != 0; }
-    friend bool operator==(mpq const & a, mpz const & b) { return a.is_integer() && mpz_cmp(mpq_numref(a.m_val), zval(b)) == 0; }
-    friend bool operator==(mpq const & a, unsigned int b) { return a.is_integer() && mpz_cmp_ui(mpq_numref(a.m_val), b) == 0; }
-    friend bool operator==(mpq const & a, int b) { return a.is_integer() && mpz_cmp_si(mpq_numref(a.m_val), b) == 0; }
+    friend bool operator==(mpq const & a, mpq const & b) {
+        if (both_small(a, b))
+            return a.m_small.m_num == b.m_small.m_num && a.m_small.m_den == b.m_small.m_den;
+        return mpq_equal(view(a), view(b)) != 0;
+    }
+    friend bool operator==(mpq const & a, mpz const & b) { return a.is_integer() && cmp(a, b) == 0; }
+    friend bool operator==(mpq const & a, unsigned int b) { return a.is_integer() && cmp(a, b) == 0; }
+    friend bool operator==(mpq const & a, int b) { return a.is_integer() && cmp(a, b) == 0; }
     friend bool operator==(mpz const & a, mpq const & b) { return operator==(b, a); }
     friend bool operator==(unsigned int a, mpq const & b) { return operator==(b, a); }
     friend bool operator==(int a, mpq const & b) { return operator==(b, a); }
@@ -130,25 +227,25 @@ public:
     friend bool operator!=(unsigned int a, mpq const & b) { return !operator==(a, b); }
     friend bool operator!=(int a, mpq const & b) { return !operator==(a, b); }
 
-    mpq & operator+=(mpq const & o) { mpq_add(m_val, m_val, o.m_val); return *this; }
-    mpq & operator+=(mpz const & o) { mpz_addmul(mpq_numref(m_val), mpq_denref(m_val), o.m_val); mpq_canonicalize(m_val); return *this; }
-    mpq & operator+=(unsigned int k) { mpz_addmul_ui(mpq_numref(m_val), mpq_denref(m_val), k); mpq_canonicalize(m_val); return *this; }
+    mpq & operator+=(mpq const & o);
+    mpq & operator+=(mpz const & o);
+    mpq & operator+=(unsigned int k);
     mpq & operator+=(int k) { if (k >= 0) return operator+=(static_cast<unsigned int>(k)); else return operator-=(static_cast<unsigned int>(-k)); }
 
-    mpq & operator-=(mpq const & o) { mpq_sub(m_val, m_val, o.m_val); return *this; }
-    mpq & operator-=(mpz const & o) { mpz_submul(mpq_numref(m_val), mpq_denref(m_val), o.m_val); mpq_canonicalize(m_val); return *this; }
-    mpq & operator-=(unsigned int k) { mpz_submul_ui(mpq_numref(m_val), mpq_denref(m_val), k); mpq_canonicalize(m_val); return *this; }
+    mpq & operator-=(mpq const & o);
+    mpq & operator-=(mpz const & o);
+    mpq & operator-=(unsigned int k);
     mpq & operator-=(int k) { if (k >= 0) return operator-=(static_cast<unsigned int>(k)); else return operator+=(static_cast<unsigned int>(-k)); }
 
-    mpq & operator*=(mpq const & o) { mpq_mul(m_val, m_val, o.m_val); return *this; }
-    mpq & operator*=(mpz const & o) { mpz_mul(mpq_numref(m_val), mpq_numref(m_val), o.m_val); mpq_canonicalize(m_val); return *this; }
-    mpq & operator*=(unsigned int k) { mpz_mul_ui(mpq_numref(m_val), mpq_numref(m_val), k); mpq_canonicalize(m_val); return *this; }
-    mpq & operator*=(int k) { mpz_mul_si(mpq_numref(m_val), mpq_numref(m_val), k); mpq_canonicalize(m_val); return *this; }
+    mpq & operator*=(mpq const & o);
+    mpq & operator*=(mpz const & o);
+    mpq & operator*=(unsigned int k);
+    mpq & operator*=(int k);
 
-    mpq & operator/=(mpq const & o) { mpq_div(m_val, m_val, o.m_val); return *this; }
-    mpq & operator/=(mpz const & o) { mpz_mul(mpq_denref(m_val), mpq_denref(m_val), o.m_val); mpq_canonicalize(m_val); return *this; }
-    mpq & operator/=(unsigned int k) { mpz_mul_ui(mpq_denref(m_val), mpq_denref(m_val), k); mpq_canonicalize(m_val); return *this; }
-    mpq & operator/=(int k) { mpz_mul_si(mpq_denref(m_val), mpq_denref(m_val), k); mpq_canonicalize(m_val); return *this; }
+    mpq & operator/=(mpq const & o);
+    mpq & operator/=(mpz const & o);
+    mpq & operator/=(unsigned int k);
+    mpq & operator/=(int k);
 
     friend mpq operator+(mpq a, mpq const & b) { return a += b; }
     friend mpq operator+(mpq a, mpz const & b) { return a += b; }
@@ -191,9 +288,13 @@ public:
     mpq operator-() const { mpq t = *this; t.neg(); return t; }
 
     // a <- numerator(b)
-    friend void numerator(mpz & a, mpq const & b) { mpz_set(zval(a), mpq_numref(b.m_val)); }
+    friend void numerator(mpz & a, mpq const & b) {
+        if (b.m_big) { mpz_set(a.big(), mpq_numref(b.m_val)); a.normalize(); } else { a.set_small(b.m_small.m_num); }
+    }
     // a <- denominator(b)
-    friend void denominator(mpz & a, mpq const & b) { mpz_set(zval(a), mpq_denref(b.m_val)); }
+    friend void denominator(mpz & a, mpq const & b) {
+        if (b.m_big) { mpz_set(a.big(), mpq_denref(b.m_val)); a.normalize(); } else { a.set_small(b.m_small.m_den); }
+    }
 
     mpz get_numerator() const { mpz r; numerator(r, *this); return r; }
     mpz get_denominator() const { mpz r; denominator(r, *this); return r; }
@@ -7,13 +7,25 @@ Author: Leonardo de Moura
 #include <memory>
 #include "util/sstream.h"
 #include "util/thread.h"
+#include "util/safe_arith.h"
 #include "util/numerics/mpz.h"
+#include "util/numerics/gcd.h"
 
 namespace lean {
 
+static unsigned log2(unsigned long v) {
+    lean_assert(v > 0);
+    unsigned r = 0;
+    while (v >>= 1)
+        r++;
+    return r;
+}
+
 unsigned mpz::log2() const {
     if (is_nonpos())
         return 0;
+    if (!m_big)
+        return ::lean::log2(static_cast<unsigned long>(m_small));
     unsigned r = mpz_sizeinbase(m_val, 2);
     lean_assert(r > 0);
     return r - 1;
@@ -22,19 +34,17 @@ unsigned mpz::log2() const {
 unsigned mpz::mlog2() const {
     if (is_nonneg())
         return 0;
-    mpz * _this = const_cast<mpz*>(this);
-    _this->neg();
-    lean_assert(is_pos());
+    if (!m_big)
+        return ::lean::log2(static_cast<unsigned long>(-m_small));
+    // Remark: mpz_sizeinbase ignores the sign
     unsigned r = mpz_sizeinbase(m_val, 2);
-    _this->neg();
-    lean_assert(is_neg());
     return r - 1;
 }
 
 bool mpz::is_power_of_two(unsigned & shift) const {
     if (is_nonpos())
         return false;
-    if (mpz_popcount(m_val) == 1) {
+    if (is_power_of_two()) {
         shift = log2();
         return true;
     } else {
@@ -55,10 +65,31 @@ mpz operator%(mpz const & a, mpz const & b) {
 
 bool root(mpz & root, mpz const & a, unsigned k) {
     static LEAN_THREAD_LOCAL mpz rem;
-    mpz_rootrem(root.m_val, rem.m_val, a.m_val, k);
+    rootrem(root, rem, a, k);
     return rem.is_zero();
 }
 
+void power(mpz & a, mpz const & b, unsigned k) {
+    long r;
+    if (!b.m_big && checked_power(b.m_small, k, r)) {
+        a.set_small(r);
+    } else {
+        mpz_pow_ui(a.big(), mpz::view(b), k);
+        a.normalize();
+    }
+}
+
+void gcd(mpz & g, mpz const & a, mpz const & b) {
+    if (both_small(a, b)) {
+        unsigned long x = static_cast<unsigned long>(a.m_small < 0 ? -a.m_small : a.m_small);
+        unsigned long y = static_cast<unsigned long>(b.m_small < 0 ? -b.m_small : b.m_small);
+        g.set_small(static_cast<long>(gcd<unsigned long>(x, y)));
+    } else {
+        mpz_gcd(g.big(), mpz::view(a), mpz::view(b));
+        g.normalize();
+    }
+}
+
 void display(std::ostream & out, __mpz_struct const * v) {
     size_t sz = mpz_sizeinbase(v, 10) + 2;
     if (sz < 1024) {
@@ -73,7 +104,10 @@ void display(std::ostream & out, __mpz_struct const * v) {
 }
 
 std::ostream & operator<<(std::ostream & out, mpz const & v) {
-    display(out, v.m_val);
+    if (v.m_big)
+        display(out, v.m_val);
+    else
+        out << v.m_small;
     return out;
 }
 
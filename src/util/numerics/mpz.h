@@ -6,39 +6,122 @@ Author: Leonardo de Moura
 */
 #pragma once
 #include <gmp.h>
+#include <climits>
+#include <algorithm>
 #include <iostream>
 #include "util/debug.h"
+#include "util/safe_arith.h"
 #include "util/lua.h"
 #include "util/serializer.h"
 #include "util/numerics/numeric_traits.h"
 
+#if __GNU_MP_VERSION < 6
+#error "GMP 6.0 or later is required, mpz_roinit_n is used to implement mpz::view"
+#endif
+
 namespace lean {
 class mpq;
 
 /**
-   \brief Wrapper for GMP integers
+   \brief Wrapper for GMP integers.
+
+   Values that fit in a machine word are stored inline, and GMP is only used
+   when an operation overflows. Thus, small numerals do not allocate memory.
 */
 class mpz {
     friend class mpq;
     friend class mpfp;
-    mpz_t m_val;
-    mpz(__mpz_struct const * v) { mpz_init_set(m_val, v); }
-public:
-    mpz() { mpz_init(m_val); }
-    explicit mpz(char const * v) { mpz_init_set_str(m_val, const_cast<char*>(v), 10); }
-    explicit mpz(unsigned long int v) { mpz_init_set_ui(m_val, v); }
-    explicit mpz(long int v) { mpz_init_set_si(m_val, v); }
-    explicit mpz(unsigned int v) { mpz_init_set_ui(m_val, v); }
-    explicit mpz(int v) { mpz_init_set_si(m_val, v); }
-    mpz(mpz const & s) { mpz_init_set(m_val, s.m_val); }
-    mpz(mpz && s):mpz() { mpz_swap(m_val, s.m_val); }
-    ~mpz() { mpz_clear(m_val); }
+    friend int cmp(mpq const & a, mpz const & b);
+    friend void swap_numerator(mpq & a, mpz & b);
+    friend void swap_denominator(mpq & a, mpz & b);
+    friend void numerator(mpz & a, mpq const & b);
+    friend void denominator(mpz & a, mpq const & b);
+    friend mpz floor(mpq const & a);
+    friend mpz ceil(mpq const & a);
+    // When m_big is false, the value is m_small, and m_val is not initialized.
+    // LONG_MIN is never stored in m_small, then neg and abs do not overflow.
+    bool m_big;
+    union {
+        long         m_small;
+        __mpz_struct m_val[1];
+    };
 
-    friend void swap(mpz & a, mpz & b) { mpz_swap(a.m_val, b.m_val); }
-
-    unsigned hash() const { return static_cast<unsigned>(mpz_get_si(m_val)); }
-
-    int sgn() const { return mpz_sgn(m_val); }
+    /**
+       \brief Read-only GMP view of a mpz object. It does not allocate memory for small values.
+       It must be used only as a temporary object (e.g., an argument for a GMP procedure).
+    */
+    class view {
+        mp_limb_t    m_limb;
+        __mpz_struct m_tmp;
+        mpz_srcptr   m_ptr;
+    public:
+        view(mpz const & v) {
+            if (v.m_big) {
+                m_ptr = v.m_val;
+            } else {
+                m_limb = static_cast<mp_limb_t>(v.m_small < 0 ? -v.m_small : v.m_small);
+                m_ptr  = mpz_roinit_n(&m_tmp, &m_limb, v.m_small < 0 ? -1 : (v.m_small > 0 ? 1 : 0));
+            }
+        }
+        view(view const &) = delete;
+        operator mpz_srcptr() const { return m_ptr; }
+    };
+
+    static bool is_small_value(long v) { return v != LONG_MIN; }
+    static bool fits_long(unsigned u) { return (static_cast<unsigned long>(u) >> (sizeof(long) * 8 - 1)) == 0; }
+    /** \brief Return the GMP representation, it converts small values. */
+    mpz_ptr big() {
+        if (!m_big) {
+            long v = m_small;
+            mpz_init_set_si(m_val, v);
+            m_big = true;
+        }
+        return m_val;
+    }
+    /** \brief Go back to the small representation if the value fits in a machine word. */
+    void normalize() {
+        if (m_big && mpz_fits_slong_p(m_val)) {
+            long v = mpz_get_si(m_val);
+            if (is_small_value(v)) {
+                mpz_clear(m_val);
+                m_big   = false;
+                m_small = v;
+            }
+        }
+    }
+    void set_small(long v) {
+        if (!is_small_value(v)) {
+            mpz_set_si(big(), v);
+        } else {
+            if (m_big)
+                mpz_clear(m_val);
+            m_big   = false;
+            m_small = v;
+        }
+    }
+    friend bool both_small(mpz const & a, mpz const & b) { return !a.m_big && !b.m_big; }
+
+    mpz(__mpz_struct const * v):m_big(true) { mpz_init_set(m_val, v); normalize(); }
+public:
+    mpz():m_big(false), m_small(0) {}
+    explicit mpz(char const * v):m_big(true) { mpz_init_set_str(m_val, const_cast<char*>(v), 10); normalize(); }
+    explicit mpz(unsigned long int v):m_big(false), m_small(0) { operator=(v); }
+    explicit mpz(long int v):m_big(false), m_small(0) { set_small(v); }
+    explicit mpz(unsigned int v):m_big(false), m_small(0) { operator=(v); }
+    explicit mpz(int v):m_big(false), m_small(0) { set_small(v); }
+    mpz(mpz const & s):m_big(s.m_big) { if (m_big) mpz_init_set(m_val, s.m_val); else m_small = s.m_small; }
+    mpz(mpz && s):mpz() { swap(*this, s); }
+    ~mpz() { if (m_big) mpz_clear(m_val); }
+
+    friend void swap(mpz & a, mpz & b) {
+        // Remark: GMP integers can be moved, mpz_swap also just swaps the fields.
+        std::swap(a.m_big, b.m_big);
+        std::swap(a.m_val[0], b.m_val[0]);
+    }
+
+    unsigned hash() const { return static_cast<unsigned>(m_big ? mpz_get_si(m_val) : m_small); }
+
+    int sgn() const { return m_big ? mpz_sgn(m_val) : (m_small > 0) - (m_small < 0); }
     friend int sgn(mpz const & a) { return a.sgn(); }
     bool is_pos() const { return sgn() > 0; }
     bool is_neg() const { return sgn() < 0; }
@@ -46,36 +129,66 @@ public:
     bool is_nonpos() const { return !is_pos(); }
     bool is_nonneg() const { return !is_neg(); }
 
-    void neg() { mpz_neg(m_val, m_val); }
+    void neg() { if (m_big) mpz_neg(m_val, m_val); else m_small = -m_small; }
     friend mpz neg(mpz a) { a.neg(); return a; }
 
-    void abs() { mpz_abs(m_val, m_val); }
+    void abs() { if (m_big) mpz_abs(m_val, m_val); else if (m_small < 0) m_small = -m_small; }
     friend mpz abs(mpz a) { a.abs(); return a; }
 
-    bool even() const { return mpz_even_p(m_val) != 0; }
+    bool even() const { return m_big ? mpz_even_p(m_val) != 0 : (m_small & 1) == 0; }
     bool odd() const { return !even(); }
 
-    bool is_int() const { return mpz_fits_sint_p(m_val) != 0; }
-    bool is_unsigned_int() const { return mpz_fits_uint_p(m_val) != 0; }
-    bool is_long_int() const { return mpz_fits_slong_p(m_val) != 0; }
-    bool is_unsigned_long_int() const { return mpz_fits_ulong_p(m_val) != 0; }
+    bool is_int() const { return m_big ? mpz_fits_sint_p(m_val) != 0 : INT_MIN <= m_small && m_small <= INT_MAX; }
+    bool is_unsigned_int() const { return m_big ? mpz_fits_uint_p(m_val) != 0 : 0 <= m_small && static_cast<unsigned long>(m_small) <= UINT_MAX; }
+    bool is_long_int() const { return m_big ? mpz_fits_slong_p(m_val) != 0 : true; }
+    bool is_unsigned_long_int() const { return m_big ? mpz_fits_ulong_p(m_val) != 0 : m_small >= 0; }
 
-    long int get_long_int() const { lean_assert(is_long_int()); return mpz_get_si(m_val); }
+    long int get_long_int() const { lean_assert(is_long_int()); return m_big ? mpz_get_si(m_val) : m_small; }
     int get_int() const { lean_assert(is_int()); return static_cast<int>(get_long_int()); }
-    unsigned long int get_unsigned_long_int() const { lean_assert(is_unsigned_long_int()); return mpz_get_ui(m_val); }
+    unsigned long int get_unsigned_long_int() const {
+        lean_assert(is_unsigned_long_int());
+        return m_big ? mpz_get_ui(m_val) : static_cast<unsigned long int>(m_small);
+    }
     unsigned int get_unsigned_int() const { lean_assert(is_unsigned_int()); return static_cast<unsigned>(get_unsigned_long_int()); }
 
-    mpz & operator=(mpz const & v) { mpz_set(m_val, v.m_val); return *this; }
+    mpz & operator=(mpz const & v) {
+        if (v.m_big)
+            mpz_set(big(), v.m_val);
+        else
+            set_small(v.m_small);
+        return *this;
+    }
     mpz & operator=(mpz && v) { swap(*this, v); return *this; }
-    mpz & operator=(char const * v) { mpz_set_str(m_val, v, 10); return *this; }
-    mpz & operator=(unsigned long int v) { mpz_set_ui(m_val, v); return *this; }
-    mpz & operator=(long int v) { mpz_set_si(m_val, v); return *this; }
+    mpz & operator=(char const * v) { mpz_set_str(big(), v, 10); normalize(); return *this; }
+    mpz & operator=(unsigned long int v) {
+        if (v <= static_cast<unsigned long int>(LONG_MAX))
+            set_small(static_cast<long int>(v));
+        else
+            mpz_set_ui(big(), v);
+        return *this;
+    }
+    mpz & operator=(long int v) { set_small(v); return *this; }
     mpz & operator=(unsigned int v) { return operator=(static_cast<unsigned long int>(v)); }
     mpz & operator=(int v) { return operator=(static_cast<long int>(v)); }
 
-    friend int cmp(mpz const & a, mpz const & b) { return mpz_cmp(a.m_val, b.m_val); }
-    friend int cmp(mpz const & a, unsigned b) { return mpz_cmp_ui(a.m_val, b); }
-    friend int cmp(mpz const & a, int b) { return mpz_cmp_si(a.m_val, b); }
+    friend int cmp(mpz const & a, mpz const & b) {
+        if (both_small(a, b))
+            return (a.m_small > b.m_small) - (a.m_small < b.m_small);
+        return mpz_cmp(view(a), view(b));
+    }
+    friend int cmp(mpz const & a, unsigned b) {
+        if (a.m_big)
+            return mpz_cmp_ui(a.m_val, b);
+        if (a.m_small < 0)
+            return -1;
+        unsigned long v = static_cast<unsigned long>(a.m_small);
+        return (v > b) - (v < b);
+    }
+    friend int cmp(mpz const & a, int b) {
+        if (a.m_big)
+            return mpz_cmp_si(a.m_val, b);
+        return (a.m_small > b) - (a.m_small < b);
+    }
 
     friend bool operator<(mpz const & a, mpz const & b) { return cmp(a, b) < 0; }
     friend bool operator<(mpz const & a, unsigned b) { return cmp(a, b) < 0; }
@@ -113,23 +226,71 @@ public:
     friend bool operator!=(unsigned a, mpz const & b) { return cmp(b, a) != 0; }
     friend bool operator!=(int a, mpz const & b) { return cmp(b, a) != 0; }
 
-    mpz & operator+=(mpz const & o) { mpz_add(m_val, m_val, o.m_val); return *this; }
-    mpz & operator+=(unsigned u) { mpz_add_ui(m_val, m_val, u); return *this; }
-    mpz & operator+=(int u) { if (u >= 0) mpz_add_ui(m_val, m_val, u); else mpz_sub_ui(m_val, m_val, -u); return *this; }
-
-    mpz & operator-=(mpz const & o) { mpz_sub(m_val, m_val, o.m_val); return *this; }
-    mpz & operator-=(unsigned u) { mpz_sub_ui(m_val, m_val, u); return *this; }
-    mpz & operator-=(int u) { if (u >= 0) mpz_sub_ui(m_val, m_val, u); else mpz_add_ui(m_val, m_val, -u); return *this; }
-
-    mpz & operator*=(mpz const & o) { mpz_mul(m_val, m_val, o.m_val); return *this; }
-    mpz & operator*=(unsigned u) { mpz_mul_ui(m_val, m_val, u); return *this; }
-    mpz & operator*=(int u) { mpz_mul_si(m_val, m_val, u); return *this; }
-
-    mpz & operator/=(mpz const & o) { mpz_tdiv_q(m_val, m_val, o.m_val); return *this; }
-    mpz & operator/=(unsigned u) { mpz_tdiv_q_ui(m_val, m_val, u); return *this; }
-
-    friend mpz rem(mpz const & a, mpz const & b) { mpz r; mpz_tdiv_r(r.m_val, a.m_val, b.m_val); return r; }
-    mpz & operator%=(mpz const & o) { mpz r(*this % o); mpz_swap(m_val, r.m_val); return *this; }
+    mpz & operator+=(mpz const & o) {
+        long r;
+        if (both_small(*this, o) && checked_add(m_small, o.m_small, r)) { set_small(r); return *this; }
+        mpz_ptr t = big(); mpz_add(t, t, view(o)); normalize(); return *this;
+    }
+    mpz & operator+=(unsigned u) {
+        long r;
+        if (!m_big && fits_long(u) && checked_add(m_small, static_cast<long>(u), r)) { set_small(r); return *this; }
+        mpz_add_ui(big(), m_val, u); normalize(); return *this;
+    }
+    mpz & operator+=(int u) {
+        long r;
+        if (!m_big && checked_add(m_small, u, r)) { set_small(r); return *this; }
+        if (u >= 0) mpz_add_ui(big(), m_val, u); else mpz_sub_ui(big(), m_val, -static_cast<long>(u));
+        normalize(); return *this;
+    }
+
+    mpz & operator-=(mpz const & o) {
+        long r;
+        if (both_small(*this, o) && checked_sub(m_small, o.m_small, r)) { set_small(r); return *this; }
+        mpz_ptr t = big(); mpz_sub(t, t, view(o)); normalize(); return *this;
+    }
+    mpz & operator-=(unsigned u) {
+        long r;
+        if (!m_big && fits_long(u) && checked_sub(m_small, static_cast<long>(u), r)) { set_small(r); return *this; }
+        mpz_sub_ui(big(), m_val, u); normalize(); return *this;
+    }
+    mpz & operator-=(int u) {
+        long r;
+        if (!m_big && checked_sub(m_small, u, r)) { set_small(r); return *this; }
+        if (u >= 0) mpz_sub_ui(big(), m_val, u); else mpz_add_ui(big(), m_val, -static_cast<long>(u));
+        normalize(); return *this;
+    }
+
+    mpz & operator*=(mpz const & o) {
+        long r;
+        if (both_small(*this, o) && checked_mul(m_small, o.m_small, r)) { set_small(r); return *this; }
+        mpz_ptr t = big(); mpz_mul(t, t, view(o)); normalize(); return *this;
+    }
+    mpz & operator*=(unsigned u) {
+        long r;
+        if (!m_big && fits_long(u) && checked_mul(m_small, static_cast<long>(u), r)) { set_small(r); return *this; }
+        mpz_mul_ui(big(), m_val, u); normalize(); return *this;
+    }
+    mpz & operator*=(int u) {
+        long r;
+        if (!m_big && checked_mul(m_small, u, r)) { set_small(r); return *this; }
+        mpz_mul_si(big(), m_val, u); normalize(); return *this;
+    }
+
+    mpz & operator/=(mpz const & o) {
+        if (both_small(*this, o)) { m_small /= o.m_small; return *this; }
+        mpz_ptr t = big(); mpz_tdiv_q(t, t, view(o)); normalize(); return *this;
+    }
+    mpz & operator/=(unsigned u) {
+        if (!m_big) { m_small = fits_long(u) ? m_small / static_cast<long>(u) : 0; return *this; }
+        mpz_tdiv_q_ui(m_val, m_val, u); normalize(); return *this;
+    }
+
+    friend mpz rem(mpz const & a, mpz const & b) {
+        if (both_small(a, b))
+            return mpz(a.m_small % b.m_small);
+        mpz r; mpz_tdiv_r(r.big(), view(a), view(b)); r.normalize(); return r;
+    }
+    mpz & operator%=(mpz const & o) { mpz r(*this % o); swap(*this, r); return *this; }
 
     friend mpz operator+(mpz a, mpz const & b) { return a += b; }
     friend mpz operator+(mpz a, unsigned b)  { return a += b; }
@@ -163,10 +324,20 @@ public:
     mpz & operator--() { return operator-=(1); }
     mpz operator--(int) { mpz r(*this); --(*this); return r; }
 
-    mpz & operator&=(mpz const & o) { mpz_and(m_val, m_val, o.m_val); return *this; }
-    mpz & operator|=(mpz const & o) { mpz_ior(m_val, m_val, o.m_val); return *this; }
-    mpz & operator^=(mpz const & o) { mpz_xor(m_val, m_val, o.m_val); return *this; }
-    void comp() { mpz_com(m_val, m_val); }
+    // Remark: GMP uses two's complement semantics for bitwise operations, then they agree with the ones on long.
+    mpz & operator&=(mpz const & o) {
+        if (both_small(*this, o)) { set_small(m_small & o.m_small); return *this; }
+        mpz_ptr t = big(); mpz_and(t, t, view(o)); normalize(); return *this;
+    }
+    mpz & operator|=(mpz const & o) {
+        if (both_small(*this, o)) { set_small(m_small | o.m_small); return *this; }
+        mpz_ptr t = big(); mpz_ior(t, t, view(o)); normalize(); return *this;
+    }
+    mpz & operator^=(mpz const & o) {
+        if (both_small(*this, o)) { set_small(m_small ^ o.m_small); return *this; }
+        mpz_ptr t = big(); mpz_xor(t, t, view(o)); normalize(); return *this;
+    }
+    void comp() { if (m_big) { mpz_com(m_val, m_val); normalize(); } else { set_small(~m_small); } }
 
     friend mpz operator&(mpz a, mpz const & b) { return a &= b; }
     friend mpz operator|(mpz a, mpz const & b) { return a |= b; }
@@ -174,14 +345,41 @@ public:
     friend mpz operator~(mpz a) { a.comp(); return a; }
 
     // this <- this + a*b
-    void addmul(mpz const & a, mpz const & b) { mpz_addmul(m_val, a.m_val, b.m_val); }
+    void addmul(mpz const & a, mpz const & b) {
+        long r;
+        if (both_small(a, b) && !m_big && checked_mul(a.m_small, b.m_small, r) && checked_add(m_small, r, r)) {
+            set_small(r);
+        } else {
+            mpz_addmul(big(), view(a), view(b)); normalize();
+        }
+    }
     // this <- this - a*b
-    void submul(mpz const & a, mpz const & b) { mpz_submul(m_val, a.m_val, b.m_val); }
+    void submul(mpz const & a, mpz const & b) {
+        long r;
+        if (both_small(a, b) && !m_big && checked_mul(a.m_small, b.m_small, r) && checked_sub(m_small, r, r)) {
+            set_small(r);
+        } else {
+            mpz_submul(big(), view(a), view(b)); normalize();
+        }
+    }
 
     // a <- b * 2^k
-    friend void mul2k(mpz & a, mpz const & b, unsigned k) { mpz_mul_2exp(a.m_val, b.m_val, k); }
+    friend void mul2k(mpz & a, mpz const & b, unsigned k) {
+        long r;
+        if (!b.m_big && k < sizeof(long) * 8 - 1 && checked_mul(b.m_small, 1l << k, r)) {
+            a.set_small(r);
+        } else {
+            mpz_mul_2exp(a.big(), view(b), k); a.normalize();
+        }
+    }
     // a <- b / 2^k
-    friend void div2k(mpz & a, mpz const & b, unsigned k) { mpz_tdiv_q_2exp(a.m_val, b.m_val, k); }
+    friend void div2k(mpz & a, mpz const & b, unsigned k) {
+        if (!b.m_big) {
+            a.set_small(k < sizeof(long) * 8 - 1 ? b.m_small / (1l << k) : 0);
+        } else {
+            mpz_tdiv_q_2exp(a.big(), view(b), k); a.normalize();
+        }
+    }
 
     /**
        \brief Return the position of the most significant bit.
@@ -195,28 +393,36 @@ public:
     */
     unsigned mlog2() const;
 
-    bool perfect_square() const { return mpz_perfect_square_p(m_val); }
+    bool perfect_square() const { return mpz_perfect_square_p(view(*this)); }
 
-    bool is_power_of_two() const { return is_pos() && mpz_popcount(m_val) == 1; }
+    bool is_power_of_two() const {
+        if (!m_big)
+            return m_small > 0 && (m_small & (m_small - 1)) == 0;
+        return is_pos() && mpz_popcount(m_val) == 1;
+    }
     bool is_power_of_two(unsigned & shift) const;
     /**
        \brief Return largest k s.t. n is a multiple of 2^k
     */
-    unsigned power_of_two_multiple() const { return mpz_scan1(m_val, 0); }
+    unsigned power_of_two_multiple() const { return mpz_scan1(view(*this), 0); }
 
-    friend void power(mpz & a, mpz const & b, unsigned k) { mpz_pow_ui(a.m_val, b.m_val, k); }
+    friend void power(mpz & a, mpz const & b, unsigned k);
     friend void _power(mpz & a, mpz const & b, unsigned k) { power(a, b, k); }
     friend mpz pow(mpz a, unsigned k) { power(a, a, k); return a; }
 
-    friend void rootrem(mpz & root, mpz & rem, mpz const & a, unsigned k) { mpz_rootrem(root.m_val, rem.m_val, a.m_val, k); }
+    friend void rootrem(mpz & root, mpz & rem, mpz const & a, unsigned k) {
+        mpz_rootrem(root.big(), rem.big(), view(a), k); root.normalize(); rem.normalize();
+    }
     // root <- a^{1/k}, return true iff the result is an integer
     friend bool root(mpz & root, mpz const & a, unsigned k);
     friend mpz root(mpz const & a, unsigned k) { mpz r; root(r, a, k); return r; }
 
-    friend void gcd(mpz & g, mpz const & a, mpz const & b) { mpz_gcd(g.m_val, a.m_val, b.m_val); }
+    friend void gcd(mpz & g, mpz const & a, mpz const & b);
     friend mpz gcd(mpz const & a, mpz const & b) { mpz r; gcd(r, a, b); return r; }
-    friend void gcdext(mpz & g, mpz & s, mpz & t, mpz const & a, mpz const & b) { mpz_gcdext(g.m_val, s.m_val, t.m_val, a.m_val, b.m_val); }
-    friend void lcm(mpz & l, mpz const & a, mpz const & b) { mpz_lcm(l.m_val, a.m_val, b.m_val); }
+    friend void gcdext(mpz & g, mpz & s, mpz & t, mpz const & a, mpz const & b) {
+        mpz_gcdext(g.big(), s.big(), t.big(), view(a), view(b)); g.normalize(); s.normalize(); t.normalize();
+    }
+    friend void lcm(mpz & l, mpz const & a, mpz const & b) { mpz_lcm(l.big(), view(a), view(b)); l.normalize(); }
     friend mpz lcm(mpz const & a, mpz const & b) { mpz l; lcm(l, a, b); return l; }
 
     friend std::ostream & operator<<(std::ostream & out, mpz const & v);
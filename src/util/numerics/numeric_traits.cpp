@@ -7,7 +7,10 @@ Author: Leonardo de Moura
 */
 #include <cfenv>
 #include <cmath>
+#include "util/thread.h"
 #include "util/numerics/numeric_traits.h"
+#include "util/numerics/double.h"
+#include "util/numerics/float.h"
 
 namespace lean {
 
@@ -17,4 +20,52 @@ void set_processor_rounding(bool plus_inf) {
     else
         std::fesetround(FE_DOWNWARD);
 }
+
+static LEAN_THREAD_LOCAL unsigned g_upward_rounding_depth = 0;
+
+scoped_upward_rounding::scoped_upward_rounding():m_old_mode(FE_UPWARD) {
+    if (g_upward_rounding_depth == 0) {
+        m_old_mode = std::fegetround();
+        if (m_old_mode != FE_UPWARD)
+            std::fesetround(FE_UPWARD);
+    }
+    g_upward_rounding_depth++;
+}
+
+scoped_upward_rounding::~scoped_upward_rounding() {
+    g_upward_rounding_depth--;
+    if (m_old_mode != FE_UPWARD)
+        std::fesetround(m_old_mode);
+}
+
+template<typename T, bool (*Up)()>
+T native_bound_arith<T, Up>::mul_core(T a, T b, bool up) { return up ? a * b : -((-a) * b); }
+template<typename T, bool (*Up)()>
+void native_bound_arith<T, Up>::add(T & r, T a, T b) { r = Up() ? a + b : -((-a) - b); }
+template<typename T, bool (*Up)()>
+void native_bound_arith<T, Up>::sub(T & r, T a, T b) { r = Up() ? a - b : -(b - a); }
+template<typename T, bool (*Up)()>
+void native_bound_arith<T, Up>::mul(T & r, T a, T b) { r = mul_core(a, b, Up()); }
+template<typename T, bool (*Up)()>
+void native_bound_arith<T, Up>::div(T & r, T a, T b) { r = Up() ? a / b : -((-a) / b); }
+template<typename T, bool (*Up)()>
+void native_bound_arith<T, Up>::inv(T & v) { div(v, static_cast<T>(1), v); }
+template<typename T, bool (*Up)()>
+void native_bound_arith<T, Up>::power(T & v, unsigned k) {
+    bool neg = v < 0 && k % 2 == 1;
+    bool up  = Up() != neg; // if the result is negative, then |v|^k must be rounded in the opposite direction
+    T b = v < 0 ? -v : v;
+    T r = static_cast<T>(1);
+    while (k > 0) {
+        if (k % 2 == 1)
+            r = mul_core(r, b, up);
+        k /= 2;
+        if (k > 0)
+            b = mul_core(b, b, up);
+    }
+    v = neg ? -r : r;
+}
+
+template class native_bound_arith<double, is_double_rnd_up>;
+template class native_bound_arith<float, is_float_rnd_up>;
 };
@@ -19,4 +19,64 @@ class numeric_traits {
 
 void set_processor_rounding(bool plus_inf);
 
+/**
+   \brief Put the processor in upward rounding mode in the scope of this object.
+   Scopes can be nested, and only the outermost one switches the rounding mode.
+   Switching the rounding mode is expensive. So, clients evaluating many interval
+   operations should create a scope around the whole evaluation.
+*/
+class scoped_upward_rounding {
+    int m_old_mode;
+public:
+    scoped_upward_rounding();
+    ~scoped_upward_rounding();
+};
+
+/**
+   \brief Arithmetic operations used to compute interval bounds (see xnumeral.h).
+   By default, they are the standard operators, and the direction is the one selected
+   using <tt>numeric_traits<T>::set_rounding</tt>.
+   The native floating point types specialize this template (see \c native_bound_arith).
+*/
+template<typename T>
+class bound_arith {
+public:
+    /** \brief Object created by interval operations before computing bounds. */
+    struct scope { scope() {} };
+    static void add(T & r, T const & a, T const & b) { r = a + b; }
+    static void sub(T & r, T const & a, T const & b) { r = a - b; }
+    static void mul(T & r, T const & a, T const & b) { r = a * b; }
+    static void div(T & r, T const & a, T const & b) { r = a / b; }
+    static void inv(T & v) { numeric_traits<T>::inv(v); }
+    static void power(T & v, unsigned k) { numeric_traits<T>::power(v, k); }
+};
+
+/**
+   \brief Bound operations for native floating point numbers. The processor is kept in
+   upward rounding mode (see \c scoped_upward_rounding), and values rounded to -oo are
+   computed by negation, e.g., <tt>down(a*b) == -up((-a)*b)</tt>. Thus, we do not
+   switch the rounding mode when computing the lower and upper bounds of an interval.
+   \c Up returns true iff the selected direction is +oo.
+
+   \remark The operations are defined (and instantiated for \c double and \c float) in
+   numeric_traits.cpp. This file is compiled with <tt>-frounding-math</tt>, otherwise the compiler
+   may fold expressions such as <tt>-((-a)*b)</tt>. They must not be defined in this header,
+   since it is included by files compiled without this flag.
+*/
+template<typename T, bool (*Up)()>
+class native_bound_arith {
+    static T mul_core(T a, T b, bool up);
+public:
+    typedef scoped_upward_rounding scope;
+    static void add(T & r, T a, T b);
+    static void sub(T & r, T a, T b);
+    static void mul(T & r, T a, T b);
+    static void div(T & r, T a, T b);
+    static void inv(T & v);
+    /**
+       \brief Compute |v|^k using repeated squaring. Multiplication is monotonic on
+       non-negative numbers, so rounding every step in the same direction produces a bound.
+    */
+    static void power(T & v, unsigned k);
+};
 }
@@ -78,7 +78,7 @@ void inv(T & a, xnumeral_kind & ak) {
         break;
     case XN_NUMERAL:
         lean_assert(!numeric_traits<T>::is_zero(a));
-        numeric_traits<T>::inv(a);
+        bound_arith<T>::inv(a);
         break;
     case XN_PLUS_INFINITY:
         ak = XN_NUMERAL;
@@ -98,7 +98,7 @@ void add(T & r, xnumeral_kind & rk, T const & a, xnumeral_kind ak, T const & b,
         numeric_traits<T>::reset(r);
         rk = bk;
     } else {
-        r = a + b;
+        bound_arith<T>::add(r, a, b);
         rk = XN_NUMERAL;
     }
 }
@@ -118,7 +118,7 @@ void sub(T & r, xnumeral_kind & rk, T const & a, xnumeral_kind ak, T const & b,
             rk = XN_PLUS_INFINITY;
             break;
         case XN_NUMERAL:
-            r = a - b;
+            bound_arith<T>::sub(r, a, b);
             rk = XN_NUMERAL;
             break;
         case XN_PLUS_INFINITY:
@@ -142,7 +142,7 @@ void mul(T & r, xnumeral_kind & rk, T const & a, xnumeral_kind ak, T const & b,
         numeric_traits<T>::reset(r);
     } else {
         rk = XN_NUMERAL;
-        r = a * b;
+        bound_arith<T>::mul(r, a, b);
     }
 }
 
@@ -166,7 +166,7 @@ void div(T & r, xnumeral_kind & rk, T const & a, xnumeral_kind ak, T const & b,
         rk = XN_NUMERAL;
     } else {
         rk = XN_NUMERAL;
-        r = a / b;
+        bound_arith<T>::div(r, a, b);
     }
 }
 
@@ -178,7 +178,7 @@ void power(T & a, xnumeral_kind & ak, unsigned n) {
             ak = XN_PLUS_INFINITY;
         break;
     case XN_NUMERAL:
-        numeric_traits<T>::power(a, n);
+        bound_arith<T>::power(a, n);
         break;
     case XN_PLUS_INFINITY:
         break; // do nothing
@@ -0,0 +1,243 @@
+/*
+Copyright (c) 2014 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+#include <string>
+#include <utility>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include "util/name.h"
+#include "util/escaped.h"
+#include "util/exception.h"
+#include "util/perf.h"
+
+#define LEAN_MAX_PERF_COUNTERS 128
+#define LEAN_MAX_PERF_TIMERS   64
+#define LEAN_MAX_PERF_EVENTS   (1u << 21)
+
+namespace lean {
+atomic<bool> g_perf_enabled(false);
+static atomic<bool> g_perf_trace_events(false);
+
+// Remark: the following variables are statically initialized.
+// So, they can be safely used by counters and timers declared as static objects.
+static mutex                      g_perf_mutex;
+static atomic<unsigned>           g_num_perf_counters(0);
+static char const *               g_perf_counter_names[LEAN_MAX_PERF_COUNTERS];
+static atomic<size_t>             g_perf_counter_values[LEAN_MAX_PERF_COUNTERS];
+static atomic<unsigned>           g_num_perf_timers(0);
+static char const *               g_perf_timer_names[LEAN_MAX_PERF_TIMERS];
+static atomic<size_t>             g_perf_timer_calls[LEAN_MAX_PERF_TIMERS];
+static atomic<size_t>             g_perf_timer_nanosecs[LEAN_MAX_PERF_TIMERS];
+static LEAN_THREAD_LOCAL unsigned g_perf_timer_depth[LEAN_MAX_PERF_TIMERS];
+
+struct perf_event {
+    unsigned  m_timer;
+    unsigned  m_thread;
+    long long m_start; // in microseconds since the performance counters were enabled
+    long long m_dur;   // in microseconds
+    perf_event(unsigned t, unsigned th, long long s, long long d):m_timer(t), m_thread(th), m_start(s), m_dur(d) {}
+};
+
+/** \brief Data that is only created when the performance counters are enabled. */
+struct perf_data {
+    std::map<std::string, size_t> m_named_counters;
+    std::vector<perf_event>       m_events;
+    size_t                        m_dropped_events;
+    perf_time_point               m_start;
+    perf_data():m_dropped_events(0), m_start(std::chrono::steady_clock::now()) {}
+};
+static perf_data * g_perf_data = nullptr;
+
+static atomic<unsigned>           g_perf_next_thread_id(1);
+static LEAN_THREAD_LOCAL unsigned g_perf_thread_id = 0;
+
+static unsigned get_perf_thread_id() {
+    if (g_perf_thread_id == 0)
+        g_perf_thread_id = g_perf_next_thread_id++;
+    return g_perf_thread_id;
+}
+
+/** \brief Return the index of \c name in \c names, add it if it is not there. */
+static unsigned register_perf_name(char const * name, char const ** names, atomic<unsigned> & num_names, unsigned max) {
+    lock_guard<mutex> lock(g_perf_mutex);
+    unsigned num = num_names;
+    for (unsigned i = 0; i < num; i++) {
+        if (strcmp(names[i], name) == 0)
+            return i;
+    }
+    if (num == max)
+        throw exception("maximum number of performance counters/timers has been reached");
+    names[num] = name;
+    num_names  = num + 1;
+    return num;
+}
+
+void enable_perf(bool flag, bool trace_events) {
+    lock_guard<mutex> lock(g_perf_mutex);
+    if (flag && !g_perf_data)
+        g_perf_data = new perf_data();
+    g_perf_trace_events = flag && trace_events;
+    g_perf_enabled      = flag;
+}
+
+void reset_perf() {
+    lock_guard<mutex> lock(g_perf_mutex);
+    for (unsigned i = 0; i < g_num_perf_counters; i++)
+        g_perf_counter_values[i] = 0;
+    for (unsigned i = 0; i < g_num_perf_timers; i++) {
+        g_perf_timer_calls[i]    = 0;
+        g_perf_timer_nanosecs[i] = 0;
+    }
+    if (g_perf_data) {
+        g_perf_data->m_named_counters.clear();
+        g_perf_data->m_events.clear();
+        g_perf_data->m_dropped_events = 0;
+        g_perf_data->m_start = std::chrono::steady_clock::now();
+    }
+}
+
+perf_counter::perf_counter(char const * name):
+    m_id(register_perf_name(name, g_perf_counter_names, g_num_perf_counters, LEAN_MAX_PERF_COUNTERS)) {}
+
+void perf_counter::inc_core(unsigned n) const {
+    atomic_fetch_add_explicit(&g_perf_counter_values[m_id], static_cast<size_t>(n), memory_order_relaxed);
+}
+
+void inc_perf_counter_core(char const * category, name const & n) {
+    std::string key(category);
+    key += " ";
+    key += n.to_string();
+    lock_guard<mutex> lock(g_perf_mutex);
+    if (g_perf_data)
+        g_perf_data->m_named_counters[key]++;
+}
+
+perf_timer::perf_timer(char const * name):
+    m_id(register_perf_name(name, g_perf_timer_names, g_num_perf_timers, LEAN_MAX_PERF_TIMERS)) {}
+
+void perf_timer_enter(unsigned id) {
+    g_perf_timer_depth[id]++;
+}
+
+void perf_timer_exit(unsigned id, perf_time_point const & start) {
+    perf_time_point end = std::chrono::steady_clock::now();
+    unsigned depth = --g_perf_timer_depth[id];
+    atomic_fetch_add_explicit(&g_perf_timer_calls[id], static_cast<size_t>(1), memory_order_relaxed);
+    if (depth == 0) {
+        size_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        atomic_fetch_add_explicit(&g_perf_timer_nanosecs[id], ns, memory_order_relaxed);
+    }
+    if (g_perf_trace_events) {
+        unsigned tid = get_perf_thread_id();
+        lock_guard<mutex> lock(g_perf_mutex);
+        if (!g_perf_data)
+            return;
+        if (g_perf_data->m_events.size() >= LEAN_MAX_PERF_EVENTS) {
+            g_perf_data->m_dropped_events++;
+        } else {
+            using std::chrono::microseconds;
+            using std::chrono::duration_cast;
+            long long s = duration_cast<microseconds>(start - g_perf_data->m_start).count();
+            long long d = duration_cast<microseconds>(end - start).count();
+            g_perf_data->m_events.emplace_back(id, tid, s, d);
+        }
+    }
+}
+
+void display_perf_summary(std::ostream & out) {
+    lock_guard<mutex> lock(g_perf_mutex);
+    out << std::left << std::setw(32) << "counter" << std::right << std::setw(16) << "value" << "\n";
+    for (unsigned i = 0; i < g_num_perf_counters; i++) {
+        if (g_perf_counter_values[i] != 0)
+            out << std::left << std::setw(32) << g_perf_counter_names[i] << std::right
+                << std::setw(16) << g_perf_counter_values[i] << "\n";
+    }
+    if (g_perf_data) {
+        std::vector<std::pair<std::string, size_t>> named(g_perf_data->m_named_counters.begin(),
+                                                          g_perf_data->m_named_counters.end());
+        std::stable_sort(named.begin(), named.end(), [](std::pair<std::string, size_t> const & p1,
+                                                        std::pair<std::string, size_t> const & p2) {
+                             return p1.second > p2.second;
+                         });
+        for (auto const & p : named)
+            out << std::left << std::setw(32) << p.first << std::right << std::setw(16) << p.second << "\n";
+    }
+    out << std::left << std::setw(32) << "timer" << std::right
+        << std::setw(16) << "calls" << std::setw(16) << "time (ms)" << "\n";
+    std::ios_base::fmtflags old_flags = out.flags();
+    std::streamsize old_precision     = out.precision();
+    for (unsigned i = 0; i < g_num_perf_timers; i++) {
+        if (g_perf_timer_calls[i] != 0)
+            out << std::left << std::setw(32) << g_perf_timer_names[i] << std::right
+                << std::setw(16) << g_perf_timer_calls[i]
+                << std::setw(16) << std::fixed << std::setprecision(3)
+                << static_cast<double>(g_perf_timer_nanosecs[i]) / 1000000.0 << "\n";
+    }
+    out.flags(old_flags);
+    out.precision(old_precision);
+    if (g_perf_data && g_perf_data->m_dropped_events > 0)
+        out << "dropped trace events: " << g_perf_data->m_dropped_events << "\n";
+}
+
+void export_perf_trace(std::ostream & out) {
+    lock_guard<mutex> lock(g_perf_mutex);
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    if (g_perf_data) {
+        for (perf_event const & e : g_perf_data->m_events) {
+            if (!first)
+                out << ",";
+            first = false;
+            out << "\n{\"name\":\"" << escaped(g_perf_timer_names[e.m_timer]) << "\",\"cat\":\"lean\",\"ph\":\"X\""
+                << ",\"ts\":" << e.m_start << ",\"dur\":" << e.m_dur
+                << ",\"pid\":1,\"tid\":" << e.m_thread << "}";
+        }
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+static bool        g_display_perf_summary_at_exit = false;
+static std::string g_perf_trace_file;
+
+static void perf_at_exit() {
+    if (g_display_perf_summary_at_exit)
+        display_perf_summary(std::cerr);
+    if (!g_perf_trace_file.empty()) {
+        std::ofstream out(g_perf_trace_file);
+        if (out)
+            export_perf_trace(out);
+        else
+            std::cerr << "failed to create trace file '" << g_perf_trace_file << "'\n";
+    }
+}
+
+static void register_perf_at_exit() {
+    static bool registered = false;
+    if (!registered) {
+        registered = true;
+        std::atexit(perf_at_exit);
+    }
+}
+
+void set_display_perf_summary_at_exit(bool flag) {
+    register_perf_at_exit();
+    g_display_perf_summary_at_exit = flag;
+    if (flag)
+        enable_perf(true, g_perf_trace_events);
+}
+
+void set_perf_trace_file(std::string const & fname) {
+    register_perf_at_exit();
+    g_perf_trace_file = fname;
+    enable_perf(true, true);
+}
+}
@@ -0,0 +1,94 @@
+/*
+Copyright (c) 2014 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: Leonardo de Moura
+*/
+#pragma once
+#include <chrono>
+#include <string>
+#include <iosfwd>
+#include "util/thread.h"
+
+namespace lean {
+class name;
+/**
+   \brief Performance counters and timers. They are always compiled, but they are
+   only updated when enabled at runtime (see \c enable_perf). When they are disabled,
+   the cost is a single load of an atomic flag.
+*/
+extern atomic<bool> g_perf_enabled;
+inline bool is_perf_enabled() { return g_perf_enabled; }
+/**
+   \brief Enable/disable performance counters and timers. When \c trace_events is true,
+   each timed scope is also recorded as an event that can be exported in the
+   Chrome trace format (see \c export_perf_trace).
+*/
+void enable_perf(bool flag, bool trace_events = false);
+/** \brief Reset all counters, timers and recorded events. */
+void reset_perf();
+
+/**
+   \brief Named counter. Counters should be declared as static objects, e.g.,
+   <code>static perf_counter g_whnf_cache_hits("whnf_cache_hits");</code>
+*/
+class perf_counter {
+    unsigned m_id;
+    void inc_core(unsigned n) const;
+public:
+    perf_counter(char const * name);
+    void inc(unsigned n = 1) const { if (is_perf_enabled()) inc_core(n); }
+};
+
+void inc_perf_counter_core(char const * category, name const & n);
+/**
+   \brief Increment the counter associated with the pair <tt>(category, n)</tt>.
+   It is used to count events by constant name (e.g., delta unfoldings).
+*/
+inline void inc_perf_counter(char const * category, name const & n) {
+    if (is_perf_enabled())
+        inc_perf_counter_core(category, n);
+}
+
+/**
+   \brief Named timer. The time reported for a timer only includes the outermost
+   (non reentrant) scopes. Thus, recursive procedures can be safely timed.
+*/
+class perf_timer {
+    unsigned m_id;
+public:
+    perf_timer(char const * name);
+    unsigned id() const { return m_id; }
+};
+
+typedef std::chrono::steady_clock::time_point perf_time_point;
+void perf_timer_enter(unsigned id);
+void perf_timer_exit(unsigned id, perf_time_point const & start);
+
+/** \brief Time the scope of this object using the given timer. */
+class scoped_perf_timer {
+    unsigned        m_id;
+    bool            m_on;
+    perf_time_point m_start;
+public:
+    scoped_perf_timer(perf_timer const & t):m_id(t.id()), m_on(is_perf_enabled()) {
+        if (m_on) {
+            perf_timer_enter(m_id);
+            m_start = std::chrono::steady_clock::now();
+        }
+    }
+    ~scoped_perf_timer() { if (m_on) perf_timer_exit(m_id, m_start); }
+};
+
+/** \brief Display counters and timers. */
+void display_perf_summary(std::ostream & out);
+/**
+   \brief Export the recorded events in the Chrome trace format (JSON).
+   The result can be inspected using chrome://tracing.
+*/
+void export_perf_trace(std::ostream & out);
+/** \brief When \c flag is true, the summary is displayed in the standard error at exit. */
+void set_display_perf_summary_at_exit(bool flag);
+/** \brief Enable trace events, and save them in the given file at exit. */
+void set_perf_trace_file(std::string const & fname);
+}
@@ -6,6 +6,7 @@ Author: Leonardo de Moura
 */
 #include <limits>
 #include "util/exception.h"
+#include "util/safe_arith.h"
 
 namespace lean {
 void check_int_overflow(long long n) {
@@ -35,4 +36,24 @@ Num1 safe_add_core(Num1 v, Num2 k) {
 int safe_add(int v, int k) { return safe_add_core(v, k); }
 int safe_add(int v, unsigned k) { return safe_add_core(v, k); }
 unsigned safe_add(unsigned v, unsigned k) { return safe_add_core(v, k); }
+
+bool checked_power(long v, unsigned k, long & r) {
+    if (v == 0 || v == 1) {
+        r = k == 0 ? 1 : v;
+        return true;
+    } else if (v == -1) {
+        r = k % 2 == 0 ? 1 : -1;
+        return true;
+    }
+    // exponentiation by squaring, it gives up as soon as there is an overflow
+    r = 1;
+    while (k > 0) {
+        if ((k & 1) && !checked_mul(r, v, r))
+            return false;
+        k >>= 1;
+        if (k > 0 && !checked_mul(v, v, v))
+            return false;
+    }
+    return true;
+}
 }
@@ -5,6 +5,7 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Author: Leonardo de Moura
 */
 #pragma once
+#include <climits>
 
 namespace lean {
 /** \brief Return v - k. It throws an exception if there is a underflow. */
@@ -15,4 +16,39 @@ int safe_sub(int v, unsigned k);
 int safe_add(int v, int k);
 int safe_add(int v, unsigned k);
 unsigned safe_add(unsigned v, unsigned k);
+
+/**
+   \brief Store v + k (v - k, v * k) in r, and return true if there is no overflow.
+   They do not throw exceptions, and are meant to be used in fast paths that fall back
+   to arbitrary precision arithmetic. The content of r is unspecified when the result is false.
+*/
+inline bool checked_add(long v, long k, long & r) {
+    if ((k > 0 && v > LONG_MAX - k) || (k < 0 && v < LONG_MIN - k))
+        return false;
+    r = v + k;
+    return true;
+}
+inline bool checked_sub(long v, long k, long & r) {
+    if ((k > 0 && v < LONG_MIN + k) || (k < 0 && v > LONG_MAX + k))
+        return false;
+    r = v - k;
+    return true;
+}
+inline bool checked_mul(long v, long k, long & r) {
+#if defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__))
+    return !__builtin_mul_overflow(v, k, &r);
+#else
+    if (v > 0) {
+        if (k > 0 ? v > LONG_MAX / k : k < LONG_MIN / v)
+            return false;
+    } else if (v < 0) {
+        if (k > 0 ? v < LONG_MIN / k : (k != 0 && v < LONG_MAX / k))
+            return false;
+    }
+    r = v * k;
+    return true;
+#endif
+}
+/** \brief Store v^k in r, and return true if there is no overflow. */
+bool checked_power(long v, unsigned k, long & r);
 }
@@ -5,15 +5,23 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Author: Leonardo de Moura
 */
 #include <iostream>
+#include <fstream>
 #include <string>
 #include <vector>
+#include <deque>
 #include <unordered_set>
+#include <algorithm>
+#include <new>
 #include "util/thread.h"
 #include "util/lua.h"
+#include "util/lua_bytecode_cache.h"
 #include "util/debug.h"
 #include "util/exception.h"
 #include "util/memory.h"
+#include "util/memory_budget.h"
+#include "util/perf.h"
 #include "util/buffer.h"
+#include "util/sstream.h"
 #include "util/interrupt.h"
 #include "util/script_state.h"
 #include "util/script_exception.h"
@@ -23,7 +31,16 @@ Author: Leonardo de Moura
 #include "util/rb_map.h"
 #include "util/lean_path.h"
 
-extern "C" void * lua_realloc(void *, void * q, size_t, size_t new_size) { return lean::realloc(q, new_size); }
+static unsigned g_lua_alloc_tag = lean::register_alloc_tag("lua");
+extern "C" void * lua_realloc(void *, void * q, size_t, size_t new_size) {
+    LEAN_ALLOC_TAG(g_lua_alloc_tag);
+    // Remark: C++ exceptions must not cross the Lua C frames, Lua expects nullptr when the allocation fails.
+    try {
+        return lean::realloc(q, new_size);
+    } catch (std::bad_alloc &) {
+        return nullptr;
+    }
+}
 
 namespace lean {
 static std::vector<script_state::reg_fn> g_modules;
@@ -72,8 +89,8 @@ struct script_state::imp {
 
     imp() {
         // TODO(Leo) investigate why TCMALLOC + lua_realloc do not work together
-        // #ifdef LEAN_USE_LUA_NEWSTATE
-        #if 0
+        // We only use lua_realloc when the allocation profiler is enabled.
+        #if defined(LEAN_ALLOC_PROFILER)
         m_state = lua_newstate(lua_realloc, nullptr);
         #else
         m_state = luaL_newstate();
@@ -113,9 +130,15 @@ struct script_state::imp {
         ::lean::dostring(m_state, str);
     }
 
+    /** \brief Similar to \c dofile, but the precompiled code is cached (see \c dofile_cached). */
+    void dofile_cached(char const * fname) {
+        lock_guard<mutex> lock(m_mutex);
+        ::lean::dofile_cached(m_state, fname);
+    }
+
     bool import_explicit(std::string const & fname) {
         if (m_imported_modules.find(fname) == m_imported_modules.end()) {
-            dofile(fname.c_str());
+            dofile_cached(fname.c_str());
             m_imported_modules.insert(fname);
             return true;
         } else {
@@ -327,120 +350,359 @@ static void open_state(lua_State * L) {
 #define SMALL_DELAY 10 // in ms
 chrono::milliseconds g_small_delay(SMALL_DELAY);
 
+struct script_state_pool::imp {
+    unsigned                  m_max_states;
+    init_fn                   m_init;
+    mutex                     m_mutex;
+    condition_variable        m_cv;
+    unsigned                  m_num_states;
+    std::vector<script_state> m_idle;
+    imp(unsigned max_states, init_fn const & fn):m_max_states(max_states), m_init(fn), m_num_states(0) {
+        if (m_max_states == 0)
+            throw exception("invalid script_state pool, it must contain at least one object");
+    }
+
+    script_state mk_state() {
+        script_state r;
+        if (m_init)
+            m_init(r);
+        return r;
+    }
+
+    script_state acquire() {
+        unique_lock<mutex> lock(m_mutex);
+        while (true) {
+            if (!m_idle.empty()) {
+                script_state r = m_idle.back();
+                m_idle.pop_back();
+                return r;
+            }
+            if (m_num_states < m_max_states) {
+                m_num_states++;
+                try {
+                    unlock_guard unlock(m_mutex);
+                    return mk_state();
+                } catch (...) {
+                    m_num_states--;
+                    throw;
+                }
+            }
+            #if defined(LEAN_MULTI_THREAD)
+            check_interrupted();
+            m_cv.wait_for(lock, g_small_delay);
+            #else
+            throw exception("all script_state objects in the pool are in use");
+            #endif
+        }
+    }
+
+    void reserve(unsigned n) {
+        while (true) {
+            {
+                lock_guard<mutex> lock(m_mutex);
+                if (m_num_states >= std::min(n, m_max_states))
+                    return;
+                m_num_states++;
+            }
+            try {
+                release(mk_state());
+            } catch (...) {
+                lock_guard<mutex> lock(m_mutex);
+                m_num_states--;
+                throw;
+            }
+        }
+    }
+
+    void release(script_state s) {
+        // remove any garbage left by the previous client
+        s.apply([](lua_State * S) { lua_settop(S, 0); });
+        lock_guard<mutex> lock(m_mutex);
+        m_idle.push_back(s);
+        m_cv.notify_one();
+    }
+};
+
+script_state_pool::script_state_pool(unsigned max_states, init_fn const & fn):
+    m_ptr(std::make_shared<imp>(max_states, fn)) {}
+script_state_pool::~script_state_pool() {}
+unsigned script_state_pool::max_states() const { return m_ptr->m_max_states; }
+unsigned script_state_pool::num_states() const {
+    lock_guard<mutex> lock(m_ptr->m_mutex);
+    return m_ptr->m_num_states;
+}
+void script_state_pool::reserve(unsigned n) { m_ptr->reserve(n); }
+script_state script_state_pool::acquire() { return m_ptr->acquire(); }
+script_state script_state_pool::acquire(script_state & caller) {
+    optional<script_state> r;
+    caller.exec_unprotected([&]() { r = m_ptr->acquire(); });
+    return *r;
+}
+void script_state_pool::release(script_state const & s) { m_ptr->release(s); }
+
+DECL_UDATA(script_state_pool)
+
+static int mk_script_state_pool(lua_State * L) {
+    int n = luaL_checkinteger(L, 1);
+    if (n <= 0)
+        throw exception("invalid script_state pool, it must contain at least one object");
+    return push_script_state_pool(L, script_state_pool(n));
+}
+
+/**
+   \brief Execute a script in one of the objects of the pool. The lock of the
+   current script_state is released while waiting for an object of the pool,
+   and while the script is being executed.
+*/
+static int script_state_pool_dostring(lua_State * L) {
+    script_state_pool & pool = to_script_state_pool(L, 1);
+    char const * script = luaL_checkstring(L, 2);
+    int first           = 3;
+    int last            = lua_gettop(L);
+    script_state caller = to_script_state(L);
+    scoped_script_state target(pool, caller);
+    return target.get().apply([&](lua_State * S) {
+            int sz_before = lua_gettop(S);
+            int status = luaL_loadstring(S, script);
+            if (status)
+                throw script_exception(lua_tostring(S, -1));
+            copy_values(L, first, last, S);
+            caller.exec_unprotected([&]() {
+                    pcall(S, first > last ? 0 : last - first + 1, LUA_MULTRET, 0);
+                });
+            int sz_after = lua_gettop(S);
+            if (sz_after > sz_before) {
+                copy_values(S, sz_before + 1, sz_after, L);
+                lua_pop(S, sz_after - sz_before);
+            }
+            return sz_after - sz_before;
+        });
+}
+
+static int script_state_pool_max_states(lua_State * L) {
+    return push_integer(L, to_script_state_pool(L, 1).max_states());
+}
+
+static int script_state_pool_reserve(lua_State * L) {
+    to_script_state_pool(L, 1).reserve(luaL_checkinteger(L, 2));
+    return 0;
+}
+
+static int script_state_pool_num_states(lua_State * L) {
+    return push_integer(L, to_script_state_pool(L, 1).num_states());
+}
+
+static const struct luaL_Reg script_state_pool_m[] = {
+    {"__gc",            script_state_pool_gc},
+    {"dostring",        safe_function<script_state_pool_dostring>},
+    {"eval",            safe_function<script_state_pool_dostring>},
+    {"max_states",      safe_function<script_state_pool_max_states>},
+    {"num_states",      safe_function<script_state_pool_num_states>},
+    {"reserve",         safe_function<script_state_pool_reserve>},
+    {0, 0}
+};
+
+static void open_script_state_pool(lua_State * L) {
+    luaL_newmetatable(L, script_state_pool_mt);
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -2, "__index");
+    setfuncs(L, script_state_pool_m, 0);
+
+    SET_GLOBAL_FUN(mk_script_state_pool,   "StatePool");
+    SET_GLOBAL_FUN(script_state_pool_pred, "is_StatePool");
+}
+
 #if defined(LEAN_MULTI_THREAD)
+/**
+   \brief Default capacity of the channels used to communicate with thread objects in the Lua API.
+   The value 0 means unbounded.
+*/
+static atomic<unsigned> g_channel_capacity(0);
+
 /**
    \brief Channel for communicating with thread objects in the Lua API
+
+   Values are stored as closures (lua_pusher) that push them into the target
+   lua_State. Lean objects that provide an export function (e.g., names,
+   levels, expressions and environments) are not copied, only their reference
+   counters are updated. Other values (e.g., functions) are stored in an
+   auxiliary lua_State that is only created when needed.
 */
 class data_channel {
-    // We use a lua_State to implement the channel. This is quite hackish,
-    // but it is a convenient storage for Lua objects sent from one state to
-    // another.
-    script_state       m_channel;
-    int                m_ini;
-    mutex              m_mutex;
-    condition_variable m_cv;
-public:
-    data_channel() {
-        lua_State * channel = m_channel.m_ptr->m_state;
-        m_ini = lua_gettop(channel);
+    mutex                         m_mutex;
+    condition_variable            m_not_empty;
+    condition_variable            m_not_full;
+    std::deque<lua_pusher>        m_values;
+    unsigned                      m_capacity;
+    mutex                         m_aux_mutex;
+    std::unique_ptr<script_state> m_aux; // auxiliary state for values that cannot be exported
+
+    lua_pusher mk_aux_pusher(lua_State * src, int i) {
+        lock_guard<mutex> lock(m_aux_mutex);
+        if (!m_aux)
+            m_aux.reset(new script_state());
+        lua_State * aux = m_aux->get_state();
+        copy_values(src, i, i, aux);
+        int ref = luaL_ref(aux, LUA_REGISTRYINDEX);
+        return lua_pusher([=](lua_State * tgt) {
+                lock_guard<mutex> lock(m_aux_mutex);
+                lua_State * aux = m_aux->get_state();
+                lua_rawgeti(aux, LUA_REGISTRYINDEX, ref);
+                int top = lua_gettop(aux);
+                copy_values(aux, top, top, tgt);
+                lua_pop(aux, 1);
+                luaL_unref(aux, LUA_REGISTRYINDEX, ref);
+            });
+    }
+
+    lua_pusher mk_pusher(lua_State * src, int i) {
+        switch (lua_type(src, i)) {
+        case LUA_TNIL:
+            return lua_pusher([](lua_State * tgt) { lua_pushnil(tgt); });
+        case LUA_TBOOLEAN: {
+            bool b = lua_toboolean(src, i);
+            return lua_pusher([=](lua_State * tgt) { lua_pushboolean(tgt, b); });
+        }
+        case LUA_TNUMBER: {
+            lua_Number n = lua_tonumber(src, i);
+            return lua_pusher([=](lua_State * tgt) { lua_pushnumber(tgt, n); });
+        }
+        case LUA_TSTRING: {
+            size_t len;
+            char const * str = lua_tolstring(src, i, &len);
+            std::string v(str, len);
+            return lua_pusher([=](lua_State * tgt) { lua_pushlstring(tgt, v.data(), v.size()); });
+        }
+        case LUA_TUSERDATA:
+            if (lua_export_fn f = get_export_fn(src, i))
+                return f(src, i);
+            return mk_aux_pusher(src, i);
+        default:
+            return mk_aux_pusher(src, i);
+        }
     }
 
+    bool full() const { return m_capacity > 0 && m_values.size() >= m_capacity; }
+
+public:
+    data_channel(unsigned capacity):m_capacity(capacity) {}
+
     /**
        \brief Copy elements from positions [first, last] from src stack
-       to the channel.
+       to the channel. If the channel has bounded capacity, then it blocks
+       the execution of \c src while the channel is full.
     */
     void write(lua_State * src, int first, int last) {
-        // write the object on the top of the stack of src to the table
-        // on m_channel.
-        if (last < first)
-            return;
-        lock_guard<mutex> lock(m_mutex);
-        lua_State * channel = m_channel.m_ptr->m_state;
-        bool was_empty = lua_gettop(channel) == m_ini;
-        copy_values(src, first, last, channel);
-        if (was_empty)
-            m_cv.notify_one();
+        for (int i = first; i <= last; i++) {
+            lua_pusher v = mk_pusher(src, i);
+            unique_lock<mutex> lock(m_mutex);
+            while (full()) {
+                check_interrupted();
+                m_not_full.wait_for(lock, g_small_delay);
+            }
+            m_values.push_back(v);
+            m_not_empty.notify_one();
+        }
     }
 
     /**
        \brief Retrieve one element from the channel. It will block
        the execution of \c tgt if the channel is empty.
+       If \c i > 0, then the argument at position \c i is a timeout (in milliseconds).
     */
     int read(lua_State * tgt, int i) {
-        unique_lock<mutex> lock(m_mutex);
-        lua_State * channel = m_channel.m_ptr->m_state;
-        if (i > 0) {
-            // i is the position of the timeout argument
-            chrono::milliseconds dura(luaL_checkinteger(tgt, i));
-            if (lua_gettop(channel) == m_ini)
-                m_cv.wait_for(lock, dura);
-            if (lua_gettop(channel) == m_ini) {
-                // timeout...
-                lua_pushboolean(tgt, false);
-                lua_pushnil(tgt);
-                return 2;
+        lua_pusher v;
+        {
+            unique_lock<mutex> lock(m_mutex);
+            if (i > 0) {
+                // i is the position of the timeout argument
+                auto deadline = chrono::steady_clock::now() + chrono::milliseconds(luaL_checkinteger(tgt, i));
+                while (m_values.empty() && chrono::steady_clock::now() < deadline) {
+                    check_interrupted();
+                    m_not_empty.wait_for(lock, g_small_delay);
+                }
+                if (m_values.empty()) {
+                    // timeout...
+                    lua_pushboolean(tgt, false);
+                    lua_pushnil(tgt);
+                    return 2;
+                }
             } else {
-                lua_pushboolean(tgt, true);
-                copy_values(channel, m_ini + 1, m_ini + 1, tgt);
-                lua_remove(channel, m_ini + 1);
-                return 2;
+                while (m_values.empty()) {
+                    check_interrupted();
+                    m_not_empty.wait_for(lock, g_small_delay);
+                }
             }
+            v = m_values.front();
+            m_values.pop_front();
+            m_not_full.notify_one();
+        }
+        if (i > 0) {
+            lua_pushboolean(tgt, true);
+            v(tgt);
+            return 2;
         } else {
-            while (lua_gettop(channel) == m_ini) {
-                check_interrupted();
-                m_cv.wait_for(lock, g_small_delay);
-            }
-            copy_values(channel, m_ini + 1, m_ini + 1, tgt);
-            lua_remove(channel, m_ini + 1);
+            v(tgt);
             return 1;
         }
     }
 };
 
 /**
-   \brief We want the channels to be lazily created.
+   \brief Channels of the current thread. They are only set in threads created
+   using the Lua API, and are owned by the corresponding leanlua_thread object.
 */
-class data_channel_ref {
-    std::unique_ptr<data_channel> m_channel;
-    mutex                         m_mutex;
-public:
-    data_channel & get() {
-        lock_guard<mutex> lock(m_mutex);
-        if (!m_channel)
-            m_channel.reset(new data_channel());
-        lean_assert(m_channel);
-        return *m_channel;
-    }
-};
+static LEAN_THREAD_LOCAL data_channel * g_in_channel  = nullptr;
+static LEAN_THREAD_LOCAL data_channel * g_out_channel = nullptr;
 
-data_channel_ref g_in_channel;
-data_channel_ref g_out_channel;
+static void check_thread_channels() {
+    if (!g_in_channel || !g_out_channel)
+        throw exception("read/write can only be used in threads created using the 'thread' API");
+}
 
 int channel_read(lua_State * L) {
-    return g_in_channel.get().read(L, lua_gettop(L));
+    check_thread_channels();
+    return g_in_channel->read(L, lua_gettop(L));
 }
 
 int channel_write(lua_State * L) {
-    g_out_channel.get().write(L, 1, lua_gettop(L));
+    check_thread_channels();
+    g_out_channel->write(L, 1, lua_gettop(L));
+    return 0;
+}
+
+static int set_channel_capacity(lua_State * L) {
+    int n = luaL_checkinteger(L, 1);
+    if (n < 0)
+        throw exception("invalid channel capacity, it must be a non-negative number");
+    g_channel_capacity = n;
     return 0;
 }
 
 class leanlua_thread {
-    script_state                    m_state;
-    int                             m_sz_before;
-    std::unique_ptr<exception>      m_exception;
-    atomic<data_channel_ref *>      m_in_channel_addr;
-    atomic<data_channel_ref *>      m_out_channel_addr;
-    interruptible_thread            m_thread;
+    script_state                       m_state;
+    std::unique_ptr<script_state_pool> m_pool; // pool containing m_state (if any)
+    int                                m_sz_before;
+    std::unique_ptr<exception>         m_exception;
+    data_channel                       m_in_channel;
+    data_channel                       m_out_channel;
+    data_channel                       m_results;     // results of a thread executed in an object of m_pool
+    int                                m_num_results; // number of values in m_results
+    bool                               m_retrieved;   // true if the results have already been retrieved
+    interruptible_thread               m_thread;
 public:
-    leanlua_thread(script_state const & st, int sz_before, int num_args):
+    leanlua_thread(script_state const & st, script_state_pool const * pool, int sz_before, int num_args):
         m_state(st),
+        m_pool(pool ? new script_state_pool(*pool) : nullptr),
         m_sz_before(sz_before),
-        m_in_channel_addr(0),
-        m_out_channel_addr(0),
+        m_in_channel(g_channel_capacity),
+        m_out_channel(g_channel_capacity),
+        m_results(0),
+        m_num_results(0),
+        m_retrieved(false),
         m_thread([=]() {
-                m_in_channel_addr.store(&g_in_channel);
-                m_out_channel_addr.store(&g_out_channel);
+                g_in_channel  = &m_in_channel;
+                g_out_channel = &m_out_channel;
                 m_state.apply([&](lua_State * S) {
                         int result = lua_pcall(S, num_args, LUA_MULTRET, 0);
                         if (result) {
@@ -448,8 +710,17 @@ public:
                                 m_exception.reset(to_exception(S, -1).clone());
                             else
                                 m_exception.reset(new script_exception(lua_tostring(S, -1)));
+                        } else if (m_pool) {
+                            // save the results, m_state is returned to the pool when the thread finishes
+                            int sz_after = lua_gettop(S);
+                            if (sz_after > m_sz_before) {
+                                m_results.write(S, m_sz_before + 1, sz_after);
+                                m_num_results = sz_after - m_sz_before;
+                            }
                         }
                     });
+                if (m_pool)
+                    m_pool->release(m_state);
             }) {
     }
 
@@ -461,6 +732,14 @@ public:
     int copy_result(lua_State * src) {
         if (m_exception)
             m_exception->rethrow();
+        if (m_retrieved)
+            return 0; // results have already been retrieved
+        m_retrieved = true;
+        if (m_pool) {
+            for (int i = 0; i < m_num_results; i++)
+                m_results.read(src, 0);
+            return m_num_results;
+        }
         return m_state.apply([&](lua_State * S) {
                 int sz_after = lua_gettop(S);
                 if (sz_after > m_sz_before) {
@@ -480,26 +759,12 @@ public:
     }
 
     void write(lua_State * src, int first, int last) {
-        while (!m_in_channel_addr) {
-            check_interrupted();
-            this_thread::sleep_for(g_small_delay);
-        }
-        data_channel & in = m_in_channel_addr.load()->get();
-        in.write(src, first, last);
+        m_in_channel.write(src, first, last);
     }
 
     int read(lua_State * src) {
-        if (!m_out_channel_addr) {
-            check_interrupted();
-            this_thread::sleep_for(g_small_delay);
-        }
-        data_channel & out = m_out_channel_addr.load()->get();
         int nargs = lua_gettop(src);
-        return out.read(src, nargs == 1 ? 0 : 2);
-    }
-
-    bool started() {
-        return m_in_channel_addr && m_out_channel_addr;
+        return m_out_channel.read(src, nargs == 1 ? 0 : 2);
     }
 };
 
@@ -513,23 +778,38 @@ leanlua_thread & to_thread(lua_State * L, int idx) {
     return *static_cast<leanlua_thread*>(luaL_checkudata(L, idx, thread_mt));
 }
 
+/**
+   \brief Create a thread that executes a script in the given State object.
+   If a StatePool is provided instead, then the thread executes the script
+   in one of the objects of the pool, and returns it to the pool when the
+   script terminates. The lock of the current State is released while
+   waiting for an object of the pool.
+*/
 int mk_thread(lua_State * L) {
     check_threadsafe();
-    script_state & st   = to_state(L, 1);
     char const * script = luaL_checkstring(L, 2);
+    script_state_pool * pool = is_script_state_pool(L, 1) ? &to_script_state_pool(L, 1) : nullptr;
+    script_state caller = to_script_state(L);
+    script_state st     = pool ? pool->acquire(caller) : to_state(L, 1);
     int first           = 3;
     int last            = lua_gettop(L);
     int nargs           = first > last ? 0 : last - first + 1;
     int sz_before;
-    st.apply([&](lua_State * S) {
-            sz_before = lua_gettop(S);
-            int result  = luaL_loadstring(S, script);
-            if (result)
-                throw script_exception(lua_tostring(S, -1));
-            copy_values(L, first, last, S);
-        });
+    try {
+        st.apply([&](lua_State * S) {
+                sz_before = lua_gettop(S);
+                int result  = luaL_loadstring(S, script);
+                if (result)
+                    throw script_exception(lua_tostring(S, -1));
+                copy_values(L, first, last, S);
+            });
+    } catch (...) {
+        if (pool)
+            pool->release(st);
+        throw;
+    }
     void * mem = lua_newuserdata(L, sizeof(leanlua_thread));
-    new (mem) leanlua_thread(st, sz_before, nargs);
+    new (mem) leanlua_thread(st, pool, sz_before, nargs);
     luaL_getmetatable(L, thread_mt);
     lua_setmetatable(L, -2);
     return 1;
@@ -615,22 +895,115 @@ static int import(lua_State * L) {
     return 0;
 }
 
+static int get_allocated_memory(lua_State * L) {
+    return push_integer(L, get_allocated_memory());
+}
+
+static int get_thread_allocated_memory(lua_State * L) {
+    return push_integer(L, get_thread_allocated_memory());
+}
+
+static int get_peak_memory(lua_State * L) {
+    return push_integer(L, get_peak_memory());
+}
+
+static int alloc_profile(lua_State * L) {
+    std::vector<alloc_tag_info> tags;
+    get_alloc_profile(tags);
+    lua_newtable(L);
+    int i = 1;
+    for (alloc_tag_info const & info : tags) {
+        lua_newtable(L);
+        lua_pushstring(L, info.m_name);        lua_setfield(L, -2, "name");
+        lua_pushinteger(L, info.m_live);       lua_setfield(L, -2, "live");
+        lua_pushinteger(L, info.m_peak);       lua_setfield(L, -2, "peak");
+        lua_pushinteger(L, info.m_num_allocs); lua_setfield(L, -2, "allocs");
+        lua_pushinteger(L, info.m_num_frees);  lua_setfield(L, -2, "frees");
+        lua_rawseti(L, -2, i);
+        i++;
+    }
+    return 1;
+}
+
+static int display_alloc_profile(lua_State *) { // NOLINT
+    display_alloc_profile(std::cout);
+    return 0;
+}
+
+static int set_memory_limits(lua_State * L) {
+    set_soft_memory_limit(lua_tointeger(L, 1));
+    set_hard_memory_limit(lua_tointeger(L, 2));
+    return 0;
+}
+
+static int get_memory_limits(lua_State * L) {
+    push_integer(L, get_soft_memory_limit());
+    push_integer(L, get_hard_memory_limit());
+    return 2;
+}
+
+static void open_memory(lua_State * L) {
+    SET_GLOBAL_FUN(get_allocated_memory,        "get_allocated_memory");
+    SET_GLOBAL_FUN(get_thread_allocated_memory, "get_thread_allocated_memory");
+    SET_GLOBAL_FUN(get_peak_memory,             "get_peak_memory");
+    SET_GLOBAL_FUN(alloc_profile,               "alloc_profile");
+    SET_GLOBAL_FUN(display_alloc_profile,       "display_alloc_profile");
+    SET_GLOBAL_FUN(set_memory_limits,           "set_memory_limits");
+    SET_GLOBAL_FUN(get_memory_limits,           "get_memory_limits");
+}
+
+static int enable_perf(lua_State * L) {
+    int nargs = lua_gettop(L);
+    enable_perf(nargs == 0 || lua_toboolean(L, 1), nargs >= 2 && lua_toboolean(L, 2));
+    return 0;
+}
+
+static int reset_perf(lua_State *) { // NOLINT
+    reset_perf();
+    return 0;
+}
+
+static int display_perf_summary(lua_State *) { // NOLINT
+    display_perf_summary(std::cout);
+    return 0;
+}
+
+static int export_perf_trace(lua_State * L) {
+    char const * fname = luaL_checkstring(L, 1);
+    std::ofstream out(fname);
+    if (!out)
+        throw exception(sstream() << "failed to create trace file '" << fname << "'");
+    export_perf_trace(out);
+    return 0;
+}
+
+static void open_perf(lua_State * L) {
+    SET_GLOBAL_FUN(enable_perf,          "enable_perf");
+    SET_GLOBAL_FUN(reset_perf,           "reset_perf");
+    SET_GLOBAL_FUN(display_perf_summary, "display_perf_summary");
+    SET_GLOBAL_FUN(export_perf_trace,    "export_perf_trace");
+}
+
 static void open_interrupt(lua_State * L) {
-    SET_GLOBAL_FUN(check_interrupted, "check_interrupted");
-    SET_GLOBAL_FUN(sleep,             "sleep");
-    SET_GLOBAL_FUN(yield,             "yield");
+    SET_GLOBAL_FUN(check_interrupted,    "check_interrupted");
+    SET_GLOBAL_FUN(sleep,                "sleep");
+    SET_GLOBAL_FUN(yield,                "yield");
 #if defined(LEAN_MULTI_THREAD)
-    SET_GLOBAL_FUN(channel_read,      "read");
-    SET_GLOBAL_FUN(channel_write,     "write");
+    SET_GLOBAL_FUN(channel_read,         "read");
+    SET_GLOBAL_FUN(channel_write,        "write");
+    SET_GLOBAL_FUN(set_channel_capacity, "set_channel_capacity");
 #endif
 }
 
 void open_extra(lua_State * L) {
     open_state(L);
+    open_script_state_pool(L);
 #if defined(LEAN_MULTI_THREAD)
     open_thread(L);
 #endif
     open_interrupt(L);
+    open_memory(L);
+    open_perf(L);
 
     SET_GLOBAL_FUN(import, "import");
 }
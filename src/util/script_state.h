@@ -6,6 +6,7 @@ Author: Leonardo de Moura
 */
 #pragma once
 #include <memory>
+#include <functional>
 #include <lua.hpp>
 #include "util/thread.h"
 #include "util/unlock_guard.h"
@@ -88,4 +89,66 @@ public:
    \brief Return a reference to the script_state object that is wrapping \c L.
 */
 script_state to_script_state(lua_State * L);
+
+/**
+   \brief Pool of script_state objects. Each object in the pool has its own
+   Lua interpreter and lock. Thus, scripts executed in different objects
+   of the pool can run in parallel.
+
+   The objects are lazily created, and are reused after they are released.
+   So, scripts should not assume they are executed in a fresh interpreter.
+
+   Lean objects (e.g., names, levels, expressions and environments) are
+   transferred between interpreters by copying the reference, not the object.
+*/
+class script_state_pool {
+public:
+    struct imp;
+    typedef std::function<void(script_state &)> init_fn;
+private:
+    std::shared_ptr<imp> m_ptr;
+public:
+    /**
+       \brief Create a pool containing at most \c max_states interpreters.
+       The function \c fn is invoked whenever a new interpreter is created.
+       It can be used, for example, to import Lua files.
+    */
+    script_state_pool(unsigned max_states, init_fn const & fn = init_fn());
+    ~script_state_pool();
+
+    unsigned max_states() const;
+    /** \brief Return the number of interpreters created so far. */
+    unsigned num_states() const;
+    /**
+       \brief Make sure at least \c n interpreters have been created.
+       It is used to pay the initialization cost upfront (e.g., when a server starts).
+    */
+    void reserve(unsigned n);
+
+    /**
+       \brief Return an idle script_state object. If all objects are in use and
+       the pool is full, then it blocks until one of them is released.
+       This method throws an exception if the current thread is interrupted.
+    */
+    script_state acquire();
+    /**
+       \brief Similar to the previous method, but the lock of \c caller is released while waiting.
+       It must be used when \c acquire is invoked from a script executed in \c caller, otherwise
+       threads holding objects of the pool may deadlock waiting for \c caller.
+    */
+    script_state acquire(script_state & caller);
+    /** \brief Return \c s to the pool. */
+    void release(script_state const & s);
+};
+
+/** \brief Acquire a script_state object from a pool, and release it when this object is destructed. */
+class scoped_script_state {
+    script_state_pool & m_pool;
+    script_state        m_state;
+public:
+    scoped_script_state(script_state_pool & p):m_pool(p), m_state(p.acquire()) {}
+    scoped_script_state(script_state_pool & p, script_state & caller):m_pool(p), m_state(p.acquire(caller)) {}
+    ~scoped_script_state() { m_pool.release(m_state); }
+    script_state & get() { return m_state; }
+};
 }
@@ -9,6 +9,10 @@
 #include <cstring>
 #include <utility>
 #include <vector>
+#include <limits>
+#include "util/rc.h"
+#include "util/hash.h"
+#include "util/buffer.h"
 #include "util/sstream.h"
 #include "util/escaped.h"
 #include "util/interrupt.h"
@@ -74,14 +78,221 @@ unsigned get_pp_width(options const & o) {
     return o.get_unsigned(g_pp_width, LEAN_DEFAULT_PP_WIDTH);
 }
 
+/** \brief Base class used to represent format cells. */
+struct format_cell {
+    void dealloc();
+    MK_LEAN_RC()
+    format::format_kind m_kind;
+    bool                m_line;  // true iff a line break is found when computing m_space
+    unsigned            m_space; // space up to the first line break
+    unsigned            m_hash;
+    format_cell(format::format_kind k, unsigned space, bool line, unsigned h):
+        m_rc(1), m_kind(k), m_line(line), m_space(space), m_hash(h) {}
+    static format_cell * get(format const & f) { return f.m_ptr; }
+};
+
+/** \brief Format cell: text */
+struct format_text_cell : public format_cell {
+    std::string m_text;
+    bool        m_name; // true if the text was created using a hierarchical name
+    format_text_cell(std::string const & s, bool n):
+        format_cell(format::TEXT, s.size(), false, hash_str(s.size(), s.c_str(), 17)), m_text(s), m_name(n) {}
+};
+
+/** \brief Format cell: nest */
+struct format_nest_cell : public format_cell {
+    int    m_indent;
+    format m_fmt;
+    format_nest_cell(int i, format const & f):
+        format_cell(format::NEST, get(f)->m_space, get(f)->m_line, hash(get(f)->m_hash, static_cast<unsigned>(i))), m_indent(i), m_fmt(f) {}
+};
+
+/** \brief Format cell: choice, the space is the one of the second alternative (see \c pretty_fn). */
+struct format_choice_cell : public format_cell {
+    format m_first;
+    format m_second;
+    format_choice_cell(format const & f1, format const & f2):
+        format_cell(format::CHOICE, get(f2)->m_space, get(f2)->m_line, hash(get(f1)->m_hash, get(f2)->m_hash)),
+        m_first(f1), m_second(f2) {}
+};
+
+/** \brief Format cell: compose and flat compose */
+struct format_compose_cell : public format_cell {
+    std::vector<format> m_args;
+    format_compose_cell(format::format_kind k, std::vector<format> && args):
+        format_cell(k, 0, false, k), m_args(std::move(args)) {
+        for (format const & a : m_args) {
+            m_hash = hash(m_hash, get(a)->m_hash);
+            if (!m_line) {
+                unsigned sp = get(a)->m_space;
+                // saturate to avoid overflows
+                m_space     = sp > std::numeric_limits<unsigned>::max() - m_space ? std::numeric_limits<unsigned>::max() : m_space + sp;
+                m_line      = get(a)->m_line;
+            }
+        }
+    }
+};
+
+/** \brief Format cell: begin of highlighted region */
+struct format_color_begin_cell : public format_cell {
+    format::format_color m_color;
+    format_color_begin_cell(format::format_color c):format_cell(format::COLOR_BEGIN, 0, false, hash(static_cast<unsigned>(c), 31u)), m_color(c) {}
+};
+
+static format_text_cell * to_text(format_cell * c) { lean_assert(c->m_kind == format::TEXT); return static_cast<format_text_cell*>(c); }
+static format_nest_cell * to_nest(format_cell * c) { lean_assert(c->m_kind == format::NEST); return static_cast<format_nest_cell*>(c); }
+static format_choice_cell * to_choice(format_cell * c) { lean_assert(c->m_kind == format::CHOICE); return static_cast<format_choice_cell*>(c); }
+static format_compose_cell * to_compose(format_cell * c) {
+    lean_assert(c->m_kind == format::COMPOSE || c->m_kind == format::FLAT_COMPOSE);
+    return static_cast<format_compose_cell*>(c);
+}
+static format_color_begin_cell * to_color_begin(format_cell * c) {
+    lean_assert(c->m_kind == format::COLOR_BEGIN);
+    return static_cast<format_color_begin_cell*>(c);
+}
+
+void format_cell::dealloc() {
+    // Remark: we use an explicit stack because format objects built using operator+= are deep.
+    buffer<format_cell *> todo;
+    try {
+        todo.push_back(this);
+        while (!todo.empty()) {
+            format_cell * it = todo.back();
+            todo.pop_back();
+            auto release = [&](format & f) {
+                format_cell * c = f.steal_ptr();
+                if (c && c->dec_ref_core())
+                    todo.push_back(c);
+            };
+            switch (it->m_kind) {
+            case format::NIL: case format::LINE: case format::COLOR_END:
+                delete it;
+                break;
+            case format::TEXT:
+                delete to_text(it);
+                break;
+            case format::COLOR_BEGIN:
+                delete to_color_begin(it);
+                break;
+            case format::NEST:
+                release(to_nest(it)->m_fmt);
+                delete to_nest(it);
+                break;
+            case format::CHOICE:
+                release(to_choice(it)->m_first);
+                release(to_choice(it)->m_second);
+                delete to_choice(it);
+                break;
+            case format::COMPOSE: case format::FLAT_COMPOSE:
+                for (format & a : to_compose(it)->m_args)
+                    release(a);
+                delete to_compose(it);
+                break;
+            }
+        }
+    } catch (std::bad_alloc &) {
+        // We need this catch, because push_back may fail when expanding the buffer size.
+        // In this case, we avoid the crash, and "accept" the memory leak.
+    }
+}
+
+/** \brief Return a format cell that is never deleted, it is used to share nil, line and color end. */
+static format_cell * mk_shared_cell(format::format_kind k) {
+    format_cell * r = new format_cell(k, 0, k == format::LINE, hash(static_cast<unsigned>(k), 7u));
+    r->inc_ref();
+    return r;
+}
+static format_cell * nil_cell() {
+    static format_cell * r = mk_shared_cell(format::NIL);
+    return r;
+}
+static format_cell * line_cell() {
+    static format_cell * r = mk_shared_cell(format::LINE);
+    return r;
+}
+static format_cell * color_end_cell() {
+    static format_cell * r = mk_shared_cell(format::COLOR_END);
+    return r;
+}
+
+template<typename T> static std::string to_text_string(T const & v) {
+    std::ostringstream out;
+    out << v;
+    return out.str();
+}
+
+format format::mk_text(std::string const & s, bool is_name) { return format(new format_text_cell(s, is_name)); }
+format format::mk_compose(format_kind k, std::vector<format> && args) { return format(new format_compose_cell(k, std::move(args))); }
+format format::mk_color_begin(format_color c) { return format(new format_color_begin_cell(c)); }
+format format::mk_color_end() { format_cell * c = color_end_cell(); c->inc_ref(); return format(c); }
+
+format::format():m_ptr(nil_cell()) { m_ptr->inc_ref(); }
+format::format(char const * v):format(mk_text(v)) {}
+format::format(std::string const & v):format(mk_text(v)) {}
+format::format(int v):format(mk_text(to_text_string(v))) {}
+format::format(double v):format(mk_text(to_text_string(v))) {}
+format::format(unsigned v):format(mk_text(to_text_string(v))) {}
+format::format(name const & v):format(mk_text(to_text_string(v), true)) {}
+format::format(mpz const & v):format(mk_text(to_text_string(v))) {}
+format::format(mpq const & v):format(mk_text(to_text_string(v))) {}
+format::format(format const & f1, format const & f2):format(mk_compose(COMPOSE, std::vector<format>({f1, f2}))) {}
+format::format(format const & f):m_ptr(f.m_ptr) { if (m_ptr) m_ptr->inc_ref(); }
+format::format(std::initializer_list<format> const & l):format(mk_compose(COMPOSE, std::vector<format>(l))) {
+    lean_assert(l.size() >= 2);
+}
+format::~format() { if (m_ptr) m_ptr->dec_ref(); }
+format & format::operator=(format const & f) { LEAN_COPY_REF(f); }
+format & format::operator=(format && f) { LEAN_MOVE_REF(f); }
+
+format::format_kind format::kind() const { return m_ptr->m_kind; }
+unsigned format::hash() const { return m_ptr->m_hash; }
+
+bool is_name(format const & f) {
+    return f.kind() == format::TEXT && to_text(format_cell::get(f))->m_name;
+}
+
+/** \brief Legacy encoding: the kind is the head of a cons cell (see \c format(sexpr const &)). */
+static format::format_kind legacy_kind(sexpr const & s) {
+    return static_cast<format::format_kind>(to_int(car(s)));
+}
+
+format::format(sexpr const & s):format() {
+    // nil = ["NIL"], text s = ("TEXT" . s), choice f1 f2 = ("CHOICE" f1 . f2), compose f1 ... fn = ["COMPOSE" f1 ... fn]
+    // line = ["LINE"], nest n f = ("NEST" n . f), color begin c = ("COLOR_BEGIN" . c), color end = ["COLOR_END"]
+    switch (legacy_kind(s)) {
+    case NIL:         break;
+    case LINE:        *this = line(); break;
+    case COLOR_END:   *this = mk_color_end(); break;
+    case COLOR_BEGIN: *this = mk_color_begin(static_cast<format_color>(to_int(cdr(s)))); break;
+    case NEST:        *this = nest(to_int(car(cdr(s))), format(cdr(cdr(s)))); break;
+    case CHOICE:      *this = choice(format(car(cdr(s))), format(cdr(cdr(s)))); break;
+    case TEXT: {
+        sexpr const & t = cdr(s);
+        if (is_string(t))
+            *this = mk_text(to_string(t));
+        else
+            *this = mk_text(to_text_string(t), ::lean::is_name(t));
+        break;
+    }
+    case COMPOSE: case FLAT_COMPOSE: {
+        std::vector<format> args;
+        for_each(cdr(s), [&](sexpr const & a) { args.push_back(format(a)); });
+        *this = mk_compose(legacy_kind(s), std::move(args));
+        break;
+    }}
+}
+
+format choice(format const & f1, format const & f2) {
+    return format(new format_choice_cell(f1, f2));
+}
 format compose(format const & f1, format const & f2) {
-    return format(format::sexpr_compose({f1.m_value, f2.m_value}));
+    return format(f1, f2);
 }
 format nest(int i, format const & f) {
-    return format(format::sexpr_nest(i, f.m_value));
+    return format(new format_nest_cell(i, f));
 }
 format highlight(format const & f, format::format_color const c) {
-    return format(format::sexpr_highlight(f.m_value, c));
+    return format::mk_compose(format::COMPOSE, std::vector<format>({format::mk_color_begin(c), f, format::mk_color_end()}));
 }
 format highlight_keyword(format const & f) {
     return highlight(f, LEAN_KEYWORD_HIGHLIGHT_COLOR);
@@ -94,7 +305,9 @@ format highlight_command(format const & f) {
 }
 // Commonly used format objects
 format mk_line() {
-    return format(format::sexpr_line());
+    format_cell * c = line_cell();
+    c->inc_ref();
+    return format(c);
 }
 static format g_line(mk_line());
 static format g_space(" ");
@@ -119,42 +332,42 @@ format const & comma() { return g_comma; }
 format const & colon() { return g_colon; }
 format const & dot() { return g_dot; }
 // Auxiliary flag used to mark whether flatten
-// produce a different sexpr
+// produce a different format object
 static bool LEAN_THREAD_LOCAL g_diff_flatten = false;
 //
-sexpr format::flatten(sexpr const & s) {
-    lean_assert(is_cons(s));
-    switch (sexpr_kind(s)) {
+format format::flatten(format const & f) {
+    format_cell * c = f.m_ptr;
+    switch (c->m_kind) {
     case format_kind::NIL:
         /* flatten NIL = NIL */
-        return s;
+        return f;
     case format_kind::NEST:
         /* flatten (NEST i x) = flatten x */
-        return flatten(sexpr_nest_s(s));
-    case format_kind::COMPOSE:
+        return flatten(to_nest(c)->m_fmt);
+    case format_kind::COMPOSE: {
         /* flatten (s_1 <> ... <> s_n ) = flatten s_1 <> ... <> flatten s_n */
-        return sexpr_flat_compose(map(sexpr_compose_list(s),
-                                      [](sexpr const & s) {
-                                          return flatten(s);
-                                      }));
+        std::vector<format> const & args = to_compose(c)->m_args;
+        std::vector<format> new_args;
+        new_args.reserve(args.size());
+        for (format const & a : args)
+            new_args.push_back(flatten(a));
+        return mk_compose(format_kind::FLAT_COMPOSE, std::move(new_args));
+    }
     case format_kind::CHOICE:
         /* flatten (x <|> y) = flatten x */
         g_diff_flatten = true;
-        return flatten(sexpr_choice_1(s));
+        return flatten(to_choice(c)->m_first);
     case format_kind::LINE:
         g_diff_flatten = true;
-        return sexpr_text(sexpr(" "));
+        return format(" ");
     case format_kind::FLAT_COMPOSE:
     case format_kind::TEXT:
     case format_kind::COLOR_BEGIN:
     case format_kind::COLOR_END:
-        return s;
+        return f;
     }
     lean_unreachable(); // LCOV_EXCL_LINE
 }
-format format::flatten(format const & f){
-    return format(flatten(f.m_value));
-}
 format group(format const & f) {
     g_diff_flatten = false;
     format flat_f = format::flatten(f);
@@ -184,149 +397,132 @@ format wrap(format const & f1, format const & f2) {
                   f2};
 }
 
-/**
-   \brief Auxiliary exception used to sign that the amount of
-   available space was exhausted. It is used in \c space_upto_line_break and
-   \c space_upto_line_break_list_exceeded
-*/
-struct space_exceeded {};
+format operator+(format const & f1, format const & f2) {
+    return format{f1, f2};
+}
 
-/**
-   \brief Return true iff the space upto line break fits in the available space.
-*/
-bool format::space_upto_line_break_list_exceeded(sexpr const & s, int available, std::vector<std::pair<sexpr, unsigned>> const & todo) {
-    try {
-        bool found_newline = false;
-        available -= space_upto_line_break(s, available, found_newline);
-        auto it    = todo.end();
-        auto begin = todo.begin();
-        while (it != begin && !found_newline) {
-            --it;
-            if (available < 0)
-                return true;
-            available -= space_upto_line_break(it->first, available, found_newline);
-        }
-        return available < 0;
-    } catch (space_exceeded) {
-        return true;
-    }
+format operator^(format const & f1, format const & f2) {
+    return format {f1, format(" "), f2};
 }
 
 /**
-   \brief Return the space upto line break. If the space exceeds available, then throw an exception.
-*/
-int format::space_upto_line_break(sexpr const & s, int available, bool & found_newline) {
-    // s : format
-    lean_assert(!found_newline);
-    lean_assert(sexpr_kind(s) <= format_kind::COLOR_END);
+   \brief Layout engine for format objects.
 
-    switch (sexpr_kind(s)) {
-    case format_kind::NIL:
-    case format_kind::COLOR_BEGIN:
-    case format_kind::COLOR_END:
-    {
-        return 0;
-    }
-    case format_kind::COMPOSE:
-    case format_kind::FLAT_COMPOSE:
-    {
-        sexpr list  = sexpr_compose_list(s);
-        int len = 0;
-        while (!is_nil(list) && !found_newline) {
-            sexpr const & h = car(list);
-            list = cdr(list);
-            len += space_upto_line_break(h, available, found_newline);
-            if (len > available)
-                throw space_exceeded();
-        }
-        return len;
-    }
-    case format_kind::NEST:
-    {
-        sexpr const & x = sexpr_nest_s(s);
-        return space_upto_line_break(x, available, found_newline);
-    }
-    case format_kind::TEXT: {
-        return sexpr_text_length(s);
+   A choice <tt>x <|> y</tt> is resolved using \c x iff the text produced by \c x followed by
+   the rest of the document (up to the first line break) fits in the remaining space.
+   The rest of the document is measured using the second alternative of each choice.
+
+   The space up to the first line break is cached in each format cell, and each entry in the
+   stack of pending cells stores the space up to the first line break of itself followed by all
+   entries below it. So, each choice is resolved in constant time, and the layout is linear in
+   the size of the format object.
+
+   The output is accumulated in a buffer that is periodically flushed to the output stream.
+*/
+class pretty_fn {
+    typedef format::format_kind format_kind;
+    struct entry {
+        format_cell * m_cell;
+        unsigned      m_indent;
+        unsigned      m_rest; // space up to the first line break of this entry and the ones below it
+        entry(format_cell * c, unsigned i, unsigned r):m_cell(c), m_indent(i), m_rest(r) {}
+    };
+    static constexpr unsigned buffer_size = 8192;
+
+    std::ostream &     m_out;
+    unsigned           m_width;
+    bool               m_colors;
+    unsigned           m_pos;
+    std::string        m_buffer;
+    // Remark: the cells are alive while the format object being printed is alive.
+    std::vector<entry> m_todo;
+
+    unsigned rest() const { return m_todo.empty() ? 0 : m_todo.back().m_rest; }
+
+    static unsigned add(unsigned a, unsigned b) {
+        return a > std::numeric_limits<unsigned>::max() - b ? std::numeric_limits<unsigned>::max() : a + b;
     }
-    case format_kind::LINE:
-        found_newline = true;
-        return 0;
-    case format_kind::CHOICE:
-    {
-        sexpr const & x = sexpr_choice_2(s);
-        return space_upto_line_break(x, available, found_newline);
+
+    void push(format const & f, unsigned indent) {
+        format_cell * c = format_cell::get(f);
+        m_todo.emplace_back(c, indent, c->m_line ? c->m_space : add(c->m_space, rest()));
     }
+
+    void write(char const * s, size_t sz) {
+        m_buffer.append(s, sz);
+        if (m_buffer.size() >= buffer_size)
+            flush();
     }
-    lean_unreachable(); // LCOV_EXCL_LINE
-}
+    void write(std::string const & s) { write(s.data(), s.size()); }
 
-format operator+(format const & f1, format const & f2) {
-    return format{f1, f2};
-}
+    void flush() {
+        m_out.write(m_buffer.data(), m_buffer.size());
+        m_buffer.clear();
+    }
 
-format operator^(format const & f1, format const & f2) {
-    return format {f1, format(" "), f2};
-}
+public:
+    pretty_fn(std::ostream & out, unsigned w, bool colors):m_out(out), m_width(w), m_colors(colors), m_pos(0) {
+        m_buffer.reserve(buffer_size);
+    }
 
-std::ostream & format::pretty(std::ostream & out, unsigned w, bool colors, format const & f) {
-    unsigned pos        = 0;
-    std::vector<std::pair<sexpr, unsigned>> todo;
-    todo.push_back(std::make_pair(f.m_value, 0));
-    while (!todo.empty()) {
-        auto pair       = todo.back();
-        sexpr s         = pair.first;
-        unsigned indent = pair.second;
-        todo.pop_back();
-
-        switch (sexpr_kind(s)) {
-        case format_kind::NIL:
-            break;
-        case format_kind::COLOR_BEGIN:
-            if (colors) {
-                format::format_color c = static_cast<format::format_color>(to_int(cdr(s)));
-                out << "\e[" << (31 + c % 7) << "m";
+    void operator()(format const & f) {
+        push(f, 0);
+        while (!m_todo.empty()) {
+            format_cell * c = m_todo.back().m_cell;
+            unsigned indent = m_todo.back().m_indent;
+            m_todo.pop_back();
+
+            switch (c->m_kind) {
+            case format_kind::NIL:
+                break;
+            case format_kind::COLOR_BEGIN:
+                if (m_colors)
+                    write("\e[" + std::to_string(31 + to_color_begin(c)->m_color % 7) + "m");
+                break;
+            case format_kind::COLOR_END:
+                if (m_colors)
+                    write("\e[0m", 4);
+                break;
+            case format_kind::COMPOSE:
+            case format_kind::FLAT_COMPOSE: {
+                // the arguments are pushed in reverse order
+                std::vector<format> const & args = to_compose(c)->m_args;
+                for (unsigned i = args.size(); i-- > 0;)
+                    push(args[i], indent);
+                break;
             }
-            break;
-        case format_kind::COLOR_END:
-            if (colors) {
-                out << "\e[0m";
+            case format_kind::NEST:
+                push(to_nest(c)->m_fmt, indent + to_nest(c)->m_indent);
+                break;
+            case format_kind::LINE:
+                m_pos = indent;
+                write("\n", 1);
+                m_buffer.append(indent, ' ');
+                break;
+            case format_kind::TEXT: {
+                std::string const & str = to_text(c)->m_text;
+                m_pos += str.length();
+                write(str);
+                break;
             }
-            break;
-        case format_kind::COMPOSE:
-        case format_kind::FLAT_COMPOSE: {
-            unsigned old_sz     = todo.size();
-            for_each(sexpr_compose_list(s), [&](sexpr const & c) { todo.emplace_back(c, indent); });
-            std::reverse(todo.begin() + old_sz, todo.end());
-            break;
-        }
-        case format_kind::NEST:
-            todo.emplace_back(sexpr_nest_s(s), indent + sexpr_nest_i(s));
-            break;
-        case format_kind::LINE:
-            pos        = indent;
-            out << "\n";
-            for (unsigned i = 0; i < indent; i++)
-                out << " ";
-            break;
-        case format_kind::TEXT:
-            pos += sexpr_text_length(s);
-            if (is_string(cdr(s)))
-                out << to_string(cdr(s));
-            else
-                out << cdr(s);
-            break;
-        case format_kind::CHOICE: {
-            sexpr const & x = sexpr_choice_1(s);
-            sexpr const & y = sexpr_choice_2(s);;
-            int available   = static_cast<int>(w) - static_cast<int>(pos);
-            if (!space_upto_line_break_list_exceeded(x, available, todo))
-                todo.emplace_back(x, indent);
-            else
-                todo.emplace_back(y, indent);
-        }
+            case format_kind::CHOICE: {
+                format const & x    = to_choice(c)->m_first;
+                format_cell * xc    = format_cell::get(x);
+                long long space     = static_cast<long long>(xc->m_line ? xc->m_space : add(xc->m_space, rest()));
+                long long available = static_cast<long long>(m_width) - static_cast<long long>(m_pos);
+                if (space <= available)
+                    push(x, indent);
+                else
+                    push(to_choice(c)->m_second, indent);
+                break;
+            }}
         }
+        flush();
     }
+};
+
+std::ostream & format::pretty(std::ostream & out, unsigned w, bool colors, format const & f) {
+    pretty_fn(out, w, colors)(f);
     return out;
 }
 
@@ -63,6 +63,7 @@ public:
     sexpr_kind kind() const;
 
     explicit operator bool() const { return m_ptr != nullptr; }
+    sexpr_cell * raw() const { return m_ptr; }
 
     friend bool is_nil(sexpr const & s) { return s.m_ptr == nullptr; }
     friend sexpr const & head(sexpr const & s);
@@ -0,0 +1,34 @@
+local env = empty_environment()
+env = add_decls(env, {mk_var_decl("A", Bool),
+                      mk_var_decl("f", mk_arrow(Const("A"), mk_arrow(Const("A"), Const("A")))),
+                      mk_var_decl("a", Const("A")),
+                      mk_var_decl("b", Const("A"))})
+assert(env:find("f"))
+assert(env:find("b"))
+local f, a, b = Const("f"), Const("a"), Const("b")
+local t = mk_app(f, {a, b})
+assert(t == f(a, b))
+local g, args = t:args()
+assert(g == f)
+assert(#args == 2 and args[1] == a and args[2] == b)
+local h, args2 = a:args()
+assert(h == a and #args2 == 0)
+local s = f(t, f(a, Var(0)))
+local cs = s:find_all({kind=expr_kind.Constant})
+assert(#cs == 3)
+assert(#s:find_all({names=name_set("a", "b")}) == 2)
+assert(#s:find_all({kind=expr_kind.App, closed=true}) == 3)
+assert(s:replace({{a, b}, {Var(0), a}}) == f(f(b, b), f(b, a)))
+-- the free variables of the patterns and replacements are lifted under binders
+local l = mk_lambda("x", Const("A"), f(Var(0), Var(1)))
+assert(l:replace({{Var(0), a}}) == mk_lambda("x", Const("A"), f(Var(0), a)))
+assert(l:replace({{a, Var(0)}, {Var(0), b}}) == mk_lambda("x", Const("A"), f(Var(0), b)))
+assert(f(a, a):replace({{a, Var(0)}}) == f(Var(0), Var(0)))
+assert(mk_lambda("x", Const("A"), f(Var(0), a)):replace({{a, Var(0)}}) == mk_lambda("x", Const("A"), f(Var(0), Var(1))))
+local tc = type_checker(env)
+local ts = tc:infer_all({a, t, s:instantiate(a)})
+assert(#ts == 3)
+for i = 1, 3 do assert(ts[i] == Const("A")) end
+local cs2 = tc:check_all({a, t})
+assert(cs2[2] == Const("A"))
+assert(tc:whnf_all({t})[1] == t)
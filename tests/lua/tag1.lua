@@ -15,3 +15,4 @@ assert(new_t2:tag() == 2)
 assert(new_t2:binder_body():tag() == 1)
 assert(not (t2 == new_t2))
 
+assert(not pcall(function() t2:set_tag(2^31) end))
@@ -0,0 +1,23 @@
+local env = empty_environment()
+env = add_decls(env, {mk_var_decl("A", Bool), mk_var_decl("a", Const("A"))})
+local tc = type_checker(env)
+assert(tc:env():find("a"))
+local a  = Const("a")
+local x  = Const("x")
+local t  = Fun(x, Const("A"), x)(a)
+assert(tc:infer(t) == Const("A"))
+assert(tc:whnf(t) == a)
+local s1 = tc:stats()
+assert(s1.infer_type_cache_size > 0)
+assert(s1.whnf_cache_size + s1.whnf_core_cache_size > 0)
+assert(tc:infer(t) == Const("A"))
+assert(tc:whnf(t) == a)
+local s2 = tc:stats()
+assert(s2.infer_type_cache_hits > s1.infer_type_cache_hits)
+assert(s2.whnf_cache_hits + s2.whnf_core_cache_hits > s1.whnf_cache_hits + s1.whnf_core_cache_hits)
+tc:clear()
+local s3 = tc:stats()
+assert(s3.infer_type_cache_size == 0)
+assert(s3.whnf_cache_size == 0)
+assert(s3.whnf_core_cache_size == 0)
+assert(tc:infer(t) == Const("A"))
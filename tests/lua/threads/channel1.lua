@@ -0,0 +1,29 @@
+-- Lean objects are sent over channels without being copied
+set_channel_capacity(2)
+local S = State()
+local T = thread(S, [[
+   local n = read()
+   for i = 1, n do
+      local e   = read()
+      local l   = read()
+      local env = read()
+      write(Const("f")(e), mk_level_succ(l), env)
+   end
+]])
+local N = 20
+T:write(N)
+local env = empty_environment()
+for i = 1, N do
+   -- the channel has capacity 2, so the writer waits for the reader
+   T:write(Const("a"), mk_param_univ("l"), env)
+   local e   = T:read()
+   local l   = T:read()
+   local env2 = T:read()
+   assert(e == Const("f")(Const("a")))
+   assert(l == mk_level_succ(mk_param_univ("l")))
+   assert(is_environment(env2))
+end
+T:wait()
+set_channel_capacity(0)
+-- read/write can only be used in threads
+assert(not pcall(function() write(10) end))
@@ -0,0 +1,56 @@
+local f = Const("f")
+local a = Const("a")
+local l = mk_level_succ(mk_param_univ("l"))
+
+P = StatePool(2)
+assert(is_StatePool(P))
+assert(P:max_states() == 2)
+assert(P:num_states() == 0)
+local r1, r2 = P:eval([[
+   local t, l = ...
+   local g = Const("g")
+   return g(t), mk_level_succ(l)
+]], f(a), l)
+print(r1, r2)
+assert(r1 == Const("g")(f(a)))
+assert(r2 == mk_level_succ(l))
+assert(P:num_states() == 1)
+
+local code = [[
+   local id, t = ...
+   local r = t
+   for i = 1, 1000 do
+       r = Const("h")(r)
+   end
+   return id, r
+]]
+-- the interpreters are returned to the pool when the scripts terminate
+for j = 1, 2 do
+   local T = {}
+   for i = 1, 2 do
+      T[i] = thread(P, code, i, f(a))
+   end
+   for i = 1, 2 do
+      local id, r = T[i]:wait()
+      assert(id == i)
+      assert(is_expr(r))
+   end
+end
+assert(P:num_states() == 2)
+
+-- more threads than interpreters in the pool
+local T = {}
+for i = 1, 5 do
+   T[i] = thread(P, code, i, f(a))
+end
+for i = 1, 5 do
+   local id, r = T[i]:wait()
+   assert(id == i)
+end
+assert(P:num_states() == 2)
+
+P2 = StatePool(3)
+P2:reserve(2)
+assert(P2:num_states() == 2)
+P2:reserve(10)
+assert(P2:num_states() == 3)